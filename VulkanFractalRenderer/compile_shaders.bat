@@ -18,7 +18,7 @@ if not exist "x64\Release\shaders" mkdir "x64\Release\shaders"
 
 REM Compile the vertex shader
 echo Compiling vertex shader...
-"%VULKAN_SDK%\Bin\glslc.exe" VulkanFractalRenderer\shaders\fractal.vert -o VulkanFractalRenderer\shaders\fractal.vert.spv
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal.vert -o VulkanFractalRenderer\shaders\fractal.vert.spv
 if %ERRORLEVEL% neq 0 (
     echo Error compiling vertex shader!
     exit /b 1
@@ -26,12 +26,60 @@ if %ERRORLEVEL% neq 0 (
 
 REM Compile the fragment shader
 echo Compiling fragment shader...
-"%VULKAN_SDK%\Bin\glslc.exe" VulkanFractalRenderer\shaders\fractal.frag -o VulkanFractalRenderer\shaders\fractal.frag.spv
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal.frag -o VulkanFractalRenderer\shaders\fractal.frag.spv
 if %ERRORLEVEL% neq 0 (
     echo Error compiling fragment shader!
     exit /b 1
 )
 
+REM Compile the compute shaders
+echo Compiling compute shaders...
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal.comp -o VulkanFractalRenderer\shaders\fractal.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_color.comp -o VulkanFractalRenderer\shaders\fractal_color.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_resample.comp -o VulkanFractalRenderer\shaders\fractal_resample.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_histogram.comp -o VulkanFractalRenderer\shaders\fractal_histogram.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_histogram_subgroup.comp -o VulkanFractalRenderer\shaders\fractal_histogram_subgroup.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_cdf.comp -o VulkanFractalRenderer\shaders\fractal_cdf.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_aa_detect.comp -o VulkanFractalRenderer\shaders\fractal_aa_detect.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_aa_refine.comp -o VulkanFractalRenderer\shaders\fractal_aa_refine.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+"%VULKAN_SDK%\Bin\glslc.exe" --target-env=vulkan1.2 VulkanFractalRenderer\shaders\fractal_tiles.comp -o VulkanFractalRenderer\shaders\fractal_tiles.comp.spv
+if %ERRORLEVEL% neq 0 (
+    echo Error compiling compute shaders!
+    exit /b 1
+)
+
 REM Copy compiled shaders to output directories
 echo Copying shaders to output directories...
 copy /Y VulkanFractalRenderer\shaders\*.spv x64\Debug\shaders\
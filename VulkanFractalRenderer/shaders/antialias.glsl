@@ -0,0 +1,28 @@
+// Adaptive anti-aliasing, shared by fractal_aa_detect.comp and
+// fractal_aa_refine.comp. After the coloring pass, the detection pass lists
+// the pixels of the band whose neighbours disagree and counts the workgroups
+// of an indirect dispatch for them; the refinement pass then takes
+// ubo.antialiasSamples jittered samples for just those pixels. Requires
+// fractal_common.glsl for the UBO.
+
+// Refinement invocations per workgroup, one listed pixel each
+const uint AA_GROUP_SIZE = 64;
+
+// Neighbouring smooth iteration counts further apart than this mark an edge
+const float AA_ITERATION_THRESHOLD = 1.0;
+
+// Distance estimates closer to the boundary than this many pixels mark an
+// edge
+const float AA_DISTANCE_THRESHOLD = 1.0;
+
+// Pixels to refine, written by the detection pass. The first three words are
+// the VkDispatchIndirectCommand of the refinement pass; the header is reset
+// to (0, 1, 1, 0) before each detection pass.
+layout(std430, binding = 5) buffer RefineBuffer {
+    uint groupCountX;
+    uint groupCountY;
+    uint groupCountZ;
+    uint pixelCount;
+    // Indices into the band's iteration and color buffers
+    uint pixels[];
+} refine;
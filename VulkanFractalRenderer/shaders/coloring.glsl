@@ -0,0 +1,78 @@
+// Iteration count to color mapping. Included by the fragment shader and the
+// headless coloring pass; requires fractal_common.glsl for the UBO.
+
+// Every palette baked into one layer of a 1D texture array, indexed by
+// ubo.colorPalette (see PaletteLut). Binding 3 in every pass that includes
+// this file.
+layout(binding = 3) uniform sampler1DArray paletteLut;
+
+// CDF of the escaped iteration counts for COLOR_MAPPING_HISTOGRAM, written by
+// fractal_cdf.comp. Only the histogram passes use the counts.
+layout(std430, binding = 4) readonly buffer HistogramBuffer {
+    uint counts[HISTOGRAM_BINS];
+    float cdf[HISTOGRAM_BINS + 1];
+} histogram;
+
+// Look up a palette position in [0, 1]. Texel i holds the palette at
+// i / (size - 1), so 0 and 1 land on the first and last texel centers and
+// linear filtering interpolates between neighbouring samples.
+vec3 applyColorPalette(float t) {
+    float size = float(textureSize(paletteLut, 0).x);
+    float u = (clamp(t, 0.0, 1.0) * (size - 1.0) + 0.5) / size;
+    return textureLod(paletteLut, vec2(u, float(ubo.colorPalette)), 0.0).rgb;
+}
+
+// Palette octaves a distance estimate spans: distances from 0 to 1023
+// pixels run through the palette once
+const float DISTANCE_OCTAVES = 10.0;
+
+// Color of a distance estimate: black inside, a palette position rising
+// with the log of the distance in the image's pixels outside, darkened
+// within a pixel of the boundary so it is drawn as a sharp line at any
+// resolution. The pixel size is the frame's own, so resampled video frames
+// color the source's distances for their zoom.
+vec3 calculateDistanceColor(float distance) {
+    float pixels = distanceInPixels(distance);
+    if(pixels <= 0.0) {
+        return vec3(0.0, 0.0, 0.0);
+    }
+
+    float t = log2(1.0 + pixels) / DISTANCE_OCTAVES;
+    return applyColorPalette(fract(t + ubo.colorOffset)) * clamp(pixels, 0.0, 1.0);
+}
+
+// Calculate smooth coloring based on iteration count, or on the distance
+// estimate when that is the channel the iteration pass stored
+vec3 calculateColor(float iterations) {
+    if(ubo.outputChannel == OUTPUT_DISTANCE) {
+        return calculateDistanceColor(iterations);
+    }
+
+    // Black for maximum iterations (interior of set)
+    if(iterations >= float(ubo.maxIterations)) {
+        return vec3(0.0, 0.0, 0.0);
+    }
+    
+    // Palette position: the normalized iteration count, or the share of
+    // escaped pixels with fewer iterations, interpolated within the bin
+    float t;
+    if(ubo.colorMapping == COLOR_MAPPING_HISTOGRAM) {
+        float position = histogramPosition(iterations);
+        int bin = min(int(position), HISTOGRAM_BINS - 1);
+        t = mix(histogram.cdf[bin], histogram.cdf[bin + 1], position - float(bin));
+    } else {
+        t = iterations / float(ubo.maxIterations);
+    }
+
+    // Shifted around the palette for color cycling
+    return applyColorPalette(fract(t + ubo.colorOffset));
+}
+
+// The windowed renderer draws into an sRGB swap chain, which encodes the
+// fragment shader's output on store. The headless passes write packed bytes,
+// so they apply the same transfer function to match the screen.
+vec3 linearToSrgb(vec3 color) {
+    vec3 low = color * 12.92;
+    vec3 high = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+    return mix(low, high, step(vec3(0.0031308), color));
+}
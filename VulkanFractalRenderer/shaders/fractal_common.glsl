@@ -0,0 +1,365 @@
+// Shared fractal definitions: parameter block and escape-time kernels.
+// Included by the compute iteration pass and the coloring pass.
+
+// Fractal parameters, mirroring FractalUBO in FractalParameters.h
+struct FractalParameters {
+    float centerX;      // Center position X
+    float centerY;      // Center position Y
+    float scale;        // Zoom scale (larger for zoomed out)
+    float aspectRatio;  // Width/Height ratio of the viewport
+    
+    int fractalType;    // Type of fractal to render
+    int maxIterations;  // Maximum iteration count
+    int colorPalette;   // Color palette to use
+    int projection;     // How pixels map to the complex plane
+    
+    // For Julia set
+    float juliaConstantX;
+    float juliaConstantY;
+    // For Multibrot
+    float multibrotPower;
+    float colorOffset;  // Palette cycling, one full cycle per 1.0
+    
+    // Iteration buffer dimensions in pixels
+    int imageWidth;
+    int imageHeight;
+    // Band of image rows evaluated by one iteration pass dispatch
+    int rowOffset;
+    int rowCount;
+    
+    int colorMapping;   // Iteration count to palette position mapping
+    int outputChannel;  // What the iteration pass stores per pixel
+    int antialiasSamples; // Samples per edge pixel (headless only; 0 or 1 is off)
+    int interiorDetection; // Bit per fractal type with the derivative test on
+};
+
+// Uniform buffer containing fractal parameters. Everything below reads them
+// as ubo. Shaders that evaluate several views in one dispatch define
+// FRACTAL_PER_INVOCATION_PARAMETERS and get ubo as a private copy instead,
+// which they fill from the buffer and then point at each invocation's view
+// (see fractal_tiles.comp).
+#ifdef FRACTAL_PER_INVOCATION_PARAMETERS
+layout(binding = 0) uniform FractalUBO {
+    FractalParameters sharedParameters;
+};
+
+FractalParameters ubo;
+#else
+layout(binding = 0) uniform FractalUBO {
+    FractalParameters ubo;
+};
+#endif
+
+// Fractal types
+const int FRACTAL_MANDELBROT = 0;
+const int FRACTAL_JULIA = 1;
+const int FRACTAL_BURNING_SHIP = 2;
+const int FRACTAL_TRICORN = 3;
+const int FRACTAL_MULTIBROT = 4;
+
+// Projections
+const int PROJECTION_PLANE = 0;
+const int PROJECTION_EXP_MAP = 1;
+
+// Color mappings
+const int COLOR_MAPPING_LINEAR = 0;
+const int COLOR_MAPPING_HISTOGRAM = 1;
+
+// Output channels
+const int OUTPUT_ITERATIONS = 0;
+const int OUTPUT_DISTANCE = 1;
+
+// Most samples adaptive anti-aliasing takes per pixel
+const int MAX_ANTIALIAS_SAMPLES = 64;
+
+// A distance estimate in pixels of the image: plane pixels are 2 * scale /
+// imageHeight wide
+float distanceInPixels(float distance) {
+    return distance * float(ubo.imageHeight) / (2.0 * ubo.scale);
+}
+
+// Histogram-equalized coloring bins escaped iteration counts into at most
+// HISTOGRAM_BINS bins of equal width (one per count at lower limits). The
+// histogram passes count them and turn the counts into a CDF sampled at the
+// bin edges, which the coloring pass interpolates.
+const int HISTOGRAM_BINS = 2048;
+
+// Position of an iteration count in bin units, from 0 to the bin count
+float histogramPosition(float iterations) {
+    float binCount = float(min(ubo.maxIterations, HISTOGRAM_BINS));
+    return clamp(iterations * binCount / float(ubo.maxIterations), 0.0, binCount);
+}
+
+// Helper function to map complex plane to screen coordinates
+vec2 mapToComplex(vec2 coord) {
+    // Adjust for aspect ratio
+    vec2 c = coord;
+    c.x = c.x * 2.0 - 1.0;  // Map from [0,1] to [-1,1]
+    c.y = c.y * 2.0 - 1.0;  // Map from [0,1] to [-1,1]
+    
+    // Apply aspect ratio correction - multiply X by aspect ratio
+    c.x *= ubo.aspectRatio;
+    
+    // Apply zoom and panning
+    c *= ubo.scale;
+    c.x += ubo.centerX;
+    c.y += ubo.centerY;
+    
+    return c;
+}
+
+// Exponential map (log-polar) strip around the center: x is the angle, one
+// full turn across the image width, and y the log of the distance, falling
+// from scale at row 0 by the same step per row as the angle per column, so
+// strip pixels are square. Rendering the strip once covers every frame of a
+// zoom into the center (see fractal_resample.comp).
+vec2 mapExpMapToComplex(vec2 stripPixel) {
+    float step = 6.28318531 / float(ubo.imageWidth);
+    float angle = stripPixel.x * step;
+    float radius = ubo.scale * exp(-stripPixel.y * step);
+    return vec2(ubo.centerX, ubo.centerY) + radius * vec2(cos(angle), sin(angle));
+}
+
+// Escape radius of the kernels. Far larger than the radius of 2 that
+// decides escape, so the smooth iteration count below is accurate to well
+// under a palette texel.
+const float BAILOUT_RADIUS = 256.0;
+
+// Escape radius for z -> z^power + c. An orbit still inside the radius can
+// reach radius^power on its next step, which has to stay a finite float, so
+// high powers get a smaller radius: 2^(100 / power) keeps it below 2^100.
+// That is still outside every orbit of the set, which stays within
+// 2^(1 / (power - 1)), so escape is decided the same way.
+float bailoutRadius(float power) {
+    return min(BAILOUT_RADIUS, exp2(100.0 / power));
+}
+
+// Interior detection (ubo.interiorDetection, Mandelbrot and Julia only):
+// along an orbit drawn into an attracting cycle, the derivative of z with
+// respect to an earlier z shrinks geometrically, so once its magnitude falls
+// below this the point is declared interior instead of running on to
+// maxIterations. Exterior orbits only get there by passing within about
+// this distance of 0, which puts them next to a component center.
+const float INTERIOR_DERIVATIVE_THRESHOLD = 1e-3;
+
+// Whether interior detection is on for a fractal type
+bool interiorDetectionEnabled(int fractalType) {
+    return (ubo.interiorDetection & (1 << fractalType)) != 0;
+}
+
+// Multiply the orbit derivative by that of z -> z² + c at the new z and
+// test it against the threshold
+bool attracted(vec2 z, inout vec2 dz) {
+    dz = 2.0 * vec2(z.x * dz.x - z.y * dz.y, z.x * dz.y + z.y * dz.x);
+    return dot(dz, dz) < INTERIOR_DERIVATIVE_THRESHOLD * INTERIOR_DERIVATIVE_THRESHOLD;
+}
+
+// Continuous escape count of an orbit that left the bailout circle at
+// iteration i with value z, for z -> z^power + c: the log-log formula, which
+// rises smoothly from i to i + 1 between one band edge and the next. The
+// log of |z| is taken without squaring it, since |z| may be up to 2^100
+// (see bailoutRadius).
+float smoothIterations(int i, vec2 z, float power) {
+    float largest = max(abs(z.x), abs(z.y));
+    vec2 scaled = z / largest;
+    float logRadius = log(largest) + 0.5 * log(dot(scaled, scaled));
+    float fraction = 1.0 - log(logRadius / log(bailoutRadius(power))) / log(power);
+
+    // Stay below i + 1, which at the last iteration is the interior's count
+    return float(i) + clamp(fraction, 0.0, 0.9999);
+}
+
+// Mandelbrot fractal calculation
+float calculateMandelbrot(vec2 c) {
+    vec2 z = vec2(0.0, 0.0);
+    // Derivative with respect to z1 = c; z0 = 0 would make it 0 at once
+    vec2 dz = vec2(1.0, 0.0);
+    bool detectInterior = interiorDetectionEnabled(FRACTAL_MANDELBROT);
+    
+    for(int i = 0; i < ubo.maxIterations; i++) {
+        // z = z² + c
+        vec2 zSquared = vec2(
+            z.x * z.x - z.y * z.y,
+            2.0 * z.x * z.y
+        );
+        z = zSquared + c;
+        
+        // Check if escaped
+        if(dot(z, z) > BAILOUT_RADIUS * BAILOUT_RADIUS) {
+            return smoothIterations(i, z, 2.0);
+        }
+        
+        if(detectInterior && attracted(z, dz)) {
+            break;
+        }
+    }
+    
+    return float(ubo.maxIterations);
+}
+
+// Julia set calculation
+float calculateJulia(vec2 z) {
+    vec2 c = vec2(ubo.juliaConstantX, ubo.juliaConstantY);
+    vec2 dz = vec2(1.0, 0.0);
+    bool detectInterior = interiorDetectionEnabled(FRACTAL_JULIA);
+    
+    for(int i = 0; i < ubo.maxIterations; i++) {
+        // z = z² + c
+        vec2 zSquared = vec2(
+            z.x * z.x - z.y * z.y,
+            2.0 * z.x * z.y
+        );
+        z = zSquared + c;
+        
+        // Check if escaped
+        if(dot(z, z) > BAILOUT_RADIUS * BAILOUT_RADIUS) {
+            return smoothIterations(i, z, 2.0);
+        }
+        
+        if(detectInterior && attracted(z, dz)) {
+            break;
+        }
+    }
+    
+    return float(ubo.maxIterations);
+}
+
+// Burning Ship fractal calculation
+float calculateBurningShip(vec2 c) {
+    vec2 z = vec2(0.0, 0.0);
+    
+    for(int i = 0; i < ubo.maxIterations; i++) {
+        // Take absolute values
+        z = abs(z);
+        
+        // z = z² + c
+        vec2 zSquared = vec2(
+            z.x * z.x - z.y * z.y,
+            2.0 * z.x * z.y
+        );
+        z = zSquared + c;
+        
+        // Check if escaped
+        if(dot(z, z) > BAILOUT_RADIUS * BAILOUT_RADIUS) {
+            return smoothIterations(i, z, 2.0);
+        }
+    }
+    
+    return float(ubo.maxIterations);
+}
+
+// Tricorn (Mandelbar) fractal calculation
+float calculateTricorn(vec2 c) {
+    vec2 z = vec2(0.0, 0.0);
+    
+    for(int i = 0; i < ubo.maxIterations; i++) {
+        // z = conj(z)² + c
+        vec2 zSquared = vec2(
+            z.x * z.x - z.y * z.y,
+            -2.0 * z.x * z.y  // conjugate
+        );
+        z = zSquared + c;
+        
+        // Check if escaped
+        if(dot(z, z) > BAILOUT_RADIUS * BAILOUT_RADIUS) {
+            return smoothIterations(i, z, 2.0);
+        }
+    }
+    
+    return float(ubo.maxIterations);
+}
+
+// Multibrot fractal calculation with customizable power
+float calculateMultibrot(vec2 c) {
+    vec2 z = vec2(0.0, 0.0);
+    float power = max(2.0, ubo.multibrotPower); // Ensure power is at least 2 to avoid issues
+    float bailout = bailoutRadius(power);
+    
+    for(int i = 0; i < ubo.maxIterations; i++) {
+        // z = z^power + c (using complex polar form)
+        float r = length(z);
+        if(r > 0.0) {
+            float theta = atan(z.y, z.x);
+            float rPow = pow(r, power);
+            float newTheta = theta * power;
+            z = vec2(rPow * cos(newTheta), rPow * sin(newTheta)) + c;
+        } else {
+            z = c;
+        }
+        
+        // Check if escaped; |z| grows by the power per iteration, so the
+        // fraction of a band is measured in that base
+        if(length(z) > bailout) {
+            return smoothIterations(i, z, power);
+        }
+    }
+    
+    return float(ubo.maxIterations);
+}
+
+// Exterior distance estimate of point c: 0.5 |z| log|z| / |dz/dc| once the
+// orbit escapes, tracking the derivative alongside z (with respect to the
+// starting point for Julia sets). The Burning Ship and Tricorn are not
+// analytic, so for them the derivative is taken along the real axis of c
+// through the absolute value or conjugate, which estimates the distance just
+// as well. In complex plane units, 0 for points that never escape. One loop
+// serves every type; the branches are uniform across the dispatch.
+float calculateDistance(vec2 c) {
+    bool julia = ubo.fractalType == FRACTAL_JULIA;
+    vec2 z = julia ? c : vec2(0.0);
+    vec2 k = julia ? vec2(ubo.juliaConstantX, ubo.juliaConstantY) : c;
+    vec2 dz = julia ? vec2(1.0, 0.0) : vec2(0.0);
+    vec2 dk = julia ? vec2(0.0) : vec2(1.0, 0.0);
+    float power = ubo.fractalType == FRACTAL_MULTIBROT ? max(2.0, ubo.multibrotPower) : 2.0;
+    float bailout = bailoutRadius(power);
+
+    for(int i = 0; i < ubo.maxIterations; i++) {
+        if(ubo.fractalType == FRACTAL_BURNING_SHIP) {
+            dz *= sign(z);
+            z = abs(z);
+        } else if(ubo.fractalType == FRACTAL_TRICORN) {
+            dz.y = -dz.y;
+            z.y = -z.y;
+        }
+
+        // dz = power z^(power - 1) dz + dk, then z = z^power + k
+        if(ubo.fractalType == FRACTAL_MULTIBROT) {
+            float r = length(z);
+            float theta = atan(z.y, z.x);
+            float rDerivative = r > 0.0 ? power * pow(r, power - 1.0) : 0.0;
+            vec2 derivative = rDerivative * vec2(cos(theta * (power - 1.0)), sin(theta * (power - 1.0)));
+            dz = vec2(derivative.x * dz.x - derivative.y * dz.y, derivative.x * dz.y + derivative.y * dz.x) + dk;
+            z = r > 0.0 ? pow(r, power) * vec2(cos(theta * power), sin(theta * power)) + k : k;
+        } else {
+            dz = 2.0 * vec2(z.x * dz.x - z.y * dz.y, z.x * dz.y + z.y * dz.x) + dk;
+            z = vec2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + k;
+        }
+
+        if(length(z) > bailout) {
+            float radius = length(z);
+            return 0.5 * radius * log(radius) / length(dz);
+        }
+    }
+
+    return 0.0;
+}
+
+// Evaluate the selected fractal type at point c. Escaped points get a
+// continuous count below maxIterations, points that never escape exactly
+// maxIterations.
+float calculateIterations(vec2 c) {
+    switch(ubo.fractalType) {
+        case FRACTAL_MANDELBROT:
+            return calculateMandelbrot(c);
+        case FRACTAL_JULIA:
+            return calculateJulia(c);
+        case FRACTAL_BURNING_SHIP:
+            return calculateBurningShip(c);
+        case FRACTAL_TRICORN:
+            return calculateTricorn(c);
+        case FRACTAL_MULTIBROT:
+            return calculateMultibrot(c);
+        default:
+            return calculateMandelbrot(c);
+    }
+}
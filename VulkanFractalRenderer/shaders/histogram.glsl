@@ -0,0 +1,80 @@
+// Histogram pass of histogram-equalized coloring, shared by
+// fractal_histogram.comp and fractal_histogram_subgroup.comp (which defines
+// USE_SUBGROUPS). Counts the escaped iteration counts of a buffer into
+// HISTOGRAM_BINS bins; fractal_cdf.comp turns the counts into a CDF.
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+#include "fractal_common.glsl"
+
+// Pixels each invocation counts. Workgroups count into shared memory and add
+// their totals to the global histogram once, so the global atomics are
+// amortized over this many pixels times the workgroup size.
+const uint PIXELS_PER_INVOCATION = 32;
+
+// Iteration counts to count, row-major
+layout(std430, binding = 1) readonly buffer IterationBuffer {
+    float iterations[];
+};
+
+// Bin counts, cleared before this pass, and the CDF (same layout as in
+// coloring.glsl)
+layout(std430, binding = 4) buffer HistogramBuffer {
+    uint counts[HISTOGRAM_BINS];
+    float cdf[HISTOGRAM_BINS + 1];
+} histogram;
+
+// Number of iteration counts in the buffer, which for a resampling source
+// is not the image size in the UBO
+layout(push_constant) uniform HistogramRange {
+    uint pixelCount;
+} range;
+
+shared uint localCounts[HISTOGRAM_BINS];
+
+void main() {
+    uint groupSize = gl_WorkGroupSize.x;
+    for(uint bin = gl_LocalInvocationIndex; bin < uint(HISTOGRAM_BINS); bin += groupSize) {
+        localCounts[bin] = 0u;
+    }
+    barrier();
+
+    // Neighbouring invocations read neighbouring pixels, so a subgroup
+    // usually sees one or two distinct counts
+    uint groupStart = gl_WorkGroupID.x * groupSize * PIXELS_PER_INVOCATION;
+    uint binCount = uint(min(ubo.maxIterations, HISTOGRAM_BINS));
+    for(uint i = 0u; i < PIXELS_PER_INVOCATION; i++) {
+        uint pixel = groupStart + i * groupSize + gl_LocalInvocationIndex;
+
+        // Interior pixels stay black and take no part in the equalization
+        bool counted = false;
+        uint bin = 0u;
+        if(pixel < range.pixelCount) {
+            float count = iterations[pixel];
+            counted = count < float(ubo.maxIterations);
+            bin = min(uint(histogramPosition(count)), binCount - 1u);
+        }
+
+#ifdef USE_SUBGROUPS
+        // One shared atomic for the whole subgroup where every invocation
+        // has the same bin, which is the common case away from edges
+        uint key = counted ? bin : 0xffffffffu;
+        if(subgroupAllEqual(key)) {
+            uint activeCount = subgroupBallotBitCount(subgroupBallot(true));
+            if(counted && subgroupElect()) {
+                atomicAdd(localCounts[bin], activeCount);
+            }
+            continue;
+        }
+#endif
+        if(counted) {
+            atomicAdd(localCounts[bin], 1u);
+        }
+    }
+    barrier();
+
+    for(uint bin = gl_LocalInvocationIndex; bin < uint(HISTOGRAM_BINS); bin += groupSize) {
+        if(localCounts[bin] != 0u) {
+            atomicAdd(histogram.counts[bin], localCounts[bin]);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include "ApplicationSettings.h"
+#include <stdexcept>
+#include <sstream>
+
+// Map a present mode name from the command line to the Vulkan enum
+static VkPresentModeKHR ParsePresentMode(const std::string& name) {
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo-relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    throw std::runtime_error("Unknown present mode: " + name + " (expected fifo, fifo-relaxed, mailbox or immediate)");
+}
+
+ApplicationSettings ParseCommandLine(const std::string& commandLine) {
+    ApplicationSettings settings;
+
+    std::istringstream stream(commandLine);
+    std::string argument;
+    while (stream >> argument) {
+        size_t separator = argument.find('=');
+        std::string name = argument.substr(0, separator);
+        std::string value = separator != std::string::npos ? argument.substr(separator + 1) : std::string();
+
+        if (name == "--frames-in-flight" && !value.empty()) {
+            settings.framesInFlight = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--present-mode" && !value.empty()) {
+            settings.swapChain.presentMode = ParsePresentMode(value);
+        } else if (name == "--swapchain-images" && !value.empty()) {
+            settings.swapChain.imageCount = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--multi-gpu" && value.empty()) {
+            settings.multiGpu = true;
+        } else if (name == "--device" && !value.empty()) {
+            settings.deviceSelection.deviceOverride = value;
+        } else if (name == "--benchmark-devices" && value.empty()) {
+            settings.deviceSelection.benchmark = true;
+        } else if (name == "--gradient" && !value.empty()) {
+            settings.gradient = ParseGradient(value);
+        } else {
+            throw std::runtime_error("Unknown command line option: " + argument);
+        }
+    }
+
+    return settings;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "VulkanContext.h"
+#include "PaletteLut.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Startup options, typically parsed from the command line
+struct ApplicationSettings {
+    // Depth of the renderer's frame ring (1-4)
+    uint32_t framesInFlight = 2;
+    // Present mode and swap chain image count
+    SwapChainSettings swapChain;
+    // Physical device override and startup benchmark
+    DeviceSelectionSettings deviceSelection;
+    // Split each frame across all GPUs in the system
+    bool multiGpu = false;
+    // Custom palette to start with (see ParseGradient); empty for none
+    std::vector<PaletteStop> gradient;
+};
+
+// Parse whitespace-separated "--name=value" options. Throws on unknown options.
+ApplicationSettings ParseCommandLine(const std::string& commandLine);
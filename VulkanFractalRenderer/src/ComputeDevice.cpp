@@ -0,0 +1,1235 @@
+#include "ComputeDevice.h"
+#include "FractalParameters.h"
+#include "PaletteLut.h"
+#include "ShaderLoader.h"
+#include <stdexcept>
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+// Compute queue family of a physical device, preferring a compute-only family
+static bool FindComputeQueueFamily(VkPhysicalDevice device, uint32_t& family) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    bool found = false;
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        if (!(queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            continue;
+        }
+        if (!(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            family = i;
+            return true;
+        }
+        if (!found) {
+            family = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+ComputeDevice::ComputeDevice(VkPhysicalDevice physicalDevice, BandFormat format, const std::vector<const char*>& extensions)
+    : m_format(format)
+    , m_physicalDevice(physicalDevice)
+    , m_device(VK_NULL_HANDLE)
+    , m_queue(VK_NULL_HANDLE)
+    , m_queueFamily(0)
+    , m_commandPool(VK_NULL_HANDLE)
+    , m_timelineSemaphore(VK_NULL_HANDLE)
+    , m_timelineValue(0)
+    , m_descriptorSetLayout(VK_NULL_HANDLE)
+    , m_pipelineLayout(VK_NULL_HANDLE)
+    , m_pipeline(VK_NULL_HANDLE)
+    , m_colorPipeline(VK_NULL_HANDLE)
+    , m_resamplePipeline(VK_NULL_HANDLE)
+    , m_histogramPipeline(VK_NULL_HANDLE)
+    , m_cdfPipeline(VK_NULL_HANDLE)
+    , m_aaDetectPipeline(VK_NULL_HANDLE)
+    , m_aaRefinePipeline(VK_NULL_HANDLE)
+    , m_tilePipeline(VK_NULL_HANDLE)
+    , m_descriptorPool(VK_NULL_HANDLE)
+    , m_timestampPeriod(0.0f)
+    , m_maxStorageBufferSize(0)
+    , m_maxTileDispatch(0)
+    , m_slotCount(0)
+    , m_width(0)
+    , m_height(0)
+    , m_source(VK_NULL_HANDLE)
+    , m_sourceMemory(VK_NULL_HANDLE)
+    , m_sourceCapacity(0)
+    , m_sourceWidth(0)
+    , m_sourceHeight(0) {
+
+    VkPhysicalDeviceMaintenance3Properties maintenance3Properties{};
+    maintenance3Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_3_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 deviceProperties2{};
+    deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties2.pNext = &maintenance3Properties;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &deviceProperties2);
+
+    const VkPhysicalDeviceProperties& deviceProperties = deviceProperties2.properties;
+    m_name = deviceProperties.deviceName;
+    m_maxStorageBufferSize = std::min<VkDeviceSize>(deviceProperties.limits.maxStorageBufferRange,
+        maintenance3Properties.maxMemoryAllocationSize);
+    m_maxTileDispatch = deviceProperties.limits.maxComputeWorkGroupCount[2];
+
+    if (!FindComputeQueueFamily(m_physicalDevice, m_queueFamily)) {
+        throw std::runtime_error("No compute queue on GPU " + m_name + "!");
+    }
+
+    // Timestamps are needed to measure the device's share of the frame
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+    if (queueFamilies[m_queueFamily].timestampValidBits != 0) {
+        m_timestampPeriod = deviceProperties.limits.timestampPeriod;
+    }
+
+    try {
+        CreateLogicalDevice(extensions);
+        CreatePipelines();
+    }
+    catch (...) {
+        Destroy();
+        throw;
+    }
+}
+
+ComputeDevice::~ComputeDevice() {
+    Destroy();
+}
+
+void ComputeDevice::Destroy() {
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkDeviceWaitIdle(m_device);
+
+    DestroySlots();
+    DestroyResampleSource();
+    m_paletteLut.reset();
+
+    if (m_tilePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_tilePipeline, nullptr);
+    }
+
+    if (m_aaRefinePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_aaRefinePipeline, nullptr);
+    }
+
+    if (m_aaDetectPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_aaDetectPipeline, nullptr);
+    }
+
+    if (m_cdfPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_cdfPipeline, nullptr);
+    }
+
+    if (m_histogramPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_histogramPipeline, nullptr);
+    }
+
+    if (m_resamplePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_resamplePipeline, nullptr);
+    }
+
+    if (m_colorPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_colorPipeline, nullptr);
+    }
+
+    if (m_pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    }
+
+    if (m_pipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    }
+
+    if (m_descriptorSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    }
+
+    if (m_timelineSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_device, m_timelineSemaphore, nullptr);
+    }
+
+    if (m_commandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    }
+
+    vkDestroyDevice(m_device, nullptr);
+    m_device = VK_NULL_HANDLE;
+}
+
+std::vector<VkPhysicalDevice> ComputeDevice::FindSecondaryDevices(VkInstance instance, VkPhysicalDevice primaryDevice) {
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+    std::vector<VkPhysicalDevice> secondaryDevices;
+    for (const auto& device : devices) {
+        if (device == primaryDevice) {
+            continue;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+        // Only real GPUs; software rasterizers would slow the frame down
+        bool isGpu = deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ||
+            deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+        if (!isGpu || deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+            continue;
+        }
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        VkPhysicalDeviceFeatures2 deviceFeatures{};
+        deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        deviceFeatures.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+        uint32_t family = 0;
+        if (vulkan12Features.timelineSemaphore == VK_TRUE && FindComputeQueueFamily(device, family)) {
+            secondaryDevices.push_back(device);
+        }
+    }
+
+    return secondaryDevices;
+}
+
+double ComputeDevice::MeasureIterationTime(VkPhysicalDevice physicalDevice) {
+    // A 256x256 view of the whole Mandelbrot set: enough interior points at
+    // 1000 iterations to dominate dispatch overhead, small enough to run on a
+    // software rasterizer in well under a second
+    const uint32_t size = 256;
+    const int runs = 3;
+
+    FractalUBO ubo{};
+    ubo.centerX = -0.5f;
+    ubo.centerY = 0.0f;
+    ubo.scale = 1.0f;
+    ubo.aspectRatio = 1.0f;
+    ubo.fractalType = FRACTAL_MANDELBROT;
+    ubo.maxIterations = 1000;
+    ubo.imageWidth = static_cast<int>(size);
+    ubo.imageHeight = static_cast<int>(size);
+
+    ComputeDevice device(physicalDevice);
+    device.Configure(1, size, size);
+    std::vector<float> iterations(static_cast<size_t>(size) * size);
+
+    // Best of a few runs; the first one also pays for shader compilation
+    // inside the driver
+    double bestMilliseconds = 0.0;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        device.Dispatch(0, ubo, 0, size);
+        double milliseconds = device.ReadBand(0, iterations.data());
+
+        // Fall back to wall-clock time without timestamp support
+        if (milliseconds <= 0.0) {
+            milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        if (run == 0 || milliseconds < bestMilliseconds) {
+            bestMilliseconds = milliseconds;
+        }
+    }
+
+    return bestMilliseconds;
+}
+
+std::string ComputeDevice::GetHistogramShaderName(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 deviceProperties{};
+    deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties);
+
+    VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_VOTE_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    bool supported = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+        (subgroupProperties.supportedOperations & required) == required;
+    return supported ? "fractal_histogram_subgroup.comp.spv" : "fractal_histogram.comp.spv";
+}
+
+void ComputeDevice::CreateLogicalDevice(const std::vector<const char*>& extensions) {
+    float queuePriority = 1.0f;
+    VkDeviceQueueCreateInfo queueCreateInfo{};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = m_queueFamily;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+
+    // No swap chain: this device never presents
+    VkDeviceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &vulkan12Features;
+    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = &queueCreateInfo;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
+    if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create logical device for GPU " + m_name + "!");
+    }
+
+    vkGetDeviceQueue(m_device, m_queueFamily, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_queueFamily;
+
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create command pool for GPU " + m_name + "!");
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timelineSemaphore) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timeline semaphore for GPU " + m_name + "!");
+    }
+}
+
+void ComputeDevice::CreatePipelines() {
+    // Same bindings as the primary device's iteration pass, plus the packed
+    // pixels written by the coloring pass, the palettes it samples, the
+    // histogram it equalizes with, the pixels anti-aliasing refines and the
+    // descriptors of batched tiles
+    std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[3].binding = 3;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[3].descriptorCount = 1;
+    bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[4].binding = 4;
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[4].descriptorCount = 1;
+    bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[5].binding = 5;
+    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[5].descriptorCount = 1;
+    bindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[6].binding = 6;
+    bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[6].descriptorCount = 1;
+    bindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor set layout for GPU " + m_name + "!");
+    }
+
+    // The resampling pass gets the source's view as push constants; the UBO
+    // holds the frame's. The histogram pass gets its pixel count in the
+    // first four bytes.
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ResampleSource);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout for GPU " + m_name + "!");
+    }
+
+    m_pipeline = CreatePipeline("fractal.comp.spv");
+    if (m_format == BAND_FORMAT_RGBA8) {
+        m_colorPipeline = CreatePipeline("fractal_color.comp.spv");
+        m_resamplePipeline = CreatePipeline("fractal_resample.comp.spv");
+        m_histogramPipeline = CreatePipeline(GetHistogramShaderName(m_physicalDevice));
+        m_cdfPipeline = CreatePipeline("fractal_cdf.comp.spv");
+        m_aaDetectPipeline = CreatePipeline("fractal_aa_detect.comp.spv");
+        m_aaRefinePipeline = CreatePipeline("fractal_aa_refine.comp.spv");
+        m_tilePipeline = CreatePipeline("fractal_tiles.comp.spv");
+        m_paletteLut = std::make_unique<PaletteLut>(m_physicalDevice, m_device, m_queue, m_queueFamily);
+    }
+}
+
+VkPipeline ComputeDevice::CreatePipeline(const std::string& shaderName) {
+    auto shaderCode = LoadShaderCode(shaderName);
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+    moduleInfo.pCode = shaderCode.data();
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(m_device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shader module " + shaderName + " for GPU " + m_name + "!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute pipeline " + shaderName + " for GPU " + m_name + "! Error code: " + std::to_string(result));
+    }
+
+    return pipeline;
+}
+
+void ComputeDevice::Configure(uint32_t slotCount, uint32_t width, uint32_t height) {
+    vkDeviceWaitIdle(m_device);
+
+    DestroySlots();
+    m_slotCount = slotCount;
+    m_width = width;
+    m_height = height;
+    CreateSlots();
+}
+
+void ComputeDevice::CreateSlots() {
+    m_slots.resize(m_slotCount);
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = m_slotCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = m_slotCount * 5;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = m_slotCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = m_slotCount;
+
+    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool for GPU " + m_name + "!");
+    }
+
+    // Iteration counts and packed pixels are both 4 bytes per pixel
+    VkDeviceSize bandBufferSize = static_cast<VkDeviceSize>(m_width) * m_height * sizeof(uint32_t);
+
+    for (auto& slot : m_slots) {
+        CreateBuffer(sizeof(FractalUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            slot.uniformBuffer, slot.uniformBufferMemory);
+        vkMapMemory(m_device, slot.uniformBufferMemory, 0, sizeof(FractalUBO), 0, &slot.uniformBufferMapped);
+
+        // With a coloring pass the iteration counts never leave the GPU
+        if (m_format == BAND_FORMAT_RGBA8) {
+            CreateBuffer(bandBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                slot.iterationBuffer, slot.iterationBufferMemory);
+
+            // Pixels are copied out to a readback ring's staging buffer, so
+            // the shader writes stay in device memory
+            CreateBuffer(bandBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.colorBuffer, slot.colorBufferMemory);
+
+            // Counts are cleared with vkCmdFillBuffer before each histogram
+            CreateBuffer(HISTOGRAM_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.histogramBuffer, slot.histogramBufferMemory);
+
+            // A four-word header, the refinement pass's indirect dispatch
+            // and pixel count, then room for every pixel of a band
+            CreateBuffer(4 * sizeof(uint32_t) + bandBufferSize,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.refineBuffer, slot.refineBufferMemory);
+
+            // Square tiles of the configured width stacked down the band.
+            // Written by the CPU before each batch, so kept host-visible.
+            slot.tileCapacity = std::max(1u, m_height / std::max(1u, m_width));
+            VkDeviceSize tileBufferSize = static_cast<VkDeviceSize>(slot.tileCapacity) * sizeof(TileDescriptor);
+            CreateBuffer(tileBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                slot.tileBuffer, slot.tileBufferMemory);
+            vkMapMemory(m_device, slot.tileBufferMemory, 0, tileBufferSize, 0, &slot.tileBufferMapped);
+        }
+        else {
+            CreateReadbackBuffer(bandBufferSize, slot.iterationBuffer, slot.iterationBufferMemory, slot.readbackMapped);
+        }
+
+        // Descriptor set
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+        if (vkAllocateDescriptorSets(m_device, &allocInfo, &slot.descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate descriptor set for GPU " + m_name + "!");
+        }
+
+        VkDescriptorBufferInfo uniformInfo{ slot.uniformBuffer, 0, sizeof(FractalUBO) };
+        VkDescriptorBufferInfo iterationInfo{ slot.iterationBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo colorInfo{ slot.colorBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo histogramInfo{ slot.histogramBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo refineInfo{ slot.refineBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo tileInfo{ slot.tileBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorImageInfo paletteInfo{};
+        if (m_paletteLut) {
+            paletteInfo.sampler = m_paletteLut->GetSampler();
+            paletteInfo.imageView = m_paletteLut->GetImageView();
+            paletteInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+
+        std::array<VkWriteDescriptorSet, 7> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = slot.descriptorSet;
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &uniformInfo;
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = slot.descriptorSet;
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &iterationInfo;
+        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[2].dstSet = slot.descriptorSet;
+        descriptorWrites[2].dstBinding = 2;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[2].descriptorCount = 1;
+        descriptorWrites[2].pBufferInfo = &colorInfo;
+        descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[3].dstSet = slot.descriptorSet;
+        descriptorWrites[3].dstBinding = 3;
+        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[3].descriptorCount = 1;
+        descriptorWrites[3].pImageInfo = &paletteInfo;
+        descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[4].dstSet = slot.descriptorSet;
+        descriptorWrites[4].dstBinding = 4;
+        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[4].descriptorCount = 1;
+        descriptorWrites[4].pBufferInfo = &histogramInfo;
+        descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[5].dstSet = slot.descriptorSet;
+        descriptorWrites[5].dstBinding = 5;
+        descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[5].descriptorCount = 1;
+        descriptorWrites[5].pBufferInfo = &refineInfo;
+        descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[6].dstSet = slot.descriptorSet;
+        descriptorWrites[6].dstBinding = 6;
+        descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[6].descriptorCount = 1;
+        descriptorWrites[6].pBufferInfo = &tileInfo;
+
+        // The iteration pipeline never reads bindings 2 to 6, so they stay
+        // unwritten without a coloring pass
+        uint32_t writeCount = m_format == BAND_FORMAT_RGBA8 ? 7 : 2;
+        vkUpdateDescriptorSets(m_device, writeCount, descriptorWrites.data(), 0, nullptr);
+        slot.iterationSource = slot.iterationBuffer;
+        slot.colorTarget = slot.colorBuffer;
+
+        // Command buffer
+        VkCommandBufferAllocateInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = m_commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(m_device, &commandBufferInfo, &slot.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate command buffer for GPU " + m_name + "!");
+        }
+
+        // Start and end timestamps of the dispatch
+        if (m_timestampPeriod > 0.0f) {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = 2;
+
+            if (vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &slot.queryPool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create query pool for GPU " + m_name + "!");
+            }
+        }
+    }
+}
+
+void ComputeDevice::DestroySlots() {
+    for (auto& slot : m_slots) {
+        if (slot.queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(m_device, slot.queryPool, nullptr);
+        }
+
+        if (slot.commandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(m_device, m_commandPool, 1, &slot.commandBuffer);
+        }
+
+        if (slot.tileBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, slot.tileBuffer, nullptr);
+        }
+
+        if (slot.tileBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, slot.tileBufferMemory, nullptr);
+        }
+
+        if (slot.refineBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, slot.refineBuffer, nullptr);
+        }
+
+        if (slot.refineBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, slot.refineBufferMemory, nullptr);
+        }
+
+        if (slot.histogramBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, slot.histogramBuffer, nullptr);
+        }
+
+        if (slot.histogramBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, slot.histogramBufferMemory, nullptr);
+        }
+
+        if (slot.colorBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, slot.colorBuffer, nullptr);
+        }
+
+        if (slot.colorBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, slot.colorBufferMemory, nullptr);
+        }
+
+        if (slot.iterationBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, slot.iterationBuffer, nullptr);
+        }
+
+        if (slot.iterationBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, slot.iterationBufferMemory, nullptr);
+        }
+
+        if (slot.uniformBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, slot.uniformBuffer, nullptr);
+        }
+
+        if (slot.uniformBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, slot.uniformBufferMemory, nullptr);
+        }
+    }
+    m_slots.clear();
+
+    // Descriptor sets are freed with the pool
+    if (m_descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+        m_descriptorPool = VK_NULL_HANDLE;
+    }
+}
+
+VkCommandBuffer ComputeDevice::RecordBand(uint32_t slotIndex, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount,
+    BandPasses passes, const ResampleSource* view) {
+    BandSlot& slot = m_slots[slotIndex];
+
+    // The slot is normally already retired by ReadBand or a readback ring
+    WaitForTimelineValue(slot.timelineValue);
+
+    FractalUBO bandUbo = ubo;
+    bandUbo.rowOffset = static_cast<int>(rowOffset);
+    bandUbo.rowCount = static_cast<int>(rowCount);
+    memcpy(slot.uniformBufferMapped, &bandUbo, sizeof(bandUbo));
+    slot.rowCount = rowCount;
+
+    VkCommandBuffer commandBuffer = slot.commandBuffer;
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording command buffer on GPU " + m_name + "!");
+    }
+
+    if (slot.queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, slot.queryPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.queryPool, 0);
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+        &slot.descriptorSet, 0, nullptr);
+
+    bool equalize = ubo.colorMapping == COLOR_MAPPING_HISTOGRAM && ubo.outputChannel == OUTPUT_ITERATIONS &&
+        m_histogramPipeline != VK_NULL_HANDLE;
+
+    if (passes == BAND_PASSES_RESAMPLE) {
+        // Source rows written by earlier submissions on this queue
+        VkMemoryBarrier sourceBarrier{};
+        sourceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        sourceBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        sourceBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &sourceBarrier, 0, nullptr, 0, nullptr);
+
+        if (equalize) {
+            RecordHistogram(commandBuffer, slotIndex, m_sourceWidth * m_sourceHeight);
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resamplePipeline);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResampleSource), view);
+        vkCmdDispatch(commandBuffer, (m_width + 7) / 8, (rowCount + 7) / 8, 1);
+    }
+    else if (passes == BAND_PASSES_TILES) {
+        // One z slice per tile; the shader evaluates and colors in one go
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_tilePipeline);
+        vkCmdDispatch(commandBuffer, (m_width + 7) / 8, (m_width + 7) / 8, rowCount / m_width);
+    }
+    else {
+        uint32_t width = m_width;
+        if (passes == BAND_PASSES_SOURCE) {
+            // Frames submitted earlier may still be resampling the previous
+            // source out of the same memory; the execution dependency covers
+            // their reads
+            VkMemoryBarrier sourceBarrier{};
+            sourceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            sourceBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            sourceBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &sourceBarrier, 0, nullptr, 0, nullptr);
+            width = m_sourceWidth;
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        vkCmdDispatch(commandBuffer, (width + 7) / 8, (rowCount + 7) / 8, 1);
+    }
+
+    if (passes == BAND_PASSES_IMAGE && m_colorPipeline != VK_NULL_HANDLE) {
+        // The coloring pass reads the iteration counts just written
+        VkMemoryBarrier iterationBarrier{};
+        iterationBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        iterationBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        iterationBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &iterationBarrier, 0, nullptr, 0, nullptr);
+
+        if (equalize) {
+            RecordHistogram(commandBuffer, slotIndex, m_width * rowCount);
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_colorPipeline);
+        vkCmdDispatch(commandBuffer, (m_width + 7) / 8, (rowCount + 7) / 8, 1);
+
+        if (ubo.antialiasSamples > 1) {
+            RecordAntialiasing(commandBuffer, slotIndex, rowCount);
+        }
+    }
+
+    if (slot.queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, slot.queryPool, 1);
+    }
+
+    return commandBuffer;
+}
+
+void ComputeDevice::RecordHistogram(VkCommandBuffer commandBuffer, uint32_t slotIndex, uint32_t pixelCount) {
+    const BandSlot& slot = m_slots[slotIndex];
+
+    // Earlier bands of the slot have retired, so only the clear has to come
+    // before the histogram's atomics
+    vkCmdFillBuffer(commandBuffer, slot.histogramBuffer, 0, HISTOGRAM_BINS * sizeof(uint32_t), 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_histogramPipeline);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pixelCount), &pixelCount);
+    vkCmdDispatch(commandBuffer, (pixelCount + HISTOGRAM_PIXELS_PER_GROUP - 1) / HISTOGRAM_PIXELS_PER_GROUP, 1, 1);
+
+    // The CDF pass reads the finished counts and the coloring pass the CDF
+    VkMemoryBarrier histogramBarrier{};
+    histogramBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    histogramBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    histogramBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &histogramBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cdfPipeline);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &histogramBarrier, 0, nullptr, 0, nullptr);
+}
+
+void ComputeDevice::RecordAntialiasing(VkCommandBuffer commandBuffer, uint32_t slotIndex, uint32_t rowCount) {
+    const BandSlot& slot = m_slots[slotIndex];
+
+    // An empty refinement dispatch, which the detection pass grows one
+    // workgroup at a time
+    const uint32_t header[4] = { 0, 1, 1, 0 };
+    vkCmdUpdateBuffer(commandBuffer, slot.refineBuffer, 0, sizeof(header), header);
+
+    VkMemoryBarrier headerBarrier{};
+    headerBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    headerBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    headerBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &headerBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_aaDetectPipeline);
+    vkCmdDispatch(commandBuffer, (m_width + 7) / 8, (rowCount + 7) / 8, 1);
+
+    // The refinement pass is sized by the detection pass's counts and
+    // overwrites pixels of the coloring pass
+    VkMemoryBarrier detectBarrier{};
+    detectBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    detectBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    detectBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &detectBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_aaRefinePipeline);
+    vkCmdDispatchIndirect(commandBuffer, slot.refineBuffer, 0);
+}
+
+uint64_t ComputeDevice::SubmitBand(uint32_t slotIndex) {
+    BandSlot& slot = m_slots[slotIndex];
+    VkCommandBuffer commandBuffer = slot.commandBuffer;
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer on GPU " + m_name + "!");
+    }
+
+    uint64_t signalValue = m_timelineValue + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_timelineSemaphore;
+
+    if (vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit command buffer on GPU " + m_name + "!");
+    }
+
+    m_timelineValue = signalValue;
+    slot.timelineValue = signalValue;
+    return signalValue;
+}
+
+void ComputeDevice::Dispatch(uint32_t slotIndex, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount) {
+    if (m_format != BAND_FORMAT_ITERATIONS) {
+        throw std::runtime_error("Bands of finished pixels are read back with DispatchToBuffer!");
+    }
+
+    VkCommandBuffer commandBuffer = RecordBand(slotIndex, ubo, rowOffset, rowCount);
+
+    // Make the shader writes visible to the CPU
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    SubmitBand(slotIndex);
+}
+
+void ComputeDevice::BindSlotBuffers(uint32_t slotIndex, VkBuffer iterations, VkDeviceSize iterationOffset, VkBuffer colors) {
+    BandSlot& slot = m_slots[slotIndex];
+    bool iterationsChanged = slot.iterationSource != iterations || slot.iterationSourceOffset != iterationOffset;
+    bool colorsChanged = slot.colorTarget != colors;
+    if (!iterationsChanged && !colorsChanged) {
+        return;
+    }
+
+    // The slot's previous dispatch has retired, so its set is not in use
+    WaitForTimelineValue(slot.timelineValue);
+
+    VkDescriptorBufferInfo iterationInfo{ iterations, iterationOffset, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo colorInfo{ colors, 0, VK_WHOLE_SIZE };
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+    uint32_t writeCount = 0;
+    if (iterationsChanged) {
+        VkWriteDescriptorSet& write = descriptorWrites[writeCount++];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = slot.descriptorSet;
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &iterationInfo;
+    }
+    if (colorsChanged) {
+        VkWriteDescriptorSet& write = descriptorWrites[writeCount++];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = slot.descriptorSet;
+        write.dstBinding = 2;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &colorInfo;
+    }
+
+    vkUpdateDescriptorSets(m_device, writeCount, descriptorWrites.data(), 0, nullptr);
+    slot.iterationSource = iterations;
+    slot.iterationSourceOffset = iterationOffset;
+    slot.colorTarget = colors;
+}
+
+uint64_t ComputeDevice::DispatchToBuffer(uint32_t slotIndex, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount,
+    const BandDestination& destination) {
+    if (m_format != BAND_FORMAT_RGBA8) {
+        throw std::runtime_error("DispatchToBuffer needs a coloring pass!");
+    }
+
+    const BandSlot& slot = m_slots[slotIndex];
+    BindSlotBuffers(slotIndex, slot.iterationBuffer, 0, destination.colorInPlace ? destination.pixels : slot.colorBuffer);
+
+    VkCommandBuffer commandBuffer = RecordBand(slotIndex, ubo, rowOffset, rowCount);
+    return SubmitToBuffer(slotIndex, commandBuffer, rowCount, destination);
+}
+
+uint64_t ComputeDevice::DispatchTilesToBuffer(uint32_t slotIndex, const FractalUBO& ubo, const TileDescriptor* tiles,
+    uint32_t tileCount, uint32_t tileSize, const BandDestination& destination) {
+    if (m_format != BAND_FORMAT_RGBA8) {
+        throw std::runtime_error("DispatchTilesToBuffer needs a coloring pass!");
+    }
+    if (tileCount == 0 || tileSize != m_width || tileCount > m_slots[slotIndex].tileCapacity) {
+        throw std::runtime_error("Tile batch does not fit the configured band size!");
+    }
+
+    const BandSlot& slot = m_slots[slotIndex];
+    BindSlotBuffers(slotIndex, slot.iterationBuffer, 0, destination.colorInPlace ? destination.pixels : slot.colorBuffer);
+
+    // The slot's previous dispatch may still be reading the descriptors
+    WaitForTimelineValue(slot.timelineValue);
+    memcpy(slot.tileBufferMapped, tiles, static_cast<size_t>(tileCount) * sizeof(TileDescriptor));
+
+    uint32_t rowCount = tileSize * tileCount;
+    VkCommandBuffer commandBuffer = RecordBand(slotIndex, ubo, 0, rowCount, BAND_PASSES_TILES);
+    return SubmitToBuffer(slotIndex, commandBuffer, rowCount, destination);
+}
+
+uint32_t ComputeDevice::GetMaxTileCount(uint32_t tileSize) const {
+    // Iteration, color and readback buffers hold 4 bytes per pixel, the
+    // descriptor buffer one TileDescriptor per tile
+    VkDeviceSize tileBytes = std::max<VkDeviceSize>(static_cast<VkDeviceSize>(tileSize) * tileSize * 4,
+        sizeof(TileDescriptor));
+    return static_cast<uint32_t>(std::min<VkDeviceSize>(m_maxStorageBufferSize / tileBytes, m_maxTileDispatch));
+}
+
+uint64_t ComputeDevice::SubmitToBuffer(uint32_t slotIndex, VkCommandBuffer commandBuffer, uint32_t rowCount,
+    const BandDestination& destination) {
+    const BandSlot& slot = m_slots[slotIndex];
+
+    if (!destination.colorInPlace) {
+        // Copy the finished pixels once the coloring pass has written them
+        VkMemoryBarrier colorBarrier{};
+        colorBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        colorBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        colorBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &colorBarrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = static_cast<VkDeviceSize>(rowCount) * m_width * sizeof(uint32_t);
+        vkCmdCopyBuffer(commandBuffer, slot.colorBuffer, destination.pixels, 1, &copyRegion);
+    }
+
+    // The dispatch timestamps travel with the pixels, so the slot can be
+    // reused before the host looks at them
+    if (slot.queryPool != VK_NULL_HANDLE) {
+        vkCmdCopyQueryPoolResults(commandBuffer, slot.queryPool, 0, 2, destination.timestamps, 0,
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    }
+    else {
+        vkCmdFillBuffer(commandBuffer, destination.timestamps, 0, 2 * sizeof(uint64_t), 0);
+    }
+
+    // Make the shader writes and copies visible to the CPU
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    // Memory imported elsewhere is handed over to the external queue family.
+    // It is not acquired back: the next band overwrites all of it, and
+    // exclusive resources may be used without a transfer if their previous
+    // contents are not needed.
+    VkBufferMemoryBarrier releaseBarrier{};
+    releaseBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    releaseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    releaseBarrier.dstAccessMask = 0;
+    releaseBarrier.srcQueueFamilyIndex = m_queueFamily;
+    releaseBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    releaseBarrier.buffer = destination.pixels;
+    releaseBarrier.offset = 0;
+    releaseBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, destination.releaseToExternal ? 1 : 0, &releaseBarrier, 0, nullptr);
+
+    return SubmitBand(slotIndex);
+}
+
+void ComputeDevice::ReserveResampleSource(uint64_t pixelCount) {
+    if (m_format != BAND_FORMAT_RGBA8) {
+        throw std::runtime_error("Resampled frames need a coloring pass!");
+    }
+    if (pixelCount <= m_sourceCapacity) {
+        return;
+    }
+
+    VkDeviceSize sourceSize = static_cast<VkDeviceSize>(pixelCount) * sizeof(float);
+    if (sourceSize > m_maxStorageBufferSize) {
+        throw std::runtime_error("Resampling source of " + std::to_string(pixelCount) +
+            " pixels exceeds the largest storage buffer on GPU " + m_name + "!");
+    }
+
+    // Slots may still be reading the old source
+    vkDeviceWaitIdle(m_device);
+    DestroyResampleSource();
+
+    CreateBuffer(sourceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_source, m_sourceMemory);
+    m_sourceCapacity = pixelCount;
+}
+
+void ComputeDevice::DestroyResampleSource() {
+    // Descriptor sets pointing at the source must not be reused as they are
+    for (auto& slot : m_slots) {
+        if (slot.iterationSource == m_source) {
+            slot.iterationSource = VK_NULL_HANDLE;
+        }
+    }
+
+    if (m_source != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, m_source, nullptr);
+        m_source = VK_NULL_HANDLE;
+    }
+
+    if (m_sourceMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(m_device, m_sourceMemory, nullptr);
+        m_sourceMemory = VK_NULL_HANDLE;
+    }
+
+    m_sourceCapacity = 0;
+    m_sourceWidth = 0;
+    m_sourceHeight = 0;
+}
+
+uint64_t ComputeDevice::DispatchSourceBand(uint32_t slotIndex, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount) {
+    uint32_t width = static_cast<uint32_t>(ubo.imageWidth);
+    uint32_t height = static_cast<uint32_t>(ubo.imageHeight);
+    if (ubo.imageWidth <= 0 || ubo.imageHeight <= 0 || static_cast<uint64_t>(width) * height > m_sourceCapacity) {
+        throw std::runtime_error("Resampling source does not fit the memory reserved for it!");
+    }
+    if (rowOffset % SOURCE_BAND_ALIGNMENT != 0 || rowOffset + rowCount > height) {
+        throw std::runtime_error("Resampling source band out of place!");
+    }
+
+    // The iteration pass writes from the start of its binding, so the band
+    // is bound at its first row. 64 rows of 4-byte counts are a multiple of
+    // 256 bytes, the largest storage buffer offset alignment Vulkan allows.
+    const BandSlot& slot = m_slots[slotIndex];
+    VkDeviceSize bandOffset = static_cast<VkDeviceSize>(rowOffset) * width * sizeof(float);
+    BindSlotBuffers(slotIndex, m_source, bandOffset, slot.colorTarget);
+
+    m_sourceWidth = width;
+    m_sourceHeight = height;
+
+    RecordBand(slotIndex, ubo, rowOffset, rowCount, BAND_PASSES_SOURCE);
+    return SubmitBand(slotIndex);
+}
+
+uint64_t ComputeDevice::DispatchResampleToBuffer(uint32_t slotIndex, const FractalUBO& ubo, const ResampleSource& view,
+    const BandDestination& destination) {
+    if (m_sourceHeight == 0) {
+        throw std::runtime_error("No resampling source to color from!");
+    }
+
+    // The shader's reads are bounded by the size it is told
+    if (view.width != static_cast<int>(m_sourceWidth) || view.height != static_cast<int>(m_sourceHeight)) {
+        throw std::runtime_error("Resampling source size does not match the last source dispatched!");
+    }
+
+    const BandSlot& slot = m_slots[slotIndex];
+    BindSlotBuffers(slotIndex, m_source, 0, destination.colorInPlace ? destination.pixels : slot.colorBuffer);
+
+    VkCommandBuffer commandBuffer = RecordBand(slotIndex, ubo, 0, m_height, BAND_PASSES_RESAMPLE, &view);
+    return SubmitToBuffer(slotIndex, commandBuffer, m_height, destination);
+}
+
+double ComputeDevice::GetTimestampDuration(const uint64_t timestamps[2]) const {
+    if (m_timestampPeriod == 0.0f || timestamps[1] <= timestamps[0]) {
+        return 0.0;
+    }
+    return static_cast<double>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6;
+}
+
+double ComputeDevice::ReadBand(uint32_t slotIndex, void* destination) {
+    BandSlot& slot = m_slots[slotIndex];
+    if (slot.readbackMapped == nullptr) {
+        throw std::runtime_error("Bands of finished pixels are read back with DispatchToBuffer!");
+    }
+
+    WaitForTimelineValue(slot.timelineValue);
+    memcpy(destination, slot.readbackMapped, static_cast<size_t>(slot.rowCount) * m_width * sizeof(uint32_t));
+
+    if (slot.queryPool == VK_NULL_HANDLE) {
+        return 0.0;
+    }
+
+    std::array<uint64_t, 2> timestamps{};
+    if (vkGetQueryPoolResults(m_device, slot.queryPool, 0, 2, sizeof(timestamps), timestamps.data(),
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return 0.0;
+    }
+
+    return GetTimestampDuration(timestamps.data());
+}
+
+void ComputeDevice::SetCustomPalette(const std::vector<PaletteStop>& stops) {
+    if (!m_paletteLut) {
+        throw std::runtime_error("GPU " + m_name + " has no coloring pass!");
+    }
+    m_paletteLut->SetCustomGradient(stops);
+}
+
+void ComputeDevice::WaitForTimelineValue(uint64_t value) {
+    if (value == 0) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_timelineSemaphore;
+    waitInfo.pValues = &value;
+
+    if (vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to wait for GPU " + m_name + "!");
+    }
+}
+
+uint32_t ComputeDevice::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type on GPU " + m_name + "!");
+}
+
+void ComputeDevice::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkBuffer& buffer, VkDeviceMemory& memory) {
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create buffer on GPU " + m_name + "!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+
+    try {
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+    }
+    catch (...) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw;
+    }
+
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to allocate buffer memory on GPU " + m_name + "!");
+    }
+
+    vkBindBufferMemory(m_device, buffer, memory, 0);
+}
+
+void ComputeDevice::CreateReadbackBuffer(VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory, void*& mapped) {
+    VkMemoryPropertyFlags readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    // Prefer cached memory: uncached reads from the CPU are very slow
+    try {
+        CreateBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            readbackProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, buffer, memory);
+    }
+    catch (const std::runtime_error&) {
+        CreateBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, readbackProperties, buffer, memory);
+    }
+    vkMapMemory(m_device, memory, 0, size, 0, &mapped);
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <memory>
+
+struct FractalUBO;
+struct ResampleSource;
+struct TileDescriptor;
+struct PaletteStop;
+class PaletteLut;
+
+// What a ComputeDevice hands back for each band: raw iteration counts (one
+// float per pixel) or finished RGBA8 pixels (one packed uint32 per pixel)
+enum BandFormat {
+    BAND_FORMAT_ITERATIONS = 0,
+    BAND_FORMAT_RGBA8
+};
+
+// Where DispatchToBuffer puts a band of finished pixels
+struct BandDestination {
+    // Receives rowCount * width packed RGBA8 pixels
+    VkBuffer pixels = VK_NULL_HANDLE;
+    // pixels is a storage buffer the coloring pass writes directly, instead
+    // of a transfer destination for a copy of the slot's color buffer
+    bool colorInPlace = false;
+    // Release pixels to VK_QUEUE_FAMILY_EXTERNAL after writing, for memory
+    // that another API or process imports
+    bool releaseToExternal = false;
+    // Receives the start and end timestamps of the dispatch as two uint64_t
+    // values, or zeros without timestamp support
+    VkBuffer timestamps = VK_NULL_HANDLE;
+};
+
+// A GPU driven without a window. Each ComputeDevice owns its own logical
+// device and evaluates bands of image rows. Split-frame rendering uses
+// secondary GPUs for iteration counts, which are written straight to host-
+// visible memory and which the primary device uploads and colors. The
+// headless renderer also runs the coloring pass here and copies the finished
+// pixels into the staging buffers of a ReadbackRing.
+class ComputeDevice {
+public:
+    // extensions are enabled on the logical device in addition to what the
+    // passes themselves need
+    ComputeDevice(VkPhysicalDevice physicalDevice, BandFormat format = BAND_FORMAT_ITERATIONS,
+        const std::vector<const char*>& extensions = std::vector<const char*>());
+    ~ComputeDevice();
+
+    // Delete copy constructors
+    ComputeDevice(const ComputeDevice&) = delete;
+    ComputeDevice& operator=(const ComputeDevice&) = delete;
+
+    // Physical devices other than the primary one that can run the iteration
+    // pass (Vulkan 1.2 timeline semaphores and a compute queue)
+    static std::vector<VkPhysicalDevice> FindSecondaryDevices(VkInstance instance, VkPhysicalDevice primaryDevice);
+
+    // Time a small fixed iteration pass on a physical device, in milliseconds.
+    // Used to rank devices at startup.
+    static double MeasureIterationTime(VkPhysicalDevice physicalDevice);
+
+    // Histogram pass shader for a physical device: the variant that merges
+    // atomics across subgroups where the device supports subgroup vote and
+    // ballot operations in compute shaders, the plain one otherwise
+    static std::string GetHistogramShaderName(VkPhysicalDevice physicalDevice);
+
+    // (Re)allocate one band slot per frame in flight, each large enough for a
+    // band of up to the full image. Waits for all outstanding work.
+    void Configure(uint32_t slotCount, uint32_t width, uint32_t height);
+
+    // Start evaluating rows [rowOffset, rowOffset + rowCount) of the image
+    // described by ubo into the given slot (BAND_FORMAT_ITERATIONS)
+    void Dispatch(uint32_t slot, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount);
+
+    // Wait for the slot's dispatch and copy its band (rowCount rows of width
+    // iteration counts) to destination. Returns the GPU time of the dispatch
+    // in milliseconds, or 0 if it could not be measured.
+    double ReadBand(uint32_t slot, void* destination);
+
+    // Evaluate and color a band (BAND_FORMAT_RGBA8) into destination.
+    // Returns the timeline value that signals when the pixels and timestamps
+    // have been written. With COLOR_MAPPING_HISTOGRAM the band is equalized
+    // over its own pixels, so images should be dispatched as a single band.
+    // With antialiasSamples above 1, the pixels on edges within the band are
+    // supersampled adaptively.
+    uint64_t DispatchToBuffer(uint32_t slot, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount,
+        const BandDestination& destination);
+
+    // Zoom videos (BAND_FORMAT_RGBA8) color frames from a source of
+    // iteration counts kept in device memory instead of iterating.
+    // ReserveResampleSource makes room for a source of up to pixelCount
+    // samples, reallocating only to grow; DispatchSourceBand evaluates rows
+    // of the source described by ubo (its image size is the source size,
+    // its projection may be PROJECTION_EXP_MAP) with the iteration pass; and
+    // DispatchResampleToBuffer colors a whole frame by resampling the source
+    // as view describes it, equalized over the whole source with
+    // COLOR_MAPPING_HISTOGRAM. Source bands are ordered after frames already
+    // resampled from the previous source. Bands must start at a multiple of
+    // SOURCE_BAND_ALIGNMENT rows. Throws if the source is larger than a
+    // storage buffer may be on this device.
+    static constexpr uint32_t SOURCE_BAND_ALIGNMENT = 64;
+
+    void ReserveResampleSource(uint64_t pixelCount);
+    uint64_t DispatchSourceBand(uint32_t slot, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount);
+    uint64_t DispatchResampleToBuffer(uint32_t slot, const FractalUBO& ubo, const ResampleSource& view,
+        const BandDestination& destination);
+
+    // Evaluate and color a batch of square tiles in one dispatch
+    // (BAND_FORMAT_RGBA8), for many small views at once. Each tile is the
+    // view of ubo with the fields of its descriptor replaced; ubo's image
+    // size is ignored. The pixels are a column of tiles, tile after tile,
+    // each tileSize x tileSize pixels row-major, like the layers of an
+    // array texture. Tiles use linear color mapping and one sample per
+    // pixel. The device must be configured tileSize wide and at least
+    // tileSize * tileCount high. Returns the timeline value as
+    // DispatchToBuffer does. GetMaxTileCount is the largest batch of
+    // tileSize tiles whose buffers and dispatch the device allows, 0 if not
+    // even one tile fits.
+    uint64_t DispatchTilesToBuffer(uint32_t slot, const FractalUBO& ubo, const TileDescriptor* tiles, uint32_t tileCount,
+        uint32_t tileSize, const BandDestination& destination);
+    uint32_t GetMaxTileCount(uint32_t tileSize) const;
+
+    // Replace the PALETTE_CUSTOM gradient the coloring passes sample
+    // (BAND_FORMAT_RGBA8). Dispatches already made keep the old gradient.
+    void SetCustomPalette(const std::vector<PaletteStop>& stops);
+
+    // Block until the dispatch that returned a timeline value has finished
+    void WaitForTimelineValue(uint64_t value);
+
+    // Milliseconds between a start and end timestamp, or 0 if unmeasured
+    double GetTimestampDuration(const uint64_t timestamps[2]) const;
+
+    // Largest storage buffer a shader may access and a single allocation
+    // may hold, in bytes; bounds sources and tile batches
+    VkDeviceSize GetMaxStorageBufferSize() const { return m_maxStorageBufferSize; }
+
+    const std::string& GetName() const { return m_name; }
+    VkPhysicalDevice GetPhysicalDevice() const { return m_physicalDevice; }
+    VkDevice GetDevice() const { return m_device; }
+    // Signaled with the values returned by DispatchToBuffer
+    VkSemaphore GetTimelineSemaphore() const { return m_timelineSemaphore; }
+
+private:
+    // Resources for one in-flight band
+    struct BandSlot {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkBuffer uniformBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory uniformBufferMemory = VK_NULL_HANDLE;
+        void* uniformBufferMapped = nullptr;
+        VkBuffer iterationBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory iterationBufferMemory = VK_NULL_HANDLE;
+        VkBuffer colorBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory colorBufferMemory = VK_NULL_HANDLE;
+        // Bin counts and CDF of histogram-equalized coloring
+        VkBuffer histogramBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory histogramBufferMemory = VK_NULL_HANDLE;
+        // Indirect dispatch and pixel list of adaptive anti-aliasing
+        VkBuffer refineBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory refineBufferMemory = VK_NULL_HANDLE;
+        // Mapped descriptors of batched tiles, room for tileCapacity
+        VkBuffer tileBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory tileBufferMemory = VK_NULL_HANDLE;
+        void* tileBufferMapped = nullptr;
+        uint32_t tileCapacity = 0;
+        // Buffers bound for the next dispatch: iterationBuffer, or (part of)
+        // the resampling source, and colorBuffer, or a destination colored
+        // in place
+        VkBuffer iterationSource = VK_NULL_HANDLE;
+        VkDeviceSize iterationSourceOffset = 0;
+        VkBuffer colorTarget = VK_NULL_HANDLE;
+        // Mapped iteration buffer for ReadBand (BAND_FORMAT_ITERATIONS only)
+        void* readbackMapped = nullptr;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint64_t timelineValue = 0;
+        uint32_t rowCount = 0;
+    };
+
+    // Initialization helpers
+    void CreateLogicalDevice(const std::vector<const char*>& extensions);
+    // Point the storage bindings of a slot at the buffers its next dispatch
+    // reads and writes
+    void BindSlotBuffers(uint32_t slot, VkBuffer iterations, VkDeviceSize iterationOffset, VkBuffer colors);
+    void CreatePipelines();
+
+    // Passes RecordBand records
+    enum BandPasses {
+        // Iteration pass, then the coloring pass for BAND_FORMAT_RGBA8
+        BAND_PASSES_IMAGE = 0,
+        // Iteration pass over source rows only
+        BAND_PASSES_SOURCE,
+        // Resampling pass only
+        BAND_PASSES_RESAMPLE,
+        // Batched tile pass only, one tile per rowCount / m_width rows
+        BAND_PASSES_TILES
+    };
+
+    // Record the passes of a band into the slot's command buffer, which is
+    // left open for the caller's barriers and copies. view is only read for
+    // BAND_PASSES_RESAMPLE.
+    VkCommandBuffer RecordBand(uint32_t slot, const FractalUBO& ubo, uint32_t rowOffset, uint32_t rowCount,
+        BandPasses passes = BAND_PASSES_IMAGE, const ResampleSource* view = nullptr);
+    // Copy, hand over and submit a band of finished pixels
+    uint64_t SubmitToBuffer(uint32_t slot, VkCommandBuffer commandBuffer, uint32_t rowCount,
+        const BandDestination& destination);
+    uint64_t SubmitBand(uint32_t slot);
+    // Record the histogram and CDF passes over the first pixelCount
+    // iteration counts bound to the slot, ahead of a coloring pass
+    void RecordHistogram(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t pixelCount);
+    // Record the edge detection pass and the indirect refinement pass of
+    // adaptive anti-aliasing over a band that has just been colored
+    void RecordAntialiasing(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t rowCount);
+    void DestroyResampleSource();
+    VkPipeline CreatePipeline(const std::string& shaderName);
+    void CreateSlots();
+    void DestroySlots();
+    void Destroy();
+
+    uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkBuffer& buffer, VkDeviceMemory& memory);
+    void CreateReadbackBuffer(VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory, void*& mapped);
+
+    std::string m_name;
+    BandFormat m_format;
+    VkPhysicalDevice m_physicalDevice;
+    VkDevice m_device;
+    VkQueue m_queue;
+    uint32_t m_queueFamily;
+    VkCommandPool m_commandPool;
+
+    // Timeline semaphore signaled by every dispatch
+    VkSemaphore m_timelineSemaphore;
+    uint64_t m_timelineValue;
+
+    // Iteration pass pipeline, and the coloring pass for BAND_FORMAT_RGBA8
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+    VkPipeline m_colorPipeline;
+    VkPipeline m_resamplePipeline;
+    VkPipeline m_histogramPipeline;
+    VkPipeline m_cdfPipeline;
+    VkPipeline m_aaDetectPipeline;
+    VkPipeline m_aaRefinePipeline;
+    VkPipeline m_tilePipeline;
+    VkDescriptorPool m_descriptorPool;
+
+    // Palettes the coloring passes sample (BAND_FORMAT_RGBA8 only)
+    std::unique_ptr<PaletteLut> m_paletteLut;
+
+    // Nanoseconds per timestamp tick (0 if the queue has no timestamps)
+    float m_timestampPeriod;
+    // Smaller of maxStorageBufferRange and maxMemoryAllocationSize
+    VkDeviceSize m_maxStorageBufferSize;
+    // maxComputeWorkGroupCount[2], the most tiles one dispatch can hold
+    uint32_t m_maxTileDispatch;
+
+    // Band slots and the image width they were allocated for
+    std::vector<BandSlot> m_slots;
+    uint32_t m_slotCount;
+    uint32_t m_width;
+    uint32_t m_height;
+
+    // Resampling source of iteration counts, the samples it has room for
+    // and the size of the source last dispatched into it
+    VkBuffer m_source;
+    VkDeviceMemory m_sourceMemory;
+    uint64_t m_sourceCapacity;
+    uint32_t m_sourceWidth;
+    uint32_t m_sourceHeight;
+};
@@ -0,0 +1,126 @@
+#include "CpuColorer.h"
+#include <algorithm>
+#include <cmath>
+
+// Palette octaves a distance estimate spans, as in coloring.glsl
+constexpr float DISTANCE_OCTAVES = 10.0f;
+
+// Linear values the sRGB table is sampled at; fine enough that the steepest
+// part of the curve, near black, moves less than a fifth of an 8-bit step
+constexpr int SRGB_STEPS = 16384;
+
+CpuColorer::CpuColorer(const FractalUBO& parameters, const std::vector<PaletteStop>& gradient)
+    : m_parameters(parameters)
+    , m_equalize(parameters.colorMapping == COLOR_MAPPING_HISTOGRAM && parameters.outputChannel == OUTPUT_ITERATIONS)
+    , m_counts(HISTOGRAM_BINS, 0)
+    , m_cdf(HISTOGRAM_BINS + 1, 0.0f) {
+    m_palette.resize(static_cast<size_t>(PaletteLut::SIZE) * 3);
+    for (uint32_t i = 0; i < PaletteLut::SIZE; i++) {
+        EvaluatePaletteColor(parameters.colorPalette, gradient, static_cast<float>(i) / (PaletteLut::SIZE - 1),
+            &m_palette[static_cast<size_t>(i) * 3]);
+    }
+
+    m_srgb.resize(SRGB_STEPS + 1);
+    for (int i = 0; i <= SRGB_STEPS; i++) {
+        float value = static_cast<float>(i) / SRGB_STEPS;
+        float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        m_srgb[i] = static_cast<uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+}
+
+bool CpuColorer::NeedsHistogram() const {
+    return m_equalize;
+}
+
+// Position of an iteration count in bin units, as histogramPosition does
+static float GetHistogramPosition(float iterations, int maxIterations) {
+    float binCount = static_cast<float>(std::min(maxIterations, static_cast<int>(HISTOGRAM_BINS)));
+    return std::clamp(iterations * binCount / static_cast<float>(maxIterations), 0.0f, binCount);
+}
+
+void CpuColorer::AddToHistogram(const float* values, size_t count) {
+    const int maxIterations = m_parameters.maxIterations;
+    const uint32_t binCount = static_cast<uint32_t>(std::min(maxIterations, static_cast<int>(HISTOGRAM_BINS)));
+    for (size_t i = 0; i < count; i++) {
+        // Interior pixels stay black and take no part in the equalization
+        if (values[i] < static_cast<float>(maxIterations)) {
+            uint32_t bin = std::min(static_cast<uint32_t>(GetHistogramPosition(values[i], maxIterations)), binCount - 1);
+            m_counts[bin]++;
+        }
+    }
+}
+
+void CpuColorer::FinishHistogram() {
+    uint64_t total = 0;
+    for (uint64_t count : m_counts) {
+        total += count;
+    }
+
+    // Share of counted pixels below each bin edge, as fractal_cdf.comp
+    // writes it
+    double scale = total > 0 ? 1.0 / static_cast<double>(total) : 0.0;
+    uint64_t running = 0;
+    for (uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++) {
+        m_cdf[bin] = static_cast<float>(running * scale);
+        running += m_counts[bin];
+    }
+    m_cdf[HISTOGRAM_BINS] = 1.0f;
+}
+
+float CpuColorer::GetPalettePosition(float iterations) const {
+    if (!m_equalize) {
+        return iterations / static_cast<float>(m_parameters.maxIterations);
+    }
+
+    float position = GetHistogramPosition(iterations, m_parameters.maxIterations);
+    uint32_t bin = std::min(static_cast<uint32_t>(position), HISTOGRAM_BINS - 1);
+    return m_cdf[bin] + (m_cdf[bin + 1] - m_cdf[bin]) * (position - static_cast<float>(bin));
+}
+
+void CpuColorer::ApplyPalette(float t, float color[3]) const {
+    // Texel i holds the palette at i / (SIZE - 1), as applyColorPalette
+    // samples it
+    float u = std::clamp(t, 0.0f, 1.0f) * (PaletteLut::SIZE - 1);
+    uint32_t texel = std::min(static_cast<uint32_t>(u), PaletteLut::SIZE - 2);
+    float weight = u - static_cast<float>(texel);
+    const float* from = &m_palette[static_cast<size_t>(texel) * 3];
+    for (int channel = 0; channel < 3; channel++) {
+        color[channel] = from[channel] + (from[3 + channel] - from[channel]) * weight;
+    }
+}
+
+void CpuColorer::StoreSrgb(const float color[3], uint8_t* pixel) const {
+    for (int channel = 0; channel < 3; channel++) {
+        float value = std::clamp(color[channel], 0.0f, 1.0f);
+        pixel[channel] = m_srgb[static_cast<int>(value * SRGB_STEPS + 0.5f)];
+    }
+    pixel[3] = 255;
+}
+
+void CpuColorer::Color(const float* values, size_t count, uint8_t* pixels) const {
+    const bool distance = m_parameters.outputChannel == OUTPUT_DISTANCE;
+    const float pixelsPerUnit = static_cast<float>(m_parameters.imageHeight) / (2.0f * m_parameters.scale);
+
+    for (size_t i = 0; i < count; i++) {
+        float color[3] = { 0.0f, 0.0f, 0.0f };
+        float t;
+        if (distance) {
+            // Palette along the log of the distance in pixels, darkened
+            // within a pixel of the boundary
+            float distancePixels = values[i] * pixelsPerUnit;
+            if (distancePixels > 0.0f) {
+                t = std::log2(1.0f + distancePixels) / DISTANCE_OCTAVES + m_parameters.colorOffset;
+                ApplyPalette(t - std::floor(t), color);
+                float darken = std::min(distancePixels, 1.0f);
+                for (float& channel : color) {
+                    channel *= darken;
+                }
+            }
+        } else if (values[i] < static_cast<float>(m_parameters.maxIterations)) {
+            t = GetPalettePosition(values[i]) + m_parameters.colorOffset;
+            ApplyPalette(t - std::floor(t), color);
+        }
+
+        StoreSrgb(color, pixels + i * 4);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include "PaletteLut.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The headless coloring pass (coloring.glsl with fractal_color.comp) on the
+// CPU: turns iteration counts or distance estimates into the same sRGB RGBA8
+// pixels, so stored iteration buffers can be recolored without a Vulkan
+// device. Palettes are evaluated from their definitions rather than sampled
+// from half float texels, which moves a few pixels by one 8-bit step.
+class CpuColorer {
+public:
+    // The palette, color offset, color mapping, output channel and iteration
+    // limit come from parameters, and for distances the image height and
+    // scale; gradient is the PALETTE_CUSTOM gradient
+    CpuColorer(const FractalUBO& parameters, const std::vector<PaletteStop>& gradient = std::vector<PaletteStop>());
+
+    // Histogram-equalized coloring of iteration counts needs every value
+    // counted first: pass them all to AddToHistogram, in any number of
+    // calls, then call FinishHistogram before coloring
+    bool NeedsHistogram() const;
+    void AddToHistogram(const float* values, size_t count);
+    void FinishHistogram();
+
+    // Color count values into count packed RGBA8 pixels
+    void Color(const float* values, size_t count, uint8_t* pixels) const;
+
+private:
+    // Palette position for an escaped iteration count
+    float GetPalettePosition(float iterations) const;
+    // Linear RGB at a palette position in [0, 1], interpolated like the
+    // filtered LUT texels
+    void ApplyPalette(float t, float color[3]) const;
+    void StoreSrgb(const float color[3], uint8_t* pixel) const;
+
+    FractalUBO m_parameters;
+    bool m_equalize;
+
+    // PaletteLut::SIZE linear RGB texels
+    std::vector<float> m_palette;
+    // sRGB bytes of evenly spaced linear values
+    std::vector<uint8_t> m_srgb;
+
+    std::vector<uint64_t> m_counts;
+    std::vector<float> m_cdf;
+};
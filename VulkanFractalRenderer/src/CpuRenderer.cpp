@@ -0,0 +1,202 @@
+#include "CpuRenderer.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+// Same escape radius as BAILOUT_RADIUS in fractal_common.glsl
+static constexpr double BAILOUT_RADIUS = 256.0;
+
+// Port of bailoutRadius in fractal_common.glsl. Double precision would not
+// overflow at the full radius, but the reference has to escape where the
+// shaders do.
+static double BailoutRadius(double power) {
+    return std::min(BAILOUT_RADIUS, std::exp2(100.0 / power));
+}
+
+// Port of smoothIterations in fractal_common.glsl
+static float SmoothIterations(int i, double zx, double zy, double power) {
+    double logRadius = std::log(std::hypot(zx, zy));
+    double fraction = 1.0 - std::log(logRadius / std::log(BailoutRadius(power))) / std::log(power);
+    return static_cast<float>(i + std::clamp(fraction, 0.0, 0.9999));
+}
+
+CpuRenderer::CpuRenderer(uint32_t threadCount)
+    : m_threadCount(threadCount) {
+    if (m_threadCount == 0) {
+        m_threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+float CpuRenderer::CalculateIterations(const FractalUBO& parameters, double x, double y) {
+    const int maxIterations = parameters.maxIterations;
+    const double bailoutSquared = BAILOUT_RADIUS * BAILOUT_RADIUS;
+
+    // Julia sets iterate the point itself with a fixed constant; everything
+    // else starts at zero with the point as the constant
+    double zx = 0.0;
+    double zy = 0.0;
+    double cx = x;
+    double cy = y;
+    if (parameters.fractalType == FRACTAL_JULIA) {
+        zx = x;
+        zy = y;
+        cx = parameters.juliaConstantX;
+        cy = parameters.juliaConstantY;
+    }
+
+    if (parameters.fractalType == FRACTAL_MULTIBROT) {
+        double power = std::max(2.0, static_cast<double>(parameters.multibrotPower));
+        double bailout = BailoutRadius(power);
+        for (int i = 0; i < maxIterations; i++) {
+            // z = z^power + c in polar form
+            double r = std::hypot(zx, zy);
+            if (r > 0.0) {
+                double theta = std::atan2(zy, zx) * power;
+                double rPow = std::pow(r, power);
+                zx = rPow * std::cos(theta) + cx;
+                zy = rPow * std::sin(theta) + cy;
+            } else {
+                zx = cx;
+                zy = cy;
+            }
+
+            if (std::hypot(zx, zy) > bailout) {
+                return SmoothIterations(i, zx, zy, power);
+            }
+        }
+        return static_cast<float>(maxIterations);
+    }
+
+    // Interior detection as in fractal_common.glsl: the derivative of z with
+    // respect to z1, stopping once it falls below the threshold
+    const bool detectInterior = (parameters.interiorDetection & INTERIOR_DETECTION_TYPES &
+        (1 << parameters.fractalType)) != 0;
+    const double thresholdSquared = INTERIOR_DERIVATIVE_THRESHOLD * INTERIOR_DERIVATIVE_THRESHOLD;
+    double dzx = 1.0;
+    double dzy = 0.0;
+
+    for (int i = 0; i < maxIterations; i++) {
+        if (parameters.fractalType == FRACTAL_BURNING_SHIP) {
+            zx = std::abs(zx);
+            zy = std::abs(zy);
+        }
+
+        // z = z² + c, with the conjugate for the Tricorn
+        double imaginary = 2.0 * zx * zy;
+        if (parameters.fractalType == FRACTAL_TRICORN) {
+            imaginary = -imaginary;
+        }
+        double real = zx * zx - zy * zy;
+        zx = real + cx;
+        zy = imaginary + cy;
+
+        if (zx * zx + zy * zy > bailoutSquared) {
+            return SmoothIterations(i, zx, zy, 2.0);
+        }
+
+        if (detectInterior) {
+            double nextDzx = 2.0 * (zx * dzx - zy * dzy);
+            dzy = 2.0 * (zx * dzy + zy * dzx);
+            dzx = nextDzx;
+            if (dzx * dzx + dzy * dzy < thresholdSquared) {
+                break;
+            }
+        }
+    }
+    return static_cast<float>(maxIterations);
+}
+
+float CpuRenderer::CalculateDistance(const FractalUBO& parameters, double x, double y) {
+    const bool julia = parameters.fractalType == FRACTAL_JULIA;
+
+    // Same derivative as calculateDistance in fractal_common.glsl: with
+    // respect to the starting point for Julia sets, to c otherwise, along the
+    // real axis of c through the Burning Ship's absolute value and the
+    // Tricorn's conjugate
+    std::complex<double> z = julia ? std::complex<double>(x, y) : 0.0;
+    std::complex<double> k = julia ? std::complex<double>(parameters.juliaConstantX, parameters.juliaConstantY) :
+        std::complex<double>(x, y);
+    std::complex<double> dz = julia ? 1.0 : 0.0;
+    std::complex<double> dk = julia ? 0.0 : 1.0;
+    double power = parameters.fractalType == FRACTAL_MULTIBROT ?
+        std::max(2.0, static_cast<double>(parameters.multibrotPower)) : 2.0;
+    const double bailout = BailoutRadius(power);
+
+    for (int i = 0; i < parameters.maxIterations; i++) {
+        if (parameters.fractalType == FRACTAL_BURNING_SHIP) {
+            dz = std::complex<double>(z.real() < 0.0 ? -dz.real() : z.real() > 0.0 ? dz.real() : 0.0,
+                z.imag() < 0.0 ? -dz.imag() : z.imag() > 0.0 ? dz.imag() : 0.0);
+            z = std::complex<double>(std::abs(z.real()), std::abs(z.imag()));
+        } else if (parameters.fractalType == FRACTAL_TRICORN) {
+            dz = std::conj(dz);
+            z = std::conj(z);
+        }
+
+        if (parameters.fractalType == FRACTAL_MULTIBROT) {
+            double r = std::abs(z);
+            double theta = std::arg(z);
+            dz = (r > 0.0 ? std::polar(power * std::pow(r, power - 1.0), theta * (power - 1.0)) : 0.0) * dz + dk;
+            z = r > 0.0 ? std::polar(std::pow(r, power), theta * power) + k : k;
+        } else {
+            dz = 2.0 * z * dz + dk;
+            z = z * z + k;
+        }
+
+        if (std::abs(z) > bailout) {
+            double radius = std::abs(z);
+            return static_cast<float>(0.5 * radius * std::log(radius) / std::abs(dz));
+        }
+    }
+    return 0.0f;
+}
+
+std::vector<float> CpuRenderer::RenderIterations(const FractalUBO& parameters, uint32_t width, uint32_t height) const {
+    FractalUBO ubo = parameters;
+    ubo.imageWidth = static_cast<int>(width);
+    ubo.imageHeight = static_cast<int>(height);
+
+    std::vector<float> iterations(static_cast<size_t>(width) * height);
+
+    // Rows are handed out one at a time, so threads that draw the interior
+    // do not hold up the others
+    std::atomic<uint32_t> nextRow(0);
+    auto worker = [&]() {
+        for (uint32_t row = nextRow++; row < height; row = nextRow++) {
+            float* rowIterations = iterations.data() + static_cast<size_t>(row) * width;
+
+            for (uint32_t column = 0; column < width; column++) {
+                // Pixel centers, mapped like mapToComplex and
+                // mapExpMapToComplex in fractal_common.glsl
+                double pixelX = column + 0.5;
+                double pixelY = row + 0.5;
+                double x;
+                double y;
+                if (ubo.projection == PROJECTION_EXP_MAP) {
+                    double step = 6.283185307179586 / width;
+                    double radius = ubo.scale * std::exp(-pixelY * step);
+                    x = ubo.centerX + radius * std::cos(pixelX * step);
+                    y = ubo.centerY + radius * std::sin(pixelX * step);
+                } else {
+                    x = (pixelX / width * 2.0 - 1.0) * ubo.aspectRatio * ubo.scale + ubo.centerX;
+                    y = (pixelY / height * 2.0 - 1.0) * ubo.scale + ubo.centerY;
+                }
+
+                rowIterations[column] = ubo.outputChannel == OUTPUT_DISTANCE ?
+                    CalculateDistance(ubo, x, y) : CalculateIterations(ubo, x, y);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < std::min(m_threadCount, height); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return iterations;
+}
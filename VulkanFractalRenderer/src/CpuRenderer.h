@@ -0,0 +1,37 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include <vector>
+#include <cstdint>
+
+// The escape-time kernels of fractal_common.glsl on the CPU, in double
+// precision: the reference the GPU passes are validated against, and a way
+// for tools to evaluate views without a Vulkan device. Produces the same
+// output channels as the GPU iteration pass, so its output can be colored,
+// equalized or compared like an iteration buffer.
+class CpuRenderer {
+public:
+    // Rows are spread over threadCount worker threads; 0 uses one per
+    // hardware thread
+    explicit CpuRenderer(uint32_t threadCount = 0);
+
+    // The output channel of parameters (iteration counts or distance
+    // estimates) for an image, width * height floats, top row first. The
+    // view comes from parameters (PROJECTION_PLANE or PROJECTION_EXP_MAP);
+    // the image size fields are filled in here and the aspect ratio is left
+    // as given.
+    std::vector<float> RenderIterations(const FractalUBO& parameters, uint32_t width, uint32_t height) const;
+
+    // Smooth iteration count of the point x + yi: below maxIterations for
+    // points that escape, exactly maxIterations for points that do not
+    static float CalculateIterations(const FractalUBO& parameters, double x, double y);
+
+    // Exterior distance estimate of the point x + yi in complex plane units,
+    // 0 for points that do not escape (OUTPUT_DISTANCE)
+    static float CalculateDistance(const FractalUBO& parameters, double x, double y);
+
+    uint32_t GetThreadCount() const { return m_threadCount; }
+
+private:
+    uint32_t m_threadCount;
+};
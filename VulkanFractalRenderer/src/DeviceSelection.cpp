@@ -0,0 +1,94 @@
+#include "DeviceSelection.h"
+#include "Platform.h"
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+uint64_t ScoreDevice(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    // Device type dominates: any hardware GPU beats a software rasterizer,
+    // but CPU and virtual devices remain usable on machines without a GPU
+    uint64_t score = 0;
+    switch (deviceProperties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   score = 10000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score = 5000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    score = 2000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:            score = 1000; break;
+    default:                                     score = 500; break;
+    }
+
+    // Device-local memory, 100 points per GiB up to 16 GiB. Integrated GPUs
+    // report shared system memory here, which the type score outweighs.
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+    VkDeviceSize deviceLocalMemory = 0;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            deviceLocalMemory = std::max(deviceLocalMemory, memoryProperties.memoryHeaps[i].size);
+        }
+    }
+    score += std::min<uint64_t>(deviceLocalMemory >> 30, 16) * 100;
+
+    // Double precision support is only a capability hint: every shader
+    // computes in single precision, so it breaks ties without outranking a
+    // GiB of memory or a better device type
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    if (features.shaderFloat64) {
+        score += 50;
+    }
+
+    // Wider subgroups with compute arithmetic support suit the iteration pass
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+
+    if ((subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+        (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT)) {
+        score += std::min<uint64_t>(subgroupProperties.subgroupSize, 64) * 4;
+    }
+
+    // A dedicated compute family lets the iteration pass overlap presentation
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    for (const auto& queueFamily : queueFamilies) {
+        if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            score += 250;
+            break;
+        }
+    }
+
+    return score;
+}
+
+std::string GetDeviceOverride(const std::string& commandLineValue) {
+    // The command line option takes precedence over the environment
+    if (!commandLineValue.empty()) {
+        return commandLineValue;
+    }
+    return GetEnvironmentString("VFR_DEVICE");
+}
+
+bool MatchesDeviceOverride(const std::string& deviceOverride, uint32_t index, const std::string& name) {
+    bool isIndex = std::all_of(deviceOverride.begin(), deviceOverride.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+    if (isIndex) {
+        return std::stoul(deviceOverride) == index;
+    }
+
+    std::string lowerName = name;
+    std::string lowerOverride = deviceOverride;
+    std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    std::transform(lowerOverride.begin(), lowerOverride.end(), lowerOverride.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lowerName.find(lowerOverride) != std::string::npos;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+
+// Static rank of a physical device for fractal rendering: device type first,
+// then device-local memory, subgroup width, a dedicated compute queue family
+// and, as a small hint, double precision support. Higher is better.
+uint64_t ScoreDevice(VkPhysicalDevice device);
+
+// The device the user asked for: the command line value if given, otherwise
+// the VFR_DEVICE environment variable. Empty means pick automatically.
+std::string GetDeviceOverride(const std::string& commandLineValue);
+
+// Whether a device override selects the device with the given enumeration
+// index and name. All-digit overrides are indices; anything else matches a
+// case-insensitive substring of the device name.
+bool MatchesDeviceOverride(const std::string& deviceOverride, uint32_t index, const std::string& name);
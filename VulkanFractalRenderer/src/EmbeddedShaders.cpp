@@ -0,0 +1,71 @@
+#include "EmbeddedShaders.h"
+#include <iterator>
+
+// The .inc files are generated by "glslc -mfmt=num", which writes the SPIR-V
+// words as a comma-separated list of integer literals
+static constexpr uint32_t FRACTAL_VERT_SPV[] = {
+#include "fractal.vert.inc"
+};
+
+static constexpr uint32_t FRACTAL_FRAG_SPV[] = {
+#include "fractal.frag.inc"
+};
+
+static constexpr uint32_t FRACTAL_COMP_SPV[] = {
+#include "fractal.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_COLOR_COMP_SPV[] = {
+#include "fractal_color.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_RESAMPLE_COMP_SPV[] = {
+#include "fractal_resample.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_HISTOGRAM_COMP_SPV[] = {
+#include "fractal_histogram.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_HISTOGRAM_SUBGROUP_COMP_SPV[] = {
+#include "fractal_histogram_subgroup.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_CDF_COMP_SPV[] = {
+#include "fractal_cdf.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_AA_DETECT_COMP_SPV[] = {
+#include "fractal_aa_detect.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_AA_REFINE_COMP_SPV[] = {
+#include "fractal_aa_refine.comp.inc"
+};
+
+static constexpr uint32_t FRACTAL_TILES_COMP_SPV[] = {
+#include "fractal_tiles.comp.inc"
+};
+
+static constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+    { "fractal.vert.spv", FRACTAL_VERT_SPV, std::size(FRACTAL_VERT_SPV) },
+    { "fractal.frag.spv", FRACTAL_FRAG_SPV, std::size(FRACTAL_FRAG_SPV) },
+    { "fractal.comp.spv", FRACTAL_COMP_SPV, std::size(FRACTAL_COMP_SPV) },
+    { "fractal_color.comp.spv", FRACTAL_COLOR_COMP_SPV, std::size(FRACTAL_COLOR_COMP_SPV) },
+    { "fractal_resample.comp.spv", FRACTAL_RESAMPLE_COMP_SPV, std::size(FRACTAL_RESAMPLE_COMP_SPV) },
+    { "fractal_histogram.comp.spv", FRACTAL_HISTOGRAM_COMP_SPV, std::size(FRACTAL_HISTOGRAM_COMP_SPV) },
+    { "fractal_histogram_subgroup.comp.spv", FRACTAL_HISTOGRAM_SUBGROUP_COMP_SPV, std::size(FRACTAL_HISTOGRAM_SUBGROUP_COMP_SPV) },
+    { "fractal_cdf.comp.spv", FRACTAL_CDF_COMP_SPV, std::size(FRACTAL_CDF_COMP_SPV) },
+    { "fractal_aa_detect.comp.spv", FRACTAL_AA_DETECT_COMP_SPV, std::size(FRACTAL_AA_DETECT_COMP_SPV) },
+    { "fractal_aa_refine.comp.spv", FRACTAL_AA_REFINE_COMP_SPV, std::size(FRACTAL_AA_REFINE_COMP_SPV) },
+    { "fractal_tiles.comp.spv", FRACTAL_TILES_COMP_SPV, std::size(FRACTAL_TILES_COMP_SPV) },
+};
+
+const EmbeddedShader* FindEmbeddedShader(const std::string& name) {
+    for (const auto& shader : EMBEDDED_SHADERS) {
+        if (name == shader.name) {
+            return &shader;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// SPIR-V of a shader compiled into the binary by the shader build step
+struct EmbeddedShader {
+    const char* name;
+    const uint32_t* code;
+    size_t wordCount;
+};
+
+// Look up an embedded shader by its .spv file name, e.g. "fractal.vert.spv".
+// Returns nullptr for unknown names.
+const EmbeddedShader* FindEmbeddedShader(const std::string& name);
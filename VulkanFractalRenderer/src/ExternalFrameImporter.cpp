@@ -0,0 +1,388 @@
+#include "ExternalFrameImporter.h"
+#include "ReadbackRing.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+ExternalFrameImporter::ExternalFrameImporter(const std::array<uint8_t, VK_UUID_SIZE>& deviceUuid)
+    : m_instance(VK_NULL_HANDLE)
+    , m_physicalDevice(VK_NULL_HANDLE)
+    , m_device(VK_NULL_HANDLE)
+    , m_queueFamily(0)
+    , m_queue(VK_NULL_HANDLE)
+    , m_commandPool(VK_NULL_HANDLE)
+    , m_commandBuffer(VK_NULL_HANDLE)
+    , m_fence(VK_NULL_HANDLE)
+    , m_hostBuffer(VK_NULL_HANDLE)
+    , m_hostMemory(VK_NULL_HANDLE)
+    , m_hostSize(0)
+    , m_hostMapped(nullptr)
+    , m_hostNeedsInvalidate(false) {
+    try {
+        CreateInstance();
+        PickPhysicalDevice(deviceUuid);
+        CreateLogicalDevice();
+    }
+    catch (...) {
+        Destroy();
+        throw;
+    }
+}
+
+ExternalFrameImporter::~ExternalFrameImporter() {
+    Destroy();
+}
+
+void ExternalFrameImporter::Destroy() {
+    if (m_device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(m_device);
+
+        for (ImportedBuffer& imported : m_imports) {
+            DestroyImport(imported);
+        }
+
+        if (m_hostBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, m_hostBuffer, nullptr);
+        }
+        if (m_hostMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, m_hostMemory, nullptr);
+        }
+        if (m_fence != VK_NULL_HANDLE) {
+            vkDestroyFence(m_device, m_fence, nullptr);
+        }
+        if (m_commandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        }
+        vkDestroyDevice(m_device, nullptr);
+        m_device = VK_NULL_HANDLE;
+    }
+
+    if (m_instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(m_instance, nullptr);
+        m_instance = VK_NULL_HANDLE;
+    }
+}
+
+void ExternalFrameImporter::CreateInstance() {
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Vulkan Fractal Renderer (importer)";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_3;
+
+    VkInstanceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    if (vkCreateInstance(&createInfo, nullptr, &m_instance) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Vulkan instance for importing!");
+    }
+}
+
+void ExternalFrameImporter::PickPhysicalDevice(const std::array<uint8_t, VK_UUID_SIZE>& deviceUuid) {
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(m_instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
+
+    // Opaque file descriptors only import on the device that exported them
+    for (VkPhysicalDevice device : devices) {
+        VkPhysicalDeviceIDProperties idProperties{};
+        idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &idProperties;
+        vkGetPhysicalDeviceProperties2(device, &properties);
+
+        if (memcmp(idProperties.deviceUUID, deviceUuid.data(), VK_UUID_SIZE) == 0) {
+            m_physicalDevice = device;
+            break;
+        }
+    }
+
+    if (m_physicalDevice == VK_NULL_HANDLE) {
+        throw std::runtime_error("Failed to find the exporting device for importing!");
+    }
+
+    // Any queue that can copy buffers
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &familyCount, families.data());
+
+    const VkQueueFlags copyCapable = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    for (uint32_t i = 0; i < familyCount; i++) {
+        if (families[i].queueFlags & copyCapable) {
+            m_queueFamily = i;
+            return;
+        }
+    }
+    throw std::runtime_error("Failed to find a transfer queue for importing!");
+}
+
+void ExternalFrameImporter::CreateLogicalDevice() {
+    float queuePriority = 1.0f;
+    VkDeviceQueueCreateInfo queueCreateInfo{};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = m_queueFamily;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+
+    const char* extensions[] = { VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME };
+
+    VkDeviceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = &queueCreateInfo;
+    createInfo.enabledExtensionCount = 1;
+    createInfo.ppEnabledExtensionNames = extensions;
+
+    if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create logical device for importing!");
+    }
+
+    vkGetDeviceQueue(m_device, m_queueFamily, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_queueFamily;
+
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create command pool for importing!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(m_device, &allocInfo, &m_commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate command buffer for importing!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create fence for importing!");
+    }
+}
+
+void ExternalFrameImporter::Import(const RenderedFrame& frame, ImportedBuffer& imported) {
+#ifdef _WIN32
+    (void)frame;
+    (void)imported;
+    throw std::runtime_error("Memory import from file descriptors is not available on Windows!");
+#else
+    // The exporter used a dedicated allocation, so the buffer and allocation
+    // repeat the ring's exactly. A successful import takes ownership of the
+    // fd, so the renderer's stays open.
+    VkExternalMemoryBufferCreateInfo externalBufferInfo{};
+    externalBufferInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalBufferInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = &externalBufferInfo;
+    bufferInfo.size = frame.bufferSize;
+    bufferInfo.usage = READBACK_IN_PLACE_USAGE;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &imported.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create buffer for imported memory!");
+    }
+
+    int fd = dup(frame.memoryFd);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to duplicate exported memory fd!");
+    }
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = imported.buffer;
+
+    VkImportMemoryFdInfoKHR importInfo{};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+    importInfo.pNext = &dedicatedInfo;
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+    importInfo.fd = fd;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = &importInfo;
+    allocInfo.allocationSize = frame.memorySize;
+    allocInfo.memoryTypeIndex = frame.memoryTypeIndex;
+
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imported.memory) != VK_SUCCESS) {
+        close(fd);
+        throw std::runtime_error("Failed to import exported memory!");
+    }
+
+    vkBindBufferMemory(m_device, imported.buffer, imported.memory, 0);
+    imported.memoryFd = frame.memoryFd;
+    imported.bufferSize = frame.bufferSize;
+    imported.width = frame.width;
+#endif
+}
+
+void ExternalFrameImporter::DestroyImport(ImportedBuffer& imported) {
+    if (imported.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, imported.buffer, nullptr);
+    }
+    if (imported.memory != VK_NULL_HANDLE) {
+        vkFreeMemory(m_device, imported.memory, nullptr);
+    }
+    imported = ImportedBuffer();
+}
+
+uint32_t ExternalFrameImporter::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+void ExternalFrameImporter::EnsureHostBuffer(VkDeviceSize size) {
+    if (m_hostSize >= size) {
+        return;
+    }
+
+    if (m_hostBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, m_hostBuffer, nullptr);
+        m_hostBuffer = VK_NULL_HANDLE;
+    }
+    if (m_hostMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(m_device, m_hostMemory, nullptr);
+        m_hostMemory = VK_NULL_HANDLE;
+    }
+    m_hostSize = 0;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_hostBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create import readback buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, m_hostBuffer, &memRequirements);
+
+    // Cached where possible, as for the renderer's staging buffers
+    uint32_t memoryType = FindMemoryType(memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if (memoryType == UINT32_MAX) {
+        memoryType = FindMemoryType(memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    if (memoryType == UINT32_MAX || vkAllocateMemory(m_device, &allocInfo, nullptr, &m_hostMemory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate import readback memory!");
+    }
+
+    vkBindBufferMemory(m_device, m_hostBuffer, m_hostMemory, 0);
+    if (vkMapMemory(m_device, m_hostMemory, 0, VK_WHOLE_SIZE, 0, &m_hostMapped) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to map import readback memory!");
+    }
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+    m_hostNeedsInvalidate = !(memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_hostSize = size;
+}
+
+void ExternalFrameImporter::Read(const RenderedFrame& frame, uint8_t* pixels) {
+    if (frame.memoryFd < 0) {
+        throw std::runtime_error("Frame was not exported to a file descriptor!");
+    }
+
+    // The renderer reallocates its buffers, closing their fds, when the
+    // image size changes, so a known index with another fd, size or width
+    // is a new buffer
+    if (frame.bufferIndex >= m_imports.size()) {
+        m_imports.resize(frame.bufferIndex + 1);
+    }
+    ImportedBuffer& imported = m_imports[frame.bufferIndex];
+    if (imported.memoryFd != frame.memoryFd || imported.bufferSize != frame.bufferSize || imported.width != frame.width) {
+        DestroyImport(imported);
+        Import(frame, imported);
+    }
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(frame.width) * frame.height * 4;
+    EnsureHostBuffer(size);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
+
+    // Acquire what the renderer released to VK_QUEUE_FAMILY_EXTERNAL
+    VkBufferMemoryBarrier acquireBarrier{};
+    acquireBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    acquireBarrier.srcAccessMask = 0;
+    acquireBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    acquireBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    acquireBarrier.dstQueueFamilyIndex = m_queueFamily;
+    acquireBarrier.buffer = imported.buffer;
+    acquireBarrier.offset = 0;
+    acquireBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 1, &acquireBarrier, 0, nullptr);
+
+    VkBufferCopy region{};
+    region.size = size;
+    vkCmdCopyBuffer(m_commandBuffer, imported.buffer, m_hostBuffer, 1, &region);
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record import copy!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_commandBuffer;
+
+    if (vkQueueSubmit(m_queue, 1, &submitInfo, m_fence) != VK_SUCCESS ||
+        vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to copy imported frame!");
+    }
+    vkResetFences(m_device, 1, &m_fence);
+
+    if (m_hostNeedsInvalidate) {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = m_hostMemory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+    }
+    memcpy(pixels, m_hostMapped, static_cast<size_t>(size));
+}
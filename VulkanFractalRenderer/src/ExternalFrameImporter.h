@@ -0,0 +1,67 @@
+#pragma once
+
+#include "HeadlessRenderer.h"
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// The consumer side of EXPORT_MODE_EXTERNAL_FD, standing in for another
+// process or API: its own Vulkan instance and device on the exporting
+// physical device (found by device UUID), which imports each exported
+// buffer once and copies frames out of it into host memory. Used to check
+// exported frames against the other export modes. POSIX only.
+class ExternalFrameImporter {
+public:
+    // deviceUuid as returned by HeadlessRenderer::GetDeviceUuid. Throws if
+    // no device with that UUID can import memory from file descriptors.
+    explicit ExternalFrameImporter(const std::array<uint8_t, VK_UUID_SIZE>& deviceUuid);
+    ~ExternalFrameImporter();
+
+    // Delete copy constructors
+    ExternalFrameImporter(const ExternalFrameImporter&) = delete;
+    ExternalFrameImporter& operator=(const ExternalFrameImporter&) = delete;
+
+    // Copy the width * height RGBA8 pixels of an exported frame into pixels.
+    // Call from the frame consumer, while the frame's memory is still the
+    // frame's. A buffer is imported the first time its index is seen, and
+    // again when the renderer has reallocated it.
+    void Read(const RenderedFrame& frame, uint8_t* pixels);
+
+private:
+    // One imported buffer of the renderer's ring
+    struct ImportedBuffer {
+        int memoryFd = -1;
+        uint64_t bufferSize = 0;
+        uint32_t width = 0;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    void Destroy();
+    void CreateInstance();
+    void PickPhysicalDevice(const std::array<uint8_t, VK_UUID_SIZE>& deviceUuid);
+    void CreateLogicalDevice();
+    void Import(const RenderedFrame& frame, ImportedBuffer& imported);
+    void DestroyImport(ImportedBuffer& imported);
+    // Host-visible buffer of at least size bytes for copies
+    void EnsureHostBuffer(VkDeviceSize size);
+    uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    VkInstance m_instance;
+    VkPhysicalDevice m_physicalDevice;
+    VkDevice m_device;
+    uint32_t m_queueFamily;
+    VkQueue m_queue;
+    VkCommandPool m_commandPool;
+    VkCommandBuffer m_commandBuffer;
+    VkFence m_fence;
+
+    std::vector<ImportedBuffer> m_imports;
+
+    VkBuffer m_hostBuffer;
+    VkDeviceMemory m_hostMemory;
+    VkDeviceSize m_hostSize;
+    void* m_hostMapped;
+    bool m_hostNeedsInvalidate;
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+// Fractal parameters shared by the windowed renderer, the headless renderer
+// and the GLSL shaders (fractal_common.glsl mirrors FractalUBO)
+
+#include <cstdint>
+
+// Fractal types
+enum FractalType {
+    FRACTAL_MANDELBROT = 0,
+    FRACTAL_JULIA,
+    FRACTAL_BURNING_SHIP,
+    FRACTAL_TRICORN,
+    FRACTAL_MULTIBROT,
+    FRACTAL_COUNT
+};
+
+// Color palettes
+enum ColorPalette {
+    PALETTE_RAINBOW = 0,
+    PALETTE_FIRE,
+    PALETTE_OCEAN,
+    PALETTE_GRAYSCALE,
+    PALETTE_ELECTRIC,
+    PALETTE_COUNT,
+    // A user-defined gradient (see PaletteLut::SetCustomGradient); not
+    // part of the built-in palettes the windowed renderer cycles through
+    PALETTE_CUSTOM = PALETTE_COUNT
+};
+
+// How iteration counts map to palette positions
+enum ColorMapping {
+    // Iteration count over the iteration limit
+    COLOR_MAPPING_LINEAR = 0,
+    // Share of escaped pixels with fewer iterations (histogram equalization),
+    // so every palette color covers about the same area whatever the limit
+    COLOR_MAPPING_HISTOGRAM,
+    COLOR_MAPPING_COUNT
+};
+
+// What the iteration pass stores per pixel of the iteration buffer
+enum OutputChannel {
+    // Smooth iteration count; maxIterations for points that never escape
+    OUTPUT_ITERATIONS = 0,
+    // Exterior distance estimate in complex plane units, from the derivative
+    // tracked alongside z; 0 for points that never escape. Colored by the
+    // distance in pixels, with the boundary as a sharp dark line; the color
+    // mapping does not apply.
+    OUTPUT_DISTANCE,
+    OUTPUT_COUNT
+};
+
+// Fractal types whose kernels can stop early on interior points: once the
+// orbit derivative with respect to z falls below a threshold, the orbit is
+// caught by an attracting cycle and the point is reported as interior.
+// Mirrors fractal_common.glsl and CpuRenderer.
+constexpr int INTERIOR_DETECTION_TYPES = (1 << FRACTAL_MANDELBROT) | (1 << FRACTAL_JULIA);
+constexpr double INTERIOR_DERIVATIVE_THRESHOLD = 1e-3;
+
+// Most samples adaptive anti-aliasing takes per pixel; mirrors
+// fractal_common.glsl
+constexpr int MAX_ANTIALIAS_SAMPLES = 64;
+
+// Histogram-equalized coloring; mirrors fractal_common.glsl and
+// histogram.glsl. The histogram buffer holds HISTOGRAM_BINS uint counts
+// followed by HISTOGRAM_BINS + 1 float CDF values, and each histogram pass
+// workgroup counts HISTOGRAM_PIXELS_PER_GROUP pixels.
+constexpr uint32_t HISTOGRAM_BINS = 2048;
+constexpr uint32_t HISTOGRAM_BUFFER_SIZE = (2 * HISTOGRAM_BINS + 1) * 4;
+constexpr uint32_t HISTOGRAM_PIXELS_PER_GROUP = 256 * 32;
+
+// How image pixels map to the complex plane
+enum Projection {
+    // A rectangle around the center, 2 * scale high
+    PROJECTION_PLANE = 0,
+    // A log-polar strip around the center for exponential map zoom videos
+    // (see HeadlessRenderer::RenderExpMap)
+    PROJECTION_EXP_MAP
+};
+
+// Uniform buffer for shader parameters
+struct FractalUBO {
+    float centerX;
+    float centerY;
+    float scale;
+    float aspectRatio;
+    
+    int fractalType;
+    int maxIterations;
+    int colorPalette;
+    int projection;
+    
+    // For Julia set
+    float juliaConstantX;
+    float juliaConstantY;
+    // For Multibrot
+    float multibrotPower;
+    // Palette cycling: shifts the palette along the iteration count, one
+    // full cycle per 1.0. Only the coloring pass reads it.
+    float colorOffset;
+    
+    // Iteration buffer dimensions in pixels
+    int imageWidth;
+    int imageHeight;
+    // Band of image rows evaluated by one iteration pass dispatch
+    int rowOffset;
+    int rowCount;
+
+    // Coloring option; like colorOffset only the coloring pass reads it
+    int colorMapping;
+    // OutputChannel: what the iteration pass stores, and so how the coloring
+    // pass reads it
+    int outputChannel;
+    // Adaptive anti-aliasing of the headless coloring pass: samples taken
+    // for each pixel on an edge, up to MAX_ANTIALIAS_SAMPLES; 0 or 1 leaves
+    // every pixel at one sample. The windowed renderer ignores it.
+    int antialiasSamples;
+    // Interior detection: bit 1 << FractalType turns the derivative
+    // attraction test on for that type (INTERIOR_DETECTION_TYPES have it)
+    int interiorDetection;
+};
+
+// The view of a resampling source; mirrors the push constants of
+// fractal_resample.comp
+struct ResampleSource {
+    // Same meaning as in FractalUBO for a plane source. For an exponential
+    // map, the center the strip was rendered around and the distance of
+    // row 0 (aspectRatio is unused).
+    float centerX;
+    float centerY;
+    float scale;
+    float aspectRatio;
+    int projection;
+    // Source size in pixels
+    int width;
+    int height;
+};
+
+// The view of one tile of a batched tile dispatch; mirrors the tile buffer of
+// fractal_tiles.comp (std430). The FractalUBO fields these replace are the
+// ones that may differ between the tiles of a batch.
+struct TileDescriptor {
+    float centerX;
+    float centerY;
+    float scale;
+    int fractalType;
+    int maxIterations;
+    int colorPalette;
+    float juliaConstantX;
+    float juliaConstantY;
+};
@@ -1,25 +1,57 @@
 #include "FractalRenderer.h"
 #include "VulkanContext.h"
+#include "ComputeDevice.h"
+#include "ShaderLoader.h"
 #include <stdexcept>
 #include <array>
-#include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <cstring>
 #include <cmath>
-#include <immintrin.h> // For SIMD optimization
-#include <filesystem>  // For path operations and checking file existence
-#include <Windows.h>   // For GetModuleFileName
 #include <sstream>     // For string formatting
+#include <iomanip>
+#include <numeric>
+#include <utility>
+
+// Stages of the coloring submission that consume the iteration buffer: the
+// upload of secondary GPU bands, the histogram pass and the fragment shader.
+// The graphics submit waits on the compute timeline at these stages, and the
+// queue family acquire barrier uses the same stages so it is ordered after
+// that wait.
+static constexpr VkPipelineStageFlags ITERATION_CONSUMER_STAGES =
+    VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+// Whether an iteration buffer evaluated with one set of parameters is valid
+// for another. Everything but the coloring options counts; the row
+// band is left out because split-frame rendering changes it every frame.
+static bool SameIterationInputs(const FractalUBO& a, const FractalUBO& b) {
+    return a.centerX == b.centerX && a.centerY == b.centerY && a.scale == b.scale &&
+        a.aspectRatio == b.aspectRatio && a.fractalType == b.fractalType &&
+        a.maxIterations == b.maxIterations && a.projection == b.projection &&
+        a.juliaConstantX == b.juliaConstantX && a.juliaConstantY == b.juliaConstantY &&
+        a.multibrotPower == b.multibrotPower && a.imageWidth == b.imageWidth && a.imageHeight == b.imageHeight &&
+        a.outputChannel == b.outputChannel && a.interiorDetection == b.interiorDetection;
+}
 
-FractalRenderer::FractalRenderer(VulkanContext* vulkanContext)
+FractalRenderer::FractalRenderer(VulkanContext* vulkanContext, uint32_t framesInFlight)
     : m_vulkanContext(vulkanContext)
     , m_renderPass(VK_NULL_HANDLE)
     , m_descriptorSetLayout(VK_NULL_HANDLE)
     , m_pipelineLayout(VK_NULL_HANDLE)
     , m_graphicsPipeline(VK_NULL_HANDLE)
+    , m_computePipelineLayout(VK_NULL_HANDLE)
+    , m_computePipeline(VK_NULL_HANDLE)
+    , m_histogramPipeline(VK_NULL_HANDLE)
+    , m_cdfPipeline(VK_NULL_HANDLE)
+    , m_iterationExtent{ 0, 0 }
+    , m_deviceThroughput(1, 0.0)
+    , m_timestampPeriod(0.0f)
     , m_descriptorPool(VK_NULL_HANDLE)
-    , m_currentFrame(0) {
+    , m_framesInFlight(std::clamp(framesInFlight, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT))
+    , m_currentFrame(0)
+    , m_nextPresentId(1)
+    , m_colorCycleSpeed(0.0f)
+    , m_lastFrameTime(std::chrono::steady_clock::now()) {
 
     // Initialize default fractal parameters
     m_ubo.centerX = 0.0f;
@@ -31,12 +63,35 @@ FractalRenderer::FractalRenderer(VulkanContext* vulkanContext)
     m_ubo.fractalType = FRACTAL_MANDELBROT;
     m_ubo.maxIterations = 100;
     m_ubo.colorPalette = PALETTE_RAINBOW;
-    m_ubo.padding = 0;
+    m_ubo.projection = PROJECTION_PLANE;
     
     m_ubo.juliaConstantX = -0.7f;
     m_ubo.juliaConstantY = 0.27015f;
     m_ubo.multibrotPower = 3.0f;
-    m_ubo.reserved = 0.0f;
+    m_ubo.colorOffset = 0.0f;
+
+    m_ubo.imageWidth = 0;
+    m_ubo.imageHeight = 0;
+    m_ubo.rowOffset = 0;
+    m_ubo.rowCount = 0;
+
+    m_ubo.colorMapping = COLOR_MAPPING_LINEAR;
+    m_ubo.outputChannel = OUTPUT_ITERATIONS;
+    m_ubo.antialiasSamples = 0;
+    m_ubo.interiorDetection = 0;
+
+    // Timestamps on the compute queue measure the primary device's share of
+    // a split frame
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkanContext->GetPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkanContext->GetPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+    if (queueFamilies[vulkanContext->GetComputeQueueFamily()].timestampValidBits != 0) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(vulkanContext->GetPhysicalDevice(), &deviceProperties);
+        m_timestampPeriod = deviceProperties.limits.timestampPeriod;
+    }
 }
 
 FractalRenderer::~FractalRenderer() {
@@ -44,15 +99,15 @@ FractalRenderer::~FractalRenderer() {
 }
 
 void FractalRenderer::Initialize() {
+    m_paletteLut = std::make_unique<PaletteLut>(m_vulkanContext->GetPhysicalDevice(), m_vulkanContext->GetDevice(),
+        m_vulkanContext->GetGraphicsQueue(), m_vulkanContext->GetGraphicsQueueFamily());
     CreateRenderPass();
     CreateDescriptorSetLayout();
     CreateGraphicsPipeline();
+    CreateComputePipelines();
     CreateFramebuffers();
-    CreateUniformBuffers();
-    CreateDescriptorPool();
-    CreateDescriptorSets();
-    CreateCommandBuffers();
-    CreateSyncObjects();
+    CreateImageSyncObjects();
+    CreateFrameResources();
 }
 
 void FractalRenderer::Cleanup() {
@@ -61,67 +116,43 @@ void FractalRenderer::Cleanup() {
     // Wait for device to finish operations
     vkDeviceWaitIdle(device);
     
-    // Clean up synchronization objects
-    for (size_t i = 0; i < m_renderFinishedSemaphores.size(); i++) {
-        if (m_renderFinishedSemaphores[i] != VK_NULL_HANDLE) {
-            vkDestroySemaphore(device, m_renderFinishedSemaphores[i], nullptr);
-        }
-    }
-    
-    for (size_t i = 0; i < m_imageAvailableSemaphores.size(); i++) {
-        if (m_imageAvailableSemaphores[i] != VK_NULL_HANDLE) {
-            vkDestroySemaphore(device, m_imageAvailableSemaphores[i], nullptr);
-        }
-    }
+    // Clean up the frame ring and per-image synchronization objects
+    DestroyFrameResources();
+    DestroyImageSyncObjects();
     
-    for (size_t i = 0; i < m_inFlightFences.size(); i++) {
-        if (m_inFlightFences[i] != VK_NULL_HANDLE) {
-            vkDestroyFence(device, m_inFlightFences[i], nullptr);
-        }
-    }
+    // Secondary devices wait for their own work before shutting down
+    m_computeDevices.clear();
     
-    // Clear sync objects vectors after destruction
-    m_renderFinishedSemaphores.clear();
-    m_imageAvailableSemaphores.clear();
-    m_inFlightFences.clear();
+    CleanupSwapChain();
     
-    // Clean up descriptor pool
-    if (m_descriptorPool != VK_NULL_HANDLE) {
-        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
-        m_descriptorPool = VK_NULL_HANDLE;
+    // Clean up compute pipelines
+    if (m_computePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, m_computePipeline, nullptr);
+        m_computePipeline = VK_NULL_HANDLE;
     }
-    
-    // Clean up descriptor sets vector (these are freed with the pool)
-    m_descriptorSets.clear();
-    
-    // Clean up uniform buffers and unmap memory
-    for (size_t i = 0; i < m_uniformBuffers.size(); i++) {
-        if (m_uniformBuffersMapped.size() > i && m_uniformBuffersMapped[i] != nullptr) {
-            vkUnmapMemory(device, m_uniformBuffersMemory[i]);
-            m_uniformBuffersMapped[i] = nullptr;
-        }
-        
-        if (m_uniformBuffersMemory.size() > i && m_uniformBuffersMemory[i] != VK_NULL_HANDLE) {
-            vkFreeMemory(device, m_uniformBuffersMemory[i], nullptr);
-        }
-        
-        if (m_uniformBuffers[i] != VK_NULL_HANDLE) {
-            vkDestroyBuffer(device, m_uniformBuffers[i], nullptr);
-        }
+
+    if (m_histogramPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, m_histogramPipeline, nullptr);
+        m_histogramPipeline = VK_NULL_HANDLE;
+    }
+
+    if (m_cdfPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, m_cdfPipeline, nullptr);
+        m_cdfPipeline = VK_NULL_HANDLE;
     }
     
-    // Clear vectors after destruction
-    m_uniformBuffers.clear();
-    m_uniformBuffersMemory.clear();
-    m_uniformBuffersMapped.clear();
-    
-    CleanupSwapChain();
+    if (m_computePipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device, m_computePipelineLayout, nullptr);
+        m_computePipelineLayout = VK_NULL_HANDLE;
+    }
     
     // Clean up descriptor set layout
     if (m_descriptorSetLayout != VK_NULL_HANDLE) {
         vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
         m_descriptorSetLayout = VK_NULL_HANDLE;
     }
+
+    m_paletteLut.reset();
     
     // Clean up render pass
     if (m_renderPass != VK_NULL_HANDLE) {
@@ -139,13 +170,6 @@ void FractalRenderer::CleanupSwapChain() {
     }
     m_swapChainFramebuffers.clear();
     
-    // Free command buffers
-    if (!m_commandBuffers.empty()) {
-        vkFreeCommandBuffers(device, m_vulkanContext->GetCommandPool(),
-            static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
-        m_commandBuffers.clear();
-    }
-    
     // Clean up pipeline
     if (m_graphicsPipeline != VK_NULL_HANDLE) {
         vkDestroyPipeline(device, m_graphicsPipeline, nullptr);
@@ -159,18 +183,34 @@ void FractalRenderer::CleanupSwapChain() {
     }
 }
 
-void FractalRenderer::RecreateSwapChain() {
-    // Clean up old swap chain resources
+bool FractalRenderer::RecreateSwapChain() {
+    if (!m_vulkanContext->HasDrawableSurface()) {
+        return false;
+    }
+
+    // Frames still in flight may reference the old framebuffers
+    vkDeviceWaitIdle(m_vulkanContext->GetDevice());
+
+    // Release everything that references the old swap chain images before
+    // the context replaces them
     CleanupSwapChain();
+    DestroyImageSyncObjects();
+    m_vulkanContext->RecreateSwapChain();
     
-    // Create new swap chain resources
+    // Create new swap chain resources. The frame ring does not depend on the
+    // swap chain and is kept as is.
     CreateGraphicsPipeline();
     CreateFramebuffers();
-    CreateCommandBuffers();
+    CreateImageSyncObjects();
+    
+    // The iteration buffers are sized to the swap chain extent
+    DestroyIterationBuffers();
+    CreateIterationBuffers();
     
     // Update aspect ratio in UBO
     m_ubo.aspectRatio = static_cast<float>(m_vulkanContext->GetSwapChainExtent().width) / 
                          static_cast<float>(m_vulkanContext->GetSwapChainExtent().height);
+    return true;
 }
 
 void FractalRenderer::CreateRenderPass() {
@@ -226,95 +266,55 @@ void FractalRenderer::CreateDescriptorSetLayout() {
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
+    // Binding for the iteration buffer (written by compute, read by fragment)
+    VkDescriptorSetLayoutBinding iterationLayoutBinding{};
+    iterationLayoutBinding.binding = 1;
+    iterationLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    iterationLayoutBinding.descriptorCount = 1;
+    iterationLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    iterationLayoutBinding.pImmutableSamplers = nullptr;
+
+    // Binding for the palette lookup texture (read by fragment)
+    VkDescriptorSetLayoutBinding paletteLayoutBinding{};
+    paletteLayoutBinding.binding = 3;
+    paletteLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    paletteLayoutBinding.descriptorCount = 1;
+    paletteLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    paletteLayoutBinding.pImmutableSamplers = nullptr;
+
+    // Binding for the histogram (written by compute, read by fragment)
+    VkDescriptorSetLayoutBinding histogramLayoutBinding{};
+    histogramLayoutBinding.binding = 4;
+    histogramLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    histogramLayoutBinding.descriptorCount = 1;
+    histogramLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    histogramLayoutBinding.pImmutableSamplers = nullptr;
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings = { uboLayoutBinding, iterationLayoutBinding, paletteLayoutBinding,
+        histogramLayoutBinding };
+
     // Create descriptor set layout
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
 
     if (vkCreateDescriptorSetLayout(m_vulkanContext->GetDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor set layout!");
     }
 }
 
-// Helper function to get the executable path
-std::filesystem::path GetExecutablePath() {
-    wchar_t exePath[MAX_PATH];
-    if (GetModuleFileNameW(nullptr, exePath, MAX_PATH) == 0) {
-        throw std::runtime_error("Failed to get executable path. Error code: " + std::to_string(GetLastError()));
-    }
-    return std::filesystem::path(exePath).parent_path();
-}
-
-// Function to find shader file in multiple possible locations
-std::filesystem::path FindShaderFile(const std::string& shaderName) {
-    std::filesystem::path executableDir = GetExecutablePath();
-    
-    // Search paths in priority order
-    std::vector<std::filesystem::path> searchPaths = {
-        // First look in the shaders directory in the executable directory
-        executableDir / "shaders" / shaderName,
-        // Then look directly in the executable directory
-        executableDir / shaderName,
-        // Check in the Debug/Release directory folders
-        executableDir / ".." / "shaders" / shaderName,
-        // Check for Visual Studio project structure
-        executableDir / ".." / ".." / "VulkanFractalRenderer" / "shaders" / shaderName,
-        // Check for deeper project structures
-        executableDir / ".." / ".." / ".." / "VulkanFractalRenderer" / "shaders" / shaderName
-    };
-    
-    // Try all paths
-    for (const auto& path : searchPaths) {
-        std::cout << "Checking path: " << path.string() << std::endl;
-        if (std::filesystem::exists(path)) {
-            std::cout << "Found shader file at: " << path.string() << std::endl;
-            return path;
-        }
-    }
-    
-    // If not found, return the first path and let the caller handle the error
-    std::stringstream errorMsg;
-    errorMsg << "Shader file not found: " << shaderName << "\n";
-    errorMsg << "Searched in the following locations:\n";
-    for (const auto& path : searchPaths) {
-        errorMsg << "  - " << path.string() << "\n";
-    }
-    throw std::runtime_error(errorMsg.str());
-}
-
 void FractalRenderer::CreateGraphicsPipeline() {
     VkShaderModule vertShaderModule = VK_NULL_HANDLE;
     VkShaderModule fragShaderModule = VK_NULL_HANDLE;
     
     try {
-        // Try to find shader files
-        std::filesystem::path vertShaderPath = FindShaderFile("fractal.vert.spv");
-        std::filesystem::path fragShaderPath = FindShaderFile("fractal.frag.spv");
-        
-        // Load shader code
-        auto vertShaderCode = ReadFile(vertShaderPath.string());
-        auto fragShaderCode = ReadFile(fragShaderPath.string());
-        
-        if (vertShaderCode.empty()) {
-            throw std::runtime_error("Vertex shader file is empty: " + vertShaderPath.string());
-        }
-        
-        if (fragShaderCode.empty()) {
-            throw std::runtime_error("Fragment shader file is empty: " + fragShaderPath.string());
-        }
-
-        // Validate SPIRV bytecode
-        if (vertShaderCode.size() % 4 != 0) {
-            throw std::runtime_error("Vertex shader SPIR-V bytecode is not properly aligned (size is not a multiple of 4 bytes)");
-        }
-        
-        if (fragShaderCode.size() % 4 != 0) {
-            throw std::runtime_error("Fragment shader SPIR-V bytecode is not properly aligned (size is not a multiple of 4 bytes)");
-        }
+        // Load shader code (embedded in the binary)
+        auto vertShaderCode = LoadShaderCode("fractal.vert.spv");
+        auto fragShaderCode = LoadShaderCode("fractal.frag.spv");
 
         // Create shader modules
         vertShaderModule = CreateShaderModule(vertShaderCode);
@@ -454,6 +454,83 @@ void FractalRenderer::CreateGraphicsPipeline() {
     }
 }
 
+void FractalRenderer::CreateComputePipelines() {
+    VkShaderModule computeShaderModule = VK_NULL_HANDLE;
+
+    // The iteration pass, and the histogram and CDF passes of histogram-
+    // equalized coloring
+    std::array<std::pair<std::string, VkPipeline*>, 3> pipelines = { {
+        { "fractal.comp.spv", &m_computePipeline },
+        { ComputeDevice::GetHistogramShaderName(m_vulkanContext->GetPhysicalDevice()), &m_histogramPipeline },
+        { "fractal_cdf.comp.spv", &m_cdfPipeline },
+    } };
+
+    try {
+        // Pipeline layout (same descriptor set layout as the coloring pass).
+        // The histogram pass gets the number of pixels to count as a push
+        // constant.
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(uint32_t);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(m_vulkanContext->GetDevice(), &pipelineLayoutInfo, nullptr, &m_computePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline layout!");
+        }
+
+        for (const auto& [shaderName, pipeline] : pipelines) {
+            auto computeShaderCode = LoadShaderCode(shaderName);
+            computeShaderModule = CreateShaderModule(computeShaderCode);
+
+            VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
+            computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            computeShaderStageInfo.module = computeShaderModule;
+            computeShaderStageInfo.pName = "main";
+
+            // Create the compute pipeline
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage = computeShaderStageInfo;
+            pipelineInfo.layout = m_computePipelineLayout;
+
+            VkResult result = vkCreateComputePipelines(m_vulkanContext->GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, pipeline);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create compute pipeline " + shaderName + "! Error code: " + std::to_string(result));
+            }
+
+            vkDestroyShaderModule(m_vulkanContext->GetDevice(), computeShaderModule, nullptr);
+            computeShaderModule = VK_NULL_HANDLE;
+        }
+    }
+    catch (const std::exception& e) {
+        if (computeShaderModule != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(m_vulkanContext->GetDevice(), computeShaderModule, nullptr);
+        }
+
+        for (const auto& entry : pipelines) {
+            if (*entry.second != VK_NULL_HANDLE) {
+                vkDestroyPipeline(m_vulkanContext->GetDevice(), *entry.second, nullptr);
+                *entry.second = VK_NULL_HANDLE;
+            }
+        }
+
+        if (m_computePipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(m_vulkanContext->GetDevice(), m_computePipelineLayout, nullptr);
+            m_computePipelineLayout = VK_NULL_HANDLE;
+        }
+
+        throw std::runtime_error("Compute pipeline creation failed: " + std::string(e.what()));
+    }
+}
+
 void FractalRenderer::CreateFramebuffers() {
     const auto& swapChainImageViews = m_vulkanContext->GetSwapChainImageViews();
     m_swapChainFramebuffers.resize(swapChainImageViews.size());
@@ -477,59 +554,145 @@ void FractalRenderer::CreateFramebuffers() {
     }
 }
 
+void FractalRenderer::CreateFrameResources() {
+    m_frames.resize(m_framesInFlight);
+    m_currentFrame = 0;
+
+    CreateUniformBuffers();
+    CreateDescriptorPool();
+    CreateDescriptorSets();
+    CreateCommandBuffers();
+    CreateSyncObjects();
+    CreateIterationBuffers();
+}
+
+void FractalRenderer::DestroyFrameResources() {
+    VkDevice device = m_vulkanContext->GetDevice();
+
+    DestroyIterationBuffers();
+
+    for (auto& frame : m_frames) {
+        // Clean up synchronization objects
+        if (frame.imageAvailableSemaphore != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, frame.imageAvailableSemaphore, nullptr);
+        }
+
+        // Free the command buffers
+        if (frame.commandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, m_vulkanContext->GetCommandPool(), 1, &frame.commandBuffer);
+        }
+
+        if (frame.computeCommandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, m_vulkanContext->GetComputeCommandPool(), 1, &frame.computeCommandBuffer);
+        }
+
+        if (frame.timestampQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, frame.timestampQueryPool, nullptr);
+        }
+
+        // Clean up uniform buffer and unmap memory
+        if (frame.uniformBufferMapped != nullptr) {
+            vkUnmapMemory(device, frame.uniformBufferMemory);
+        }
+
+        if (frame.uniformBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(device, frame.uniformBufferMemory, nullptr);
+        }
+
+        if (frame.uniformBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, frame.uniformBuffer, nullptr);
+        }
+
+        if (frame.histogramBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, frame.histogramBuffer, nullptr);
+        }
+
+        if (frame.histogramBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(device, frame.histogramBufferMemory, nullptr);
+        }
+    }
+    m_frames.clear();
+
+    // Clean up descriptor pool (descriptor sets are freed with the pool)
+    if (m_descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        m_descriptorPool = VK_NULL_HANDLE;
+    }
+}
+
+void FractalRenderer::SetFramesInFlight(uint32_t framesInFlight) {
+    framesInFlight = std::clamp(framesInFlight, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+    if (framesInFlight == m_framesInFlight && !m_frames.empty()) {
+        return;
+    }
+
+    // The ring can only be rebuilt once every slot has retired
+    vkDeviceWaitIdle(m_vulkanContext->GetDevice());
+
+    DestroyFrameResources();
+    m_framesInFlight = framesInFlight;
+    CreateFrameResources();
+}
+
 void FractalRenderer::CreateUniformBuffers() {
     VkDeviceSize bufferSize = sizeof(FractalUBO);
-    const auto& swapChainImages = m_vulkanContext->GetSwapChainImages();
 
-    m_uniformBuffers.resize(swapChainImages.size());
-    m_uniformBuffersMemory.resize(swapChainImages.size());
-    m_uniformBuffersMapped.resize(swapChainImages.size());
-
-    // Create uniform buffers for each swap chain image
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
+    // Create one uniform buffer per frame slot
+    for (auto& frame : m_frames) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = bufferSize;
         bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if (vkCreateBuffer(m_vulkanContext->GetDevice(), &bufferInfo, nullptr, &m_uniformBuffers[i]) != VK_SUCCESS) {
+        if (vkCreateBuffer(m_vulkanContext->GetDevice(), &bufferInfo, nullptr, &frame.uniformBuffer) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create uniform buffer!");
         }
 
         // Allocate memory for the buffer
         VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(m_vulkanContext->GetDevice(), m_uniformBuffers[i], &memRequirements);
+        vkGetBufferMemoryRequirements(m_vulkanContext->GetDevice(), frame.uniformBuffer, &memRequirements);
 
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = m_vulkanContext->FindMemoryType(memRequirements.memoryTypeBits, 
+        allocInfo.memoryTypeIndex = m_vulkanContext->FindMemoryType(memRequirements.memoryTypeBits,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-        if (vkAllocateMemory(m_vulkanContext->GetDevice(), &allocInfo, nullptr, &m_uniformBuffersMemory[i]) != VK_SUCCESS) {
+        if (vkAllocateMemory(m_vulkanContext->GetDevice(), &allocInfo, nullptr, &frame.uniformBufferMemory) != VK_SUCCESS) {
             throw std::runtime_error("Failed to allocate uniform buffer memory!");
         }
 
         // Bind memory to buffer
-        vkBindBufferMemory(m_vulkanContext->GetDevice(), m_uniformBuffers[i], m_uniformBuffersMemory[i], 0);
+        vkBindBufferMemory(m_vulkanContext->GetDevice(), frame.uniformBuffer, frame.uniformBufferMemory, 0);
 
         // Map memory for efficient updates
-        vkMapMemory(m_vulkanContext->GetDevice(), m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i]);
+        vkMapMemory(m_vulkanContext->GetDevice(), frame.uniformBufferMemory, 0, bufferSize, 0, &frame.uniformBufferMapped);
+
+        // The histogram lives next to the uniforms: both are sized by the
+        // frame ring, not the swap chain. Counts are cleared with
+        // vkCmdFillBuffer before each histogram pass.
+        m_vulkanContext->CreateBuffer(HISTOGRAM_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.histogramBuffer, frame.histogramBufferMemory);
     }
 }
 
 void FractalRenderer::CreateDescriptorPool() {
-    // Create a descriptor pool for uniform buffers
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(m_vulkanContext->GetSwapChainImages().size());
+    // Create a descriptor pool for uniform buffers, iteration buffers,
+    // histograms and the palette
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = m_framesInFlight;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = m_framesInFlight * 2;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = m_framesInFlight;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(m_vulkanContext->GetSwapChainImages().size());
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = m_framesInFlight;
 
     if (vkCreateDescriptorPool(m_vulkanContext->GetDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor pool!");
@@ -538,81 +701,322 @@ void FractalRenderer::CreateDescriptorPool() {
 
 void FractalRenderer::CreateDescriptorSets() {
     // Allocate descriptor sets
-    std::vector<VkDescriptorSetLayout> layouts(m_vulkanContext->GetSwapChainImages().size(), m_descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(m_framesInFlight, m_descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(m_vulkanContext->GetSwapChainImages().size());
+    allocInfo.descriptorSetCount = m_framesInFlight;
     allocInfo.pSetLayouts = layouts.data();
 
-    m_descriptorSets.resize(m_vulkanContext->GetSwapChainImages().size());
-    if (vkAllocateDescriptorSets(m_vulkanContext->GetDevice(), &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+    std::vector<VkDescriptorSet> descriptorSets(m_framesInFlight);
+    if (vkAllocateDescriptorSets(m_vulkanContext->GetDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate descriptor sets!");
     }
 
-    // Update descriptor sets with uniform buffer info
-    for (size_t i = 0; i < m_vulkanContext->GetSwapChainImages().size(); i++) {
+    // Update descriptor sets with uniform buffer, palette and histogram
+    // info. Palette changes rewrite the image's contents, never these
+    // descriptors.
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        m_frames[i].descriptorSet = descriptorSets[i];
+
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_uniformBuffers[i];
+        bufferInfo.buffer = m_frames[i].uniformBuffer;
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(FractalUBO);
 
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = m_descriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-
-        vkUpdateDescriptorSets(m_vulkanContext->GetDevice(), 1, &descriptorWrite, 0, nullptr);
+        VkDescriptorImageInfo paletteInfo{};
+        paletteInfo.sampler = m_paletteLut->GetSampler();
+        paletteInfo.imageView = m_paletteLut->GetImageView();
+        paletteInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkDescriptorBufferInfo histogramInfo{};
+        histogramInfo.buffer = m_frames[i].histogramBuffer;
+        histogramInfo.offset = 0;
+        histogramInfo.range = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = m_frames[i].descriptorSet;
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = m_frames[i].descriptorSet;
+        descriptorWrites[1].dstBinding = 3;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &paletteInfo;
+        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[2].dstSet = m_frames[i].descriptorSet;
+        descriptorWrites[2].dstBinding = 4;
+        descriptorWrites[2].dstArrayElement = 0;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[2].descriptorCount = 1;
+        descriptorWrites[2].pBufferInfo = &histogramInfo;
+
+        vkUpdateDescriptorSets(m_vulkanContext->GetDevice(), static_cast<uint32_t>(descriptorWrites.size()),
+            descriptorWrites.data(), 0, nullptr);
     }
 }
 
 void FractalRenderer::CreateCommandBuffers() {
-    // Allocate command buffers
-    m_commandBuffers.resize(m_swapChainFramebuffers.size());
+    // Allocate one command buffer per frame slot
+    std::vector<VkCommandBuffer> commandBuffers(m_framesInFlight);
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = m_vulkanContext->GetCommandPool();
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
+    allocInfo.commandBufferCount = m_framesInFlight;
 
-    if (vkAllocateCommandBuffers(m_vulkanContext->GetDevice(), &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
+    if (vkAllocateCommandBuffers(m_vulkanContext->GetDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate command buffers!");
     }
+
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        m_frames[i].commandBuffer = commandBuffers[i];
+    }
+
+    // Allocate the iteration pass command buffers from the compute queue's pool
+    allocInfo.commandPool = m_vulkanContext->GetComputeCommandPool();
+
+    if (vkAllocateCommandBuffers(m_vulkanContext->GetDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate compute command buffers!");
+    }
+
+    for (uint32_t i = 0; i < m_framesInFlight; i++) {
+        m_frames[i].computeCommandBuffer = commandBuffers[i];
+    }
 }
 
 void FractalRenderer::CreateSyncObjects() {
-    // Create semaphores and fences for synchronization
-    m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-
+    // Create the acquire semaphore for each frame slot. Swap chain acquire
+    // and present only accept binary semaphores; everything else is ordered
+    // by the context's timeline semaphore.
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Start signaled so we don't wait on first frame
+    for (auto& frame : m_frames) {
+        if (vkCreateSemaphore(m_vulkanContext->GetDevice(), &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create synchronization objects!");
+        }
+    }
+
+    // Start and end timestamps of each slot's iteration pass
+    if (m_timestampPeriod > 0.0f) {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2;
+
+        for (auto& frame : m_frames) {
+            if (vkCreateQueryPool(m_vulkanContext->GetDevice(), &queryPoolInfo, nullptr, &frame.timestampQueryPool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create timestamp query pool!");
+            }
+        }
+    }
+}
+
+void FractalRenderer::CreateImageSyncObjects() {
+    size_t imageCount = m_vulkanContext->GetSwapChainImages().size();
+
+    // No frame has rendered to any of the new images yet
+    m_imageTimelineValues.assign(imageCount, 0);
+    m_renderFinishedSemaphores.resize(imageCount, VK_NULL_HANDLE);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(m_vulkanContext->GetDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(m_vulkanContext->GetDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(m_vulkanContext->GetDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS) {
+    for (size_t i = 0; i < imageCount; i++) {
+        if (vkCreateSemaphore(m_vulkanContext->GetDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create synchronization objects!");
         }
     }
 }
 
-void FractalRenderer::UpdateUniformBuffer(uint32_t currentImage) {
+void FractalRenderer::DestroyImageSyncObjects() {
+    for (auto semaphore : m_renderFinishedSemaphores) {
+        if (semaphore != VK_NULL_HANDLE) {
+            vkDestroySemaphore(m_vulkanContext->GetDevice(), semaphore, nullptr);
+        }
+    }
+    m_renderFinishedSemaphores.clear();
+    m_imageTimelineValues.clear();
+}
+
+void FractalRenderer::CreateIterationBuffers() {
+    m_iterationExtent = m_vulkanContext->GetSwapChainExtent();
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(m_iterationExtent.width) * m_iterationExtent.height * sizeof(float);
+
+    for (auto& frame : m_frames) {
+        m_vulkanContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.iterationBuffer, frame.iterationBufferMemory);
+
+        // Secondary GPUs write their bands here, at the band's image offset
+        if (!m_computeDevices.empty()) {
+            m_vulkanContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                frame.bandUploadBuffer, frame.bandUploadBufferMemory);
+            vkMapMemory(m_vulkanContext->GetDevice(), frame.bandUploadBufferMemory, 0, bufferSize, 0, &frame.bandUploadBufferMapped);
+        }
+
+        // Bands measured at the old size no longer apply, and the new buffer
+        // holds nothing yet
+        frame.bandRows.clear();
+        frame.iterationsValid = false;
+
+        // Point the frame's descriptor set at its iteration buffer
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = frame.iterationBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = frame.descriptorSet;
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+        vkUpdateDescriptorSets(m_vulkanContext->GetDevice(), 1, &descriptorWrite, 0, nullptr);
+    }
+
+    m_ubo.imageWidth = static_cast<int>(m_iterationExtent.width);
+    m_ubo.imageHeight = static_cast<int>(m_iterationExtent.height);
+    m_ubo.rowOffset = 0;
+    m_ubo.rowCount = m_ubo.imageHeight;
+
+    for (auto& computeDevice : m_computeDevices) {
+        computeDevice->Configure(m_framesInFlight, m_iterationExtent.width, m_iterationExtent.height);
+    }
+}
+
+void FractalRenderer::DestroyIterationBuffers() {
+    VkDevice device = m_vulkanContext->GetDevice();
+
+    for (auto& frame : m_frames) {
+        if (frame.iterationBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, frame.iterationBuffer, nullptr);
+            frame.iterationBuffer = VK_NULL_HANDLE;
+        }
+
+        if (frame.iterationBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(device, frame.iterationBufferMemory, nullptr);
+            frame.iterationBufferMemory = VK_NULL_HANDLE;
+        }
+
+        if (frame.bandUploadBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, frame.bandUploadBuffer, nullptr);
+            frame.bandUploadBuffer = VK_NULL_HANDLE;
+        }
+
+        if (frame.bandUploadBufferMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(device, frame.bandUploadBufferMemory, nullptr);
+            frame.bandUploadBufferMemory = VK_NULL_HANDLE;
+            frame.bandUploadBufferMapped = nullptr;
+        }
+    }
+}
+
+void FractalRenderer::SetMultiGpu(bool enable) {
+    if (enable == !m_computeDevices.empty()) {
+        return;
+    }
+
+    // The iteration buffers change layout, so nothing may be in flight
+    vkDeviceWaitIdle(m_vulkanContext->GetDevice());
+    DestroyIterationBuffers();
+    m_computeDevices.clear();
+
+    if (enable) {
+        // One logical device per additional GPU. Device groups would let a
+        // single logical device span identical GPUs, but separate devices
+        // also work with mixed vendors and models.
+        auto physicalDevices = ComputeDevice::FindSecondaryDevices(m_vulkanContext->GetInstance(), m_vulkanContext->GetPhysicalDevice());
+
+        for (VkPhysicalDevice physicalDevice : physicalDevices) {
+            try {
+                m_computeDevices.push_back(std::make_unique<ComputeDevice>(physicalDevice));
+                std::cout << "Split-frame rendering on secondary GPU: " << m_computeDevices.back()->GetName() << std::endl;
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Skipping secondary GPU: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    m_deviceThroughput.assign(m_computeDevices.size() + 1, 0.0);
+    CreateIterationBuffers();
+}
+
+void FractalRenderer::SplitFrame(std::vector<uint32_t>& bandRows) const {
+    size_t deviceCount = m_deviceThroughput.size();
+    bandRows.assign(deviceCount, 0);
+
+    // Until every device has been measured, split evenly
+    std::vector<double> weights = m_deviceThroughput;
+    if (std::find(weights.begin(), weights.end(), 0.0) != weights.end()) {
+        std::fill(weights.begin(), weights.end(), 1.0);
+    }
+    double totalWeight = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+    // Secondary bands are whole 8-row workgroups, taken from the bottom of
+    // the image. Each device keeps at least one workgroup row so its
+    // throughput stays measured. The primary device takes the rest.
+    uint32_t height = m_iterationExtent.height;
+    uint32_t groupRows = (height + 7) / 8;
+    uint32_t assignedGroups = 0;
+
+    for (size_t i = 1; i < deviceCount; i++) {
+        uint32_t groups = static_cast<uint32_t>(groupRows * weights[i] / totalWeight);
+        uint32_t remainingGroups = groupRows - assignedGroups;
+        uint32_t availableGroups = remainingGroups > 0 ? remainingGroups - 1 : 0;
+        groups = std::min(std::max(groups, 1u), availableGroups);
+
+        bandRows[i] = groups * 8;
+        assignedGroups += groups;
+    }
+
+    bandRows[0] = height - std::min(height, assignedGroups * 8);
+}
+
+void FractalRenderer::UpdateThroughput(size_t deviceIndex, uint32_t rows, double milliseconds) {
+    if (rows == 0 || milliseconds <= 0.0) {
+        return;
+    }
+
+    // Smooth over a few frames so one slow frame does not move the split
+    double rowsPerMillisecond = rows / milliseconds;
+    double& throughput = m_deviceThroughput[deviceIndex];
+    throughput = throughput == 0.0 ? rowsPerMillisecond : throughput * 0.75 + rowsPerMillisecond * 0.25;
+}
+
+double FractalRenderer::ReadIterationPassTime(const FrameResources& frame) const {
+    if (frame.timestampQueryPool == VK_NULL_HANDLE) {
+        return 0.0;
+    }
+
+    std::array<uint64_t, 2> timestamps{};
+    if (vkGetQueryPoolResults(m_vulkanContext->GetDevice(), frame.timestampQueryPool, 0, 2, sizeof(timestamps),
+        timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return 0.0;
+    }
+
+    return static_cast<double>(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1e-6;
+}
+
+void FractalRenderer::UpdateUniformBuffer(uint32_t frameIndex) {
     // Copy UBO data to mapped memory
-    memcpy(m_uniformBuffersMapped[currentImage], &m_ubo, sizeof(m_ubo));
+    memcpy(m_frames[frameIndex].uniformBufferMapped, &m_ubo, sizeof(m_ubo));
 }
 
-void FractalRenderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+void FractalRenderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameIndex,
+    bool newIterations) {
     // Begin command buffer
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -621,6 +1025,96 @@ void FractalRenderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
 
+    FrameResources& frame = m_frames[frameIndex];
+
+    // Acquire the iteration buffer from the compute queue family. This pairs
+    // with the release barrier in RecordComputeCommandBuffer; a recolored
+    // buffer is still owned by the graphics family from its last acquire.
+    if (newIterations && m_vulkanContext->HasAsyncCompute()) {
+        VkBufferMemoryBarrier acquireBarrier{};
+        acquireBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        acquireBarrier.srcAccessMask = 0;
+        acquireBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        acquireBarrier.srcQueueFamilyIndex = m_vulkanContext->GetComputeQueueFamily();
+        acquireBarrier.dstQueueFamilyIndex = m_vulkanContext->GetGraphicsQueueFamily();
+        acquireBarrier.buffer = frame.iterationBuffer;
+        acquireBarrier.offset = 0;
+        acquireBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, ITERATION_CONSUMER_STAGES, ITERATION_CONSUMER_STAGES,
+            0, 0, nullptr, 1, &acquireBarrier, 0, nullptr);
+    }
+
+    // Upload the bands evaluated by secondary GPUs below the primary's band
+    if (newIterations && frame.bandUploadBuffer != VK_NULL_HANDLE && frame.bandRows.size() > 1) {
+        VkDeviceSize rowSize = static_cast<VkDeviceSize>(m_iterationExtent.width) * sizeof(float);
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = frame.bandRows[0] * rowSize;
+        copyRegion.dstOffset = copyRegion.srcOffset;
+        copyRegion.size = (m_iterationExtent.height - frame.bandRows[0]) * rowSize;
+
+        if (copyRegion.size > 0) {
+            vkCmdCopyBuffer(commandBuffer, frame.bandUploadBuffer, frame.iterationBuffer, 1, &copyRegion);
+
+            VkBufferMemoryBarrier uploadBarrier{};
+            uploadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            uploadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            uploadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            uploadBarrier.buffer = frame.iterationBuffer;
+            uploadBarrier.offset = copyRegion.dstOffset;
+            uploadBarrier.size = copyRegion.size;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 0, nullptr, 1, &uploadBarrier, 0, nullptr);
+        }
+    }
+
+    // Equalize over the whole frame once all bands are in. Recolored frames
+    // reuse the slot's histogram unless the mapping was just switched on.
+    if (m_ubo.colorMapping == COLOR_MAPPING_HISTOGRAM && m_ubo.outputChannel == OUTPUT_ITERATIONS && !frame.histogramValid) {
+        vkCmdFillBuffer(commandBuffer, frame.histogramBuffer, 0, HISTOGRAM_BINS * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        uint32_t pixelCount = m_iterationExtent.width * m_iterationExtent.height;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_histogramPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1,
+            &frame.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, m_computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pixelCount), &pixelCount);
+        vkCmdDispatch(commandBuffer, (pixelCount + HISTOGRAM_PIXELS_PER_GROUP - 1) / HISTOGRAM_PIXELS_PER_GROUP, 1, 1);
+
+        VkMemoryBarrier histogramBarrier{};
+        histogramBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        histogramBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        histogramBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &histogramBarrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cdfPipeline);
+        vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+        // The fragment shader samples the finished CDF
+        VkMemoryBarrier cdfBarrier{};
+        cdfBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        cdfBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cdfBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 1, &cdfBarrier, 0, nullptr, 0, nullptr);
+
+        frame.histogramValid = true;
+    }
+
     // Begin render pass
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -655,7 +1149,7 @@ void FractalRenderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
     // Bind descriptor set
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[imageIndex], 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_frames[frameIndex].descriptorSet, 0, nullptr);
 
     // Draw fullscreen triangle
     vkCmdDraw(commandBuffer, 3, 1, 0, 0);
@@ -669,113 +1163,271 @@ void FractalRenderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_
     }
 }
 
-void FractalRenderer::RenderFrame() {
-    // Wait for previous frame to finish
-    vkWaitForFences(m_vulkanContext->GetDevice(), 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+void FractalRenderer::RecordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    try {
-        // Acquire the next image
-        uint32_t imageIndex = m_vulkanContext->AcquireNextImage(m_imageAvailableSemaphores[m_currentFrame]);
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording compute command buffer!");
+    }
 
-        // Update uniform buffer with fractal parameters
-        UpdateUniformBuffer(imageIndex);
+    VkQueryPool queryPool = m_frames[frameIndex].timestampQueryPool;
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+
+    // Evaluate the fractal for every pixel of this device's band (8x8 workgroups)
+    uint32_t rowCount = static_cast<uint32_t>(m_ubo.rowCount);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1,
+        &m_frames[frameIndex].descriptorSet, 0, nullptr);
+    vkCmdDispatch(commandBuffer, (m_iterationExtent.width + 7) / 8, (rowCount + 7) / 8, 1);
 
-        // Reset the fence for this frame
-        vkResetFences(m_vulkanContext->GetDevice(), 1, &m_inFlightFences[m_currentFrame]);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+    }
+
+    // Release the iteration buffer to the graphics queue family. No transfer
+    // back is needed: every iteration pass rewrites the whole buffer (with
+    // the band uploads), so its previous contents may be discarded.
+    if (m_vulkanContext->HasAsyncCompute()) {
+        VkBufferMemoryBarrier releaseBarrier{};
+        releaseBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        releaseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        releaseBarrier.dstAccessMask = 0;
+        releaseBarrier.srcQueueFamilyIndex = m_vulkanContext->GetComputeQueueFamily();
+        releaseBarrier.dstQueueFamilyIndex = m_vulkanContext->GetGraphicsQueueFamily();
+        releaseBarrier.buffer = m_frames[frameIndex].iterationBuffer;
+        releaseBarrier.offset = 0;
+        releaseBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 1, &releaseBarrier, 0, nullptr);
+    }
 
-        // Reset and record command buffer
-        vkResetCommandBuffer(m_commandBuffers[imageIndex], 0);
-        RecordCommandBuffer(m_commandBuffers[imageIndex], imageIndex);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record compute command buffer!");
+    }
+}
 
-        // Submit the command buffer
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+bool FractalRenderer::RenderFrame() {
+    // Resizes and out-of-date presents only flag the swap chain; rebuild it
+    // here, between frames, where nothing references the old images
+    if (m_vulkanContext->IsSwapChainOutOfDate() && !RecreateSwapChain()) {
+        return false;
+    }
 
-        VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
+    FrameResources& frame = m_frames[m_currentFrame];
 
-        VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+    // Wait until the GPU is done with this slot's command buffers, uniform
+    // buffer and iteration buffer. The slot's graphics submission waited for
+    // its compute submission, so the graphics value covers both.
+    m_vulkanContext->WaitForTimelineValue(frame.timelineValue);
 
-        if (vkQueueSubmit(m_vulkanContext->GetGraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to submit draw command buffer!");
+    // Advance color cycling by the time since the last frame
+    auto now = std::chrono::steady_clock::now();
+    if (m_colorCycleSpeed != 0.0f) {
+        float elapsed = std::chrono::duration<float>(now - m_lastFrameTime).count();
+        m_ubo.colorOffset = std::fmod(m_ubo.colorOffset + elapsed * m_colorCycleSpeed, 1.0f);
+    }
+    m_lastFrameTime = now;
+
+    // The escape-time loops only run when something they depend on changed
+    // since this slot's buffer was evaluated. Palette changes and color
+    // cycling just recolor it, which costs a fraction of a millisecond even
+    // for large images at high iteration counts.
+    bool newIterations = !frame.iterationsValid || !SameIterationInputs(frame.iterationParameters, m_ubo);
+
+    // Split the frame between the GPUs. The slot's previous iteration pass
+    // has retired, so its timing feeds into this frame's split.
+    if (newIterations && !m_computeDevices.empty()) {
+        if (!frame.bandRows.empty()) {
+            UpdateThroughput(0, frame.bandRows[0], ReadIterationPassTime(frame));
         }
+        SplitFrame(frame.bandRows);
 
-        // Present the result
-        m_vulkanContext->PresentImage(imageIndex, m_renderFinishedSemaphores[m_currentFrame]);
+        uint32_t rowOffset = frame.bandRows[0];
+        for (size_t i = 0; i < m_computeDevices.size(); i++) {
+            m_computeDevices[i]->Dispatch(m_currentFrame, m_ubo, rowOffset, frame.bandRows[i + 1]);
+            rowOffset += frame.bandRows[i + 1];
+        }
 
-        // Move to the next frame
-        m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_ubo.rowCount = static_cast<int>(frame.bandRows[0]);
     }
-    catch (const std::exception& e) {
-        // Ensure fence is reset in case of an error
-        vkResetFences(m_vulkanContext->GetDevice(), 1, &m_inFlightFences[m_currentFrame]);
-        throw; // Re-throw the exception
+
+    // Update uniform buffer with fractal parameters
+    UpdateUniformBuffer(m_currentFrame);
+
+    // Kick off the iteration pass before acquiring a swap chain image. On a
+    // separate compute queue it runs while the graphics queue is still
+    // coloring and presenting the previous frame.
+    frame.computeTimelineValue = 0;
+    if (newIterations) {
+        vkResetCommandBuffer(frame.computeCommandBuffer, 0);
+        RecordComputeCommandBuffer(frame.computeCommandBuffer, m_currentFrame);
+        frame.computeTimelineValue = m_vulkanContext->SubmitCompute(frame.computeCommandBuffer);
+        frame.iterationParameters = m_ubo;
+        frame.iterationsValid = true;
+        frame.histogramValid = false;
     }
-}
 
-VkShaderModule FractalRenderer::CreateShaderModule(const std::vector<char>& code) {
-    if (code.empty()) {
-        throw std::runtime_error("Cannot create shader module from empty code");
+    // Acquire the next image. If the swap chain went out of date the frame is
+    // dropped: nothing waits on the unsignaled acquire semaphore, and the
+    // slot may only be reused once the iteration pass submitted above is done.
+    // Its buffer was released by the compute queue but never acquired, so
+    // the next frame in the slot evaluates it again.
+    uint32_t imageIndex = 0;
+    if (!m_vulkanContext->AcquireNextImage(frame.imageAvailableSemaphore, imageIndex)) {
+        m_vulkanContext->WaitForComputeTimelineValue(frame.computeTimelineValue);
+        frame.iterationsValid = false;
+        return RecreateSwapChain();
     }
-    
-    // Ensure proper alignment for SPIR-V
-    if (code.size() % 4 != 0) {
-        throw std::runtime_error("Shader code size is not a multiple of 4 bytes (invalid SPIR-V)");
+
+    // An image can be returned before the frame that last rendered to it has
+    // retired (e.g. more frames in flight than swap chain images), so wait for
+    // that frame too before reusing the image's render-finished semaphore
+    m_vulkanContext->WaitForTimelineValue(m_imageTimelineValues[imageIndex]);
+
+    // Retire latency samples whose frames have reached the display
+    CollectLatencySamples();
+
+    // Collect the secondary GPUs' bands into the upload buffer
+    if (newIterations && !m_computeDevices.empty()) {
+        size_t rowOffset = frame.bandRows[0];
+        float* uploadRows = static_cast<float*>(frame.bandUploadBufferMapped);
+
+        for (size_t i = 0; i < m_computeDevices.size(); i++) {
+            double milliseconds = m_computeDevices[i]->ReadBand(m_currentFrame, uploadRows + rowOffset * m_iterationExtent.width);
+            UpdateThroughput(i + 1, frame.bandRows[i + 1], milliseconds);
+            rowOffset += frame.bandRows[i + 1];
+        }
     }
-    
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-    VkShaderModule shaderModule;
-    VkResult result = vkCreateShaderModule(m_vulkanContext->GetDevice(), &createInfo, nullptr, &shaderModule);
-    if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create shader module! Error code: " + std::to_string(result));
+    // Reset and record command buffer
+    vkResetCommandBuffer(frame.commandBuffer, 0);
+    RecordCommandBuffer(frame.commandBuffer, imageIndex, m_currentFrame, newIterations);
+
+    // Submit the command buffer after the iteration pass; the returned
+    // timeline value retires both the frame slot and the swap chain image
+    SubmitDependencies dependencies;
+    dependencies.waitSemaphore = frame.imageAvailableSemaphore;
+    dependencies.waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies.signalSemaphore = m_renderFinishedSemaphores[imageIndex];
+    dependencies.computeWaitValue = frame.computeTimelineValue;
+    dependencies.timelineWaitStage = ITERATION_CONSUMER_STAGES;
+
+    frame.timelineValue = m_vulkanContext->SubmitGraphics(frame.commandBuffer, dependencies);
+    m_imageTimelineValues[imageIndex] = frame.timelineValue;
+
+    // Tag this frame if it is the first to show the effect of an input event
+    uint64_t presentId = 0;
+    if (m_pendingInputTime) {
+        presentId = m_nextPresentId++;
+        m_pendingLatencySamples.push_back({ *m_pendingInputTime, presentId, frame.timelineValue,
+            m_vulkanContext->GetSwapChainGeneration() });
+        m_pendingInputTime.reset();
     }
 
-    return shaderModule;
+    // Present the result
+    m_vulkanContext->PresentImage(imageIndex, m_renderFinishedSemaphores[imageIndex], presentId);
+
+    // Move to the next frame
+    m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+    return true;
 }
 
-std::vector<char> FractalRenderer::ReadFile(const std::string& filename) {
-    // Verify the file exists
-    if (!std::filesystem::exists(filename)) {
-        throw std::runtime_error("File does not exist: " + filename);
+void FractalRenderer::MarkInputEvent(std::chrono::steady_clock::time_point timestamp) {
+    // Several events can arrive between frames; the oldest one defines the latency
+    if (!m_pendingInputTime) {
+        m_pendingInputTime = timestamp;
     }
-    
-    // Open the file for binary reading at the end to get size
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+}
 
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filename + 
-                              " (Error code: " + std::to_string(errno) + ")");
+void FractalRenderer::ResetInputLatencyStats() {
+    m_latencyStats = LatencyStats();
+}
+
+std::string FractalRenderer::GetStatusText() const {
+    std::ostringstream status;
+    status << VulkanContext::GetPresentModeName(m_vulkanContext->GetPresentMode());
+    if (GetGpuCount() > 1) {
+        status << " - " << GetGpuCount() << " GPUs";
     }
 
-    // Get file size and allocate buffer
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    if (fileSize == 0) {
-        throw std::runtime_error("File is empty: " + filename);
+    if (m_latencyStats.sampleCount > 0) {
+        status << std::fixed << std::setprecision(1)
+               << (m_latencyStats.measuresPresent ? " - input-to-photon " : " - input-to-render ")
+               << m_latencyStats.averageMs << " ms (" << m_latencyStats.minMs << "-" << m_latencyStats.maxMs << " ms, "
+               << m_latencyStats.sampleCount << " samples)";
     }
-    
-    std::vector<char> buffer(fileSize);
 
-    // Move to the beginning and read the file
-    file.seekg(0);
-    if (!file.read(buffer.data(), fileSize)) {
-        throw std::runtime_error("Failed to read file: " + filename + 
-                              " (Read " + std::to_string(file.gcount()) + 
-                              " bytes out of " + std::to_string(fileSize) + ")");
+    return status.str();
+}
+
+void FractalRenderer::CollectLatencySamples() {
+    bool presentWait = m_vulkanContext->IsPresentWaitSupported();
+    uint64_t completedValue = presentWait ? 0 : m_vulkanContext->GetCompletedTimelineValue();
+
+    // Samples complete in submission order, so stop at the first pending one.
+    // Polling once per frame bounds the measurement error by one frame time.
+    while (!m_pendingLatencySamples.empty()) {
+        const PendingLatencySample& sample = m_pendingLatencySamples.front();
+
+        // Present ids do not survive swap chain recreation
+        if (sample.swapChainGeneration != m_vulkanContext->GetSwapChainGeneration()) {
+            m_pendingLatencySamples.pop_front();
+            continue;
+        }
+
+        if (presentWait) {
+            VkResult result = m_vulkanContext->WaitForPresent(sample.presentId, 0);
+            if (result == VK_TIMEOUT) {
+                break;
+            }
+            if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+                AddLatencySample(sample.inputTime);
+            }
+        } else {
+            if (sample.timelineValue > completedValue) {
+                break;
+            }
+            AddLatencySample(sample.inputTime);
+        }
+
+        m_pendingLatencySamples.pop_front();
+    }
+}
+
+void FractalRenderer::AddLatencySample(std::chrono::steady_clock::time_point inputTime) {
+    double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inputTime).count();
+
+    LatencyStats& stats = m_latencyStats;
+    stats.minMs = stats.sampleCount == 0 ? latencyMs : std::min(stats.minMs, latencyMs);
+    stats.maxMs = stats.sampleCount == 0 ? latencyMs : std::max(stats.maxMs, latencyMs);
+    stats.averageMs = (stats.averageMs * stats.sampleCount + latencyMs) / (stats.sampleCount + 1);
+    stats.lastMs = latencyMs;
+    stats.sampleCount++;
+    stats.measuresPresent = m_vulkanContext->IsPresentWaitSupported();
+}
+
+VkShaderModule FractalRenderer::CreateShaderModule(const std::vector<uint32_t>& code) {
+    if (code.empty()) {
+        throw std::runtime_error("Cannot create shader module from empty code");
     }
     
-    file.close();
-    return buffer;
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    VkResult result = vkCreateShaderModule(m_vulkanContext->GetDevice(), &createInfo, nullptr, &shaderModule);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shader module! Error code: " + std::to_string(result));
+    }
+
+    return shaderModule;
 }
 
 void FractalRenderer::SetFractalType(FractalType type) {
@@ -790,6 +1442,26 @@ void FractalRenderer::SetColorPalette(ColorPalette palette) {
     m_ubo.colorPalette = palette;
 }
 
+void FractalRenderer::SetCustomPalette(const std::vector<PaletteStop>& stops) {
+    m_paletteLut->SetCustomGradient(stops);
+}
+
+void FractalRenderer::SetColorMapping(ColorMapping mapping) {
+    m_ubo.colorMapping = mapping;
+}
+
+void FractalRenderer::SetOutputChannel(OutputChannel channel) {
+    m_ubo.outputChannel = channel;
+}
+
+void FractalRenderer::SetInteriorDetection(int types) {
+    m_ubo.interiorDetection = types;
+}
+
+void FractalRenderer::SetColorCycleSpeed(float cyclesPerSecond) {
+    m_colorCycleSpeed = cyclesPerSecond;
+}
+
 void FractalRenderer::SetZoom(float zoom) {
     m_ubo.scale = 1.0f / zoom;
 }
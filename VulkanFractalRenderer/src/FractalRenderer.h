@@ -1,56 +1,81 @@
 #pragma once
 
+#include "FractalParameters.h"
+#include "PaletteLut.h"
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <array>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <deque>
+#include <optional>
 
 class VulkanContext;
+class ComputeDevice;
 
-// Fractal types
-enum FractalType {
-    FRACTAL_MANDELBROT = 0,
-    FRACTAL_JULIA,
-    FRACTAL_BURNING_SHIP,
-    FRACTAL_TRICORN,
-    FRACTAL_MULTIBROT,
-    FRACTAL_COUNT
-};
+// Resources owned by one frame-in-flight slot. These are indexed by frame
+// slot, never by swap chain image, so their lifetime is tied to the timeline
+// value of the slot's last submission rather than to whichever image happens
+// to be acquired.
+struct FrameResources {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkBuffer uniformBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory uniformBufferMemory = VK_NULL_HANDLE;
+    void* uniformBufferMapped = nullptr;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+    uint64_t timelineValue = 0;
+
+    // Iteration pass, recorded on the compute queue's command pool
+    VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE;
+    VkBuffer iterationBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory iterationBufferMemory = VK_NULL_HANDLE;
+    uint64_t computeTimelineValue = 0;
+
+    // The parameters the iteration buffer was last evaluated with. While
+    // nothing the iteration pass reads changes (palette and color cycling
+    // only affect coloring), frames skip the pass and recolor the buffer.
+    FractalUBO iterationParameters{};
+    bool iterationsValid = false;
+
+    // Bin counts and CDF of histogram-equalized coloring, and whether they
+    // were computed from the iteration buffer as it is now
+    VkBuffer histogramBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory histogramBufferMemory = VK_NULL_HANDLE;
+    bool histogramValid = false;
 
-// Color palettes
-enum ColorPalette {
-    PALETTE_RAINBOW = 0,
-    PALETTE_FIRE,
-    PALETTE_OCEAN,
-    PALETTE_GRAYSCALE,
-    PALETTE_ELECTRIC,
-    PALETTE_COUNT
+    // Split-frame rendering: start/end timestamps of the iteration pass, the
+    // rows each device evaluated (index 0 is the primary device) and the
+    // staging buffer the secondary devices' bands are uploaded from
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    std::vector<uint32_t> bandRows;
+    VkBuffer bandUploadBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory bandUploadBufferMemory = VK_NULL_HANDLE;
+    void* bandUploadBufferMapped = nullptr;
 };
 
-// Uniform buffer for shader parameters
-struct FractalUBO {
-    float centerX;
-    float centerY;
-    float scale;
-    float aspectRatio;
-    
-    int fractalType;
-    int maxIterations;
-    int colorPalette;
-    int padding;
-    
-    // For Julia set
-    float juliaConstantX;
-    float juliaConstantY;
-    // For Multibrot
-    float multibrotPower;
-    float reserved;
+// Input-to-photon latency statistics in milliseconds
+struct LatencyStats {
+    double lastMs = 0.0;
+    double averageMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    uint32_t sampleCount = 0;
+    // True when measured to present completion, false when only measured to
+    // the end of GPU rendering (present wait unsupported)
+    bool measuresPresent = false;
 };
 
 class FractalRenderer {
 public:
-    FractalRenderer(VulkanContext* vulkanContext);
+    // Frames-in-flight depth limits. One frame minimizes latency, more frames
+    // let the CPU run further ahead of the GPU for throughput.
+    static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+    static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+    FractalRenderer(VulkanContext* vulkanContext, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
     ~FractalRenderer();
 
     // Delete copy constructors
@@ -60,15 +85,58 @@ public:
     // Initialize renderer components
     void Initialize();
     void Cleanup();
-    void RecreateSwapChain();
 
-    // Render one frame
-    void RenderFrame();
+    // Recreate the swap chain and everything sized to it. Returns false,
+    // leaving the current resources in place, while the surface has nothing
+    // to draw to (e.g. the window is minimized).
+    bool RecreateSwapChain();
+
+    // Render one frame, first recreating the swap chain if the window was
+    // resized. Returns false if the surface has nothing to draw to; the
+    // window layer should then block on its events instead of spinning.
+    bool RenderFrame();
+
+    // Frame ring depth (clamped to [MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT])
+    void SetFramesInFlight(uint32_t framesInFlight);
+    uint32_t GetFramesInFlight() const { return static_cast<uint32_t>(m_frames.size()); }
+
+    // Split-frame rendering. Every other GPU gets its own logical device and
+    // evaluates a band of rows sized to its measured throughput; the primary
+    // device uploads the bands and colors the frame.
+    void SetMultiGpu(bool enable);
+    uint32_t GetGpuCount() const { return static_cast<uint32_t>(m_computeDevices.size()) + 1; }
+
+    // Input-to-photon latency measurement. The next frame rendered after an
+    // input event is tagged with the event's timestamp and timed until its
+    // present completes.
+    void MarkInputEvent(std::chrono::steady_clock::time_point timestamp);
+    const LatencyStats& GetInputLatencyStats() const { return m_latencyStats; }
+    void ResetInputLatencyStats();
+
+    // Present mode, GPU count and input latency as one line of text for the
+    // window title
+    std::string GetStatusText() const;
 
     // Update parameters
     void SetFractalType(FractalType type);
     void SetMaxIterations(int iterations);
     void SetColorPalette(ColorPalette palette);
+    // Replace the PALETTE_CUSTOM gradient; select it with SetColorPalette.
+    // Waits for the graphics queue to go idle.
+    void SetCustomPalette(const std::vector<PaletteStop>& stops);
+    void SetColorMapping(ColorMapping mapping);
+    ColorMapping GetColorMapping() const { return static_cast<ColorMapping>(m_ubo.colorMapping); }
+    // Switching the output channel reruns the iteration pass
+    void SetOutputChannel(OutputChannel channel);
+    OutputChannel GetOutputChannel() const { return static_cast<OutputChannel>(m_ubo.outputChannel); }
+    // Bit 1 << FractalType per type with interior detection; types outside
+    // INTERIOR_DETECTION_TYPES ignore it
+    void SetInteriorDetection(int types);
+    int GetInteriorDetection() const { return m_ubo.interiorDetection; }
+    // Palette cycling in full cycles per second (0 stops it)
+    static constexpr float DEFAULT_COLOR_CYCLE_SPEED = 0.2f;
+    void SetColorCycleSpeed(float cyclesPerSecond);
+    float GetColorCycleSpeed() const { return m_colorCycleSpeed; }
     void SetZoom(float zoom);
     void SetPan(float x, float y);
     void ResetView();
@@ -78,24 +146,43 @@ private:
     void CreateRenderPass();
     void CreateDescriptorSetLayout();
     void CreateGraphicsPipeline();
+    void CreateComputePipelines();
     void CreateFramebuffers();
     void CreateUniformBuffers();
     void CreateDescriptorPool();
     void CreateDescriptorSets();
     void CreateCommandBuffers();
     void CreateSyncObjects();
+    void CreateImageSyncObjects();
+    void CreateIterationBuffers();
+    void DestroyIterationBuffers();
+
+    // Frame ring management
+    void CreateFrameResources();
+    void DestroyFrameResources();
+    void DestroyImageSyncObjects();
+
+    // Latency measurement helpers
+    void CollectLatencySamples();
+    void AddLatencySample(std::chrono::steady_clock::time_point inputTime);
+
+    // Split-frame helpers
+    void SplitFrame(std::vector<uint32_t>& bandRows) const;
+    void UpdateThroughput(size_t deviceIndex, uint32_t rows, double milliseconds);
+    double ReadIterationPassTime(const FrameResources& frame) const;
 
     // Helper function to update uniform buffer
-    void UpdateUniformBuffer(uint32_t currentImage);
+    void UpdateUniformBuffer(uint32_t frameIndex);
     
     // Command buffer recording
-    void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    // newIterations is set when the frame's iteration pass was submitted;
+    // otherwise the buffer is recolored as it is, and the histogram is only
+    // recomputed if it is needed and out of date
+    void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameIndex, bool newIterations);
+    void RecordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex);
 
     // Shader module creation helper
-    VkShaderModule CreateShaderModule(const std::vector<char>& code);
-    
-    // Helper for loading shader files
-    static std::vector<char> ReadFile(const std::string& filename);
+    VkShaderModule CreateShaderModule(const std::vector<uint32_t>& code);
 
     // Cleanup
     void CleanupSwapChain();
@@ -109,30 +196,62 @@ private:
     VkPipelineLayout m_pipelineLayout;
     VkPipeline m_graphicsPipeline;
 
+    // Compute pipelines for the iteration pass, and the histogram and CDF
+    // passes of histogram-equalized coloring (run on the graphics queue)
+    VkPipelineLayout m_computePipelineLayout;
+    VkPipeline m_computePipeline;
+    VkPipeline m_histogramPipeline;
+    VkPipeline m_cdfPipeline;
+
+    // Dimensions the per-frame iteration buffers were allocated for
+    VkExtent2D m_iterationExtent;
+
+    // Secondary GPUs and the iteration throughput of every device in rows
+    // per millisecond (index 0 is the primary device, 0 = not measured yet)
+    std::vector<std::unique_ptr<ComputeDevice>> m_computeDevices;
+    std::vector<double> m_deviceThroughput;
+
+    // Nanoseconds per timestamp tick on the compute queue (0 = unsupported)
+    float m_timestampPeriod;
+
     // Framebuffers for rendering
     std::vector<VkFramebuffer> m_swapChainFramebuffers;
 
-    // Uniform buffers for fractal parameters
-    std::vector<VkBuffer> m_uniformBuffers;
-    std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-    std::vector<void*> m_uniformBuffersMapped;
-
-    // Descriptor pool and sets
+    // Descriptor pool for the per-frame descriptor sets
     VkDescriptorPool m_descriptorPool;
-    std::vector<VkDescriptorSet> m_descriptorSets;
 
-    // Command buffers for rendering
-    std::vector<VkCommandBuffer> m_commandBuffers;
+    // Palettes sampled by the fragment shader
+    std::unique_ptr<PaletteLut> m_paletteLut;
 
-    // Synchronization objects
-    std::vector<VkSemaphore> m_imageAvailableSemaphores;
-    std::vector<VkSemaphore> m_renderFinishedSemaphores;
-    std::vector<VkFence> m_inFlightFences;
+    // Frame ring (uniform buffers, descriptor sets, command buffers, sync)
+    std::vector<FrameResources> m_frames;
+    uint32_t m_framesInFlight;
     uint32_t m_currentFrame;
 
+    // Per swap chain image synchronization. The render-finished semaphore is
+    // waited on by the presentation engine, so it must not be reused until
+    // the same image is acquired again. The timeline value records the last
+    // submission that rendered to the image.
+    std::vector<VkSemaphore> m_renderFinishedSemaphores;
+    std::vector<uint64_t> m_imageTimelineValues;
+
+    // Input latency tracking. Each sample waits for either its present id
+    // or its timeline value, depending on present wait support.
+    struct PendingLatencySample {
+        std::chrono::steady_clock::time_point inputTime;
+        uint64_t presentId;
+        uint64_t timelineValue;
+        uint64_t swapChainGeneration;
+    };
+    std::optional<std::chrono::steady_clock::time_point> m_pendingInputTime;
+    std::deque<PendingLatencySample> m_pendingLatencySamples;
+    uint64_t m_nextPresentId;
+    LatencyStats m_latencyStats;
+
     // Fractal view parameters
     FractalUBO m_ubo;
 
-    // Constants
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    // Palette cycling speed and the time colorOffset was last advanced
+    float m_colorCycleSpeed;
+    std::chrono::steady_clock::time_point m_lastFrameTime;
 };
\ No newline at end of file
@@ -0,0 +1,542 @@
+#include "HeadlessRenderer.h"
+#include "ComputeDevice.h"
+#include "DeviceSelection.h"
+#include "ReadbackRing.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+// Band slots on the device: the GPU evaluates one image while the previous
+// one is being copied out
+constexpr uint32_t SLOT_COUNT = 2;
+
+// Staging buffers: one being written by the GPU, one being consumed and one
+// spare, so a short consumer hiccup does not stall submission
+constexpr uint32_t READBACK_BUFFER_COUNT = 3;
+
+// Resampling source rows per dispatch, a multiple of
+// ComputeDevice::SOURCE_BAND_ALIGNMENT. Deep zooms have exponential map
+// strips of tens of thousands of rows, which as one dispatch could trip a
+// driver's watchdog.
+constexpr uint32_t SOURCE_BAND_ROWS = 256;
+
+// Whether ComputeDevice can run on a physical device
+static bool SupportsComputeDevice(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+    return vulkan12Features.timelineSemaphore == VK_TRUE;
+}
+
+// Ring memory behind an export mode
+static ReadbackMemory GetReadbackMemory(ExportMode exportMode) {
+    switch (exportMode) {
+    case EXPORT_MODE_HOST_VISIBLE:
+        return READBACK_MEMORY_HOST_VISIBLE;
+    case EXPORT_MODE_EXTERNAL_FD:
+        return READBACK_MEMORY_EXTERNAL_FD;
+    default:
+        return READBACK_MEMORY_STAGING;
+    }
+}
+
+HeadlessRenderer::HeadlessRenderer(const std::string& deviceOverride, ExportMode exportMode)
+    : m_instance(VK_NULL_HANDLE)
+    , m_exportMode(exportMode)
+    , m_width(0)
+    , m_height(0)
+    , m_nextSlot(0)
+    , m_nextFrameId(1)
+    , m_renderTarget(nullptr)
+    , m_lastGpuTime(0.0)
+    , m_source{}
+    , m_sourceParameters{} {
+
+    CreateInstance();
+
+    try {
+        VkPhysicalDevice physicalDevice = PickPhysicalDevice(deviceOverride);
+
+        // Zero-copy export where the device allows it
+        if (m_exportMode == EXPORT_MODE_AUTO) {
+            m_exportMode = ReadbackRing::SupportsMemory(physicalDevice, READBACK_MEMORY_HOST_VISIBLE) ?
+                EXPORT_MODE_HOST_VISIBLE : EXPORT_MODE_STAGING;
+        }
+
+        std::vector<const char*> extensions;
+        if (!ReadbackRing::SupportsMemory(physicalDevice, GetReadbackMemory(m_exportMode), &extensions)) {
+            throw std::runtime_error(m_exportMode == EXPORT_MODE_HOST_VISIBLE ?
+                "Device has no host-visible cached device memory for zero-copy export!" :
+                "Device cannot export memory to file descriptors!");
+        }
+
+        m_device = std::make_unique<ComputeDevice>(physicalDevice, BAND_FORMAT_RGBA8, extensions);
+    }
+    catch (...) {
+        vkDestroyInstance(m_instance, nullptr);
+        throw;
+    }
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+    // The ring's staging buffers belong to the device, which must go before
+    // the instance it was enumerated from
+    m_readbackRing.reset();
+    m_iterationDevice.reset();
+    m_device.reset();
+
+    if (m_instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(m_instance, nullptr);
+    }
+}
+
+void HeadlessRenderer::CreateInstance() {
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Vulkan Fractal Renderer (headless)";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_3;
+
+    // No surface extensions: nothing is ever presented
+    VkInstanceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    if (vkCreateInstance(&createInfo, nullptr, &m_instance) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Vulkan instance!");
+    }
+}
+
+VkPhysicalDevice HeadlessRenderer::PickPhysicalDevice(const std::string& deviceOverride) {
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(m_instance, &deviceCount, nullptr);
+
+    if (deviceCount == 0) {
+        throw std::runtime_error("Failed to find devices with Vulkan support!");
+    }
+
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
+
+    std::string requestedDevice = GetDeviceOverride(deviceOverride);
+
+    // Same selection rules as the windowed renderer, minus presentation
+    uint64_t bestScore = 0;
+    VkPhysicalDevice bestDevice = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
+
+        std::string name = deviceProperties.deviceName;
+        bool suitable = SupportsComputeDevice(devices[i]);
+
+        if (!requestedDevice.empty()) {
+            if (!MatchesDeviceOverride(requestedDevice, i, name)) {
+                continue;
+            }
+            if (!suitable) {
+                throw std::runtime_error("Requested device " + std::to_string(i) + " (" + name + ") does not support Vulkan 1.2 timeline semaphores!");
+            }
+            return devices[i];
+        }
+
+        if (!suitable) {
+            continue;
+        }
+
+        uint64_t score = ScoreDevice(devices[i]);
+        if (score > bestScore) {
+            bestScore = score;
+            bestDevice = devices[i];
+        }
+    }
+
+    if (!requestedDevice.empty()) {
+        throw std::runtime_error("No device matches \"" + requestedDevice + "\"!");
+    }
+
+    if (bestDevice == VK_NULL_HANDLE) {
+        throw std::runtime_error("Failed to find a device with Vulkan 1.2 timeline semaphores!");
+    }
+
+    return bestDevice;
+}
+
+void HeadlessRenderer::EnsureConfigured(uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0) {
+        throw std::runtime_error("Image size must be at least 1x1!");
+    }
+
+    if (width == m_width && height == m_height) {
+        return;
+    }
+
+    // Frames of the old size still use the slots and staging buffers
+    if (m_readbackRing) {
+        m_readbackRing->Flush();
+        m_readbackRing.reset();
+    }
+
+    // Band slot buffers are sized for the whole image
+    m_device->Configure(SLOT_COUNT, width, height);
+    m_width = width;
+    m_height = height;
+    m_nextSlot = 0;
+
+    m_readbackRing = std::make_unique<ReadbackRing>(m_device->GetPhysicalDevice(), m_device->GetDevice(),
+        m_device->GetTimelineSemaphore(), READBACK_BUFFER_COUNT, static_cast<VkDeviceSize>(width) * height * 4,
+        GetReadbackMemory(m_exportMode),
+        [this, width](const ReadbackView& view) {
+            ConsumeFrame(view, width);
+        });
+}
+
+void HeadlessRenderer::ConsumeFrame(const ReadbackView& view, uint32_t width) {
+    RenderedFrame frame{};
+    frame.id = view.id;
+    frame.pixels = static_cast<const uint8_t*>(view.data);
+    frame.width = width;
+    frame.height = static_cast<uint32_t>(view.size / (static_cast<size_t>(width) * 4));
+    frame.gpuTime = m_device->GetTimestampDuration(view.timestamps);
+    frame.memoryFd = view.memoryFd;
+    frame.bufferIndex = view.index;
+    frame.memoryTypeIndex = view.memoryTypeIndex;
+    frame.memorySize = view.memorySize;
+    frame.bufferSize = view.bufferSize;
+
+    // Render sets the target only while its own frames are the only ones in
+    // flight, and the ring's mutex orders that with this thread. Split tile
+    // batches arrive as several frames in order.
+    if (m_renderTarget != nullptr) {
+        m_lastGpuTime = (m_renderTarget->empty() ? 0.0 : m_lastGpuTime) + frame.gpuTime;
+        m_renderTarget->insert(m_renderTarget->end(), frame.pixels, frame.pixels + view.size);
+    } else if (m_consumer) {
+        m_consumer(frame);
+    }
+}
+
+uint64_t HeadlessRenderer::GetMaxSourcePixels() const {
+    return m_device->GetMaxStorageBufferSize() / sizeof(float);
+}
+
+void HeadlessRenderer::SetCustomPalette(const std::vector<PaletteStop>& stops) {
+    m_device->SetCustomPalette(stops);
+}
+
+void HeadlessRenderer::SetFrameConsumer(FrameConsumer consumer) {
+    // The worker thread may be calling the current consumer
+    Flush();
+    m_consumer = std::move(consumer);
+}
+
+uint64_t HeadlessRenderer::Submit(const FractalUBO& parameters, uint32_t width, uint32_t height) {
+    return SubmitFrame(parameters, width, height, FRAME_KIND_IMAGE);
+}
+
+uint64_t HeadlessRenderer::SubmitResampled(const FractalUBO& parameters, uint32_t width, uint32_t height) {
+    if (m_source.height == 0) {
+        throw std::runtime_error("No source to resample; call RenderSource or RenderExpMap first!");
+    }
+
+    // Source samples are colored against the source's iteration limit
+    FractalUBO ubo = parameters;
+    ubo.fractalType = m_sourceParameters.fractalType;
+    ubo.maxIterations = m_sourceParameters.maxIterations;
+    return SubmitFrame(ubo, width, height, FRAME_KIND_RESAMPLED);
+}
+
+uint64_t HeadlessRenderer::SubmitTiles(const FractalUBO& parameters, const std::vector<TileDescriptor>& tiles,
+    uint32_t tileSize) {
+    if (tiles.empty() || tileSize == 0) {
+        throw std::runtime_error("Tile batches need at least one tile of at least 1x1!");
+    }
+
+    uint32_t maxBatch = GetMaxTileBatch(tileSize);
+    if (maxBatch == 0) {
+        throw std::runtime_error("Tiles of " + std::to_string(tileSize) + " pixels exceed the largest storage buffer on GPU " +
+            m_device->GetName() + "!");
+    }
+
+    // Room for the batch in powers of two, so batches of varying size
+    // settle on one allocation instead of reconfiguring for each, up to
+    // what the device allows
+    uint32_t tileCount = static_cast<uint32_t>(std::min<size_t>(tiles.size(), maxBatch));
+    if (m_width != tileSize || m_height / tileSize < tileCount) {
+        uint32_t capacity = 1;
+        while (capacity < tileCount) {
+            capacity *= 2;
+        }
+        EnsureConfigured(tileSize, tileSize * std::min(capacity, maxBatch));
+    }
+
+    // Larger batches go out as consecutive frames of up to maxBatch tiles
+    uint64_t firstId = m_nextFrameId;
+    for (size_t first = 0; first < tiles.size(); first += maxBatch) {
+        size_t count = std::min<size_t>(tiles.size() - first, maxBatch);
+        std::vector<TileDescriptor> part;
+        const std::vector<TileDescriptor>* frameTiles = &tiles;
+        if (count < tiles.size()) {
+            part.assign(tiles.begin() + first, tiles.begin() + first + count);
+            frameTiles = &part;
+        }
+        SubmitFrame(parameters, tileSize, tileSize * static_cast<uint32_t>(count), FRAME_KIND_TILES, frameTiles);
+    }
+    return firstId;
+}
+
+uint32_t HeadlessRenderer::GetMaxTileBatch(uint32_t tileSize) const {
+    return m_device->GetMaxTileCount(tileSize);
+}
+
+uint64_t HeadlessRenderer::DispatchSource(const FractalUBO& parameters) {
+    uint32_t sourceHeight = static_cast<uint32_t>(parameters.imageHeight);
+    m_device->ReserveResampleSource(static_cast<uint64_t>(parameters.imageWidth) * sourceHeight);
+
+    // Bands alternate between the slots, so one is recorded while the
+    // other runs
+    uint64_t timelineValue = 0;
+    for (uint32_t rowOffset = 0; rowOffset < sourceHeight; rowOffset += SOURCE_BAND_ROWS) {
+        uint32_t rowCount = std::min(SOURCE_BAND_ROWS, sourceHeight - rowOffset);
+        timelineValue = m_device->DispatchSourceBand(m_nextSlot, parameters, rowOffset, rowCount);
+        m_nextSlot = (m_nextSlot + 1) % SLOT_COUNT;
+    }
+
+    m_sourceParameters = parameters;
+    return timelineValue;
+}
+
+void HeadlessRenderer::RenderSource(const FractalUBO& parameters, uint32_t sourceWidth, uint32_t sourceHeight,
+    uint32_t width, uint32_t height) {
+    if (sourceWidth == 0 || sourceHeight == 0) {
+        throw std::runtime_error("Source size must be at least 1x1!");
+    }
+
+    // Frames resampled from the source go through the slots of their size
+    EnsureConfigured(width, height);
+
+    FractalUBO ubo = parameters;
+    ubo.projection = PROJECTION_PLANE;
+    ubo.aspectRatio = static_cast<float>(sourceWidth) / static_cast<float>(sourceHeight);
+    ubo.imageWidth = static_cast<int>(sourceWidth);
+    ubo.imageHeight = static_cast<int>(sourceHeight);
+    DispatchSource(ubo);
+
+    m_source.centerX = ubo.centerX;
+    m_source.centerY = ubo.centerY;
+    m_source.scale = ubo.scale;
+    m_source.aspectRatio = ubo.aspectRatio;
+    m_source.projection = PROJECTION_PLANE;
+    m_source.width = static_cast<int>(sourceWidth);
+    m_source.height = static_cast<int>(sourceHeight);
+}
+
+void HeadlessRenderer::RenderExpMap(const FractalUBO& parameters, double outerRadius, double innerRadius,
+    uint32_t stripWidth, uint32_t width, uint32_t height) {
+    if (stripWidth == 0 || !(innerRadius > 0.0) || !(outerRadius > innerRadius)) {
+        throw std::runtime_error("Exponential map strip needs a width and an outer radius beyond the inner one!");
+    }
+
+    EnsureConfigured(width, height);
+
+    // Rows step down in log distance by the angle of one column, which
+    // keeps strip pixels square
+    double step = 2.0 * 3.14159265358979323846 / stripWidth;
+    uint32_t stripHeight = static_cast<uint32_t>(std::ceil(std::log(outerRadius / innerRadius) / step)) + 1;
+
+    FractalUBO ubo = parameters;
+    ubo.projection = PROJECTION_EXP_MAP;
+    ubo.scale = static_cast<float>(outerRadius);
+    ubo.aspectRatio = 1.0f;
+    ubo.imageWidth = static_cast<int>(stripWidth);
+    ubo.imageHeight = static_cast<int>(stripHeight);
+    m_device->WaitForTimelineValue(DispatchSource(ubo));
+
+    m_source.centerX = ubo.centerX;
+    m_source.centerY = ubo.centerY;
+    m_source.scale = ubo.scale;
+    m_source.aspectRatio = 1.0f;
+    m_source.projection = PROJECTION_EXP_MAP;
+    m_source.width = static_cast<int>(stripWidth);
+    m_source.height = static_cast<int>(stripHeight);
+}
+
+uint64_t HeadlessRenderer::SubmitFrame(const FractalUBO& parameters, uint32_t width, uint32_t height, FrameKind kind,
+    const std::vector<TileDescriptor>* tiles) {
+    // SubmitTiles has configured a batch capacity of its own
+    if (kind != FRAME_KIND_TILES) {
+        EnsureConfigured(width, height);
+    }
+
+    FractalUBO ubo = parameters;
+    ubo.projection = PROJECTION_PLANE;
+    ubo.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    ubo.imageWidth = static_cast<int>(width);
+    ubo.imageHeight = static_cast<int>(height);
+
+    uint32_t buffer = m_readbackRing->Acquire();
+    uint64_t timelineValue = 0;
+    try {
+        // Staging buffers receive a copy; the zero-copy modes are colored in
+        // place
+        BandDestination destination;
+        destination.pixels = m_readbackRing->GetBuffer(buffer);
+        destination.colorInPlace = m_exportMode != EXPORT_MODE_STAGING;
+        destination.releaseToExternal = m_exportMode == EXPORT_MODE_EXTERNAL_FD;
+        destination.timestamps = m_readbackRing->GetTimestampBuffer(buffer);
+
+        // The whole image, or batch of tiles, is a single band
+        if (kind == FRAME_KIND_RESAMPLED) {
+            timelineValue = m_device->DispatchResampleToBuffer(m_nextSlot, ubo, m_source, destination);
+        } else if (kind == FRAME_KIND_TILES) {
+            timelineValue = m_device->DispatchTilesToBuffer(m_nextSlot, ubo, tiles->data(),
+                static_cast<uint32_t>(tiles->size()), width, destination);
+        } else {
+            timelineValue = m_device->DispatchToBuffer(m_nextSlot, ubo, 0, height, destination);
+        }
+    }
+    catch (...) {
+        m_readbackRing->Release(buffer);
+        throw;
+    }
+
+    uint64_t id = m_nextFrameId++;
+    m_readbackRing->Submit(buffer, timelineValue, static_cast<size_t>(width) * height * 4, id);
+    m_nextSlot = (m_nextSlot + 1) % SLOT_COUNT;
+    return id;
+}
+
+void HeadlessRenderer::Flush() {
+    if (m_readbackRing) {
+        m_readbackRing->Flush();
+    }
+}
+
+std::vector<uint8_t> HeadlessRenderer::Render(const FractalUBO& parameters, uint32_t width, uint32_t height) {
+    return RenderFrame([&]() { Submit(parameters, width, height); });
+}
+
+std::vector<uint8_t> HeadlessRenderer::RenderTiles(const FractalUBO& parameters, const std::vector<TileDescriptor>& tiles,
+    uint32_t tileSize) {
+    return RenderFrame([&]() { SubmitTiles(parameters, tiles, tileSize); });
+}
+
+std::vector<uint8_t> HeadlessRenderer::RenderFrame(const std::function<void()>& submit) {
+    if (m_exportMode == EXPORT_MODE_EXTERNAL_FD) {
+        throw std::runtime_error("Exported frames can only be handed to a frame consumer!");
+    }
+
+    // Earlier asynchronous frames still go to the consumer
+    Flush();
+
+    std::vector<uint8_t> pixels;
+    m_renderTarget = &pixels;
+    try {
+        submit();
+        Flush();
+    }
+    catch (...) {
+        m_renderTarget = nullptr;
+        throw;
+    }
+    m_renderTarget = nullptr;
+
+    return pixels;
+}
+
+std::vector<float> HeadlessRenderer::RenderIterations(const FractalUBO& parameters, uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0) {
+        throw std::runtime_error("Image size must be at least 1x1!");
+    }
+
+    if (!m_iterationDevice) {
+        m_iterationDevice = std::make_unique<ComputeDevice>(m_device->GetPhysicalDevice(), BAND_FORMAT_ITERATIONS);
+    }
+
+    FractalUBO ubo = parameters;
+    ubo.projection = PROJECTION_PLANE;
+    ubo.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    ubo.imageWidth = static_cast<int>(width);
+    ubo.imageHeight = static_cast<int>(height);
+
+    // The whole image is a single band in a single slot, reallocated on
+    // every call: this path serves occasional reference renders, not batches
+    m_iterationDevice->Configure(1, width, height);
+    m_iterationDevice->Dispatch(0, ubo, 0, height);
+
+    std::vector<float> iterations(static_cast<size_t>(width) * height);
+    m_lastGpuTime = m_iterationDevice->ReadBand(0, iterations.data());
+    return iterations;
+}
+
+void HeadlessRenderer::RenderIterationBands(const FractalUBO& parameters, uint32_t width, uint32_t height,
+    uint32_t bandRows, const IterationBandConsumer& consumer) {
+    if (width == 0 || height == 0 || bandRows == 0) {
+        throw std::runtime_error("Image size and band height must be at least 1!");
+    }
+
+    if (!m_iterationDevice) {
+        m_iterationDevice = std::make_unique<ComputeDevice>(m_device->GetPhysicalDevice(), BAND_FORMAT_ITERATIONS);
+    }
+
+    FractalUBO ubo = parameters;
+    ubo.projection = PROJECTION_PLANE;
+    ubo.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    ubo.imageWidth = static_cast<int>(width);
+    ubo.imageHeight = static_cast<int>(height);
+
+    // Two slots of one band each: the GPU evaluates one band while the
+    // other is copied out and consumed
+    bandRows = std::min(bandRows, height);
+    m_iterationDevice->Configure(2, width, bandRows);
+
+    uint32_t bandCount = (height + bandRows - 1) / bandRows;
+    auto dispatch = [&](uint32_t band) {
+        uint32_t rowOffset = band * bandRows;
+        m_iterationDevice->Dispatch(band % 2, ubo, rowOffset, std::min(bandRows, height - rowOffset));
+    };
+
+    std::vector<float> rows(static_cast<size_t>(width) * bandRows);
+    m_lastGpuTime = 0.0;
+    dispatch(0);
+    for (uint32_t band = 0; band < bandCount; band++) {
+        if (band + 1 < bandCount) {
+            dispatch(band + 1);
+        }
+
+        uint32_t rowOffset = band * bandRows;
+        m_lastGpuTime += m_iterationDevice->ReadBand(band % 2, rows.data());
+        consumer(rows.data(), rowOffset, std::min(bandRows, height - rowOffset));
+    }
+}
+
+const std::string& HeadlessRenderer::GetDeviceName() const {
+    return m_device->GetName();
+}
+
+std::array<uint8_t, VK_UUID_SIZE> HeadlessRenderer::GetDeviceUuid() const {
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(m_device->GetPhysicalDevice(), &properties);
+
+    std::array<uint8_t, VK_UUID_SIZE> uuid;
+    std::copy(idProperties.deviceUUID, idProperties.deviceUUID + VK_UUID_SIZE, uuid.begin());
+    return uuid;
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include "PaletteLut.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+class ComputeDevice;
+class ReadbackRing;
+struct ReadbackView;
+
+// How finished pixels reach the host or another consumer
+enum ExportMode {
+    // EXPORT_MODE_HOST_VISIBLE where the device supports it, otherwise
+    // EXPORT_MODE_STAGING
+    EXPORT_MODE_AUTO = 0,
+    // Copy from device memory into host-cached staging buffers
+    EXPORT_MODE_STAGING,
+    // Color straight into device memory the host maps (integrated GPUs and
+    // software renderers); frames reach the consumer without any copy
+    EXPORT_MODE_HOST_VISIBLE,
+    // Color straight into device memory exported as POSIX file descriptors
+    // (VK_KHR_external_memory_fd) for another process or API to import
+    EXPORT_MODE_EXTERNAL_FD
+};
+
+// A finished image handed to a HeadlessRenderer's frame consumer
+struct RenderedFrame {
+    // Value returned by the Submit call that started it
+    uint64_t id;
+    // width * height RGBA8 pixels, top row first; only valid during the
+    // call. nullptr with EXPORT_MODE_EXTERNAL_FD.
+    const uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    // GPU time of the render in milliseconds, or 0 if unmeasured
+    double gpuTime;
+    // With EXPORT_MODE_EXTERNAL_FD, the exported memory holding the pixels
+    // at offset 0 and which of the renderer's buffers it is; -1 otherwise.
+    // The fd stays valid and refers to the same memory until the image size
+    // changes, so importers can import each buffer once.
+    int memoryFd;
+    uint32_t bufferIndex;
+    // With EXPORT_MODE_EXTERNAL_FD, the memory type index and size of the
+    // exported allocation and the size of the buffer bound to it, which an
+    // importer must repeat (see ExternalFrameImporter)
+    uint32_t memoryTypeIndex;
+    uint64_t memorySize;
+    uint64_t bufferSize;
+};
+
+// Renders fractal images without a window, swap chain or display. The
+// iteration and coloring passes run as compute on a single device and the
+// finished RGBA8 pixels are read back through a ring of buffers (see
+// ExportMode), so this works on any Vulkan 1.2 implementation, including
+// software ones on GPU-less servers.
+class HeadlessRenderer {
+public:
+    // deviceOverride selects a device by index or name substring like
+    // --device; empty falls back to VFR_DEVICE, then to the best score.
+    // Throws if an explicit exportMode is not supported by the device.
+    explicit HeadlessRenderer(const std::string& deviceOverride = std::string(),
+        ExportMode exportMode = EXPORT_MODE_AUTO);
+    ~HeadlessRenderer();
+
+    // Delete copy constructors
+    HeadlessRenderer(const HeadlessRenderer&) = delete;
+    HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+    // Render one image. The view, fractal and palette come from parameters;
+    // the image size and aspect ratio fields are filled in here. Returns
+    // width * height RGBA8 pixels, top row first. Not available with
+    // EXPORT_MODE_EXTERNAL_FD.
+    std::vector<uint8_t> Render(const FractalUBO& parameters, uint32_t width, uint32_t height);
+
+    // Evaluate the iteration pass alone for one image, with the same view
+    // mapping as Render. Returns width * height values of the output channel
+    // of parameters, top row first, for validation against the CPU
+    // reference (CpuRenderer) and other consumers of raw counts. Runs on a
+    // second set of slots on the same physical device, created on first use.
+    std::vector<float> RenderIterations(const FractalUBO& parameters, uint32_t width, uint32_t height);
+
+    // RenderIterations for images too large to hold or evaluate at once:
+    // the image is evaluated in bands of bandRows rows, the next band
+    // running on the GPU while the last one is read back, and each band is
+    // passed to consumer as soon as it is on the host, top band first. rows
+    // holds rowCount * width values and is only valid during the call.
+    // GetLastGpuTime reports the sum over all bands.
+    using IterationBandConsumer = std::function<void(const float* rows, uint32_t rowOffset, uint32_t rowCount)>;
+    void RenderIterationBands(const FractalUBO& parameters, uint32_t width, uint32_t height, uint32_t bandRows,
+        const IterationBandConsumer& consumer);
+
+    // Asynchronous rendering for batches: Submit records and submits a render
+    // and returns its frame id without waiting for the GPU. Finished frames
+    // are passed to the frame consumer on a readback worker thread, in
+    // submission order. Submit only blocks while every staging buffer is
+    // still being copied or consumed, so a consumer that keeps up leaves the
+    // GPU busy all the time. A change of image size waits for the frames
+    // already submitted, so batches are fastest with same-size jobs together.
+    using FrameConsumer = std::function<void(const RenderedFrame& frame)>;
+
+    void SetFrameConsumer(FrameConsumer consumer);
+    uint64_t Submit(const FractalUBO& parameters, uint32_t width, uint32_t height);
+
+    // The id the next successful Submit, SubmitTiles or SubmitResampled will
+    // return. Lets callers register a frame before its consumer can run;
+    // ids are not used up by submits that throw.
+    uint64_t GetNextFrameId() const { return m_nextFrameId; }
+
+    // Wait until every submitted frame has been consumed. Rethrows the first
+    // exception thrown by the consumer since the last one was reported;
+    // later frames are unaffected.
+    void Flush();
+
+    // Many small views in one dispatch, for thumbnails and map tiles:
+    // SubmitTiles renders one tileSize x tileSize image per descriptor,
+    // each the view of parameters with the descriptor's fields replaced,
+    // and hands them to the frame consumer as a single frame tileSize wide
+    // and tileSize * tiles.size() high, the tiles stacked top to bottom in
+    // order. Tiles use linear color mapping and no anti-aliasing. Batches
+    // of any size up to the largest so far reuse the same buffers, so
+    // sending the largest batch first avoids waiting for reallocations.
+    // Batches larger than GetMaxTileBatch, the most tiles of tileSize the
+    // device's buffers and dispatches can hold, go out as consecutive frames
+    // of up to that many tiles each; SubmitTiles returns the id of the first.
+    // RenderTiles is the blocking variant, like Render, and returns all of
+    // the tiles either way.
+    uint64_t SubmitTiles(const FractalUBO& parameters, const std::vector<TileDescriptor>& tiles, uint32_t tileSize);
+    std::vector<uint8_t> RenderTiles(const FractalUBO& parameters, const std::vector<TileDescriptor>& tiles,
+        uint32_t tileSize);
+    uint32_t GetMaxTileBatch(uint32_t tileSize) const;
+
+    // Zoom videos resampled from a source of iteration counts kept on the
+    // device. A source is evaluated once and can then stand in for many
+    // frames: SubmitResampled submits a frame like Submit but colors it by
+    // resampling the current source, at a cost independent of the iteration
+    // count. Frames show the source's fractal at the source's iteration
+    // limit; their own view and palette apply. Parts of a frame the source
+    // does not cover, or covers with larger pixels than the frame's, come
+    // out clamped or blurred, so choosing sources is up to the caller.
+    //
+    // RenderSource submits a plane source: the view of parameters at
+    // sourceWidth x sourceHeight pixels, typically larger and sharper than
+    // the frames it serves. It does not wait for the GPU, and frames already
+    // submitted still see the previous source.
+    //
+    // RenderExpMap evaluates a log-polar strip around the center of
+    // parameters instead, with stripWidth samples per turn and rows from
+    // outerRadius in to innerRadius, which covers every frame of a zoom into
+    // that center whose corners are at most outerRadius away and whose
+    // pixels are no smaller than innerRadius. Blocks until the strip is done.
+    //
+    // width and height are the size of the frames to come.
+    void RenderSource(const FractalUBO& parameters, uint32_t sourceWidth, uint32_t sourceHeight,
+        uint32_t width, uint32_t height);
+    void RenderExpMap(const FractalUBO& parameters, double outerRadius, double innerRadius, uint32_t stripWidth,
+        uint32_t width, uint32_t height);
+    uint64_t SubmitResampled(const FractalUBO& parameters, uint32_t width, uint32_t height);
+
+    // Replace the gradient of PALETTE_CUSTOM, for frames submitted from now
+    // on. Throws on unsorted or missing stops.
+    void SetCustomPalette(const std::vector<PaletteStop>& stops);
+
+    // Most pixels a source may have on this device, bounded by the largest
+    // storage buffer; RenderSource and RenderExpMap throw beyond it
+    uint64_t GetMaxSourcePixels() const;
+
+    // Size of the current source in pixels
+    uint32_t GetSourceWidth() const { return static_cast<uint32_t>(m_source.width); }
+    uint32_t GetSourceHeight() const { return static_cast<uint32_t>(m_source.height); }
+
+    // GPU time of the last Render in milliseconds, or 0 if the device has no
+    // timestamp support
+    double GetLastGpuTime() const { return m_lastGpuTime; }
+
+    const std::string& GetDeviceName() const;
+
+    // VkPhysicalDeviceIDProperties::deviceUUID of the device, which
+    // importers of exported frames use to find the same device
+    std::array<uint8_t, VK_UUID_SIZE> GetDeviceUuid() const;
+
+    // The export mode in use (never EXPORT_MODE_AUTO)
+    ExportMode GetExportMode() const { return m_exportMode; }
+
+private:
+    void CreateInstance();
+    VkPhysicalDevice PickPhysicalDevice(const std::string& deviceOverride);
+
+    // (Re)allocate the device's band slots and the readback ring when the
+    // image size changes. Waits for all submitted frames first.
+    void EnsureConfigured(uint32_t width, uint32_t height);
+
+    // Called by the readback ring for each finished frame; frames may use
+    // fewer rows than the buffers have room for
+    void ConsumeFrame(const ReadbackView& view, uint32_t width);
+
+    // Kinds of frame SubmitFrame starts
+    enum FrameKind {
+        FRAME_KIND_IMAGE = 0,
+        FRAME_KIND_RESAMPLED,
+        FRAME_KIND_TILES
+    };
+
+    // Submit for every kind of frame; tiles are only read for
+    // FRAME_KIND_TILES, where width is the tile size and height covers the
+    // whole batch
+    uint64_t SubmitFrame(const FractalUBO& parameters, uint32_t width, uint32_t height, FrameKind kind,
+        const std::vector<TileDescriptor>* tiles = nullptr);
+
+    // Submit and wait for a frame that Render-style calls return instead of
+    // passing to the consumer
+    std::vector<uint8_t> RenderFrame(const std::function<void()>& submit);
+
+    // Evaluate a source of the size in parameters in bands, alternating
+    // slots. Returns the timeline value of the last band.
+    uint64_t DispatchSource(const FractalUBO& parameters);
+
+    VkInstance m_instance;
+    std::unique_ptr<ComputeDevice> m_device;
+    // BAND_FORMAT_ITERATIONS device behind RenderIterations
+    std::unique_ptr<ComputeDevice> m_iterationDevice;
+    std::unique_ptr<ReadbackRing> m_readbackRing;
+
+    ExportMode m_exportMode;
+
+    // Image size the slots and staging buffers are allocated for
+    uint32_t m_width;
+    uint32_t m_height;
+
+    uint32_t m_nextSlot;
+    uint64_t m_nextFrameId;
+
+    FrameConsumer m_consumer;
+    // While Render waits for its frame, the frame is copied here instead of
+    // going to the consumer
+    std::vector<uint8_t>* m_renderTarget;
+
+    double m_lastGpuTime;
+
+    // The source behind SubmitResampled and the parameters it was rendered
+    // with
+    ResampleSource m_source;
+    FractalUBO m_sourceParameters;
+};
@@ -0,0 +1,35 @@
+#include "XcbApplication.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <cstdlib>
+
+// Entry point for Linux (X11 through XCB)
+int main(int argc, char* argv[]) {
+    try {
+        // Same options as the Windows build, which gets them as one string
+        std::string commandLine;
+        for (int i = 1; i < argc; i++) {
+            commandLine += argv[i];
+            commandLine += ' ';
+        }
+
+        // Create and run the application
+        const int initialWidth = 1280;
+        const int initialHeight = 720;
+        const ApplicationSettings settings = ParseCommandLine(commandLine);
+
+        std::unique_ptr<XcbApplication> app = std::make_unique<XcbApplication>(
+            "Vulkan Fractal Renderer",
+            initialWidth,
+            initialHeight,
+            settings
+        );
+
+        return app->Run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
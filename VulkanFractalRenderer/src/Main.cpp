@@ -37,12 +37,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         const int initialWidth = 1280;
         const int initialHeight = 720;
         const std::wstring appTitle = L"Vulkan Fractal Renderer";
+        const ApplicationSettings settings = ParseCommandLine(lpCmdLine ? lpCmdLine : "");
 
         std::unique_ptr<WindowsApplication> app = std::make_unique<WindowsApplication>(
             hInstance, 
             appTitle, 
             initialWidth, 
-            initialHeight
+            initialHeight,
+            settings
         );
         
         return app->Run();
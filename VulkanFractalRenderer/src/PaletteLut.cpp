@@ -0,0 +1,432 @@
+#include "PaletteLut.h"
+#include "FractalParameters.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Built-in palettes as they used to be evaluated per pixel in coloring.glsl
+static void EvaluatePalette(int palette, float t, float color[3]) {
+    switch (palette) {
+        case PALETTE_FIRE:
+            color[0] = std::min(1.0f, t * 4.0f);
+            color[1] = std::clamp(t * 4.0f - 1.0f, 0.0f, 1.0f);
+            color[2] = std::clamp(t * 4.0f - 3.0f, 0.0f, 1.0f);
+            break;
+        case PALETTE_OCEAN:
+            color[0] = std::clamp(t * 4.0f - 3.0f, 0.0f, 1.0f);
+            color[1] = std::clamp(t * 4.0f - 2.0f, 0.0f, 1.0f);
+            color[2] = std::min(1.0f, t * 4.0f);
+            break;
+        case PALETTE_GRAYSCALE:
+            color[0] = t;
+            color[1] = t;
+            color[2] = t;
+            break;
+        case PALETTE_ELECTRIC:
+            color[0] = 0.5f + 0.5f * std::sin(t * 25.0f);
+            color[1] = 0.5f + 0.5f * std::sin(t * 25.0f + 2.1f);
+            color[2] = 1.0f;
+            break;
+        default:
+            color[0] = 0.5f + 0.5f * std::sin(3.1415926f + t * 20.0f);
+            color[1] = 0.5f + 0.5f * std::sin(1.5f + t * 20.0f);
+            color[2] = 0.5f + 0.5f * std::sin(t * 20.0f);
+            break;
+    }
+}
+
+// IEEE 754 half precision, rounding to nearest. Palette colors are finite
+// and non-negative, so infinities and NaNs need no special care.
+static uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        // Subnormal, or zero below the smallest subnormal
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = (mantissa >> shift) + ((mantissa >> (shift - 1)) & 1);
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // A rounding carry out of the mantissa correctly bumps the exponent
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1;
+    return static_cast<uint16_t>(sign | half);
+}
+
+// Append one layer of SIZE texels; texel i holds the palette at i / (SIZE - 1)
+template <typename Evaluate>
+static void BakeLayer(std::vector<uint16_t>& texels, Evaluate evaluate) {
+    for (uint32_t i = 0; i < PaletteLut::SIZE; i++) {
+        float color[3];
+        evaluate(static_cast<float>(i) / (PaletteLut::SIZE - 1), color);
+        texels.push_back(FloatToHalf(color[0]));
+        texels.push_back(FloatToHalf(color[1]));
+        texels.push_back(FloatToHalf(color[2]));
+        texels.push_back(FloatToHalf(1.0f));
+    }
+}
+
+// Piecewise linear through sorted stops, constant before the first and after
+// the last
+static void EvaluateGradient(const std::vector<PaletteStop>& stops, float t, float color[3]) {
+    auto next = std::find_if(stops.begin(), stops.end(), [t](const PaletteStop& stop) { return stop.position > t; });
+    if (next == stops.begin() || next == stops.end()) {
+        const PaletteStop& stop = next == stops.begin() ? stops.front() : stops.back();
+        color[0] = stop.red;
+        color[1] = stop.green;
+        color[2] = stop.blue;
+        return;
+    }
+
+    const PaletteStop& from = *(next - 1);
+    const PaletteStop& to = *next;
+    float weight = (t - from.position) / (to.position - from.position);
+    color[0] = from.red + (to.red - from.red) * weight;
+    color[1] = from.green + (to.green - from.green) * weight;
+    color[2] = from.blue + (to.blue - from.blue) * weight;
+}
+
+static float SrgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+std::vector<PaletteStop> ParseGradient(const std::string& text) {
+    std::vector<PaletteStop> stops;
+
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string stop = text.substr(start, end - start);
+        start = end + 1;
+
+        size_t separator = stop.find(':');
+        std::string color = separator != std::string::npos ? stop.substr(separator + 1) : std::string();
+        if (separator == std::string::npos || color.size() != 6 ||
+            color.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            throw std::runtime_error("Gradient stops must be position:RRGGBB, got \"" + stop + "\"");
+        }
+
+        PaletteStop parsed{};
+        parsed.position = std::stof(stop.substr(0, separator));
+        unsigned long rgb = std::stoul(color, nullptr, 16);
+        parsed.red = SrgbToLinear(static_cast<float>((rgb >> 16) & 0xff) / 255.0f);
+        parsed.green = SrgbToLinear(static_cast<float>((rgb >> 8) & 0xff) / 255.0f);
+        parsed.blue = SrgbToLinear(static_cast<float>(rgb & 0xff) / 255.0f);
+        stops.push_back(parsed);
+    }
+
+    return stops;
+}
+
+void EvaluatePaletteColor(int palette, const std::vector<PaletteStop>& stops, float t, float color[3]) {
+    if (palette == PALETTE_CUSTOM && !stops.empty()) {
+        EvaluateGradient(stops, t, color);
+    } else {
+        EvaluatePalette(palette == PALETTE_CUSTOM ? PALETTE_GRAYSCALE : palette, t, color);
+    }
+}
+
+PaletteLut::PaletteLut(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamily)
+    : m_physicalDevice(physicalDevice)
+    , m_device(device)
+    , m_queue(queue)
+    , m_commandPool(VK_NULL_HANDLE)
+    , m_image(VK_NULL_HANDLE)
+    , m_imageMemory(VK_NULL_HANDLE)
+    , m_imageView(VK_NULL_HANDLE)
+    , m_sampler(VK_NULL_HANDLE)
+    , m_firstUpload(true) {
+
+    try {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamily;
+
+        if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create palette command pool!");
+        }
+
+        // Half floats keep the dark end of linear palettes free of the
+        // banding 8-bit texels would show after sRGB encoding, and are
+        // filterable on every device
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_1D;
+        imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        imageInfo.extent = { SIZE, 1, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = PALETTE_CUSTOM + 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(m_device, &imageInfo, nullptr, &m_image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create palette image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, m_image, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate palette image memory!");
+        }
+        vkBindImageMemory(m_device, m_image, m_imageMemory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_1D_ARRAY;
+        viewInfo.format = imageInfo.format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = imageInfo.arrayLayers;
+
+        if (vkCreateImageView(m_device, &viewInfo, nullptr, &m_imageView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create palette image view!");
+        }
+
+        // Clamping keeps the ends of the palette from blending into each
+        // other; the shader maps [0, 1] onto the first and last texel centers
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create palette sampler!");
+        }
+
+        // Built-in palettes, and grayscale in the custom layer until a
+        // gradient is set
+        std::vector<uint16_t> texels;
+        texels.reserve(static_cast<size_t>(SIZE) * 4 * (PALETTE_CUSTOM + 1));
+        for (int palette = 0; palette < PALETTE_COUNT; palette++) {
+            BakeLayer(texels, [palette](float t, float color[3]) { EvaluatePalette(palette, t, color); });
+        }
+        BakeLayer(texels, [](float t, float color[3]) { EvaluatePalette(PALETTE_GRAYSCALE, t, color); });
+        Upload(texels, 0, PALETTE_CUSTOM + 1);
+    }
+    catch (...) {
+        Destroy();
+        throw;
+    }
+}
+
+PaletteLut::~PaletteLut() {
+    Destroy();
+}
+
+void PaletteLut::Destroy() {
+    if (m_sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(m_device, m_sampler, nullptr);
+        m_sampler = VK_NULL_HANDLE;
+    }
+
+    if (m_imageView != VK_NULL_HANDLE) {
+        vkDestroyImageView(m_device, m_imageView, nullptr);
+        m_imageView = VK_NULL_HANDLE;
+    }
+
+    if (m_image != VK_NULL_HANDLE) {
+        vkDestroyImage(m_device, m_image, nullptr);
+        m_image = VK_NULL_HANDLE;
+    }
+
+    if (m_imageMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(m_device, m_imageMemory, nullptr);
+        m_imageMemory = VK_NULL_HANDLE;
+    }
+
+    if (m_commandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+}
+
+void PaletteLut::SetCustomGradient(const std::vector<PaletteStop>& stops) {
+    if (stops.empty()) {
+        throw std::runtime_error("A gradient needs at least one stop!");
+    }
+    for (size_t i = 1; i < stops.size(); i++) {
+        if (stops[i].position < stops[i - 1].position) {
+            throw std::runtime_error("Gradient stops must be sorted by position!");
+        }
+    }
+
+    std::vector<uint16_t> texels;
+    texels.reserve(static_cast<size_t>(SIZE) * 4);
+    BakeLayer(texels, [&stops](float t, float color[3]) { EvaluateGradient(stops, t, color); });
+    Upload(texels, PALETTE_CUSTOM, 1);
+}
+
+void PaletteLut::Upload(const std::vector<uint16_t>& texels, uint32_t firstLayer, uint32_t layerCount) {
+    VkDeviceSize size = texels.size() * sizeof(uint16_t);
+
+    // Staging buffer
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+    auto cleanup = [&]() {
+        if (commandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+        }
+        if (stagingBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+        }
+        if (stagingMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, stagingMemory, nullptr);
+        }
+    };
+
+    try {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create palette staging buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(m_device, stagingBuffer, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &stagingMemory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate palette staging memory!");
+        }
+        vkBindBufferMemory(m_device, stagingBuffer, stagingMemory, 0);
+
+        void* mapped = nullptr;
+        vkMapMemory(m_device, stagingMemory, 0, size, 0, &mapped);
+        std::memcpy(mapped, texels.data(), static_cast<size_t>(size));
+        vkUnmapMemory(m_device, stagingMemory);
+
+        VkCommandBufferAllocateInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = m_commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(m_device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate palette command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        // Passes already submitted to the queue may still sample the layers;
+        // the copy waits for them (an execution dependency suffices for a
+        // write after read)
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = m_firstUpload ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = firstLayer;
+        barrier.subresourceRange.layerCount = layerCount;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = firstLayer;
+        region.imageSubresource.layerCount = layerCount;
+        region.imageExtent = { SIZE, 1, 1 };
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        // Any stage may sample the palette next: the fragment shader on a
+        // graphics queue, the coloring passes on a compute-only one
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        if (vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit palette upload!");
+        }
+
+        // Palette changes are rare; waiting keeps the staging buffer simple
+        vkQueueWaitIdle(m_queue);
+        m_firstUpload = false;
+    }
+    catch (...) {
+        cleanup();
+        throw;
+    }
+
+    cleanup();
+}
+
+uint32_t PaletteLut::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type for the palette!");
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// One color of a gradient; position runs from 0 (first escape band) to 1
+// (last before the interior), colors are linear RGB in [0, 1]
+struct PaletteStop {
+    float position;
+    float red;
+    float green;
+    float blue;
+};
+
+// Parse a gradient from the command line: comma-separated position:RRGGBB
+// stops, e.g. "0:000000,0.5:ff8000,1:ffffff". Hex colors are sRGB as in
+// image editors and converted to linear. Throws on malformed stops.
+std::vector<PaletteStop> ParseGradient(const std::string& text);
+
+// A palette at position t in [0, 1] as linear RGB, evaluated on the CPU from
+// the same definitions the LUT layers are baked from. PALETTE_CUSTOM follows
+// stops, or is grayscale while stops is empty, as in a new PaletteLut.
+void EvaluatePaletteColor(int palette, const std::vector<PaletteStop>& stops, float t, float color[3]);
+
+// The color palettes baked into a 1D texture array, one layer per
+// ColorPalette value and PALETTE_CUSTOM last. The coloring passes sample it
+// with linear filtering, so coloring is a single texture fetch whatever the
+// palette, and switching or replacing a palette never touches a shader.
+class PaletteLut {
+public:
+    // Texels per palette; linear filtering between them is exact for the
+    // piecewise linear palettes and well below 8-bit output precision for
+    // the rest
+    static constexpr uint32_t SIZE = 1024;
+
+    // Uploads go through the given queue, which must support transfers and
+    // must not be used by another thread while the palette is uploaded
+    PaletteLut(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamily);
+    ~PaletteLut();
+
+    // Delete copy constructors
+    PaletteLut(const PaletteLut&) = delete;
+    PaletteLut& operator=(const PaletteLut&) = delete;
+
+    // Replace the PALETTE_CUSTOM layer with a piecewise linear gradient
+    // through the stops, which must be sorted by position. Work already
+    // submitted samples the old gradient; blocks until the upload is done.
+    void SetCustomGradient(const std::vector<PaletteStop>& stops);
+
+    // Bound as a combined image sampler; the view is VK_IMAGE_VIEW_TYPE_1D_ARRAY
+    VkImageView GetImageView() const { return m_imageView; }
+    VkSampler GetSampler() const { return m_sampler; }
+
+private:
+    // Copy texels (SIZE RGBA half floats per layer) into layers
+    // [firstLayer, firstLayer + layerCount) and return the image to shader reads
+    void Upload(const std::vector<uint16_t>& texels, uint32_t firstLayer, uint32_t layerCount);
+    uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    void Destroy();
+
+    VkPhysicalDevice m_physicalDevice;
+    VkDevice m_device;
+    VkQueue m_queue;
+    VkCommandPool m_commandPool;
+
+    VkImage m_image;
+    VkDeviceMemory m_imageMemory;
+    VkImageView m_imageView;
+    VkSampler m_sampler;
+
+    // The image has not been uploaded to yet (VK_IMAGE_LAYOUT_UNDEFINED)
+    bool m_firstUpload;
+};
@@ -0,0 +1,26 @@
+#include "Platform.h"
+
+#ifdef _WIN32
+#include <Windows.h>   // For GetEnvironmentVariable
+#else
+#include <cstdlib>
+#endif
+
+std::string GetEnvironmentString(const char* name) {
+#ifdef _WIN32
+    // std::getenv is deprecated under /sdl
+    DWORD length = GetEnvironmentVariableA(name, nullptr, 0);
+    if (length == 0) {
+        return std::string();
+    }
+
+    // The returned length includes the terminating null
+    std::string value(length, '\0');
+    length = GetEnvironmentVariableA(name, value.data(), length);
+    value.resize(length);
+    return value;
+#else
+    const char* value = std::getenv(name);
+    return value != nullptr ? std::string(value) : std::string();
+#endif
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+// Value of an environment variable, or an empty string if it is not set
+std::string GetEnvironmentString(const char* name);
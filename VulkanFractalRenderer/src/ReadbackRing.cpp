@@ -0,0 +1,417 @@
+#include "ReadbackRing.h"
+#include <stdexcept>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// First memory type allowed by typeBits that has all of properties, or
+// UINT32_MAX
+static uint32_t FindMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeBits,
+    VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+bool ReadbackRing::SupportsMemory(VkPhysicalDevice physicalDevice, ReadbackMemory memory,
+    std::vector<const char*>* extensions) {
+    switch (memory) {
+    case READBACK_MEMORY_STAGING:
+        return true;
+
+    case READBACK_MEMORY_HOST_VISIBLE:
+        {
+            // Uncached mappings of device memory (e.g. resizable BAR on
+            // discrete GPUs) are far too slow for the CPU to read from
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+            return FindMemoryType(memProperties, UINT32_MAX, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != UINT32_MAX;
+        }
+
+    case READBACK_MEMORY_EXTERNAL_FD:
+        {
+#ifdef _WIN32
+            return false;
+#else
+            uint32_t extensionCount = 0;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+            bool hasExtension = false;
+            for (const auto& extension : availableExtensions) {
+                if (strcmp(extension.extensionName, VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) == 0) {
+                    hasExtension = true;
+                }
+            }
+            if (!hasExtension) {
+                return false;
+            }
+
+            VkPhysicalDeviceExternalBufferInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_BUFFER_INFO;
+            bufferInfo.usage = READBACK_IN_PLACE_USAGE;
+            bufferInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+            VkExternalBufferProperties bufferProperties{};
+            bufferProperties.sType = VK_STRUCTURE_TYPE_EXTERNAL_BUFFER_PROPERTIES;
+            vkGetPhysicalDeviceExternalBufferProperties(physicalDevice, &bufferInfo, &bufferProperties);
+
+            if (!(bufferProperties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT)) {
+                return false;
+            }
+
+            if (extensions != nullptr) {
+                extensions->push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+            }
+            return true;
+#endif
+        }
+    }
+
+    return false;
+}
+
+ReadbackRing::ReadbackRing(VkPhysicalDevice physicalDevice, VkDevice device, VkSemaphore timelineSemaphore,
+    uint32_t bufferCount, VkDeviceSize bufferSize, ReadbackMemory memory, Consumer consumer)
+    : m_device(device)
+    , m_timelineSemaphore(timelineSemaphore)
+    , m_bufferSize(bufferSize)
+    , m_memory(memory)
+    , m_needsInvalidate(false)
+    , m_consumer(std::move(consumer))
+    , m_consuming(false)
+    , m_stopping(false) {
+
+    try {
+        CreateBuffers(physicalDevice, bufferCount);
+    }
+    catch (...) {
+        DestroyBuffers();
+        throw;
+    }
+
+    for (uint32_t i = 0; i < bufferCount; i++) {
+        m_freeBuffers.push_back(i);
+    }
+
+    m_worker = std::thread(&ReadbackRing::ConsumeLoop, this);
+}
+
+ReadbackRing::~ReadbackRing() {
+    // Submitted copies still reference the buffers, so they are consumed
+    // before anything is destroyed
+    Stop();
+    DestroyBuffers();
+}
+
+void ReadbackRing::CreateBuffers(VkPhysicalDevice physicalDevice, uint32_t bufferCount) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    m_buffers.resize(bufferCount);
+
+    for (auto& staging : m_buffers) {
+        CreateResultBuffer(memProperties, staging);
+        CreateTimestampBuffer(memProperties, staging);
+    }
+}
+
+void ReadbackRing::CreateResultBuffer(const VkPhysicalDeviceMemoryProperties& memProperties, StagingBuffer& staging) {
+    bool external = m_memory == READBACK_MEMORY_EXTERNAL_FD;
+
+    VkExternalMemoryBufferCreateInfo externalBufferInfo{};
+    externalBufferInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalBufferInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = external ? &externalBufferInfo : nullptr;
+    bufferInfo.size = m_bufferSize;
+    bufferInfo.usage = m_memory == READBACK_MEMORY_STAGING ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : READBACK_IN_PLACE_USAGE;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &staging.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create readback buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, staging.buffer, &memRequirements);
+
+    uint32_t memoryType = UINT32_MAX;
+    switch (m_memory) {
+    case READBACK_MEMORY_STAGING:
+        // Prefer cached memory: uncached reads from the CPU are very slow.
+        // Cached memory need not be coherent; it is invalidated per readback.
+        memoryType = FindMemoryType(memProperties, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        if (memoryType == UINT32_MAX) {
+            memoryType = FindMemoryType(memProperties, memRequirements.memoryTypeBits,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        }
+        break;
+
+    case READBACK_MEMORY_HOST_VISIBLE:
+        memoryType = FindMemoryType(memProperties, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        break;
+
+    case READBACK_MEMORY_EXTERNAL_FD:
+        memoryType = FindMemoryType(memProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        break;
+    }
+
+    if (memoryType == UINT32_MAX) {
+        throw std::runtime_error("Failed to find suitable memory for readback!");
+    }
+
+    VkMemoryPropertyFlags memoryFlags = memProperties.memoryTypes[memoryType].propertyFlags;
+    // Exported memory is never mapped here, so there is nothing to
+    // invalidate even if its type is host-visible and non-coherent
+    m_needsInvalidate = !external && (memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        !(memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    // Exported memory gets a dedicated allocation, which every driver that
+    // can export buffers accepts
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = staging.buffer;
+
+    VkExportMemoryAllocateInfo exportInfo{};
+    exportInfo.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+    exportInfo.pNext = &dedicatedInfo;
+    exportInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = external ? &exportInfo : nullptr;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &staging.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate readback buffer memory!");
+    }
+
+    vkBindBufferMemory(m_device, staging.buffer, staging.memory, 0);
+    staging.memoryTypeIndex = memoryType;
+    staging.memorySize = memRequirements.size;
+
+    if (external) {
+        ExportMemory(staging);
+        return;
+    }
+
+    // Mapped once for the lifetime of the ring
+    if (vkMapMemory(m_device, staging.memory, 0, VK_WHOLE_SIZE, 0, &staging.mapped) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to map readback buffer memory!");
+    }
+}
+
+void ReadbackRing::CreateTimestampBuffer(const VkPhysicalDeviceMemoryProperties& memProperties, StagingBuffer& staging) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = 2 * sizeof(uint64_t);
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &staging.timestampBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create readback timestamp buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, staging.timestampBuffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(memProperties, memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(m_device, &allocInfo, nullptr, &staging.timestampMemory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate readback timestamp memory!");
+    }
+
+    vkBindBufferMemory(m_device, staging.timestampBuffer, staging.timestampMemory, 0);
+    vkMapMemory(m_device, staging.timestampMemory, 0, VK_WHOLE_SIZE, 0, &staging.timestampMapped);
+}
+
+void ReadbackRing::ExportMemory(StagingBuffer& staging) {
+#ifdef _WIN32
+    (void)staging;
+    throw std::runtime_error("Memory export to file descriptors is not available on Windows!");
+#else
+    auto getMemoryFd = reinterpret_cast<PFN_vkGetMemoryFdKHR>(vkGetDeviceProcAddr(m_device, "vkGetMemoryFdKHR"));
+    if (getMemoryFd == nullptr) {
+        throw std::runtime_error("VK_KHR_external_memory_fd is not enabled!");
+    }
+
+    VkMemoryGetFdInfoKHR getFdInfo{};
+    getFdInfo.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
+    getFdInfo.memory = staging.memory;
+    getFdInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    if (getMemoryFd(m_device, &getFdInfo, &staging.memoryFd) != VK_SUCCESS) {
+        staging.memoryFd = -1;
+        throw std::runtime_error("Failed to export readback memory!");
+    }
+#endif
+}
+
+void ReadbackRing::DestroyBuffers() {
+    for (auto& staging : m_buffers) {
+#ifndef _WIN32
+        // Importers hold their own reference to the memory
+        if (staging.memoryFd >= 0) {
+            close(staging.memoryFd);
+        }
+#endif
+
+        if (staging.timestampBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, staging.timestampBuffer, nullptr);
+        }
+
+        if (staging.timestampMemory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, staging.timestampMemory, nullptr);
+        }
+
+        if (staging.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, staging.buffer, nullptr);
+        }
+
+        // Freeing the memory also unmaps it
+        if (staging.memory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, staging.memory, nullptr);
+        }
+    }
+    m_buffers.clear();
+}
+
+uint32_t ReadbackRing::Acquire() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_bufferAvailable.wait(lock, [this] { return !m_freeBuffers.empty(); });
+    ThrowIfFailed();
+
+    uint32_t index = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+    return index;
+}
+
+void ReadbackRing::Release(uint32_t index) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeBuffers.push_back(index);
+    }
+    m_bufferAvailable.notify_one();
+}
+
+void ReadbackRing::Submit(uint32_t index, uint64_t timelineValue, size_t size, uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back({ index, timelineValue, size, id });
+    }
+    m_workAvailable.notify_one();
+}
+
+void ReadbackRing::Flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pending.empty() && !m_consuming; });
+    ThrowIfFailed();
+}
+
+void ReadbackRing::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_one();
+
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+void ReadbackRing::ThrowIfFailed() {
+    if (!m_error.empty()) {
+        std::string error = std::move(m_error);
+        m_error.clear();
+        throw std::runtime_error(error);
+    }
+}
+
+void ReadbackRing::ConsumeLoop() {
+    while (true) {
+        PendingReadback readback;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this] { return !m_pending.empty() || m_stopping; });
+
+            // Everything submitted is consumed even when stopping
+            if (m_pending.empty()) {
+                return;
+            }
+
+            readback = m_pending.front();
+            m_pending.pop_front();
+            m_consuming = true;
+        }
+
+        std::string error;
+        try {
+            // Waiting on a timeline semaphore needs no queue access, so it
+            // does not contend with the producer's submissions
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &m_timelineSemaphore;
+            waitInfo.pValues = &readback.timelineValue;
+
+            if (vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to wait for readback!");
+            }
+
+            const StagingBuffer& staging = m_buffers[readback.index];
+            if (m_needsInvalidate) {
+                VkMappedMemoryRange range{};
+                range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                range.memory = staging.memory;
+                range.offset = 0;
+                range.size = VK_WHOLE_SIZE;
+                vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+            }
+
+            ReadbackView view{};
+            view.id = readback.id;
+            view.index = readback.index;
+            view.data = staging.mapped;
+            view.size = readback.size;
+            view.memoryFd = staging.memoryFd;
+            view.memoryTypeIndex = staging.memoryTypeIndex;
+            view.memorySize = staging.memorySize;
+            view.bufferSize = m_bufferSize;
+            memcpy(view.timestamps, staging.timestampMapped, sizeof(view.timestamps));
+
+            m_consumer(view);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_freeBuffers.push_back(readback.index);
+            m_consuming = false;
+            if (!error.empty() && m_error.empty()) {
+                m_error = error;
+            }
+        }
+        m_bufferAvailable.notify_one();
+        m_idle.notify_all();
+    }
+}
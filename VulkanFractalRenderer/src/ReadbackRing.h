@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// Where a ReadbackRing's buffers live
+enum ReadbackMemory {
+    // Host-cached staging buffers the GPU copies into
+    READBACK_MEMORY_STAGING = 0,
+    // Device-local memory the host can map and read fast (integrated GPUs,
+    // software renderers): shaders write the results in place, no copy
+    READBACK_MEMORY_HOST_VISIBLE,
+    // Device-local memory exported as POSIX file descriptors through
+    // VK_KHR_external_memory_fd, for a consumer in another API or process.
+    // Shaders write in place and the host never maps it.
+    READBACK_MEMORY_EXTERNAL_FD
+};
+
+// Usage of the result buffers that shaders write in place. Importers of
+// exported buffers create theirs with the same usage, which includes copying
+// out of them.
+constexpr VkBufferUsageFlags READBACK_IN_PLACE_USAGE = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+// A finished readback, as handed to the consumer
+struct ReadbackView {
+    uint64_t id;
+    // Index of the buffer in the ring
+    uint32_t index;
+    // Mapped contents, or nullptr for READBACK_MEMORY_EXTERNAL_FD
+    const void* data;
+    size_t size;
+    // Exported memory of the buffer (READBACK_MEMORY_EXTERNAL_FD only, -1
+    // otherwise). Owned by the ring: dup() it to keep it past the ring.
+    int memoryFd;
+    // What importing memoryFd needs: the memory type index and size of the
+    // allocation, and the size of the buffer bound to it at offset 0
+    uint32_t memoryTypeIndex;
+    uint64_t memorySize;
+    uint64_t bufferSize;
+    // Start and end GPU timestamps written next to the results
+    uint64_t timestamps[2];
+};
+
+// A ring of persistently mapped, host-cached staging buffers for reading GPU
+// results back without stalling either side. The producer acquires a buffer,
+// records a copy into it and submits it together with the timeline value its
+// submission signals. A worker thread waits for each value in submission
+// order and hands the buffer's contents to the consumer, then returns the
+// buffer to the ring. The producer only blocks when every buffer is still
+// being copied or consumed, so the GPU is never left waiting on the CPU.
+// With READBACK_MEMORY_HOST_VISIBLE or READBACK_MEMORY_EXTERNAL_FD the
+// buffers are written in place and reach the consumer without any copy.
+class ReadbackRing {
+public:
+    // Called on the worker thread; the view's memory may be overwritten once
+    // the call returns
+    using Consumer = std::function<void(const ReadbackView& view)>;
+
+    // timelineSemaphore is the semaphore signaled by the submissions that
+    // write into the ring's buffers
+    ReadbackRing(VkPhysicalDevice physicalDevice, VkDevice device, VkSemaphore timelineSemaphore,
+        uint32_t bufferCount, VkDeviceSize bufferSize, ReadbackMemory memory, Consumer consumer);
+    ~ReadbackRing();
+
+    // Delete copy constructors
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    // Index of a free buffer. Blocks while all buffers are in use; rethrows
+    // the first consumer error not reported yet.
+    uint32_t Acquire();
+
+    // Return an acquired buffer that will not be submitted (e.g. recording
+    // the copy failed)
+    void Release(uint32_t index);
+
+    // Whether a physical device can back a ring with the given memory. The
+    // device extensions it needs are added to extensions.
+    static bool SupportsMemory(VkPhysicalDevice physicalDevice, ReadbackMemory memory,
+        std::vector<const char*>* extensions = nullptr);
+
+    // Queue an acquired buffer for the consumer: once the timeline semaphore
+    // reaches timelineValue, its first size bytes are passed on as frame id
+    void Submit(uint32_t index, uint64_t timelineValue, size_t size, uint64_t id);
+
+    // Wait until every submitted buffer has been consumed. Rethrows the first
+    // consumer error not reported yet. Each error is reported once, by
+    // whichever of Acquire and Flush comes first, and the ring stays usable.
+    void Flush();
+
+    // The result buffer (TRANSFER_DST and, unless staging, STORAGE usage)
+    // and the 16-byte timestamp buffer (TRANSFER_DST) of an entry
+    VkBuffer GetBuffer(uint32_t index) const { return m_buffers[index].buffer; }
+    VkBuffer GetTimestampBuffer(uint32_t index) const { return m_buffers[index].timestampBuffer; }
+    VkDeviceSize GetBufferSize() const { return m_bufferSize; }
+    ReadbackMemory GetMemory() const { return m_memory; }
+
+private:
+    struct StagingBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        int memoryFd = -1;
+        uint32_t memoryTypeIndex = 0;
+        VkDeviceSize memorySize = 0;
+        VkBuffer timestampBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory timestampMemory = VK_NULL_HANDLE;
+        void* timestampMapped = nullptr;
+    };
+
+    struct PendingReadback {
+        uint32_t index;
+        uint64_t timelineValue;
+        size_t size;
+        uint64_t id;
+    };
+
+    void CreateBuffers(VkPhysicalDevice physicalDevice, uint32_t bufferCount);
+    void CreateResultBuffer(const VkPhysicalDeviceMemoryProperties& memProperties, StagingBuffer& staging);
+    void CreateTimestampBuffer(const VkPhysicalDeviceMemoryProperties& memProperties, StagingBuffer& staging);
+    void ExportMemory(StagingBuffer& staging);
+    void DestroyBuffers();
+    void ConsumeLoop();
+    void Stop();
+
+    // Throw the stored consumer error, if any, and clear it. Callers hold
+    // m_mutex.
+    void ThrowIfFailed();
+
+    VkDevice m_device;
+    VkSemaphore m_timelineSemaphore;
+    VkDeviceSize m_bufferSize;
+    ReadbackMemory m_memory;
+    // Mapped memory that is not host-coherent must be invalidated before
+    // the CPU reads what the GPU wrote
+    bool m_needsInvalidate;
+    Consumer m_consumer;
+
+    std::vector<StagingBuffer> m_buffers;
+
+    // Shared with the worker thread
+    std::mutex m_mutex;
+    std::condition_variable m_bufferAvailable;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_idle;
+    std::vector<uint32_t> m_freeBuffers;
+    std::deque<PendingReadback> m_pending;
+    bool m_consuming;
+    bool m_stopping;
+    // First consumer error since the last one was reported
+    std::string m_error;
+    std::thread m_worker;
+};
@@ -0,0 +1,47 @@
+#include "ShaderLoader.h"
+#include "EmbeddedShaders.h"
+#include "Platform.h"
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+
+// Read a SPIR-V file from disk (development override only)
+static std::vector<uint32_t> ReadSpirvFile(const std::filesystem::path& path) {
+    // Open the file for binary reading at the end to get size
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open shader override: " + path.string());
+    }
+
+    // SPIR-V is a stream of 32-bit words
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0) {
+        throw std::runtime_error("Shader override is not valid SPIR-V (size " + std::to_string(fileSize) + " bytes): " + path.string());
+    }
+
+    std::vector<uint32_t> code(fileSize / sizeof(uint32_t));
+
+    // Move to the beginning and read the file
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(code.data()), fileSize)) {
+        throw std::runtime_error("Failed to read shader override: " + path.string());
+    }
+
+    return code;
+}
+
+std::vector<uint32_t> LoadShaderCode(const std::string& shaderName) {
+    // On-disk override for shader development
+    std::string overrideDirectory = GetEnvironmentString("VFR_SHADER_DIR");
+    if (!overrideDirectory.empty()) {
+        return ReadSpirvFile(std::filesystem::path(overrideDirectory) / shaderName);
+    }
+
+    const EmbeddedShader* shader = FindEmbeddedShader(shaderName);
+    if (shader == nullptr) {
+        throw std::runtime_error("No embedded shader named " + shaderName);
+    }
+
+    return std::vector<uint32_t>(shader->code, shader->code + shader->wordCount);
+}
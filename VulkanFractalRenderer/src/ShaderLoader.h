@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Load the SPIR-V code of a compiled shader, e.g. "fractal.comp.spv".
+// Shaders are compiled into the binary, so this normally does no file I/O.
+// During shader development, set VFR_SHADER_DIR to a directory of .spv files
+// to load them from disk instead without rebuilding the application.
+std::vector<uint32_t> LoadShaderCode(const std::string& shaderName);
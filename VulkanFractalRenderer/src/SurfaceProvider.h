@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// Window system integration for VulkanContext. The renderer core only talks
+// to the window through this interface, so the same frame loop runs on every
+// platform. Implementations must be cheap to query and must never block:
+// they are called from the render thread between frames.
+class SurfaceProvider {
+public:
+    virtual ~SurfaceProvider() = default;
+
+    // Instance extensions needed by CreateSurface, besides VK_KHR_surface
+    virtual std::vector<const char*> GetRequiredInstanceExtensions() const = 0;
+
+    // Create a presentation surface for the window
+    virtual VkSurfaceKHR CreateSurface(VkInstance instance) const = 0;
+
+    // Current size of the window's drawable area in pixels; 0x0 while the
+    // window is minimized or otherwise has nothing to draw to
+    virtual VkExtent2D GetDrawableExtent() const = 0;
+};
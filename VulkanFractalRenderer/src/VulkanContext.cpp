@@ -1,4 +1,6 @@
 #include "VulkanContext.h"
+#include "ComputeDevice.h"
+#include "DeviceSelection.h"
 #include <stdexcept>
 #include <vector>
 #include <iostream>
@@ -47,11 +49,10 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
     }
 }
 
-VulkanContext::VulkanContext(HWND hwnd, int width, int height)
-    : m_hwnd(hwnd)
-    , m_width(width)
-    , m_height(height)
-    , m_framebufferResized(false)
+VulkanContext::VulkanContext(const SurfaceProvider& surfaceProvider, const SwapChainSettings& swapChainSettings,
+    const DeviceSelectionSettings& deviceSelection)
+    : m_surfaceProvider(surfaceProvider)
+    , m_swapChainOutOfDate(false)
     , m_instance(VK_NULL_HANDLE)
     , m_debugMessenger(VK_NULL_HANDLE)
     , m_surface(VK_NULL_HANDLE)
@@ -59,8 +60,22 @@ VulkanContext::VulkanContext(HWND hwnd, int width, int height)
     , m_device(VK_NULL_HANDLE)
     , m_graphicsQueue(VK_NULL_HANDLE)
     , m_presentQueue(VK_NULL_HANDLE)
+    , m_computeQueue(VK_NULL_HANDLE)
+    , m_graphicsQueueFamily(0)
+    , m_computeQueueFamily(0)
     , m_commandPool(VK_NULL_HANDLE)
-    , m_swapChain(VK_NULL_HANDLE) {
+    , m_computeCommandPool(VK_NULL_HANDLE)
+    , m_timelineSemaphore(VK_NULL_HANDLE)
+    , m_timelineValue(0)
+    , m_computeTimelineSemaphore(VK_NULL_HANDLE)
+    , m_computeTimelineValue(0)
+    , m_deviceSelection(deviceSelection)
+    , m_swapChainSettings(swapChainSettings)
+    , m_presentMode(VK_PRESENT_MODE_FIFO_KHR)
+    , m_swapChainGeneration(0)
+    , m_swapChain(VK_NULL_HANDLE)
+    , m_presentWaitSupported(false)
+    , m_vkWaitForPresentKHR(nullptr) {
 
     InitVulkan();
 }
@@ -72,11 +87,27 @@ VulkanContext::~VulkanContext() {
     // Clean up swap chain resources
     CleanupSwapChain();
 
-    // Clean up command pool
+    // Free any single-time command buffers (all work has completed)
+    ReleaseCompletedCommandBuffers();
+
+    // Clean up timeline semaphores
+    if (m_timelineSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_device, m_timelineSemaphore, nullptr);
+    }
+
+    if (m_computeTimelineSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_device, m_computeTimelineSemaphore, nullptr);
+    }
+
+    // Clean up command pools
     if (m_commandPool != VK_NULL_HANDLE) {
         vkDestroyCommandPool(m_device, m_commandPool, nullptr);
     }
 
+    if (m_computeCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(m_device, m_computeCommandPool, nullptr);
+    }
+
     // Clean up device
     if (m_device != VK_NULL_HANDLE) {
         vkDestroyDevice(m_device, nullptr);
@@ -105,6 +136,7 @@ void VulkanContext::InitVulkan() {
     PickPhysicalDevice();
     CreateLogicalDevice();
     CreateCommandPool();
+    CreateTimelineSemaphore();
     CreateSwapChain();
     CreateImageViews();
 }
@@ -154,11 +186,9 @@ void VulkanContext::CreateInstance() {
 }
 
 std::vector<const char*> VulkanContext::GetRequiredExtensions() {
-    // Windows surface extension is always required
-    std::vector<const char*> extensions = {
-        VK_KHR_SURFACE_EXTENSION_NAME,
-        VK_KHR_WIN32_SURFACE_EXTENSION_NAME
-    };
+    // Surface extensions for the window system
+    std::vector<const char*> extensions = m_surfaceProvider.GetRequiredInstanceExtensions();
+    extensions.insert(extensions.begin(), VK_KHR_SURFACE_EXTENSION_NAME);
 
     // Add debug utilities extension if validation layers are enabled
     if (m_enableValidationLayers) {
@@ -222,15 +252,7 @@ void VulkanContext::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreate
 }
 
 void VulkanContext::CreateSurface() {
-    // Create a Windows surface
-    VkWin32SurfaceCreateInfoKHR createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-    createInfo.hwnd = m_hwnd;
-    createInfo.hinstance = GetModuleHandle(nullptr);
-
-    if (vkCreateWin32SurfaceKHR(m_instance, &createInfo, nullptr, &m_surface) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create window surface!");
-    }
+    m_surface = m_surfaceProvider.CreateSurface(m_instance);
 }
 
 void VulkanContext::PickPhysicalDevice() {
@@ -245,12 +267,74 @@ void VulkanContext::PickPhysicalDevice() {
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
-    // Find a suitable device
-    for (const auto& device : devices) {
-        if (IsDeviceSuitable(device)) {
-            m_physicalDevice = device;
+    std::string deviceOverride = GetDeviceOverride(m_deviceSelection.deviceOverride);
+
+    // Rank every device that meets the hard requirements
+    uint64_t bestScore = 0;
+    double bestMilliseconds = 0.0;
+    VkPhysicalDevice fastestDevice = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
+
+        std::string name = deviceProperties.deviceName;
+        bool suitable = IsDeviceSuitable(devices[i]);
+
+        // An explicit choice must name a suitable device
+        if (!deviceOverride.empty()) {
+            bool matches = MatchesDeviceOverride(deviceOverride, i, name);
+            if (!matches) {
+                continue;
+            }
+            if (!suitable) {
+                throw std::runtime_error("Requested device " + std::to_string(i) + " (" + name + ") does not meet the renderer's requirements!");
+            }
+
+            m_physicalDevice = devices[i];
+            std::cout << "GPU " << i << ": " << name << " (selected by override \"" << deviceOverride << "\")" << std::endl;
             break;
         }
+
+        if (!suitable) {
+            std::cout << "GPU " << i << ": " << name << " (unsuitable)" << std::endl;
+            continue;
+        }
+
+        uint64_t score = ScoreDevice(devices[i]);
+        std::cout << "GPU " << i << ": " << name << " (score " << score;
+
+        if (score > bestScore) {
+            bestScore = score;
+            m_physicalDevice = devices[i];
+        }
+
+        // Measured speed beats the static score; a device that fails to run
+        // the benchmark keeps only its score
+        if (m_deviceSelection.benchmark) {
+            try {
+                double milliseconds = ComputeDevice::MeasureIterationTime(devices[i]);
+                std::cout << ", benchmark " << milliseconds << " ms";
+
+                if (fastestDevice == VK_NULL_HANDLE || milliseconds < bestMilliseconds) {
+                    bestMilliseconds = milliseconds;
+                    fastestDevice = devices[i];
+                }
+            }
+            catch (const std::exception& e) {
+                std::cout << ", benchmark failed: " << e.what();
+            }
+        }
+
+        std::cout << ")" << std::endl;
+    }
+
+    if (!deviceOverride.empty() && m_physicalDevice == VK_NULL_HANDLE) {
+        throw std::runtime_error("No device matches \"" + deviceOverride + "\"!");
+    }
+
+    if (deviceOverride.empty() && fastestDevice != VK_NULL_HANDLE) {
+        m_physicalDevice = fastestDevice;
     }
 
     if (m_physicalDevice == VK_NULL_HANDLE) {
@@ -281,17 +365,23 @@ bool VulkanContext::IsDeviceSuitable(VkPhysicalDevice device) {
     VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-    // Get device features
-    VkPhysicalDeviceFeatures deviceFeatures;
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    // Timeline semaphores are core in Vulkan 1.2 but still an optional feature
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 
-    // Prefer discrete GPUs, but accept integrated if necessary
-    bool isDiscrete = deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
-    bool isIntegrated = deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &vulkan12Features;
 
-    // Device is suitable if it has required queue families, extension support, and swap chain support
-    // Prefer discrete, but also accept integrated GPUs
-    return indices.isComplete() && extensionsSupported && swapChainAdequate && (isDiscrete || isIntegrated);
+    bool supportsTimelineSemaphores = false;
+    if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+        vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+        supportsTimelineSemaphores = vulkan12Features.timelineSemaphore == VK_TRUE;
+    }
+
+    // Device is suitable if it has required queue families, extension support, and swap chain support.
+    // Any device type qualifies; ScoreDevice ranks GPUs above CPU and virtual devices.
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportsTimelineSemaphores;
 }
 
 QueueFamilyIndices VulkanContext::FindQueueFamilies(VkPhysicalDevice device) {
@@ -304,27 +394,33 @@ QueueFamilyIndices VulkanContext::FindQueueFamilies(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    // Find queue families that support graphics and presentation
-    int i = 0;
-    for (const auto& queueFamily : queueFamilies) {
+    // Find queue families that support graphics, presentation and compute
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        const auto& queueFamily = queueFamilies[i];
+
         // Check for graphics support
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if (!indices.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
             indices.graphicsFamily = i;
         }
 
         // Check for presentation support
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
-        if (presentSupport) {
+        if (!indices.presentFamily.has_value() && presentSupport) {
             indices.presentFamily = i;
         }
 
-        // If we found both, we can stop searching
-        if (indices.isComplete()) {
-            break;
+        // A compute family without graphics support maps to a separate
+        // hardware engine that can run alongside graphics (async compute)
+        if (!indices.computeFamily.has_value() &&
+            (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.computeFamily = i;
         }
+    }
 
-        i++;
+    // Without a dedicated family, compute work shares the graphics queue
+    if (!indices.computeFamily.has_value()) {
+        indices.computeFamily = indices.graphicsFamily;
     }
 
     return indices;
@@ -348,6 +444,22 @@ bool VulkanContext::CheckDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+bool VulkanContext::IsDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 SwapChainSupportDetails VulkanContext::QuerySwapChainSupport(VkPhysicalDevice device) {
     SwapChainSupportDetails details;
 
@@ -383,7 +495,8 @@ void VulkanContext::CreateLogicalDevice() {
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {
         indices.graphicsFamily.value(),
-        indices.presentFamily.value()
+        indices.presentFamily.value(),
+        indices.computeFamily.value()
     };
 
     float queuePriority = 1.0f;
@@ -399,14 +512,46 @@ void VulkanContext::CreateLogicalDevice() {
     // Specify device features
     VkPhysicalDeviceFeatures deviceFeatures{};
 
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+
+    std::vector<const char*> enabledExtensions = m_deviceExtensions;
+
+    // Present id/wait let us measure when a frame actually reaches the display
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.pNext = &presentIdFeatures;
+
+    if (IsDeviceExtensionSupported(m_physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        IsDeviceExtensionSupported(m_physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &presentWaitFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+
+        m_presentWaitSupported = presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+    }
+
+    if (m_presentWaitSupported) {
+        enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        presentIdFeatures.pNext = &vulkan12Features;
+    }
+
     // Create the logical device
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = m_presentWaitSupported ? static_cast<void*>(&presentWaitFeatures) : static_cast<void*>(&vulkan12Features);
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // Set up validation layers if enabled
     if (m_enableValidationLayers) {
@@ -424,6 +569,18 @@ void VulkanContext::CreateLogicalDevice() {
     // Get queue handles
     vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+    vkGetDeviceQueue(m_device, indices.computeFamily.value(), 0, &m_computeQueue);
+    m_graphicsQueueFamily = indices.graphicsFamily.value();
+    m_computeQueueFamily = indices.computeFamily.value();
+
+    if (HasAsyncCompute()) {
+        std::cout << "Async compute queue family: " << m_computeQueueFamily << std::endl;
+    }
+
+    if (m_presentWaitSupported) {
+        m_vkWaitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR");
+        m_presentWaitSupported = m_vkWaitForPresentKHR != nullptr;
+    }
 }
 
 void VulkanContext::CreateCommandPool() {
@@ -438,6 +595,35 @@ void VulkanContext::CreateCommandPool() {
     if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create command pool!");
     }
+
+    // Command pool for compute command buffers
+    poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_computeCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute command pool!");
+    }
+}
+
+void VulkanContext::CreateTimelineSemaphore() {
+    m_timelineSemaphore = CreateTimeline();
+    m_computeTimelineSemaphore = CreateTimeline();
+}
+
+VkSemaphore VulkanContext::CreateTimeline() {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timeline semaphore!");
+    }
+    return semaphore;
 }
 
 void VulkanContext::CreateSwapChain() {
@@ -449,7 +635,9 @@ void VulkanContext::CreateSwapChain() {
     VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
     // Decide how many images in the swap chain
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    uint32_t imageCount = m_swapChainSettings.imageCount > 0 ?
+        std::max(m_swapChainSettings.imageCount, swapChainSupport.capabilities.minImageCount) :
+        swapChainSupport.capabilities.minImageCount + 1;
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
@@ -496,6 +684,12 @@ void VulkanContext::CreateSwapChain() {
     // Store format and extent
     m_swapChainImageFormat = surfaceFormat.format;
     m_swapChainExtent = extent;
+    m_presentMode = presentMode;
+
+    // Present ids and image indices from the previous swap chain are now meaningless
+    m_swapChainGeneration++;
+
+    std::cout << "Swap chain: " << imageCount << " images, present mode " << GetPresentModeName(presentMode) << std::endl;
 }
 
 VkSurfaceFormatKHR VulkanContext::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -512,25 +706,46 @@ VkSurfaceFormatKHR VulkanContext::ChooseSwapSurfaceFormat(const std::vector<VkSu
 }
 
 VkPresentModeKHR VulkanContext::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-    // Prefer mailbox (triple buffering) if available
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
-        }
+    auto isAvailable = [&](VkPresentModeKHR mode) {
+        return std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end();
+    };
+
+    // Use the requested mode if the surface supports it
+    VkPresentModeKHR requested = m_swapChainSettings.presentMode;
+    if (isAvailable(requested)) {
+        return requested;
+    }
+
+    // IMMEDIATE was requested for latency; MAILBOX is the next lowest-latency mode
+    if (requested == VK_PRESENT_MODE_IMMEDIATE_KHR && isAvailable(VK_PRESENT_MODE_MAILBOX_KHR)) {
+        return VK_PRESENT_MODE_MAILBOX_KHR;
     }
 
     // Otherwise use FIFO (guaranteed to be available)
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+const char* VulkanContext::GetPresentModeName(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO_RELAXED";
+    default:
+        return "UNKNOWN";
+    }
+}
+
 VkExtent2D VulkanContext::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
     if (capabilities.currentExtent.width != UINT32_MAX) {
         return capabilities.currentExtent;
     } else {
-        VkExtent2D actualExtent = {
-            static_cast<uint32_t>(m_width),
-            static_cast<uint32_t>(m_height)
-        };
+        // The surface leaves the size to the swap chain (e.g. Wayland)
+        VkExtent2D actualExtent = m_surfaceProvider.GetDrawableExtent();
 
         actualExtent.width = std::clamp(actualExtent.width,
             capabilities.minImageExtent.width,
@@ -568,20 +783,23 @@ void VulkanContext::CreateImageViews() {
     }
 }
 
-void VulkanContext::RecreateSwapChain() {
-    // Wait until window is not minimized
-    int width = 0, height = 0;
-    while (width == 0 || height == 0) {
-        RECT rect;
-        GetClientRect(m_hwnd, &rect);
-        width = rect.right - rect.left;
-        height = rect.bottom - rect.top - 80; // Adjust for control area
-        if (width <= 0 || height <= 0) {
-            // Window is minimized, wait for events
-            WaitMessage();
-        }
+bool VulkanContext::HasDrawableSurface() {
+    VkExtent2D extent = m_surfaceProvider.GetDrawableExtent();
+    if (extent.width == 0 || extent.height == 0) {
+        return false;
     }
 
+    // Some window systems shrink the surface to 0x0 before the window layer
+    // hears about it
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &capabilities);
+    return capabilities.currentExtent.width != 0 && capabilities.currentExtent.height != 0;
+}
+
+void VulkanContext::RecreateSwapChain() {
+    // The caller checks HasDrawableSurface first; this never waits for the
+    // window to be restored
+
     // Wait for device to finish all operations
     vkDeviceWaitIdle(m_device);
 
@@ -592,7 +810,7 @@ void VulkanContext::RecreateSwapChain() {
     CreateSwapChain();
     CreateImageViews();
 
-    m_framebufferResized = false;
+    m_swapChainOutOfDate = false;
 }
 
 void VulkanContext::CleanupSwapChain() {
@@ -645,6 +863,37 @@ uint32_t VulkanContext::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlag
     throw std::runtime_error(errorMsg.str());
 }
 
+void VulkanContext::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkBuffer& buffer, VkDeviceMemory& memory) {
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create buffer!");
+    }
+
+    // Allocate and bind memory for the buffer
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to allocate buffer memory!");
+    }
+
+    vkBindBufferMemory(m_device, buffer, memory, 0);
+}
+
 VkCommandBuffer VulkanContext::BeginSingleTimeCommands() {
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -665,60 +914,163 @@ VkCommandBuffer VulkanContext::BeginSingleTimeCommands() {
 }
 
 void VulkanContext::EndSingleTimeCommands(VkCommandBuffer commandBuffer) {
+    // Wait for this submission only, not for everything queued before it
+    WaitForTimelineValue(SubmitSingleTimeCommands(commandBuffer));
+    ReleaseCompletedCommandBuffers();
+}
+
+uint64_t VulkanContext::SubmitSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkEndCommandBuffer(commandBuffer);
 
+    // The command buffer is freed once the timeline passes its value
+    uint64_t timelineValue = SubmitGraphics(commandBuffer);
+    m_pendingCommandBuffers.emplace_back(timelineValue, commandBuffer);
+
+    return timelineValue;
+}
+
+void VulkanContext::ReleaseCompletedCommandBuffers() {
+    if (m_pendingCommandBuffers.empty()) {
+        return;
+    }
+
+    uint64_t completedValue = GetCompletedTimelineValue();
+    auto it = std::remove_if(m_pendingCommandBuffers.begin(), m_pendingCommandBuffers.end(),
+        [&](const std::pair<uint64_t, VkCommandBuffer>& pending) {
+            if (pending.first > completedValue) {
+                return false;
+            }
+            vkFreeCommandBuffers(m_device, m_commandPool, 1, &pending.second);
+            return true;
+        });
+    m_pendingCommandBuffers.erase(it, m_pendingCommandBuffers.end());
+}
+
+uint64_t VulkanContext::SubmitGraphics(VkCommandBuffer commandBuffer, const SubmitDependencies& dependencies) {
+    // Reclaim finished single-time command buffers while we are here
+    ReleaseCompletedCommandBuffers();
+
+    return Submit(m_graphicsQueue, m_timelineSemaphore, m_timelineValue, commandBuffer, dependencies);
+}
+
+uint64_t VulkanContext::SubmitCompute(VkCommandBuffer commandBuffer, const SubmitDependencies& dependencies) {
+    return Submit(m_computeQueue, m_computeTimelineSemaphore, m_computeTimelineValue, commandBuffer, dependencies);
+}
+
+uint64_t VulkanContext::Submit(VkQueue queue, VkSemaphore timeline, uint64_t& timelineValue,
+    VkCommandBuffer commandBuffer, const SubmitDependencies& dependencies) {
+
+    uint64_t signalValue = timelineValue + 1;
+
+    // Binary semaphores take part in the same submission; their entries in
+    // the value arrays are ignored by the implementation
+    std::array<VkSemaphore, 3> waitSemaphores{};
+    std::array<uint64_t, 3> waitValues{};
+    std::array<VkPipelineStageFlags, 3> waitStages{};
+    uint32_t waitCount = 0;
+
+    if (dependencies.waitSemaphore != VK_NULL_HANDLE) {
+        waitSemaphores[waitCount] = dependencies.waitSemaphore;
+        waitValues[waitCount] = 0;
+        waitStages[waitCount++] = dependencies.waitStage;
+    }
+    if (dependencies.graphicsWaitValue != 0) {
+        waitSemaphores[waitCount] = m_timelineSemaphore;
+        waitValues[waitCount] = dependencies.graphicsWaitValue;
+        waitStages[waitCount++] = dependencies.timelineWaitStage;
+    }
+    if (dependencies.computeWaitValue != 0) {
+        waitSemaphores[waitCount] = m_computeTimelineSemaphore;
+        waitValues[waitCount] = dependencies.computeWaitValue;
+        waitStages[waitCount++] = dependencies.timelineWaitStage;
+    }
+
+    std::array<VkSemaphore, 2> signalSemaphores = { timeline, dependencies.signalSemaphore };
+    std::array<uint64_t, 2> signalValues = { signalValue, 0 };
+    uint32_t signalCount = dependencies.signalSemaphore != VK_NULL_HANDLE ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
 
-    vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_graphicsQueue);
+    if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit command buffer!");
+    }
 
-    vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+    timelineValue = signalValue;
+    return signalValue;
 }
 
-uint32_t VulkanContext::AcquireNextImage(VkSemaphore imageAvailableSemaphore) {
-    uint32_t imageIndex;
-    
-    // Try to acquire next image, recreating the swapchain if necessary
-    bool swapChainRecreated = false;
-    VkResult result;
-    
-    do {
-        // Attempt to acquire the next image
-        result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, 
-                                     imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-        
-        // Handle swapchain outdated or suboptimal
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || 
-            (result == VK_SUBOPTIMAL_KHR && !swapChainRecreated) || 
-            m_framebufferResized) {
-            
-            // Only recreate the swapchain once
-            if (swapChainRecreated) {
-                throw std::runtime_error("Failed to recreate swap chain!");
-            }
-            
-            m_framebufferResized = false;
-            RecreateSwapChain();
-            swapChainRecreated = true;
-            
-            // After recreation, go back to the beginning of the loop and try again
-            continue;
-        } 
-        else if (result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to acquire swap chain image!");
-        }
-        
-        // Successful acquisition, break out of the loop
-        break;
-    } while (true);
+void VulkanContext::WaitForTimelineValue(uint64_t value) {
+    WaitForTimeline(m_timelineSemaphore, value);
+}
+
+void VulkanContext::WaitForComputeTimelineValue(uint64_t value) {
+    WaitForTimeline(m_computeTimelineSemaphore, value);
+}
+
+void VulkanContext::WaitForTimeline(VkSemaphore timeline, uint64_t value) {
+    // Value 0 is the initial semaphore value, so there is nothing to wait for
+    if (value == 0) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &value;
 
-    return imageIndex;
+    if (vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to wait for timeline semaphore!");
+    }
 }
 
-void VulkanContext::PresentImage(uint32_t imageIndex, VkSemaphore renderFinishedSemaphore) {
+uint64_t VulkanContext::GetCompletedTimelineValue() const {
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(m_device, m_timelineSemaphore, &value) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to query timeline semaphore value!");
+    }
+    return value;
+}
+
+bool VulkanContext::AcquireNextImage(VkSemaphore imageAvailableSemaphore, uint32_t& imageIndex) {
+    VkResult result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX,
+        imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+    // A suboptimal image is still presentable; use it and recreate afterwards
+    if (result == VK_SUBOPTIMAL_KHR) {
+        m_swapChainOutOfDate = true;
+        return true;
+    }
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        m_swapChainOutOfDate = true;
+        return false;
+    }
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to acquire swap chain image!");
+    }
+
+    return true;
+}
+
+void VulkanContext::PresentImage(uint32_t imageIndex, VkSemaphore renderFinishedSemaphore, uint64_t presentId) {
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
@@ -730,12 +1082,28 @@ void VulkanContext::PresentImage(uint32_t imageIndex, VkSemaphore renderFinished
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
 
+    // Tag the present so its completion can be waited on
+    VkPresentIdKHR presentIdInfo{};
+    if (m_presentWaitSupported && presentId != 0) {
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        presentInfo.pNext = &presentIdInfo;
+    }
+
     VkResult result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized) {
-        m_framebufferResized = false;
-        RecreateSwapChain();
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        m_swapChainOutOfDate = true;
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swap chain image!");
     }
-}
\ No newline at end of file
+}
+
+VkResult VulkanContext::WaitForPresent(uint64_t presentId, uint64_t timeout) {
+    if (!m_presentWaitSupported) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    return m_vkWaitForPresentKHR(m_device, m_swapChain, presentId, timeout);
+}
@@ -1,32 +1,67 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
+#include "SurfaceProvider.h"
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <optional>
 #include <string>
 #include <memory>
 #include <array>
-#include <Windows.h>
+#include <utility>
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Dedicated compute-only family if the device has one, else the graphics family
+    std::optional<uint32_t> computeFamily;
     
     bool isComplete() const {
         return graphicsFamily.has_value() && presentFamily.has_value();
     }
 };
 
+// Semaphore dependencies of a queue submission. Binary semaphores are only
+// used for swap chain acquire/present; everything else waits on timeline values.
+struct SubmitDependencies {
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    VkPipelineStageFlags waitStage = 0;
+    VkSemaphore signalSemaphore = VK_NULL_HANDLE;
+
+    // Timeline values to wait for (0 = no wait) and the stage that waits
+    uint64_t graphicsWaitValue = 0;
+    uint64_t computeWaitValue = 0;
+    VkPipelineStageFlags timelineWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+};
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Swap chain presentation settings
+struct SwapChainSettings {
+    // Preferred present mode; the closest supported mode is used otherwise
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // Requested number of swap chain images (0 selects minImageCount + 1)
+    uint32_t imageCount = 0;
+};
+
+// Physical device selection settings
+struct DeviceSelectionSettings {
+    // Device index or case-insensitive name substring. Empty selects the
+    // highest-ranked device, unless the VFR_DEVICE environment variable is set.
+    std::string deviceOverride;
+    // Time a small fractal dispatch on every suitable device and pick the
+    // fastest instead of trusting the static score
+    bool benchmark = false;
+};
+
 class VulkanContext {
 public:
-    VulkanContext(HWND hwnd, int width, int height);
+    // The surface provider must outlive the context
+    VulkanContext(const SurfaceProvider& surfaceProvider, const SwapChainSettings& swapChainSettings = SwapChainSettings(),
+        const DeviceSelectionSettings& deviceSelection = DeviceSelectionSettings());
     ~VulkanContext();
 
     // Delete copy constructors
@@ -40,36 +75,74 @@ public:
     void CleanupSwapChain();
 
     // Getters for renderer
+    VkInstance GetInstance() const { return m_instance; }
     VkDevice GetDevice() const { return m_device; }
     VkPhysicalDevice GetPhysicalDevice() const { return m_physicalDevice; }
     VkQueue GetGraphicsQueue() const { return m_graphicsQueue; }
     VkQueue GetPresentQueue() const { return m_presentQueue; }
+    VkQueue GetComputeQueue() const { return m_computeQueue; }
     VkCommandPool GetCommandPool() const { return m_commandPool; }
+    VkCommandPool GetComputeCommandPool() const { return m_computeCommandPool; }
+    uint32_t GetGraphicsQueueFamily() const { return m_graphicsQueueFamily; }
+    uint32_t GetComputeQueueFamily() const { return m_computeQueueFamily; }
+    bool HasAsyncCompute() const { return m_computeQueueFamily != m_graphicsQueueFamily; }
     VkSwapchainKHR GetSwapChain() const { return m_swapChain; }
     VkFormat GetSwapChainImageFormat() const { return m_swapChainImageFormat; }
     VkExtent2D GetSwapChainExtent() const { return m_swapChainExtent; }
     const std::vector<VkImage>& GetSwapChainImages() const { return m_swapChainImages; }
     const std::vector<VkImageView>& GetSwapChainImageViews() const { return m_swapChainImageViews; }
+    VkPresentModeKHR GetPresentMode() const { return m_presentMode; }
+    uint64_t GetSwapChainGeneration() const { return m_swapChainGeneration; }
+    static const char* GetPresentModeName(VkPresentModeKHR presentMode);
 
     // Info for resource management
     uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkBuffer& buffer, VkDeviceMemory& memory);
 
     // Command buffer helpers
     VkCommandBuffer BeginSingleTimeCommands();
     void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
-
-    // Frame handling
-    uint32_t AcquireNextImage(VkSemaphore imageAvailableSemaphore);
-    void PresentImage(uint32_t imageIndex, VkSemaphore renderFinishedSemaphore);
-
-    // Resize handling
-    void SetWindowSize(int width, int height) {
-        if (width > 0 && height > 0) {
-            m_width = width;
-            m_height = height;
-            m_framebufferResized = true;
-        }
-    }
+    uint64_t SubmitSingleTimeCommands(VkCommandBuffer commandBuffer);
+
+    // GPU progress timeline. Every submission to the graphics queue signals
+    // the next value of one timeline semaphore, so a single monotonically
+    // increasing counter orders all GPU work. CPU waits key off that counter.
+    uint64_t SubmitGraphics(VkCommandBuffer commandBuffer, const SubmitDependencies& dependencies = SubmitDependencies());
+    void WaitForTimelineValue(uint64_t value);
+    uint64_t GetCompletedTimelineValue() const;
+    uint64_t GetLastSubmittedTimelineValue() const { return m_timelineValue; }
+    VkSemaphore GetTimelineSemaphore() const { return m_timelineSemaphore; }
+
+    // The compute queue has its own timeline: two queues signaling one
+    // timeline semaphore could complete out of order, which would move the
+    // counter backwards. Graphics submissions wait on compute values (and
+    // vice versa) through SubmitDependencies.
+    uint64_t SubmitCompute(VkCommandBuffer commandBuffer, const SubmitDependencies& dependencies = SubmitDependencies());
+    void WaitForComputeTimelineValue(uint64_t value);
+
+    // Frame handling. Neither call recreates the swap chain: that would pull
+    // the images out from under the renderer's framebuffers. Instead an
+    // out-of-date or suboptimal result marks the swap chain out of date and
+    // the renderer recreates it between frames. AcquireNextImage returns
+    // false if no image could be acquired.
+    bool AcquireNextImage(VkSemaphore imageAvailableSemaphore, uint32_t& imageIndex);
+    void PresentImage(uint32_t imageIndex, VkSemaphore renderFinishedSemaphore, uint64_t presentId = 0);
+
+    // Present completion tracking (VK_KHR_present_id + VK_KHR_present_wait).
+    // Returns VK_SUCCESS once the present tagged with presentId is visible,
+    // VK_TIMEOUT if it is still pending.
+    bool IsPresentWaitSupported() const { return m_presentWaitSupported; }
+    VkResult WaitForPresent(uint64_t presentId, uint64_t timeout);
+
+    // Resize handling. The window layer only flags a resize; it never
+    // recreates the swap chain itself, so resize events cost nothing.
+    void NotifySurfaceResized() { m_swapChainOutOfDate = true; }
+    bool IsSwapChainOutOfDate() const { return m_swapChainOutOfDate; }
+
+    // Whether the surface currently has a non-zero size. A swap chain cannot
+    // be created while it is zero, e.g. when the window is minimized.
+    bool HasDrawableSurface();
 
 private:
     // Initialization helper functions
@@ -79,11 +152,20 @@ private:
     void PickPhysicalDevice();
     void CreateLogicalDevice();
     void CreateCommandPool();
+    void CreateTimelineSemaphore();
+    VkSemaphore CreateTimeline();
+    uint64_t Submit(VkQueue queue, VkSemaphore timeline, uint64_t& timelineValue,
+        VkCommandBuffer commandBuffer, const SubmitDependencies& dependencies);
+    void WaitForTimeline(VkSemaphore timeline, uint64_t value);
+    
+    // Frees single-time command buffers whose submission has completed
+    void ReleaseCompletedCommandBuffers();
     
     // Device related helpers
     bool IsDeviceSuitable(VkPhysicalDevice device);
     QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
     bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+    bool IsDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
     SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
     
     // Extension helpers
@@ -99,11 +181,9 @@ private:
     bool CheckValidationLayerSupport();
     void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     
-    // Window handle
-    HWND m_hwnd;
-    int m_width;
-    int m_height;
-    bool m_framebufferResized;
+    // Window system integration
+    const SurfaceProvider& m_surfaceProvider;
+    bool m_swapChainOutOfDate;
 
     // Vulkan objects
     VkInstance m_instance;
@@ -113,9 +193,28 @@ private:
     VkDevice m_device;
     VkQueue m_graphicsQueue;
     VkQueue m_presentQueue;
+    VkQueue m_computeQueue;
+    uint32_t m_graphicsQueueFamily;
+    uint32_t m_computeQueueFamily;
     VkCommandPool m_commandPool;
+    VkCommandPool m_computeCommandPool;
+
+    // Timeline semaphores and the last value handed out for each
+    VkSemaphore m_timelineSemaphore;
+    uint64_t m_timelineValue;
+    VkSemaphore m_computeTimelineSemaphore;
+    uint64_t m_computeTimelineValue;
+
+    // Single-time command buffers waiting for their timeline value to retire
+    std::vector<std::pair<uint64_t, VkCommandBuffer>> m_pendingCommandBuffers;
+
+    // Device selection
+    DeviceSelectionSettings m_deviceSelection;
 
     // Swap chain
+    SwapChainSettings m_swapChainSettings;
+    VkPresentModeKHR m_presentMode;
+    uint64_t m_swapChainGeneration;
     VkSwapchainKHR m_swapChain;
     std::vector<VkImage> m_swapChainImages;
     VkFormat m_swapChainImageFormat;
@@ -132,6 +231,10 @@ private:
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
+    // Optional present wait support used for latency measurement
+    bool m_presentWaitSupported;
+    PFN_vkWaitForPresentKHR m_vkWaitForPresentKHR;
+
 #ifdef NDEBUG
     const bool m_enableValidationLayers = false;
 #else
@@ -0,0 +1,37 @@
+#include "Win32SurfaceProvider.h"
+#include <vulkan/vulkan_win32.h>
+#include <stdexcept>
+
+Win32SurfaceProvider::Win32SurfaceProvider(HINSTANCE hInstance, HWND hwnd)
+    : m_hInstance(hInstance)
+    , m_hwnd(hwnd) {
+}
+
+std::vector<const char*> Win32SurfaceProvider::GetRequiredInstanceExtensions() const {
+    return { VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
+}
+
+VkSurfaceKHR Win32SurfaceProvider::CreateSurface(VkInstance instance) const {
+    VkWin32SurfaceCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+    createInfo.hwnd = m_hwnd;
+    createInfo.hinstance = m_hInstance;
+
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (vkCreateWin32SurfaceKHR(instance, &createInfo, nullptr, &surface) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create window surface!");
+    }
+    return surface;
+}
+
+VkExtent2D Win32SurfaceProvider::GetDrawableExtent() const {
+    // The swap chain covers the whole client area; the UI controls are
+    // child windows drawn on top of it
+    if (IsIconic(m_hwnd)) {
+        return { 0, 0 };
+    }
+
+    RECT rect;
+    GetClientRect(m_hwnd, &rect);
+    return { static_cast<uint32_t>(rect.right - rect.left), static_cast<uint32_t>(rect.bottom - rect.top) };
+}
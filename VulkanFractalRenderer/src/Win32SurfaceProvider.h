@@ -0,0 +1,19 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "SurfaceProvider.h"
+
+// Surface for a Win32 window
+class Win32SurfaceProvider : public SurfaceProvider {
+public:
+    Win32SurfaceProvider(HINSTANCE hInstance, HWND hwnd);
+
+    std::vector<const char*> GetRequiredInstanceExtensions() const override;
+    VkSurfaceKHR CreateSurface(VkInstance instance) const override;
+    VkExtent2D GetDrawableExtent() const override;
+
+private:
+    HINSTANCE m_hInstance;
+    HWND m_hwnd;
+};
@@ -5,6 +5,7 @@
 #include <CommCtrl.h>
 #include <string>
 #include <stdexcept>
+#include <sstream>
 
 #pragma comment(lib, "comctl32.lib")
 
@@ -20,13 +21,19 @@ constexpr int ID_ITERATIONS_SLIDER = 102;
 constexpr int ID_ITERATIONS_TEXT = 103;
 constexpr int ID_PALETTE_COMBO = 104;
 constexpr int ID_RESET_BUTTON = 105;
+constexpr int ID_CYCLE_CHECKBOX = 106;
+constexpr int ID_EQUALIZE_CHECKBOX = 107;
+constexpr int ID_DISTANCE_CHECKBOX = 108;
+constexpr int ID_INTERIOR_CHECKBOX = 109;
 
-WindowsApplication::WindowsApplication(HINSTANCE hInstance, const std::wstring& title, int width, int height)
+WindowsApplication::WindowsApplication(HINSTANCE hInstance, const std::wstring& title, int width, int height,
+    const ApplicationSettings& settings)
     : m_hInstance(hInstance)
     , m_title(title)
     , m_width(width)
     , m_height(height)
     , m_resizing(false)
+    , m_settings(settings)
     , m_hwnd(nullptr)
     , m_fractalType(FRACTAL_MANDELBROT)
     , m_maxIterations(100)
@@ -37,11 +44,16 @@ WindowsApplication::WindowsApplication(HINSTANCE hInstance, const std::wstring&
     , m_leftMouseDown(false)
     , m_lastMouseX(0)
     , m_lastMouseY(0)
+    , m_lastLatencyDisplay(std::chrono::steady_clock::now())
     , m_fractalTypeCombo(nullptr)
     , m_iterationsSlider(nullptr)
     , m_iterationsText(nullptr)
     , m_paletteCombo(nullptr)
-    , m_resetButton(nullptr) {
+    , m_resetButton(nullptr)
+    , m_cycleCheckbox(nullptr)
+    , m_equalizeCheckbox(nullptr)
+    , m_distanceCheckbox(nullptr)
+    , m_interiorCheckbox(nullptr) {
 
     // Initialize common controls
     INITCOMMONCONTROLSEX icex;
@@ -101,9 +113,15 @@ WindowsApplication::WindowsApplication(HINSTANCE hInstance, const std::wstring&
 
     // Initialize Vulkan and renderer
     try {
-        m_vulkanContext = std::make_unique<VulkanContext>(m_hwnd, width, height);
-        m_fractalRenderer = std::make_unique<FractalRenderer>(m_vulkanContext.get());
+        m_surfaceProvider = std::make_unique<Win32SurfaceProvider>(m_hInstance, m_hwnd);
+        m_vulkanContext = std::make_unique<VulkanContext>(*m_surfaceProvider, m_settings.swapChain, m_settings.deviceSelection);
+        m_fractalRenderer = std::make_unique<FractalRenderer>(m_vulkanContext.get(), m_settings.framesInFlight);
         m_fractalRenderer->Initialize();
+        m_fractalRenderer->SetMultiGpu(m_settings.multiGpu);
+        if (!m_settings.gradient.empty()) {
+            m_fractalRenderer->SetCustomPalette(m_settings.gradient);
+            SetColorPalette(PALETTE_CUSTOM);
+        }
     } catch (const std::exception& e) {
         MessageBoxA(m_hwnd, e.what(), "Vulkan Initialization Error", MB_OK | MB_ICONERROR);
         throw;
@@ -118,6 +136,7 @@ WindowsApplication::~WindowsApplication() {
     }
     
     m_vulkanContext.reset();
+    m_surfaceProvider.reset();
 
     // Destroy all controls
     if (m_fractalTypeCombo) {
@@ -145,6 +164,26 @@ WindowsApplication::~WindowsApplication() {
         m_resetButton = nullptr;
     }
     
+    if (m_cycleCheckbox) {
+        DestroyWindow(m_cycleCheckbox);
+        m_cycleCheckbox = nullptr;
+    }
+
+    if (m_equalizeCheckbox) {
+        DestroyWindow(m_equalizeCheckbox);
+        m_equalizeCheckbox = nullptr;
+    }
+
+    if (m_distanceCheckbox) {
+        DestroyWindow(m_distanceCheckbox);
+        m_distanceCheckbox = nullptr;
+    }
+
+    if (m_interiorCheckbox) {
+        DestroyWindow(m_interiorCheckbox);
+        m_interiorCheckbox = nullptr;
+    }
+    
     // Clear the control map
     m_controlMap.clear();
 
@@ -181,7 +220,13 @@ int WindowsApplication::Run() {
         // If we're still running, render the fractal
         if (running && m_fractalRenderer) {
             try {
-                m_fractalRenderer->RenderFrame();
+                // Nothing to draw while minimized: sleep until the next
+                // message instead of spinning
+                if (!m_fractalRenderer->RenderFrame()) {
+                    WaitMessage();
+                    continue;
+                }
+                UpdateLatencyDisplay();
             } catch (const std::exception& e) {
                 MessageBoxA(m_hwnd, e.what(), "Render Error", MB_OK | MB_ICONERROR);
                 running = false;
@@ -236,7 +281,7 @@ LRESULT WindowsApplication::HandleMessage(HWND hwnd, UINT message, WPARAM wParam
     case WM_EXITSIZEMOVE:
         m_resizing = false;
         if (m_vulkanContext) {
-            m_vulkanContext->RecreateSwapChain();
+            m_vulkanContext->NotifySurfaceResized();
         }
         break;
 
@@ -265,6 +310,14 @@ LRESULT WindowsApplication::HandleMessage(HWND hwnd, UINT message, WPARAM wParam
         if (m_leftMouseDown) {
             int x = GET_X_LPARAM(lParam);
             int y = GET_Y_LPARAM(lParam);
+
+            // Timestamp the event when it was posted, not when it was handled,
+            // so time spent in the message queue counts towards latency
+            if (m_fractalRenderer) {
+                DWORD ageMs = GetTickCount() - static_cast<DWORD>(GetMessageTime());
+                m_fractalRenderer->MarkInputEvent(std::chrono::steady_clock::now() - std::chrono::milliseconds(ageMs));
+            }
+
             OnMouseMove(x, y, true);
         }
         break;
@@ -375,8 +428,35 @@ void WindowsApplication::CreateControls() {
     SendMessage(m_paletteCombo, CB_ADDSTRING, 0, (LPARAM)L"Ocean");
     SendMessage(m_paletteCombo, CB_ADDSTRING, 0, (LPARAM)L"Grayscale");
     SendMessage(m_paletteCombo, CB_ADDSTRING, 0, (LPARAM)L"Electric");
+    if (!m_settings.gradient.empty()) {
+        SendMessage(m_paletteCombo, CB_ADDSTRING, 0, (LPARAM)L"Custom");
+    }
     SendMessage(m_paletteCombo, CB_SETCURSEL, 0, 0);
     RegisterControl(m_paletteCombo, "paletteCombo");
+
+    // Color cycling checkbox, left of the reset button
+    m_cycleCheckbox = CreateWindowW(L"BUTTON", L"Cycle Colors", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+        width - MARGIN - LABEL_WIDTH - CONTROL_WIDTH, TOP_MARGIN + 10 + CONTROL_HEIGHT + 5, LABEL_WIDTH + CONTROL_WIDTH - BUTTON_WIDTH - 5, CONTROL_HEIGHT,
+        m_hwnd, (HMENU)ID_CYCLE_CHECKBOX, m_hInstance, nullptr);
+    RegisterControl(m_cycleCheckbox, "cycleCheckbox");
+
+    // Histogram equalization checkbox, left of the color cycling one
+    m_equalizeCheckbox = CreateWindowW(L"BUTTON", L"Equalize Colors", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+        width - MARGIN - LABEL_WIDTH - 2 * CONTROL_WIDTH - 5, TOP_MARGIN + 10 + CONTROL_HEIGHT + 5, CONTROL_WIDTH, CONTROL_HEIGHT,
+        m_hwnd, (HMENU)ID_EQUALIZE_CHECKBOX, m_hInstance, nullptr);
+    RegisterControl(m_equalizeCheckbox, "equalizeCheckbox");
+
+    // Distance estimation checkbox, left of the equalization one
+    m_distanceCheckbox = CreateWindowW(L"BUTTON", L"Distance Estimate", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+        width - MARGIN - LABEL_WIDTH - 3 * CONTROL_WIDTH - 10, TOP_MARGIN + 10 + CONTROL_HEIGHT + 5, CONTROL_WIDTH, CONTROL_HEIGHT,
+        m_hwnd, (HMENU)ID_DISTANCE_CHECKBOX, m_hInstance, nullptr);
+    RegisterControl(m_distanceCheckbox, "distanceCheckbox");
+
+    // Interior detection checkbox, left of the distance estimation one
+    m_interiorCheckbox = CreateWindowW(L"BUTTON", L"Interior Detection", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+        width - MARGIN - LABEL_WIDTH - 4 * CONTROL_WIDTH - 15, TOP_MARGIN + 10 + CONTROL_HEIGHT + 5, CONTROL_WIDTH, CONTROL_HEIGHT,
+        m_hwnd, (HMENU)ID_INTERIOR_CHECKBOX, m_hInstance, nullptr);
+    RegisterControl(m_interiorCheckbox, "interiorCheckbox");
     
     // Reset view button
     m_resetButton = CreateWindowW(L"BUTTON", L"Reset View", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
@@ -395,13 +475,11 @@ void WindowsApplication::OnResize(int width, int height) {
     m_width = width;
     m_height = height;
 
-    // Only update Vulkan if not currently in a resize operation
+    // Only flag the swap chain here; the renderer recreates it before its
+    // next frame. During an interactive resize that happens once the drag
+    // ends (WM_EXITSIZEMOVE).
     if (!m_resizing && m_vulkanContext) {
-        m_vulkanContext->SetWindowSize(width, height);
-        
-        if (m_fractalRenderer) {
-            m_fractalRenderer->RecreateSwapChain();
-        }
+        m_vulkanContext->NotifySurfaceResized();
     }
 
     // Update layout of controls
@@ -427,6 +505,30 @@ void WindowsApplication::LayoutControls() {
             width - 10 - 100, rect.bottom - 40, 
             0, 0, SWP_NOSIZE | SWP_NOZORDER);
     }
+
+    if (m_cycleCheckbox) {
+        SetWindowPos(m_cycleCheckbox, nullptr,
+            width - 10 - 100 - 150, rect.bottom - 40,
+            0, 0, SWP_NOSIZE | SWP_NOZORDER);
+    }
+
+    if (m_equalizeCheckbox) {
+        SetWindowPos(m_equalizeCheckbox, nullptr,
+            width - 10 - 100 - 2 * 150 - 5, rect.bottom - 40,
+            0, 0, SWP_NOSIZE | SWP_NOZORDER);
+    }
+
+    if (m_distanceCheckbox) {
+        SetWindowPos(m_distanceCheckbox, nullptr,
+            width - 10 - 100 - 3 * 150 - 10, rect.bottom - 40,
+            0, 0, SWP_NOSIZE | SWP_NOZORDER);
+    }
+
+    if (m_interiorCheckbox) {
+        SetWindowPos(m_interiorCheckbox, nullptr,
+            width - 10 - 100 - 4 * 150 - 15, rect.bottom - 40,
+            0, 0, SWP_NOSIZE | SWP_NOZORDER);
+    }
 }
 
 void WindowsApplication::OnMouseWheel(int delta, int x, int y) {
@@ -467,6 +569,24 @@ void WindowsApplication::OnMouseMove(int x, int y, bool leftButtonDown) {
     m_lastMouseY = y;
 }
 
+void WindowsApplication::UpdateLatencyDisplay() {
+    // Refresh once per second with the statistics gathered in that second
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastLatencyDisplay < std::chrono::seconds(1)) {
+        return;
+    }
+    m_lastLatencyDisplay = now;
+
+    // The status text is plain ASCII, so widening it byte by byte is enough
+    std::string status = m_fractalRenderer->GetStatusText();
+
+    std::wostringstream title;
+    title << m_title << L" - " << std::wstring(status.begin(), status.end());
+
+    SetWindowTextW(m_hwnd, title.str().c_str());
+    m_fractalRenderer->ResetInputLatencyStats();
+}
+
 void WindowsApplication::OnControlCommand(HWND controlHwnd, int notificationCode) {
     if (!controlHwnd) {
         return;
@@ -508,6 +628,34 @@ void WindowsApplication::OnControlCommand(HWND controlHwnd, int notificationCode
             m_fractalRenderer->SetColorPalette(static_cast<ColorPalette>(m_colorPalette));
         }
     }
+    else if (controlId == "cycleCheckbox" && notificationCode == BN_CLICKED && m_cycleCheckbox) {
+        bool cycling = SendMessage(m_cycleCheckbox, BM_GETCHECK, 0, 0) == BST_CHECKED;
+
+        if (m_fractalRenderer) {
+            m_fractalRenderer->SetColorCycleSpeed(cycling ? FractalRenderer::DEFAULT_COLOR_CYCLE_SPEED : 0.0f);
+        }
+    }
+    else if (controlId == "equalizeCheckbox" && notificationCode == BN_CLICKED && m_equalizeCheckbox) {
+        bool equalize = SendMessage(m_equalizeCheckbox, BM_GETCHECK, 0, 0) == BST_CHECKED;
+
+        if (m_fractalRenderer) {
+            m_fractalRenderer->SetColorMapping(equalize ? COLOR_MAPPING_HISTOGRAM : COLOR_MAPPING_LINEAR);
+        }
+    }
+    else if (controlId == "distanceCheckbox" && notificationCode == BN_CLICKED && m_distanceCheckbox) {
+        bool distance = SendMessage(m_distanceCheckbox, BM_GETCHECK, 0, 0) == BST_CHECKED;
+
+        if (m_fractalRenderer) {
+            m_fractalRenderer->SetOutputChannel(distance ? OUTPUT_DISTANCE : OUTPUT_ITERATIONS);
+        }
+    }
+    else if (controlId == "interiorCheckbox" && notificationCode == BN_CLICKED && m_interiorCheckbox) {
+        bool detect = SendMessage(m_interiorCheckbox, BM_GETCHECK, 0, 0) == BST_CHECKED;
+
+        if (m_fractalRenderer) {
+            m_fractalRenderer->SetInteriorDetection(detect ? INTERIOR_DETECTION_TYPES : 0);
+        }
+    }
     else if (controlId == "resetButton" && notificationCode == BN_CLICKED) {
         // Reset view parameters
         m_zoom = 1.0f;
@@ -6,14 +6,18 @@
 #include <memory>
 #include <functional>
 #include <unordered_map>
+#include <cstdint>
+#include <chrono>
+#include "ApplicationSettings.h"
+#include "Win32SurfaceProvider.h"
 
 // Forward declaration
-class VulkanContext;
 class FractalRenderer;
 
 class WindowsApplication {
 public:
-    WindowsApplication(HINSTANCE hInstance, const std::wstring& title, int width, int height);
+    WindowsApplication(HINSTANCE hInstance, const std::wstring& title, int width, int height,
+        const ApplicationSettings& settings = ApplicationSettings());
     ~WindowsApplication();
 
     // Delete copy constructors
@@ -53,6 +57,9 @@ private:
     void OnMouseMove(int x, int y, bool leftButtonDown);
     void OnControlCommand(HWND controlHwnd, int notificationCode);
 
+    // Shows present mode and input latency in the title bar
+    void UpdateLatencyDisplay();
+
     // Window data
     HINSTANCE m_hInstance;
     HWND m_hwnd;
@@ -60,6 +67,7 @@ private:
     int m_width;
     int m_height;
     bool m_resizing;
+    ApplicationSettings m_settings;
 
     // Fractal parameters
     int m_fractalType;
@@ -71,6 +79,7 @@ private:
     bool m_leftMouseDown;
     int m_lastMouseX;
     int m_lastMouseY;
+    std::chrono::steady_clock::time_point m_lastLatencyDisplay;
 
     // UI Controls
     HWND m_fractalTypeCombo;
@@ -78,9 +87,15 @@ private:
     HWND m_iterationsText;
     HWND m_paletteCombo;
     HWND m_resetButton;
+    HWND m_cycleCheckbox;
+    HWND m_equalizeCheckbox;
+    HWND m_distanceCheckbox;
+    HWND m_interiorCheckbox;
     std::unordered_map<HWND, std::string> m_controlMap;
 
-    // Rendering objects
+    // Rendering objects. The surface provider is declared first so it
+    // outlives the context that uses it.
+    std::unique_ptr<Win32SurfaceProvider> m_surfaceProvider;
     std::unique_ptr<VulkanContext> m_vulkanContext;
     std::unique_ptr<FractalRenderer> m_fractalRenderer;
 };
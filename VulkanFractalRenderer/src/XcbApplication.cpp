@@ -0,0 +1,365 @@
+#include "XcbApplication.h"
+#include "VulkanContext.h"
+#include "FractalRenderer.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// X11 keysyms used for the controls (Latin-1 keysyms equal their characters)
+constexpr uint32_t KEYSYM_ESCAPE = 0xff1b;
+constexpr uint32_t KEYSYM_PLUS = '+';
+constexpr uint32_t KEYSYM_EQUAL = '=';
+constexpr uint32_t KEYSYM_MINUS = '-';
+constexpr uint32_t KEYSYM_KP_ADD = 0xffab;
+constexpr uint32_t KEYSYM_KP_SUBTRACT = 0xffad;
+
+// Pointer buttons
+constexpr xcb_button_t BUTTON_LEFT = 1;
+constexpr xcb_button_t BUTTON_WHEEL_UP = 4;
+constexpr xcb_button_t BUTTON_WHEEL_DOWN = 5;
+
+// Iteration count range and step, matching the Win32 slider
+constexpr int MIN_ITERATIONS = 10;
+constexpr int MAX_ITERATIONS = 1000;
+constexpr int ITERATION_STEP = 50;
+
+XcbApplication::XcbApplication(const std::string& title, int width, int height,
+    const ApplicationSettings& settings)
+    : m_connection(nullptr)
+    , m_window(0)
+    , m_wmProtocols(XCB_ATOM_NONE)
+    , m_wmDeleteWindow(XCB_ATOM_NONE)
+    , m_title(title)
+    , m_width(width)
+    , m_height(height)
+    , m_running(true)
+    , m_settings(settings)
+    , m_minKeycode(0)
+    , m_keysymsPerKeycode(0)
+    , m_fractalType(FRACTAL_MANDELBROT)
+    , m_maxIterations(100)
+    , m_colorPalette(PALETTE_RAINBOW)
+    , m_zoom(1.0f)
+    , m_panX(0.0f)
+    , m_panY(0.0f)
+    , m_leftMouseDown(false)
+    , m_lastMouseX(0)
+    , m_lastMouseY(0)
+    , m_lastLatencyDisplay(std::chrono::steady_clock::now()) {
+
+    // Connect to the X server named by DISPLAY
+    int screenNumber = 0;
+    m_connection = xcb_connect(nullptr, &screenNumber);
+    if (xcb_connection_has_error(m_connection)) {
+        xcb_disconnect(m_connection);
+        throw std::runtime_error("Failed to connect to the X server!");
+    }
+
+    xcb_screen_iterator_t screenIterator = xcb_setup_roots_iterator(xcb_get_setup(m_connection));
+    for (int i = 0; i < screenNumber; i++) {
+        xcb_screen_next(&screenIterator);
+    }
+    xcb_screen_t* screen = screenIterator.data;
+
+    // Create window
+    m_window = xcb_generate_id(m_connection);
+
+    uint32_t eventMask = XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE |
+        XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+    uint32_t values[] = { screen->black_pixel, eventMask };
+
+    xcb_create_window(m_connection, XCB_COPY_FROM_PARENT, m_window, screen->root,
+        0, 0, static_cast<uint16_t>(width), static_cast<uint16_t>(height), 0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+        XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK, values);
+
+    // Ask the window manager for a close event instead of a killed connection
+    m_wmProtocols = InternAtom("WM_PROTOCOLS");
+    m_wmDeleteWindow = InternAtom("WM_DELETE_WINDOW");
+    xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, m_window, m_wmProtocols,
+        XCB_ATOM_ATOM, 32, 1, &m_wmDeleteWindow);
+
+    SetTitle(m_title);
+    LoadKeyboardMapping();
+
+    xcb_map_window(m_connection, m_window);
+    xcb_flush(m_connection);
+
+    // Initialize Vulkan and renderer
+    try {
+        m_surfaceProvider = std::make_unique<XcbSurfaceProvider>(m_connection, m_window);
+        m_surfaceProvider->SetDrawableExtent(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+        m_vulkanContext = std::make_unique<VulkanContext>(*m_surfaceProvider, m_settings.swapChain, m_settings.deviceSelection);
+        m_fractalRenderer = std::make_unique<FractalRenderer>(m_vulkanContext.get(), m_settings.framesInFlight);
+        m_fractalRenderer->Initialize();
+        m_fractalRenderer->SetMultiGpu(m_settings.multiGpu);
+        if (!m_settings.gradient.empty()) {
+            m_fractalRenderer->SetCustomPalette(m_settings.gradient);
+            m_colorPalette = PALETTE_CUSTOM;
+            m_fractalRenderer->SetColorPalette(PALETTE_CUSTOM);
+        }
+    } catch (...) {
+        m_fractalRenderer.reset();
+        m_vulkanContext.reset();
+        xcb_destroy_window(m_connection, m_window);
+        xcb_disconnect(m_connection);
+        throw;
+    }
+}
+
+XcbApplication::~XcbApplication() {
+    // Cleanup renderer and Vulkan before window destruction
+    if (m_fractalRenderer) {
+        m_fractalRenderer->Cleanup();
+        m_fractalRenderer.reset();
+    }
+
+    m_vulkanContext.reset();
+    m_surfaceProvider.reset();
+
+    xcb_destroy_window(m_connection, m_window);
+    xcb_disconnect(m_connection);
+}
+
+int XcbApplication::Run() {
+    while (m_running) {
+        // Process all pending events
+        while (xcb_generic_event_t* event = xcb_poll_for_event(m_connection)) {
+            HandleEvent(event);
+            free(event);
+        }
+
+        if (xcb_connection_has_error(m_connection)) {
+            throw std::runtime_error("Lost the connection to the X server!");
+        }
+
+        if (!m_running) {
+            break;
+        }
+
+        // Nothing to draw while unmapped or zero-sized: sleep until the next
+        // event instead of spinning
+        if (!m_fractalRenderer->RenderFrame()) {
+            xcb_generic_event_t* event = xcb_wait_for_event(m_connection);
+            if (event != nullptr) {
+                HandleEvent(event);
+                free(event);
+            }
+            continue;
+        }
+
+        UpdateLatencyDisplay();
+    }
+
+    // Make sure Vulkan device is idle before exiting
+    vkDeviceWaitIdle(m_vulkanContext->GetDevice());
+
+    return EXIT_SUCCESS;
+}
+
+void XcbApplication::HandleEvent(const xcb_generic_event_t* event) {
+    switch (event->response_type & 0x7f) {
+    case XCB_CONFIGURE_NOTIFY:
+        {
+            auto configure = reinterpret_cast<const xcb_configure_notify_event_t*>(event);
+            if (configure->width != m_width || configure->height != m_height) {
+                m_width = configure->width;
+                m_height = configure->height;
+
+                // Only flag the swap chain; the renderer recreates it before
+                // its next frame
+                m_surfaceProvider->SetDrawableExtent(configure->width, configure->height);
+                m_vulkanContext->NotifySurfaceResized();
+            }
+        }
+        break;
+
+    case XCB_UNMAP_NOTIFY:
+        m_surfaceProvider->SetDrawableExtent(0, 0);
+        m_vulkanContext->NotifySurfaceResized();
+        break;
+
+    case XCB_MAP_NOTIFY:
+        m_surfaceProvider->SetDrawableExtent(static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height));
+        m_vulkanContext->NotifySurfaceResized();
+        break;
+
+    case XCB_KEY_PRESS:
+        OnKeyPress(reinterpret_cast<const xcb_key_press_event_t*>(event)->detail);
+        break;
+
+    case XCB_BUTTON_PRESS:
+        {
+            auto press = reinterpret_cast<const xcb_button_press_event_t*>(event);
+            if (press->detail == BUTTON_LEFT) {
+                m_leftMouseDown = true;
+                m_lastMouseX = press->event_x;
+                m_lastMouseY = press->event_y;
+            } else if (press->detail == BUTTON_WHEEL_UP || press->detail == BUTTON_WHEEL_DOWN) {
+                OnMouseWheel(press->detail == BUTTON_WHEEL_UP);
+            }
+        }
+        break;
+
+    case XCB_BUTTON_RELEASE:
+        if (reinterpret_cast<const xcb_button_release_event_t*>(event)->detail == BUTTON_LEFT) {
+            m_leftMouseDown = false;
+        }
+        break;
+
+    case XCB_MOTION_NOTIFY:
+        if (m_leftMouseDown) {
+            auto motion = reinterpret_cast<const xcb_motion_notify_event_t*>(event);
+
+            // Event timestamps are in server time, which has no fixed
+            // relation to the steady clock, so latency starts at dispatch
+            m_fractalRenderer->MarkInputEvent(std::chrono::steady_clock::now());
+            OnMouseMove(motion->event_x, motion->event_y);
+        }
+        break;
+
+    case XCB_CLIENT_MESSAGE:
+        {
+            auto message = reinterpret_cast<const xcb_client_message_event_t*>(event);
+            if (message->type == m_wmProtocols && message->data.data32[0] == m_wmDeleteWindow) {
+                m_running = false;
+            }
+        }
+        break;
+
+    case XCB_MAPPING_NOTIFY:
+        LoadKeyboardMapping();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void XcbApplication::OnKeyPress(xcb_keycode_t keycode) {
+    uint32_t keysym = GetKeysym(keycode);
+
+    if (keysym == KEYSYM_ESCAPE) {
+        m_running = false;
+    } else if (keysym >= '1' && keysym < '1' + FRACTAL_COUNT) {
+        // Number keys select the fractal type
+        m_fractalType = static_cast<int>(keysym - '1');
+        m_fractalRenderer->SetFractalType(static_cast<FractalType>(m_fractalType));
+    } else if (keysym == 'p' || keysym == 'P') {
+        // Cycle the color palette, including the custom one if given
+        int paletteCount = PALETTE_COUNT + (m_settings.gradient.empty() ? 0 : 1);
+        m_colorPalette = (m_colorPalette + 1) % paletteCount;
+        m_fractalRenderer->SetColorPalette(static_cast<ColorPalette>(m_colorPalette));
+    } else if (keysym == 'c' || keysym == 'C') {
+        // Toggle color cycling
+        bool cycling = m_fractalRenderer->GetColorCycleSpeed() != 0.0f;
+        m_fractalRenderer->SetColorCycleSpeed(cycling ? 0.0f : FractalRenderer::DEFAULT_COLOR_CYCLE_SPEED);
+    } else if (keysym == 'h' || keysym == 'H') {
+        // Toggle histogram-equalized coloring
+        bool equalized = m_fractalRenderer->GetColorMapping() == COLOR_MAPPING_HISTOGRAM;
+        m_fractalRenderer->SetColorMapping(equalized ? COLOR_MAPPING_LINEAR : COLOR_MAPPING_HISTOGRAM);
+    } else if (keysym == 'd' || keysym == 'D') {
+        // Toggle distance estimation
+        bool distance = m_fractalRenderer->GetOutputChannel() == OUTPUT_DISTANCE;
+        m_fractalRenderer->SetOutputChannel(distance ? OUTPUT_ITERATIONS : OUTPUT_DISTANCE);
+    } else if (keysym == 'i' || keysym == 'I') {
+        // Toggle interior detection for every type that supports it
+        bool detecting = m_fractalRenderer->GetInteriorDetection() != 0;
+        m_fractalRenderer->SetInteriorDetection(detecting ? 0 : INTERIOR_DETECTION_TYPES);
+    } else if (keysym == KEYSYM_PLUS || keysym == KEYSYM_EQUAL || keysym == KEYSYM_KP_ADD) {
+        m_maxIterations = std::min(m_maxIterations + ITERATION_STEP, MAX_ITERATIONS);
+        m_fractalRenderer->SetMaxIterations(m_maxIterations);
+    } else if (keysym == KEYSYM_MINUS || keysym == KEYSYM_KP_SUBTRACT) {
+        m_maxIterations = std::max(m_maxIterations - ITERATION_STEP, MIN_ITERATIONS);
+        m_fractalRenderer->SetMaxIterations(m_maxIterations);
+    } else if (keysym == 'r' || keysym == 'R') {
+        // Reset view parameters
+        m_zoom = 1.0f;
+        m_panX = 0.0f;
+        m_panY = 0.0f;
+        m_fractalRenderer->ResetView();
+    }
+}
+
+void XcbApplication::OnMouseWheel(bool zoomIn) {
+    const float ZOOM_FACTOR = 1.1f;
+
+    if (zoomIn) {
+        m_zoom *= ZOOM_FACTOR;
+    } else {
+        m_zoom /= ZOOM_FACTOR;
+    }
+
+    m_fractalRenderer->SetZoom(m_zoom);
+}
+
+void XcbApplication::OnMouseMove(int x, int y) {
+    // Same mapping as the Win32 window: screen delta to fractal coordinates,
+    // with Y inverted for natural panning
+    float deltaX = static_cast<float>(x - m_lastMouseX);
+    float deltaY = static_cast<float>(y - m_lastMouseY);
+
+    float moveScaleX = 2.0f / (m_width * m_zoom);
+    float moveScaleY = 2.0f / (m_height * m_zoom);
+
+    m_panX += deltaX * moveScaleX;
+    m_panY -= deltaY * moveScaleY;
+    m_fractalRenderer->SetPan(m_panX, m_panY);
+
+    m_lastMouseX = x;
+    m_lastMouseY = y;
+}
+
+void XcbApplication::LoadKeyboardMapping() {
+    const xcb_setup_t* setup = xcb_get_setup(m_connection);
+    m_minKeycode = setup->min_keycode;
+    uint8_t keycodeCount = static_cast<uint8_t>(setup->max_keycode - setup->min_keycode + 1);
+
+    xcb_get_keyboard_mapping_cookie_t cookie = xcb_get_keyboard_mapping(m_connection, m_minKeycode, keycodeCount);
+    xcb_get_keyboard_mapping_reply_t* reply = xcb_get_keyboard_mapping_reply(m_connection, cookie, nullptr);
+    if (reply == nullptr) {
+        return;
+    }
+
+    const xcb_keysym_t* keysyms = xcb_get_keyboard_mapping_keysyms(reply);
+    m_keysymsPerKeycode = reply->keysyms_per_keycode;
+    m_keysyms.assign(keysyms, keysyms + xcb_get_keyboard_mapping_keysyms_length(reply));
+    free(reply);
+}
+
+uint32_t XcbApplication::GetKeysym(xcb_keycode_t keycode) const {
+    // The unshifted keysym is the first one of each keycode
+    size_t index = static_cast<size_t>(keycode - m_minKeycode) * m_keysymsPerKeycode;
+    return index < m_keysyms.size() ? m_keysyms[index] : 0;
+}
+
+xcb_atom_t XcbApplication::InternAtom(const char* name) {
+    xcb_intern_atom_cookie_t cookie = xcb_intern_atom(m_connection, 0, static_cast<uint16_t>(strlen(name)), name);
+    xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(m_connection, cookie, nullptr);
+    if (reply == nullptr) {
+        throw std::runtime_error(std::string("Failed to intern X atom ") + name + "!");
+    }
+
+    xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+void XcbApplication::SetTitle(const std::string& title) {
+    xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, m_window, XCB_ATOM_WM_NAME,
+        XCB_ATOM_STRING, 8, static_cast<uint32_t>(title.size()), title.c_str());
+}
+
+void XcbApplication::UpdateLatencyDisplay() {
+    // Refresh once per second with the statistics gathered in that second
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastLatencyDisplay < std::chrono::seconds(1)) {
+        return;
+    }
+    m_lastLatencyDisplay = now;
+
+    SetTitle(m_title + " - " + m_fractalRenderer->GetStatusText());
+    xcb_flush(m_connection);
+    m_fractalRenderer->ResetInputLatencyStats();
+}
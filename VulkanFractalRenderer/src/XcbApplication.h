@@ -0,0 +1,80 @@
+#pragma once
+
+#include <xcb/xcb.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include "ApplicationSettings.h"
+#include "XcbSurfaceProvider.h"
+
+// Forward declaration
+class FractalRenderer;
+
+// X11 window for Linux. There are no widgets: the fractal is controlled
+// with the mouse and keyboard (see the README).
+class XcbApplication {
+public:
+    XcbApplication(const std::string& title, int width, int height,
+        const ApplicationSettings& settings = ApplicationSettings());
+    ~XcbApplication();
+
+    // Delete copy constructors
+    XcbApplication(const XcbApplication&) = delete;
+    XcbApplication& operator=(const XcbApplication&) = delete;
+
+    // Run the application
+    int Run();
+
+private:
+    // Event handling
+    void HandleEvent(const xcb_generic_event_t* event);
+    void OnKeyPress(xcb_keycode_t keycode);
+    void OnMouseMove(int x, int y);
+    void OnMouseWheel(bool zoomIn);
+
+    // Keyboard mapping from the server, for keycode to keysym lookup
+    void LoadKeyboardMapping();
+    uint32_t GetKeysym(xcb_keycode_t keycode) const;
+
+    xcb_atom_t InternAtom(const char* name);
+
+    // Shows present mode and input latency in the title bar
+    void UpdateLatencyDisplay();
+    void SetTitle(const std::string& title);
+
+    // Window data
+    xcb_connection_t* m_connection;
+    xcb_window_t m_window;
+    xcb_atom_t m_wmProtocols;
+    xcb_atom_t m_wmDeleteWindow;
+    std::string m_title;
+    int m_width;
+    int m_height;
+    bool m_running;
+    ApplicationSettings m_settings;
+
+    // Keyboard mapping
+    xcb_keycode_t m_minKeycode;
+    uint8_t m_keysymsPerKeycode;
+    std::vector<uint32_t> m_keysyms;
+
+    // Fractal parameters
+    int m_fractalType;
+    int m_maxIterations;
+    int m_colorPalette;
+    float m_zoom;
+    float m_panX;
+    float m_panY;
+    bool m_leftMouseDown;
+    int m_lastMouseX;
+    int m_lastMouseY;
+    std::chrono::steady_clock::time_point m_lastLatencyDisplay;
+
+    // Rendering objects. The surface provider is declared first so it
+    // outlives the context that uses it.
+    std::unique_ptr<XcbSurfaceProvider> m_surfaceProvider;
+    std::unique_ptr<VulkanContext> m_vulkanContext;
+    std::unique_ptr<FractalRenderer> m_fractalRenderer;
+};
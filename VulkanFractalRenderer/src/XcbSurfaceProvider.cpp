@@ -0,0 +1,30 @@
+#include "XcbSurfaceProvider.h"
+#include <vulkan/vulkan_xcb.h>
+#include <stdexcept>
+
+XcbSurfaceProvider::XcbSurfaceProvider(xcb_connection_t* connection, xcb_window_t window)
+    : m_connection(connection)
+    , m_window(window)
+    , m_extent{ 0, 0 } {
+}
+
+std::vector<const char*> XcbSurfaceProvider::GetRequiredInstanceExtensions() const {
+    return { VK_KHR_XCB_SURFACE_EXTENSION_NAME };
+}
+
+VkSurfaceKHR XcbSurfaceProvider::CreateSurface(VkInstance instance) const {
+    VkXcbSurfaceCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+    createInfo.connection = m_connection;
+    createInfo.window = m_window;
+
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (vkCreateXcbSurfaceKHR(instance, &createInfo, nullptr, &surface) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create window surface!");
+    }
+    return surface;
+}
+
+VkExtent2D XcbSurfaceProvider::GetDrawableExtent() const {
+    return m_extent;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <xcb/xcb.h>
+#include "SurfaceProvider.h"
+
+// Surface for an X11 window, through XCB
+class XcbSurfaceProvider : public SurfaceProvider {
+public:
+    XcbSurfaceProvider(xcb_connection_t* connection, xcb_window_t window);
+
+    std::vector<const char*> GetRequiredInstanceExtensions() const override;
+    VkSurfaceKHR CreateSurface(VkInstance instance) const override;
+    VkExtent2D GetDrawableExtent() const override;
+
+    // The window size is tracked from ConfigureNotify events rather than
+    // queried, which would be a server round trip
+    void SetDrawableExtent(uint32_t width, uint32_t height) { m_extent = { width, height }; }
+
+private:
+    xcb_connection_t* m_connection;
+    xcb_window_t m_window;
+    VkExtent2D m_extent;
+};
@@ -0,0 +1,311 @@
+#include "HeadlessRenderer.h"
+#include "FractalOptions.h"
+#include "ImageWriter.h"
+#include "JobFile.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+// fractal_batch: render every job of a job file back to back on one device.
+// The device keeps its pipelines and buffers across jobs, and the work is
+// pipelined: while the GPU renders job N+1, the renderer's readback thread
+// copies out job N and encoder threads write out the jobs before it.
+
+static void PrintUsage() {
+    std::cout <<
+        "Usage: fractal_batch --jobs=FILE [options]\n"
+        "  --jobs=FILE         job file, .csv or JSON lines (see README)\n"
+        "  --output=PATTERN    output path for jobs without an output field, with a\n"
+        "                      %d for the job number, optionally zero-padded like\n"
+        "                      %05d, and %% for a percent sign (default frame_%05d.ppm)\n"
+        "  --width=W           default image width in pixels (default 1920)\n"
+        "  --height=H          default image height in pixels (default 1080)\n"
+        "  --encoders=N        image encoding threads (default 2)\n"
+        "  --export=MODE       auto (default), staging or host-visible: how pixels\n"
+        "                      reach the host (see README)\n"
+        << GetFractalOptionsHelp() <<
+        "The fractal options set defaults for fields a job leaves out.\n";
+}
+
+// Writes images on worker threads. Pixel buffers are recycled so a long batch
+// does not allocate per image, and at most capacity images wait for encoding,
+// which bounds memory when the GPU outruns the disk.
+class EncodeQueue {
+public:
+    EncodeQueue(uint32_t threadCount, size_t capacity)
+        : m_capacity(capacity)
+        , m_stopping(false) {
+        for (uint32_t i = 0; i < threadCount; i++) {
+            m_threads.emplace_back(&EncodeQueue::EncodeLoop, this);
+        }
+    }
+
+    ~EncodeQueue() {
+        Stop();
+    }
+
+    // A buffer to read the next image into
+    std::vector<uint8_t> AcquireBuffer() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_freeBuffers.empty()) {
+            return std::vector<uint8_t>();
+        }
+
+        std::vector<uint8_t> buffer = std::move(m_freeBuffers.back());
+        m_freeBuffers.pop_back();
+        return buffer;
+    }
+
+    // Queue an image for writing; blocks while the queue is full
+    void Push(const std::string& path, std::vector<uint8_t>&& pixels, uint32_t width, uint32_t height) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_spaceAvailable.wait(lock, [this] { return m_queue.size() < m_capacity; });
+        ThrowIfFailed();
+
+        m_queue.push_back({ path, std::move(pixels), width, height });
+        m_workAvailable.notify_one();
+    }
+
+    // Write everything queued and stop the threads. Rethrows the first
+    // encoding error.
+    void Finish() {
+        Stop();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ThrowIfFailed();
+    }
+
+private:
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+        m_threads.clear();
+    }
+
+    struct Image {
+        std::string path;
+        std::vector<uint8_t> pixels;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    void EncodeLoop() {
+        while (true) {
+            Image image;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_workAvailable.wait(lock, [this] { return !m_queue.empty() || m_stopping; });
+                if (m_queue.empty()) {
+                    return;
+                }
+
+                image = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            m_spaceAvailable.notify_one();
+
+            std::string error;
+            try {
+                WritePpm(image.path, image.pixels.data(), image.width, image.height);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_freeBuffers.push_back(std::move(image.pixels));
+            if (!error.empty() && m_error.empty()) {
+                m_error = error;
+            }
+        }
+    }
+
+    // Callers hold m_mutex
+    void ThrowIfFailed() const {
+        if (!m_error.empty()) {
+            throw std::runtime_error(m_error);
+        }
+    }
+
+    size_t m_capacity;
+    bool m_stopping;
+    std::string m_error;
+    std::deque<Image> m_queue;
+    std::vector<std::vector<uint8_t>> m_freeBuffers;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_spaceAvailable;
+};
+
+// Substitute the job number for the single %d (with optional zero padding
+// and width, e.g. %05d) of pattern; %% stands for a percent sign. The
+// pattern is user input, so it is parsed here rather than handed to printf.
+static std::string FormatOutputPath(const std::string& pattern, size_t jobIndex) {
+    std::string path;
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') {
+            path += pattern[i];
+            continue;
+        }
+
+        i++;
+        if (i < pattern.size() && pattern[i] == '%') {
+            path += '%';
+            continue;
+        }
+
+        bool zeroPadded = i < pattern.size() && pattern[i] == '0';
+        if (zeroPadded) {
+            i++;
+        }
+        size_t width = 0;
+        while (i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i])) && width < 100) {
+            width = width * 10 + static_cast<size_t>(pattern[i++] - '0');
+        }
+        if (i >= pattern.size() || pattern[i] != 'd' || width >= 100) {
+            throw std::runtime_error("Invalid output pattern: " + pattern + " (only %d, e.g. %05d, and %% are allowed)");
+        }
+
+        std::string number = std::to_string(jobIndex);
+        if (number.size() < width) {
+            number.insert(0, width - number.size(), zeroPadded ? '0' : ' ');
+        }
+        path += number;
+        conversions++;
+    }
+
+    if (conversions != 1) {
+        throw std::runtime_error("Invalid output pattern: " + pattern + " (needs exactly one %d for the job number)");
+    }
+    return path;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        RenderJob defaults{};
+        defaults.parameters = DefaultFractalParameters();
+        defaults.width = 1920;
+        defaults.height = 1080;
+
+        std::string jobFile;
+        std::string outputPattern = "frame_%05d.ppm";
+        std::string device;
+        std::vector<PaletteStop> gradient;
+        uint32_t encoderCount = 2;
+        ExportMode exportMode = EXPORT_MODE_AUTO;
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            std::string name, value;
+            SplitOption(argument, name, value);
+
+            if (name == "--help" || name == "-h") {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            } else if (name == "--jobs" && !value.empty()) {
+                jobFile = value;
+            } else if (name == "--output" && !value.empty()) {
+                outputPattern = value;
+            } else if (name == "--width" && !value.empty()) {
+                defaults.width = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--height" && !value.empty()) {
+                defaults.height = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--encoders" && !value.empty()) {
+                encoderCount = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+            } else if (name == "--export" && !value.empty()) {
+                exportMode = ParseExportMode(value);
+            } else if (name == "--device" && !value.empty()) {
+                device = value;
+            } else if (name == "--gradient" && !value.empty()) {
+                gradient = ParseGradient(value);
+                defaults.parameters.colorPalette = PALETTE_CUSTOM;
+            } else if (!ParseFractalOption(name, value, defaults.parameters)) {
+                throw std::runtime_error("Unknown command line option: " + argument);
+            }
+        }
+
+        if (jobFile.empty()) {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+
+        std::vector<RenderJob> jobs = LoadJobFile(jobFile, defaults);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs[i].output.empty()) {
+                jobs[i].output = FormatOutputPath(outputPattern, i);
+            }
+        }
+
+        // Enough queued images to keep every encoder busy while the GPU
+        // produces the next ones. Declared before the renderer, whose
+        // readback thread feeds it until the renderer is destroyed.
+        EncodeQueue encoder(encoderCount, encoderCount * 2);
+
+        HeadlessRenderer renderer(device, exportMode);
+        if (!gradient.empty()) {
+            renderer.SetCustomPalette(gradient);
+        }
+        std::cout << "Device: " << renderer.GetDeviceName() << ", "
+            << (renderer.GetExportMode() == EXPORT_MODE_HOST_VISIBLE ? "zero-copy host-visible" : "staging") << " export, "
+            << jobs.size() << " jobs" << std::endl;
+
+        // Only touched by the readback thread until Flush returns. Frames
+        // arrive in submission order, so the n-th frame is the n-th job.
+        size_t consumedJobs = 0;
+        double totalGpuMilliseconds = 0.0;
+        double totalMegapixels = 0.0;
+
+        // Copy each frame into an encoder buffer right away so the ring
+        // buffer goes back to the GPU; encoding happens on the encoder
+        // threads. With host-visible export this is the only copy.
+        renderer.SetFrameConsumer([&](const RenderedFrame& frame) {
+            const RenderJob& job = jobs[consumedJobs++];
+
+            std::vector<uint8_t> pixels = encoder.AcquireBuffer();
+            pixels.assign(frame.pixels, frame.pixels + static_cast<size_t>(frame.width) * frame.height * 4);
+            totalGpuMilliseconds += frame.gpuTime;
+            totalMegapixels += static_cast<double>(frame.width) * frame.height * 1e-6;
+
+            encoder.Push(job.output, std::move(pixels), frame.width, frame.height);
+        });
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (const RenderJob& job : jobs) {
+            renderer.Submit(job.parameters, job.width, job.height);
+        }
+
+        renderer.Flush();
+        encoder.Finish();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::fixed << std::setprecision(2)
+            << "Rendered " << jobs.size() << " images in " << seconds << " s: "
+            << (seconds > 0.0 ? jobs.size() / seconds : 0.0) << " images/s, "
+            << (seconds > 0.0 ? totalMegapixels / seconds : 0.0) << " Mpixel/s, GPU busy "
+            << totalGpuMilliseconds * 1e-3 << " s" << std::endl;
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
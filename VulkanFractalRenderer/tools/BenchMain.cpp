@@ -0,0 +1,472 @@
+#include "HeadlessRenderer.h"
+#include "CpuRenderer.h"
+#include "ExternalFrameImporter.h"
+#include "FractalOptions.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+// fractal_bench: time headless renders of each fractal type (or just the one
+// given with --fractal) and report wall-clock time, GPU time and throughput.
+// With --validate it instead compares the GPU iteration pass against the
+// double precision CPU reference, with --validate-interior it checks
+// interior detection against brute force iteration on a fixed scene set,
+// with --validate-export it checks the zero-copy export modes against
+// staging, and with --thumbnails it compares batched tile dispatches with one
+// render per thumbnail.
+
+static void PrintUsage() {
+    std::cout <<
+        "Usage: fractal_bench [options]\n"
+        "  --width=W           image width in pixels (default 1920)\n"
+        "  --height=H          image height in pixels (default 1080)\n"
+        "  --frames=N          timed renders per fractal (default 20)\n"
+        "  --validate          compare GPU iteration counts with the CPU reference\n"
+        "                      instead of timing\n"
+        "  --max-mismatch=P    with --validate, fail when more than P percent of the\n"
+        "                      pixels differ by over half an iteration (default 1)\n"
+        "  --validate-interior render the standard scenes with and without interior\n"
+        "                      detection; fails when more than --max-mismatch percent\n"
+        "                      of the pixels are wrongly taken for interior\n"
+        "  --validate-export   render through the host-visible and external-fd export\n"
+        "                      modes the device supports, importing exported frames\n"
+        "                      into a device of their own, and fail unless the\n"
+        "                      pixels match staging export exactly\n"
+        "  --thumbnails=N      time N square thumbnails of the fractal types rendered\n"
+        "                      one by one and as a single batched dispatch\n"
+        "  --thumbnail-size=S  thumbnail width and height in pixels (default 128)\n"
+        << GetFractalOptionsHelp();
+}
+
+// Iteration counts (or distance estimates in pixels) further apart than this
+// count as a mismatch. Single precision on the GPU moves pixels near the
+// boundary by a whole iteration or into the set, which is expected in small
+// numbers.
+constexpr double MISMATCH_THRESHOLD = 0.5;
+
+// Render each fractal type on the GPU and the CPU and report how far the
+// output channel agrees. Returns whether every type stays within
+// maxMismatch percent.
+static bool Validate(HeadlessRenderer& renderer, FractalUBO ubo, const std::vector<FractalType>& fractalTypes,
+    uint32_t width, uint32_t height, double maxMismatch) {
+    CpuRenderer cpuRenderer;
+    std::cout << "Validating against the CPU reference on " << cpuRenderer.GetThreadCount() << " threads" << std::endl;
+
+    std::cout << std::left << std::setw(14) << "fractal" << std::right
+        << std::setw(12) << "mismatch %" << std::setw(12) << "mean diff" << std::setw(12) << "cpu ms" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    // Distances are compared in pixels
+    double unit = ubo.outputChannel == OUTPUT_DISTANCE ? 2.0 * ubo.scale / height : 1.0;
+
+    bool passed = true;
+    for (FractalType type : fractalTypes) {
+        ubo.fractalType = type;
+
+        std::vector<float> gpuIterations = renderer.RenderIterations(ubo, width, height);
+
+        // Same aspect ratio as the GPU view
+        FractalUBO cpuUbo = ubo;
+        cpuUbo.projection = PROJECTION_PLANE;
+        cpuUbo.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<float> cpuIterations = cpuRenderer.RenderIterations(cpuUbo, width, height);
+        double cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        size_t mismatches = 0;
+        double totalDifference = 0.0;
+        for (size_t i = 0; i < gpuIterations.size(); i++) {
+            double difference = std::abs(static_cast<double>(gpuIterations[i]) - cpuIterations[i]) / unit;
+            totalDifference += difference;
+            if (difference > MISMATCH_THRESHOLD) {
+                mismatches++;
+            }
+        }
+
+        double mismatchPercent = 100.0 * mismatches / gpuIterations.size();
+        passed = passed && mismatchPercent <= maxMismatch;
+
+        std::cout << std::left << std::setw(14) << GetFractalTypeName(type) << std::right
+            << std::setw(12) << mismatchPercent
+            << std::setw(12) << totalDifference / gpuIterations.size()
+            << std::setw(12) << cpuMilliseconds << std::endl;
+    }
+
+    std::cout << (passed ? "Validation passed" : "Validation failed") << std::endl;
+    return passed;
+}
+
+// A view for --validate-interior
+struct InteriorScene {
+    const char* name;
+    FractalType fractalType;
+    float centerX;
+    float centerY;
+    float scale;
+    int maxIterations;
+    float juliaConstantX;
+    float juliaConstantY;
+};
+
+// The whole Mandelbrot set, zooms onto its boundary and into a minibrot,
+// and Julia sets with attracting cycles of different periods: the interior
+// is where detection saves time and the boundary is where it can go wrong
+static const InteriorScene INTERIOR_SCENES[] = {
+    { "mandelbrot", FRACTAL_MANDELBROT, -0.5f, 0.0f, 1.25f, 1000, 0.0f, 0.0f },
+    { "seahorse", FRACTAL_MANDELBROT, -0.745f, 0.1f, 0.01f, 2000, 0.0f, 0.0f },
+    { "elephant", FRACTAL_MANDELBROT, 0.275f, 0.0f, 0.01f, 2000, 0.0f, 0.0f },
+    { "minibrot", FRACTAL_MANDELBROT, -1.7549f, 0.0f, 0.002f, 2000, 0.0f, 0.0f },
+    { "julia-rabbit", FRACTAL_JULIA, 0.0f, 0.0f, 1.5f, 1000, -0.123f, 0.745f },
+    { "julia-basilica", FRACTAL_JULIA, 0.0f, 0.0f, 1.5f, 1000, -1.0f, 0.0f },
+    { "julia-default", FRACTAL_JULIA, 0.0f, 0.0f, 1.5f, 1000, -0.7f, 0.27015f },
+};
+
+// Render each standard scene with interior detection off (brute force) and
+// on, and report how much of it is interior, how many escaping pixels
+// detection took for interior and how much GPU time it saved. Returns
+// whether every scene stays within maxMismatch percent of false interior.
+static bool ValidateInterior(HeadlessRenderer& renderer, FractalUBO ubo, uint32_t width, uint32_t height,
+    double maxMismatch) {
+    std::cout << std::left << std::setw(16) << "scene" << std::right
+        << std::setw(12) << "interior %" << std::setw(12) << "false %" << std::setw(12) << "brute ms"
+        << std::setw(12) << "detect ms" << std::setw(10) << "speedup" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    ubo.outputChannel = OUTPUT_ITERATIONS;
+
+    bool passed = true;
+    for (const InteriorScene& scene : INTERIOR_SCENES) {
+        ubo.fractalType = scene.fractalType;
+        ubo.centerX = scene.centerX;
+        ubo.centerY = scene.centerY;
+        ubo.scale = scene.scale;
+        ubo.maxIterations = scene.maxIterations;
+        ubo.juliaConstantX = scene.juliaConstantX;
+        ubo.juliaConstantY = scene.juliaConstantY;
+
+        // Each pass is timed on the GPU where the device has timestamps and
+        // on the wall clock otherwise
+        double milliseconds[2];
+        std::vector<float> iterations[2];
+        for (int detect = 0; detect < 2; detect++) {
+            ubo.interiorDetection = detect ? INTERIOR_DETECTION_TYPES : 0;
+
+            auto start = std::chrono::steady_clock::now();
+            iterations[detect] = renderer.RenderIterations(ubo, width, height);
+            milliseconds[detect] = renderer.GetLastGpuTime();
+            if (milliseconds[detect] <= 0.0) {
+                milliseconds[detect] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+
+        size_t interior = 0;
+        size_t falseInterior = 0;
+        for (size_t i = 0; i < iterations[0].size(); i++) {
+            bool bruteInterior = iterations[0][i] >= static_cast<float>(scene.maxIterations);
+            bool detectedInterior = iterations[1][i] >= static_cast<float>(scene.maxIterations);
+            interior += bruteInterior;
+            falseInterior += detectedInterior && !bruteInterior;
+        }
+
+        double falsePercent = 100.0 * falseInterior / iterations[0].size();
+        passed = passed && falsePercent <= maxMismatch;
+
+        std::cout << std::left << std::setw(16) << scene.name << std::right
+            << std::setw(12) << 100.0 * interior / iterations[0].size()
+            << std::setw(12) << falsePercent
+            << std::setw(12) << milliseconds[0]
+            << std::setw(12) << milliseconds[1]
+            << std::setw(10) << milliseconds[0] / std::max(milliseconds[1], 1e-6) << std::endl;
+    }
+
+    std::cout << (passed ? "Interior validation passed" : "Interior validation failed") << std::endl;
+    return passed;
+}
+
+// Time thumbnailCount thumbnails, zooming in on the center of ubo and
+// cycling through fractalTypes, submitted as separate renders and as one
+// SubmitTiles batch. Wall clock, since per-render overhead is what batching
+// saves.
+static void BenchmarkThumbnails(HeadlessRenderer& renderer, const FractalUBO& ubo,
+    const std::vector<FractalType>& fractalTypes, uint32_t thumbnailCount, uint32_t thumbnailSize, uint32_t frames) {
+    std::vector<TileDescriptor> tiles;
+    for (uint32_t i = 0; i < thumbnailCount; i++) {
+        TileDescriptor tile{};
+        tile.centerX = ubo.centerX;
+        tile.centerY = ubo.centerY;
+        tile.scale = ubo.scale * std::pow(0.9f, static_cast<float>(i / fractalTypes.size()));
+        tile.fractalType = fractalTypes[i % fractalTypes.size()];
+        tile.maxIterations = ubo.maxIterations;
+        tile.colorPalette = ubo.colorPalette;
+        tile.juliaConstantX = ubo.juliaConstantX;
+        tile.juliaConstantY = ubo.juliaConstantY;
+        tiles.push_back(tile);
+    }
+
+    auto submitSeparately = [&]() {
+        for (const TileDescriptor& tile : tiles) {
+            FractalUBO parameters = ubo;
+            parameters.centerX = tile.centerX;
+            parameters.centerY = tile.centerY;
+            parameters.scale = tile.scale;
+            parameters.fractalType = tile.fractalType;
+            renderer.Submit(parameters, thumbnailSize, thumbnailSize);
+        }
+        renderer.Flush();
+    };
+    auto submitBatched = [&]() {
+        renderer.SubmitTiles(ubo, tiles, thumbnailSize);
+        renderer.Flush();
+    };
+
+    std::cout << std::left << std::setw(14) << "submission" << std::right
+        << std::setw(12) << "mean ms" << std::setw(14) << "ms/thumbnail" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    double meanMilliseconds[2];
+    for (int batched = 0; batched < 2; batched++) {
+        // Untimed warm-up: allocation and driver pipeline compilation. The
+        // two ways need differently sized buffers, so each warms up its own.
+        batched ? submitBatched() : submitSeparately();
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            batched ? submitBatched() : submitSeparately();
+        }
+        meanMilliseconds[batched] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+        std::cout << std::left << std::setw(14) << (batched ? "batched" : "separate") << std::right
+            << std::setw(12) << meanMilliseconds[batched]
+            << std::setw(14) << meanMilliseconds[batched] / thumbnailCount << std::endl;
+    }
+
+    std::cout << "Batched speedup: " << std::setprecision(2)
+        << meanMilliseconds[0] / std::max(meanMilliseconds[1], 1e-6) << "x" << std::endl;
+}
+
+// Render each fractal type through the zero-copy export modes the device
+// supports and compare the pixels with staging export. Exported frames are
+// imported into a Vulkan device of their own, as another process would, and
+// a second, smaller size makes the importer follow reallocated buffers.
+// Returns whether every supported mode matches byte for byte.
+static bool ValidateExport(const std::string& device, const std::vector<PaletteStop>& gradient, FractalUBO ubo,
+    const std::vector<FractalType>& fractalTypes, uint32_t width, uint32_t height) {
+    HeadlessRenderer reference(device, EXPORT_MODE_STAGING);
+    if (!gradient.empty()) {
+        reference.SetCustomPalette(gradient);
+    }
+    std::cout << "Device: " << reference.GetDeviceName() << ", " << width << "x" << height << std::endl;
+
+    const uint32_t sizes[2][2] = { { width, height }, { std::max(1u, width / 2), std::max(1u, height / 2) } };
+
+    std::cout << std::left << std::setw(14) << "export" << std::setw(14) << "fractal" << std::setw(12) << "size"
+        << std::right << std::setw(16) << "bytes differing" << std::endl;
+
+    bool passed = true;
+    for (ExportMode mode : { EXPORT_MODE_HOST_VISIBLE, EXPORT_MODE_EXTERNAL_FD }) {
+        const char* modeName = mode == EXPORT_MODE_HOST_VISIBLE ? "host-visible" : "external-fd";
+
+        std::unique_ptr<HeadlessRenderer> renderer;
+        std::unique_ptr<ExternalFrameImporter> importer;
+        try {
+            renderer = std::make_unique<HeadlessRenderer>(device, mode);
+            if (mode == EXPORT_MODE_EXTERNAL_FD) {
+                importer = std::make_unique<ExternalFrameImporter>(renderer->GetDeviceUuid());
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << std::left << std::setw(14) << modeName << "not supported: " << e.what() << std::endl;
+            continue;
+        }
+        if (!gradient.empty()) {
+            renderer->SetCustomPalette(gradient);
+        }
+
+        // Exported frames only reach a frame consumer
+        std::vector<uint8_t> imported;
+        if (importer) {
+            renderer->SetFrameConsumer([&](const RenderedFrame& frame) {
+                imported.resize(static_cast<size_t>(frame.width) * frame.height * 4);
+                importer->Read(frame, imported.data());
+            });
+        }
+
+        for (const auto& size : sizes) {
+            for (FractalType type : fractalTypes) {
+                ubo.fractalType = type;
+                std::vector<uint8_t> expected = reference.Render(ubo, size[0], size[1]);
+
+                std::vector<uint8_t> pixels;
+                if (importer) {
+                    renderer->Submit(ubo, size[0], size[1]);
+                    renderer->Flush();
+                    pixels = imported;
+                } else {
+                    pixels = renderer->Render(ubo, size[0], size[1]);
+                }
+
+                size_t differing = pixels.size() == expected.size() ? 0 : expected.size();
+                for (size_t i = 0; i < std::min(pixels.size(), expected.size()); i++) {
+                    if (pixels[i] != expected[i]) {
+                        differing++;
+                    }
+                }
+                passed = passed && differing == 0;
+
+                std::cout << std::left << std::setw(14) << modeName << std::setw(14) << GetFractalTypeName(type)
+                    << std::setw(12) << (std::to_string(size[0]) + "x" + std::to_string(size[1]))
+                    << std::right << std::setw(16) << differing << std::endl;
+            }
+        }
+    }
+
+    std::cout << (passed ? "Export validation passed" : "Export validation failed") << std::endl;
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        FractalUBO ubo = DefaultFractalParameters();
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t frames = 20;
+        std::string device;
+        std::vector<PaletteStop> gradient;
+        bool singleFractal = false;
+        bool validate = false;
+        bool validateInterior = false;
+        bool validateExport = false;
+        double maxMismatch = 1.0;
+        uint32_t thumbnailCount = 0;
+        uint32_t thumbnailSize = 128;
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            std::string name, value;
+            SplitOption(argument, name, value);
+
+            if (name == "--help" || name == "-h") {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            } else if (name == "--width" && !value.empty()) {
+                width = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--height" && !value.empty()) {
+                height = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--frames" && !value.empty()) {
+                frames = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+            } else if (name == "--validate") {
+                validate = true;
+            } else if (name == "--validate-interior") {
+                validateInterior = true;
+            } else if (name == "--validate-export") {
+                validateExport = true;
+            } else if (name == "--thumbnails" && !value.empty()) {
+                thumbnailCount = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--thumbnail-size" && !value.empty()) {
+                thumbnailSize = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+            } else if (name == "--max-mismatch" && !value.empty()) {
+                maxMismatch = std::stod(value);
+            } else if (name == "--device" && !value.empty()) {
+                device = value;
+            } else if (name == "--gradient" && !value.empty()) {
+                gradient = ParseGradient(value);
+                ubo.colorPalette = PALETTE_CUSTOM;
+            } else if (ParseFractalOption(name, value, ubo)) {
+                singleFractal = singleFractal || name == "--fractal";
+            } else {
+                throw std::runtime_error("Unknown command line option: " + argument);
+            }
+        }
+
+        std::vector<FractalType> fractalTypes;
+        if (singleFractal) {
+            fractalTypes.push_back(static_cast<FractalType>(ubo.fractalType));
+        } else {
+            for (int type = 0; type < FRACTAL_COUNT; type++) {
+                fractalTypes.push_back(static_cast<FractalType>(type));
+            }
+        }
+
+        // Creates a renderer per export mode itself
+        if (validateExport) {
+            return ValidateExport(device, gradient, ubo, fractalTypes, width, height) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        HeadlessRenderer renderer(device);
+        if (!gradient.empty()) {
+            renderer.SetCustomPalette(gradient);
+        }
+
+        if (validate) {
+            std::cout << "Device: " << renderer.GetDeviceName() << ", " << width << "x" << height
+                << ", " << ubo.maxIterations << " iterations" << std::endl;
+            return Validate(renderer, ubo, fractalTypes, width, height, maxMismatch) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        if (validateInterior) {
+            std::cout << "Device: " << renderer.GetDeviceName() << ", " << width << "x" << height << std::endl;
+            return ValidateInterior(renderer, ubo, width, height, maxMismatch) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        if (thumbnailCount > 0) {
+            std::cout << "Device: " << renderer.GetDeviceName() << ", " << thumbnailCount << " thumbnails of "
+                << thumbnailSize << "x" << thumbnailSize << ", " << ubo.maxIterations << " iterations, "
+                << frames << " frames" << std::endl;
+            BenchmarkThumbnails(renderer, ubo, fractalTypes, thumbnailCount, thumbnailSize, frames);
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "Device: " << renderer.GetDeviceName() << ", " << width << "x" << height
+            << ", " << ubo.maxIterations << " iterations, " << frames << " frames" << std::endl;
+
+        std::cout << std::left << std::setw(14) << "fractal" << std::right
+            << std::setw(12) << "mean ms" << std::setw(12) << "min ms" << std::setw(12) << "gpu ms"
+            << std::setw(12) << "Mpixel/s" << std::endl;
+        std::cout << std::fixed << std::setprecision(2);
+
+        double megapixels = static_cast<double>(width) * height * 1e-6;
+
+        for (FractalType type : fractalTypes) {
+            ubo.fractalType = type;
+
+            // Untimed warm-up: allocation and driver pipeline compilation
+            renderer.Render(ubo, width, height);
+
+            double totalMilliseconds = 0.0;
+            double minMilliseconds = 0.0;
+            double totalGpuMilliseconds = 0.0;
+
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                auto start = std::chrono::steady_clock::now();
+                renderer.Render(ubo, width, height);
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                totalMilliseconds += milliseconds;
+                totalGpuMilliseconds += renderer.GetLastGpuTime();
+                if (frame == 0 || milliseconds < minMilliseconds) {
+                    minMilliseconds = milliseconds;
+                }
+            }
+
+            double meanMilliseconds = totalMilliseconds / frames;
+            std::cout << std::left << std::setw(14) << GetFractalTypeName(type) << std::right
+                << std::setw(12) << meanMilliseconds
+                << std::setw(12) << minMilliseconds
+                << std::setw(12) << totalGpuMilliseconds / frames
+                << std::setw(12) << megapixels / (meanMilliseconds * 1e-3) << std::endl;
+        }
+
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,200 @@
+#include "FractalOptions.h"
+#include <stdexcept>
+
+static const char* const FRACTAL_TYPE_NAMES[FRACTAL_COUNT] = {
+    "mandelbrot", "julia", "burning-ship", "tricorn", "multibrot"
+};
+
+static const char* const PALETTE_NAMES[PALETTE_COUNT] = {
+    "rainbow", "fire", "ocean", "grayscale", "electric"
+};
+
+FractalUBO DefaultFractalParameters() {
+    FractalUBO ubo{};
+    ubo.centerX = 0.0f;
+    ubo.centerY = 0.0f;
+    ubo.scale = 1.0f;
+    ubo.aspectRatio = 1.0f;
+    ubo.fractalType = FRACTAL_MANDELBROT;
+    ubo.maxIterations = 100;
+    ubo.colorPalette = PALETTE_RAINBOW;
+    ubo.juliaConstantX = -0.7f;
+    ubo.juliaConstantY = 0.27015f;
+    ubo.multibrotPower = 3.0f;
+    return ubo;
+}
+
+void SplitOption(const std::string& argument, std::string& name, std::string& value) {
+    size_t separator = argument.find('=');
+    name = argument.substr(0, separator);
+    value = separator != std::string::npos ? argument.substr(separator + 1) : std::string();
+}
+
+FractalType ParseFractalType(const std::string& name) {
+    for (int i = 0; i < FRACTAL_COUNT; i++) {
+        if (name == FRACTAL_TYPE_NAMES[i]) {
+            return static_cast<FractalType>(i);
+        }
+    }
+    throw std::runtime_error("Unknown fractal: " + name + " (expected mandelbrot, julia, burning-ship, tricorn or multibrot)");
+}
+
+const char* GetFractalTypeName(FractalType type) {
+    return type >= 0 && type < FRACTAL_COUNT ? FRACTAL_TYPE_NAMES[type] : "unknown";
+}
+
+ColorPalette ParsePalette(const std::string& name) {
+    for (int i = 0; i < PALETTE_COUNT; i++) {
+        if (name == PALETTE_NAMES[i]) {
+            return static_cast<ColorPalette>(i);
+        }
+    }
+    if (name == "custom") {
+        return PALETTE_CUSTOM;
+    }
+    throw std::runtime_error("Unknown palette: " + name + " (expected rainbow, fire, ocean, grayscale, electric or custom)");
+}
+
+ColorMapping ParseColorMapping(const std::string& name) {
+    if (name == "linear") {
+        return COLOR_MAPPING_LINEAR;
+    } else if (name == "histogram") {
+        return COLOR_MAPPING_HISTOGRAM;
+    }
+    throw std::runtime_error("Unknown color mapping: " + name + " (expected linear or histogram)");
+}
+
+OutputChannel ParseOutputChannel(const std::string& name) {
+    if (name == "iterations") {
+        return OUTPUT_ITERATIONS;
+    } else if (name == "distance") {
+        return OUTPUT_DISTANCE;
+    }
+    throw std::runtime_error("Unknown output channel: " + name + " (expected iterations or distance)");
+}
+
+int ParseInteriorDetection(const std::string& names) {
+    if (names == "all") {
+        return INTERIOR_DETECTION_TYPES;
+    } else if (names == "none") {
+        return 0;
+    }
+
+    int types = 0;
+    size_t start = 0;
+    while (start <= names.size()) {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos) {
+            end = names.size();
+        }
+
+        FractalType type = ParseFractalType(names.substr(start, end - start));
+        if (!(INTERIOR_DETECTION_TYPES & (1 << type))) {
+            throw std::runtime_error(std::string("No interior detection for ") + GetFractalTypeName(type) +
+                " (only mandelbrot and julia)");
+        }
+        types |= 1 << type;
+        start = end + 1;
+    }
+    return types;
+}
+
+ExportMode ParseExportMode(const std::string& name) {
+    if (name == "auto") {
+        return EXPORT_MODE_AUTO;
+    } else if (name == "staging") {
+        return EXPORT_MODE_STAGING;
+    } else if (name == "host-visible") {
+        return EXPORT_MODE_HOST_VISIBLE;
+    }
+    throw std::runtime_error("Unknown export mode: " + name + " (expected auto, staging or host-visible)");
+}
+
+IterationPrecision ParseIterationPrecision(const std::string& name) {
+    if (name == "float32") {
+        return ITERATION_PRECISION_FLOAT32;
+    } else if (name == "float16") {
+        return ITERATION_PRECISION_FLOAT16;
+    }
+    throw std::runtime_error("Unknown raw precision: " + name + " (expected float32 or float16)");
+}
+
+IterationCompression ParseIterationCompression(const std::string& name) {
+    if (name == "none") {
+        return ITERATION_COMPRESSION_NONE;
+    } else if (name == "rle") {
+        return ITERATION_COMPRESSION_RLE;
+    }
+    throw std::runtime_error("Unknown raw compression: " + name + " (expected none or rle)");
+}
+
+bool ParseFractalOption(const std::string& name, const std::string& value, FractalUBO& ubo) {
+    if (value.empty()) {
+        return false;
+    }
+
+    if (name == "--fractal") {
+        ubo.fractalType = ParseFractalType(value);
+    } else if (name == "--palette") {
+        ubo.colorPalette = ParsePalette(value);
+    } else if (name == "--center-x") {
+        ubo.centerX = std::stof(value);
+    } else if (name == "--center-y") {
+        ubo.centerY = std::stof(value);
+    } else if (name == "--zoom") {
+        // Same convention as FractalRenderer::SetZoom
+        ubo.scale = 1.0f / std::stof(value);
+    } else if (name == "--iterations") {
+        ubo.maxIterations = std::stoi(value);
+    } else if (name == "--julia-x") {
+        ubo.juliaConstantX = std::stof(value);
+    } else if (name == "--julia-y") {
+        ubo.juliaConstantY = std::stof(value);
+    } else if (name == "--power") {
+        ubo.multibrotPower = std::stof(value);
+    } else if (name == "--color-offset") {
+        ubo.colorOffset = std::stof(value);
+    } else if (name == "--color-mapping") {
+        ubo.colorMapping = ParseColorMapping(value);
+    } else if (name == "--output-channel") {
+        ubo.outputChannel = ParseOutputChannel(value);
+    } else if (name == "--interior-detection") {
+        ubo.interiorDetection = ParseInteriorDetection(value);
+    } else if (name == "--antialias") {
+        ubo.antialiasSamples = std::stoi(value);
+        if (ubo.antialiasSamples < 0 || ubo.antialiasSamples > MAX_ANTIALIAS_SAMPLES) {
+            throw std::runtime_error("--antialias takes 0 to " + std::to_string(MAX_ANTIALIAS_SAMPLES) + " samples");
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+const char* GetFractalOptionsHelp() {
+    return
+        "  --fractal=NAME      mandelbrot, julia, burning-ship, tricorn or multibrot\n"
+        "  --palette=NAME      rainbow, fire, ocean, grayscale, electric or custom\n"
+        "  --gradient=STOPS    custom palette as position:RRGGBB stops, e.g.\n"
+        "                      0:000000,0.5:ff8000,1:ffffff (implies --palette=custom)\n"
+        "  --center-x=X        view center, real part (default 0)\n"
+        "  --center-y=Y        view center, imaginary part (default 0)\n"
+        "  --zoom=Z            zoom factor (default 1)\n"
+        "  --iterations=N      maximum iteration count (default 100)\n"
+        "  --julia-x=X         Julia constant, real part (default -0.7)\n"
+        "  --julia-y=Y         Julia constant, imaginary part (default 0.27015)\n"
+        "  --power=P           Multibrot exponent (default 3)\n"
+        "  --color-offset=O    shift the palette along the iteration count, one\n"
+        "                      cycle per 1.0 (default 0)\n"
+        "  --color-mapping=M   linear (iteration count, the default) or histogram\n"
+        "                      (equalized so each color covers a similar area)\n"
+        "  --output-channel=C  iterations (smooth escape counts, the default) or\n"
+        "                      distance (exterior distance estimates, sharp edges)\n"
+        "  --interior-detection=T  stop iterating once an orbit is caught by an\n"
+        "                      attracting cycle, for all, none (the default) or a\n"
+        "                      comma-separated list of mandelbrot and julia\n"
+        "  --antialias=N       take N samples for pixels on edges, found from their\n"
+        "                      neighbours, and one elsewhere (up to 64, default off)\n"
+        "  --device=NAME       device index or name substring (default: VFR_DEVICE, then best score)\n";
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include "HeadlessRenderer.h"
+#include "IterationFile.h"
+#include <string>
+#include <cstdint>
+
+// Command line handling shared by the headless tools
+
+// The windowed renderer's initial view: Mandelbrot, rainbow palette, 100 iterations
+FractalUBO DefaultFractalParameters();
+
+// Split "--name=value" into name and value (empty for plain flags)
+void SplitOption(const std::string& argument, std::string& name, std::string& value);
+
+// Apply a fractal parameter option (--fractal, --palette, --center-x,
+// --center-y, --zoom, --iterations, --julia-x, --julia-y, --power,
+// --color-offset, --color-mapping).
+// Returns false if name is not one of them.
+bool ParseFractalOption(const std::string& name, const std::string& value, FractalUBO& ubo);
+
+// Command line names of fractal types, e.g. "burning-ship", and palettes
+// ("custom" is the gradient given with --gradient)
+FractalType ParseFractalType(const std::string& name);
+const char* GetFractalTypeName(FractalType type);
+ColorPalette ParsePalette(const std::string& name);
+
+// --color-mapping values: linear or histogram
+ColorMapping ParseColorMapping(const std::string& name);
+
+// --output-channel values: iterations or distance
+OutputChannel ParseOutputChannel(const std::string& name);
+
+// --interior-detection values: all, none or comma-separated fractal type
+// names, as a FractalUBO::interiorDetection bit mask. Throws on types
+// without interior detection.
+int ParseInteriorDetection(const std::string& names);
+
+// --export values: auto, staging or host-visible
+ExportMode ParseExportMode(const std::string& name);
+
+// --raw-precision values: float32 or float16
+IterationPrecision ParseIterationPrecision(const std::string& name);
+
+// --raw-compression values: none or rle
+IterationCompression ParseIterationCompression(const std::string& name);
+
+// Usage text for the fractal parameter options
+const char* GetFractalOptionsHelp();
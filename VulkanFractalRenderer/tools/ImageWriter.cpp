@@ -0,0 +1,54 @@
+#include "ImageWriter.h"
+#include <stdexcept>
+
+void WritePpm(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height) {
+    PpmWriter writer(path, width, height);
+    writer.WriteRows(pixels, height);
+    writer.Finish();
+}
+
+PpmWriter::PpmWriter(const std::string& path, uint32_t width, uint32_t height)
+    : m_path(path)
+    , m_width(width)
+    , m_height(height)
+    , m_rowsWritten(0)
+    , m_row(static_cast<size_t>(width) * 3) {
+    m_file.open(path, std::ios::binary);
+    if (!m_file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+
+    m_file << "P6\n" << width << " " << height << "\n255\n";
+}
+
+void PpmWriter::WriteRows(const uint8_t* pixels, uint32_t rowCount) {
+    if (rowCount > m_height - m_rowsWritten) {
+        throw std::runtime_error("More rows than the image has!");
+    }
+
+    for (uint32_t y = 0; y < rowCount; y++) {
+        const uint8_t* source = pixels + static_cast<size_t>(y) * m_width * 4;
+        for (uint32_t x = 0; x < m_width; x++) {
+            m_row[x * 3 + 0] = static_cast<char>(source[x * 4 + 0]);
+            m_row[x * 3 + 1] = static_cast<char>(source[x * 4 + 1]);
+            m_row[x * 3 + 2] = static_cast<char>(source[x * 4 + 2]);
+        }
+        m_file.write(m_row.data(), m_row.size());
+    }
+    m_rowsWritten += rowCount;
+
+    if (!m_file) {
+        throw std::runtime_error("Failed to write output file: " + m_path);
+    }
+}
+
+void PpmWriter::Finish() {
+    if (m_rowsWritten != m_height) {
+        throw std::runtime_error("Image finished before every row was written!");
+    }
+
+    m_file.close();
+    if (!m_file) {
+        throw std::runtime_error("Failed to write output file: " + m_path);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+// Write width * height RGBA8 pixels, top row first, as a binary PPM
+// (alpha is dropped). Throws on I/O errors.
+void WritePpm(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height);
+
+// WritePpm a band of rows at a time, for images that are never whole in
+// memory. Throws on I/O errors.
+class PpmWriter {
+public:
+    PpmWriter(const std::string& path, uint32_t width, uint32_t height);
+
+    // Delete copy constructors
+    PpmWriter(const PpmWriter&) = delete;
+    PpmWriter& operator=(const PpmWriter&) = delete;
+
+    // Append rowCount rows of width RGBA8 pixels
+    void WriteRows(const uint8_t* pixels, uint32_t rowCount);
+
+    // Flush and close the file. Throws if rows are missing.
+    void Finish();
+
+private:
+    std::string m_path;
+    std::ofstream m_file;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_rowsWritten;
+    std::vector<char> m_row;
+};
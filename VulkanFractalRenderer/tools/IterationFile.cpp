@@ -0,0 +1,326 @@
+#include "IterationFile.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+static_assert(sizeof(IterationFileHeader) == 40 + sizeof(FractalUBO), "Iteration file header must not be padded");
+static_assert(sizeof(IterationTileEntry) == 16, "Iteration tile entries must not be padded");
+
+// Half float conversion, rounding to nearest. Iteration counts and distances
+// are finite and non-negative; values beyond the half range become infinity.
+static uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = (mantissa >> shift) + ((mantissa >> (shift - 1)) & 1);
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1;
+    return static_cast<uint16_t>(sign | half);
+}
+
+static float HalfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        // Subnormal: normalize into a float exponent
+        exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    } else {
+        bits = sign;
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static size_t GetSampleSize(IterationPrecision precision) {
+    return precision == ITERATION_PRECISION_FLOAT16 ? sizeof(uint16_t) : sizeof(float);
+}
+
+// Shortest run worth a repeat packet; shorter ones go into literals
+constexpr size_t MIN_RUN = 3;
+// Longest literal or run of one packet
+constexpr size_t MAX_PACKET = 128;
+
+// PackBits: a control byte c below 128 starts c + 1 literal bytes, one above
+// 128 repeats the next byte 257 - c times
+static void PackBits(const uint8_t* data, size_t size, std::vector<uint8_t>& encoded) {
+    size_t i = 0;
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && run < MAX_PACKET && data[i + run] == data[i]) {
+            run++;
+        }
+
+        if (run >= MIN_RUN) {
+            encoded.push_back(static_cast<uint8_t>(257 - run));
+            encoded.push_back(data[i]);
+            i += run;
+            continue;
+        }
+
+        // Literals up to the next run worth a packet
+        size_t end = i;
+        while (end < size && end - i < MAX_PACKET &&
+            !(end + MIN_RUN <= size && data[end] == data[end + 1] && data[end] == data[end + 2])) {
+            end++;
+        }
+        encoded.push_back(static_cast<uint8_t>(end - i - 1));
+        encoded.insert(encoded.end(), data + i, data + end);
+        i = end;
+    }
+}
+
+static void UnpackBits(const uint8_t* data, size_t size, uint8_t* decoded, size_t decodedSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        uint8_t control = data[in++];
+        if (control < 128) {
+            size_t count = static_cast<size_t>(control) + 1;
+            if (in + count > size || out + count > decodedSize) {
+                throw std::runtime_error("Corrupt iteration tile!");
+            }
+            memcpy(decoded + out, data + in, count);
+            in += count;
+            out += count;
+        } else if (control > 128) {
+            size_t count = 257 - static_cast<size_t>(control);
+            if (in >= size || out + count > decodedSize) {
+                throw std::runtime_error("Corrupt iteration tile!");
+            }
+            memset(decoded + out, data[in++], count);
+            out += count;
+        }
+    }
+
+    if (out != decodedSize) {
+        throw std::runtime_error("Corrupt iteration tile!");
+    }
+}
+
+uint32_t GetIterationTileCount(uint32_t size, uint32_t tileSize) {
+    return (size + tileSize - 1) / tileSize;
+}
+
+void EncodeIterationTile(const float* values, size_t count, IterationPrecision precision,
+    IterationCompression compression, std::vector<uint8_t>& encoded, uint32_t& encoding) {
+    size_t sampleSize = GetSampleSize(precision);
+    std::vector<uint8_t> raw(count * sampleSize);
+    if (precision == ITERATION_PRECISION_FLOAT16) {
+        for (size_t i = 0; i < count; i++) {
+            uint16_t half = FloatToHalf(values[i]);
+            memcpy(raw.data() + i * sizeof(half), &half, sizeof(half));
+        }
+    } else {
+        memcpy(raw.data(), values, raw.size());
+    }
+
+    encoded.clear();
+    encoding = ITERATION_COMPRESSION_NONE;
+    if (compression == ITERATION_COMPRESSION_RLE) {
+        // Byte planes: the bytes of neighbouring values that rarely differ
+        // end up next to each other
+        std::vector<uint8_t> planes(raw.size());
+        for (size_t i = 0; i < count; i++) {
+            for (size_t byte = 0; byte < sampleSize; byte++) {
+                planes[byte * count + i] = raw[i * sampleSize + byte];
+            }
+        }
+
+        PackBits(planes.data(), planes.size(), encoded);
+        if (encoded.size() < raw.size()) {
+            encoding = ITERATION_COMPRESSION_RLE;
+            return;
+        }
+    }
+
+    encoded = std::move(raw);
+}
+
+void DecodeIterationTile(const uint8_t* data, size_t size, uint32_t encoding, IterationPrecision precision,
+    size_t count, float* values) {
+    size_t sampleSize = GetSampleSize(precision);
+    std::vector<uint8_t> raw;
+    const uint8_t* samples = data;
+
+    if (encoding == ITERATION_COMPRESSION_RLE) {
+        std::vector<uint8_t> planes(count * sampleSize);
+        UnpackBits(data, size, planes.data(), planes.size());
+
+        raw.resize(planes.size());
+        for (size_t i = 0; i < count; i++) {
+            for (size_t byte = 0; byte < sampleSize; byte++) {
+                raw[i * sampleSize + byte] = planes[byte * count + i];
+            }
+        }
+        samples = raw.data();
+    } else if (encoding != ITERATION_COMPRESSION_NONE || size != count * sampleSize) {
+        throw std::runtime_error("Corrupt iteration tile!");
+    }
+
+    if (precision == ITERATION_PRECISION_FLOAT16) {
+        for (size_t i = 0; i < count; i++) {
+            uint16_t half;
+            memcpy(&half, samples + i * sizeof(half), sizeof(half));
+            values[i] = HalfToFloat(half);
+        }
+    } else {
+        memcpy(values, samples, count * sizeof(float));
+    }
+}
+
+IterationFileWriter::IterationFileWriter(const std::string& path, const FractalUBO& parameters, uint32_t width,
+    uint32_t height, IterationPrecision precision, IterationCompression compression, uint32_t tileSize)
+    : m_path(path)
+    , m_header{}
+    , m_bufferedRows(0)
+    , m_rowsWritten(0)
+    , m_fileSize(0) {
+    if (width == 0 || height == 0 || tileSize == 0) {
+        throw std::runtime_error("Iteration files need an image and tiles of at least 1x1!");
+    }
+    if (tileSize > MAX_ITERATION_TILE_SIZE) {
+        throw std::runtime_error("Iteration file tiles must be at most " + std::to_string(MAX_ITERATION_TILE_SIZE) +
+            " pixels wide!");
+    }
+    if (static_cast<uint32_t>(precision) >= ITERATION_PRECISION_COUNT ||
+        static_cast<uint32_t>(compression) >= ITERATION_COMPRESSION_COUNT) {
+        throw std::runtime_error("Unknown iteration file precision or compression!");
+    }
+    if (precision == ITERATION_PRECISION_FLOAT16 && parameters.outputChannel == OUTPUT_ITERATIONS &&
+        parameters.maxIterations > 65504) {
+        throw std::runtime_error("Iteration counts above 65504 do not fit half precision!");
+    }
+
+    memcpy(m_header.magic, ITERATION_FILE_MAGIC, sizeof(ITERATION_FILE_MAGIC));
+    m_header.version = ITERATION_FILE_VERSION;
+    m_header.parametersSize = sizeof(FractalUBO);
+    m_header.width = width;
+    m_header.height = height;
+    m_header.tileSize = tileSize;
+    m_header.precision = precision;
+    m_header.compression = compression;
+    m_header.parameters = parameters;
+    m_header.parameters.projection = PROJECTION_PLANE;
+    m_header.parameters.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    m_header.parameters.imageWidth = static_cast<int>(width);
+    m_header.parameters.imageHeight = static_cast<int>(height);
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+
+    // The index is rewritten by Finish; until then it stays zero, which no
+    // reader accepts
+    m_index.resize(static_cast<size_t>(GetIterationTileCount(width, tileSize)) * GetIterationTileCount(height, tileSize));
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_file.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(IterationTileEntry));
+    m_fileSize = sizeof(m_header) + m_index.size() * sizeof(IterationTileEntry);
+
+    m_rows.resize(static_cast<size_t>(width) * std::min(tileSize, height));
+    m_tile.reserve(static_cast<size_t>(tileSize) * tileSize);
+}
+
+void IterationFileWriter::WriteRows(const float* rows, uint32_t rowCount) {
+    const uint32_t width = m_header.width;
+    const uint32_t tileSize = m_header.tileSize;
+    if (rowCount > m_header.height - m_rowsWritten - m_bufferedRows) {
+        throw std::runtime_error("More rows than the iteration file's image has!");
+    }
+
+    // Rows are buffered until they complete a row of tiles
+    while (rowCount > 0) {
+        uint32_t tileRowHeight = std::min(tileSize, m_header.height - m_rowsWritten);
+        uint32_t count = std::min(rowCount, tileRowHeight - m_bufferedRows);
+        memcpy(m_rows.data() + static_cast<size_t>(m_bufferedRows) * width, rows,
+            static_cast<size_t>(count) * width * sizeof(float));
+
+        rows += static_cast<size_t>(count) * width;
+        rowCount -= count;
+        m_bufferedRows += count;
+        if (m_bufferedRows == tileRowHeight) {
+            WriteTileRow();
+        }
+    }
+}
+
+void IterationFileWriter::WriteTileRow() {
+    const uint32_t width = m_header.width;
+    const uint32_t tileSize = m_header.tileSize;
+    const uint32_t tilesX = GetIterationTileCount(width, tileSize);
+    const uint32_t tileY = m_rowsWritten / tileSize;
+    const uint32_t tileHeight = m_bufferedRows;
+
+    for (uint32_t tileX = 0; tileX < tilesX; tileX++) {
+        uint32_t x = tileX * tileSize;
+        uint32_t tileWidth = std::min(tileSize, width - x);
+
+        m_tile.clear();
+        for (uint32_t row = 0; row < tileHeight; row++) {
+            const float* source = m_rows.data() + static_cast<size_t>(row) * width + x;
+            m_tile.insert(m_tile.end(), source, source + tileWidth);
+        }
+
+        uint32_t encoding;
+        EncodeIterationTile(m_tile.data(), m_tile.size(), static_cast<IterationPrecision>(m_header.precision),
+            static_cast<IterationCompression>(m_header.compression), m_encoded, encoding);
+        m_file.write(reinterpret_cast<const char*>(m_encoded.data()), m_encoded.size());
+
+        IterationTileEntry& entry = m_index[static_cast<size_t>(tileY) * tilesX + tileX];
+        entry.offset = m_fileSize;
+        entry.size = static_cast<uint32_t>(m_encoded.size());
+        entry.encoding = encoding;
+        m_fileSize += m_encoded.size();
+    }
+
+    if (!m_file) {
+        throw std::runtime_error("Failed to write output file: " + m_path);
+    }
+
+    m_rowsWritten += tileHeight;
+    m_bufferedRows = 0;
+}
+
+void IterationFileWriter::Finish() {
+    if (m_rowsWritten != m_header.height) {
+        throw std::runtime_error("Iteration file finished before every row was written!");
+    }
+
+    m_file.seekp(sizeof(m_header));
+    m_file.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(IterationTileEntry));
+    m_file.close();
+    if (!m_file) {
+        throw std::runtime_error("Failed to write output file: " + m_path);
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+// Raw iteration buffers on disk (.vfri): the output channel of a render as
+// floats, for recoloring, re-equalizing and comparing renders without
+// rendering them again. The file starts with an IterationFileHeader holding
+// the FractalUBO the buffer was rendered with, then an index with one
+// IterationTileEntry per tile, row by row, then the tiles. The image is cut
+// into square tiles of tileSize pixels (smaller at the right and bottom
+// edges), each stored row-major and encoded on its own, so a reader can
+// decode any tile without touching the rest of the file. Little-endian, as
+// written by the hosts this builds on.
+
+// Sample format of the stored values
+enum IterationPrecision {
+    // Exactly the floats the iteration pass wrote
+    ITERATION_PRECISION_FLOAT32 = 0,
+    // IEEE half floats: half the size, about three significant digits. The
+    // fraction of smooth counts is lost above 2048 iterations, and counts
+    // above 65504 do not fit.
+    ITERATION_PRECISION_FLOAT16,
+    ITERATION_PRECISION_COUNT
+};
+
+// Tile encodings
+enum IterationCompression {
+    ITERATION_COMPRESSION_NONE = 0,
+    // The bytes of each value split into planes (all first bytes, then all
+    // second bytes...), each plane run-length encoded. Interior regions and
+    // the exponent and high mantissa bytes of smooth counts form long runs;
+    // tiles that would not shrink are stored as they are.
+    ITERATION_COMPRESSION_RLE,
+    ITERATION_COMPRESSION_COUNT
+};
+
+constexpr char ITERATION_FILE_MAGIC[8] = { 'V', 'F', 'R', 'I', 'T', 'E', 'R', '1' };
+constexpr uint32_t ITERATION_FILE_VERSION = 1;
+constexpr uint32_t DEFAULT_ITERATION_TILE_SIZE = 256;
+// Largest tile side: an uncompressed float32 tile of it (64 MiB) leaves
+// IterationTileEntry::size far from its 32-bit limit
+constexpr uint32_t MAX_ITERATION_TILE_SIZE = 4096;
+
+struct IterationFileHeader {
+    char magic[8];
+    uint32_t version;
+    // sizeof(FractalUBO) when written, so files from builds with another
+    // parameter layout are rejected instead of misread
+    uint32_t parametersSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    // IterationPrecision
+    uint32_t precision;
+    // IterationCompression the tiles were written with; each tile records
+    // whether it is actually compressed
+    uint32_t compression;
+    uint32_t reserved;
+    // The render's parameters, including the image size and the output
+    // channel the values are in
+    FractalUBO parameters;
+};
+
+struct IterationTileEntry {
+    // From the start of the file
+    uint64_t offset;
+    uint32_t size;
+    // ITERATION_COMPRESSION_NONE or ITERATION_COMPRESSION_RLE
+    uint32_t encoding;
+};
+
+// Tiles per row and column of an image
+uint32_t GetIterationTileCount(uint32_t size, uint32_t tileSize);
+
+// Encode count values in precision, with compression if it helps; sets
+// encoding to what was used
+void EncodeIterationTile(const float* values, size_t count, IterationPrecision precision,
+    IterationCompression compression, std::vector<uint8_t>& encoded, uint32_t& encoding);
+
+// Decode a tile of count values. Throws if the data does not hold exactly
+// that many.
+void DecodeIterationTile(const uint8_t* data, size_t size, uint32_t encoding, IterationPrecision precision,
+    size_t count, float* values);
+
+// Writes an iteration file from rows of values as they arrive, typically
+// the bands of HeadlessRenderer::RenderIterationBands, holding no more than
+// one row of tiles in memory. Throws on I/O errors.
+class IterationFileWriter {
+public:
+    // The image size fields of parameters are set to width and height, as
+    // the renderer fills them in. tileSize is at most MAX_ITERATION_TILE_SIZE.
+    IterationFileWriter(const std::string& path, const FractalUBO& parameters, uint32_t width, uint32_t height,
+        IterationPrecision precision = ITERATION_PRECISION_FLOAT32,
+        IterationCompression compression = ITERATION_COMPRESSION_RLE,
+        uint32_t tileSize = DEFAULT_ITERATION_TILE_SIZE);
+
+    // Delete copy constructors
+    IterationFileWriter(const IterationFileWriter&) = delete;
+    IterationFileWriter& operator=(const IterationFileWriter&) = delete;
+
+    // Append rowCount rows of width values, continuing where the last call
+    // stopped
+    void WriteRows(const float* rows, uint32_t rowCount);
+
+    // Write the index once every row has arrived. Throws if rows are
+    // missing; a file that is never finished has an empty index and is
+    // rejected by readers.
+    void Finish();
+
+    // Bytes written so far
+    uint64_t GetFileSize() const { return m_fileSize; }
+
+private:
+    // Encode and write the tiles of the buffered row of tiles
+    void WriteTileRow();
+
+    std::string m_path;
+    std::ofstream m_file;
+    IterationFileHeader m_header;
+    std::vector<IterationTileEntry> m_index;
+
+    // Rows of the current row of tiles received so far
+    std::vector<float> m_rows;
+    uint32_t m_bufferedRows;
+    uint32_t m_rowsWritten;
+    uint64_t m_fileSize;
+
+    std::vector<float> m_tile;
+    std::vector<uint8_t> m_encoded;
+};
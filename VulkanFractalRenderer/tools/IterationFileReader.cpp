@@ -0,0 +1,129 @@
+#include "IterationFileReader.h"
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+IterationFileReader::IterationFileReader(const std::string& path)
+    : m_fd(-1)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_header{}
+    , m_index(nullptr)
+    , m_tilesX(0)
+    , m_tilesY(0) {
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        throw std::runtime_error("Failed to open iteration file " + path + ": " + strerror(errno));
+    }
+
+    struct stat status;
+    if (fstat(m_fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(IterationFileHeader)) {
+        close(m_fd);
+        throw std::runtime_error("Not an iteration file: " + path);
+    }
+    m_size = static_cast<size_t>(status.st_size);
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        close(m_fd);
+        throw std::runtime_error("Failed to map iteration file " + path + ": " + strerror(errno));
+    }
+    m_data = static_cast<const uint8_t*>(data);
+
+    try {
+        memcpy(&m_header, m_data, sizeof(m_header));
+        if (memcmp(m_header.magic, ITERATION_FILE_MAGIC, sizeof(ITERATION_FILE_MAGIC)) != 0) {
+            throw std::runtime_error("Not an iteration file: " + path);
+        }
+        if (m_header.version != ITERATION_FILE_VERSION || m_header.parametersSize != sizeof(FractalUBO)) {
+            throw std::runtime_error("Iteration file " + path + " was written by an incompatible version!");
+        }
+        if (m_header.width == 0 || m_header.height == 0 ||
+            m_header.tileSize == 0 || m_header.tileSize > MAX_ITERATION_TILE_SIZE ||
+            m_header.precision >= ITERATION_PRECISION_COUNT || m_header.compression >= ITERATION_COMPRESSION_COUNT) {
+            throw std::runtime_error("Corrupt iteration file header: " + path);
+        }
+
+        m_tilesX = GetIterationTileCount(m_header.width, m_header.tileSize);
+        m_tilesY = GetIterationTileCount(m_header.height, m_header.tileSize);
+        size_t indexSize = static_cast<size_t>(m_tilesX) * m_tilesY * sizeof(IterationTileEntry);
+        size_t dataStart = sizeof(m_header) + indexSize;
+        if (m_size < dataStart) {
+            throw std::runtime_error("Truncated iteration file: " + path);
+        }
+
+        // Tiles point past the index and inside the file; an unfinished
+        // file still has its zeroed index
+        m_index = reinterpret_cast<const IterationTileEntry*>(m_data + sizeof(m_header));
+        for (size_t i = 0; i < static_cast<size_t>(m_tilesX) * m_tilesY; i++) {
+            const IterationTileEntry& entry = m_index[i];
+            if (entry.offset < dataStart || entry.offset > m_size || entry.size > m_size - entry.offset ||
+                entry.encoding >= ITERATION_COMPRESSION_COUNT) {
+                throw std::runtime_error("Unfinished or corrupt iteration file: " + path);
+            }
+        }
+    }
+    catch (...) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        close(m_fd);
+        throw;
+    }
+}
+
+IterationFileReader::~IterationFileReader() {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+    close(m_fd);
+}
+
+const IterationTileEntry& IterationFileReader::GetTileEntry(uint32_t tileX, uint32_t tileY) const {
+    if (tileX >= m_tilesX || tileY >= m_tilesY) {
+        throw std::runtime_error("Tile outside the iteration file!");
+    }
+    return m_index[static_cast<size_t>(tileY) * m_tilesX + tileX];
+}
+
+void IterationFileReader::ReadTile(uint32_t tileX, uint32_t tileY, float* destination,
+    uint32_t& tileWidth, uint32_t& tileHeight) const {
+    const IterationTileEntry& entry = GetTileEntry(tileX, tileY);
+    tileWidth = std::min(m_header.tileSize, m_header.width - tileX * m_header.tileSize);
+    tileHeight = std::min(m_header.tileSize, m_header.height - tileY * m_header.tileSize);
+
+    DecodeIterationTile(m_data + entry.offset, entry.size, entry.encoding,
+        static_cast<IterationPrecision>(m_header.precision), static_cast<size_t>(tileWidth) * tileHeight, destination);
+}
+
+void IterationFileReader::ReadRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, float* destination) const {
+    if (x > m_header.width || width > m_header.width - x || y > m_header.height || height > m_header.height - y) {
+        throw std::runtime_error("Region outside the iteration file!");
+    }
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    const uint32_t tileSize = m_header.tileSize;
+    std::vector<float> tile(static_cast<size_t>(tileSize) * tileSize);
+    for (uint32_t tileY = y / tileSize; tileY <= (y + height - 1) / tileSize; tileY++) {
+        for (uint32_t tileX = x / tileSize; tileX <= (x + width - 1) / tileSize; tileX++) {
+            uint32_t tileWidth, tileHeight;
+            ReadTile(tileX, tileY, tile.data(), tileWidth, tileHeight);
+
+            // Overlap of the tile and the region, in image pixels
+            uint32_t left = std::max(x, tileX * tileSize);
+            uint32_t right = std::min(x + width, tileX * tileSize + tileWidth);
+            uint32_t top = std::max(y, tileY * tileSize);
+            uint32_t bottom = std::min(y + height, tileY * tileSize + tileHeight);
+            for (uint32_t row = top; row < bottom; row++) {
+                memcpy(destination + static_cast<size_t>(row - y) * width + (left - x),
+                    tile.data() + static_cast<size_t>(row - tileY * tileSize) * tileWidth + (left - tileX * tileSize),
+                    static_cast<size_t>(right - left) * sizeof(float));
+            }
+        }
+    }
+}
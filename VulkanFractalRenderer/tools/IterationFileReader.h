@@ -0,0 +1,56 @@
+#pragma once
+
+#include "IterationFile.h"
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Random access to an iteration file (see IterationFile.h). The file is
+// memory-mapped once and its header and index checked; reading a region
+// decodes only the tiles it overlaps, so tools can work through images far
+// larger than memory a tile row at a time. Reads may run on several
+// threads at once. POSIX only (mmap).
+class IterationFileReader {
+public:
+    // Throws if the file cannot be mapped, is not a finished iteration file
+    // or was written with another FractalUBO layout
+    explicit IterationFileReader(const std::string& path);
+    ~IterationFileReader();
+
+    // Delete copy constructors
+    IterationFileReader(const IterationFileReader&) = delete;
+    IterationFileReader& operator=(const IterationFileReader&) = delete;
+
+    const IterationFileHeader& GetHeader() const { return m_header; }
+    uint32_t GetWidth() const { return m_header.width; }
+    uint32_t GetHeight() const { return m_header.height; }
+    // The render's parameters; imageWidth and imageHeight are the size of
+    // the whole image
+    const FractalUBO& GetParameters() const { return m_header.parameters; }
+
+    uint32_t GetTilesX() const { return m_tilesX; }
+    uint32_t GetTilesY() const { return m_tilesY; }
+    const IterationTileEntry& GetTileEntry(uint32_t tileX, uint32_t tileY) const;
+
+    // Decode one tile, row-major, into destination, which has room for
+    // tileSize * tileSize values; edge tiles are narrower or shorter. Sets
+    // the tile's size in pixels.
+    void ReadTile(uint32_t tileX, uint32_t tileY, float* destination, uint32_t& tileWidth, uint32_t& tileHeight) const;
+
+    // Decode the region of width * height values at (x, y), row-major, into
+    // destination. Throws if the region leaves the image.
+    void ReadRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height, float* destination) const;
+
+    // Total size of the file in bytes
+    size_t GetFileSize() const { return m_size; }
+
+private:
+    int m_fd;
+    const uint8_t* m_data;
+    size_t m_size;
+
+    IterationFileHeader m_header;
+    const IterationTileEntry* m_index;
+    uint32_t m_tilesX;
+    uint32_t m_tilesY;
+};
@@ -0,0 +1,311 @@
+#include "JobFile.h"
+#include "FractalOptions.h"
+#include <fstream>
+#include <stdexcept>
+#include <cctype>
+
+static bool IsNumber(const std::string& value) {
+    size_t parsed = 0;
+    try {
+        std::stod(value, &parsed);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return parsed == value.size();
+}
+
+static std::string Trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return std::string();
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+// Set one field of a job from its text value
+static void ApplyJobField(const std::string& name, const std::string& value, RenderJob& job) {
+    FractalUBO& ubo = job.parameters;
+
+    if (name == "width") {
+        job.width = static_cast<uint32_t>(std::stoul(value));
+    } else if (name == "height") {
+        job.height = static_cast<uint32_t>(std::stoul(value));
+    } else if (name == "output") {
+        job.output = value;
+    } else if (name == "centerX") {
+        ubo.centerX = std::stof(value);
+    } else if (name == "centerY") {
+        ubo.centerY = std::stof(value);
+    } else if (name == "scale") {
+        ubo.scale = std::stof(value);
+    } else if (name == "fractalType") {
+        ubo.fractalType = IsNumber(value) ? std::stoi(value) : ParseFractalType(value);
+    } else if (name == "maxIterations") {
+        ubo.maxIterations = std::stoi(value);
+    } else if (name == "colorPalette") {
+        ubo.colorPalette = IsNumber(value) ? std::stoi(value) : ParsePalette(value);
+    } else if (name == "juliaConstantX") {
+        ubo.juliaConstantX = std::stof(value);
+    } else if (name == "juliaConstantY") {
+        ubo.juliaConstantY = std::stof(value);
+    } else if (name == "multibrotPower") {
+        ubo.multibrotPower = std::stof(value);
+    } else if (name == "colorOffset") {
+        ubo.colorOffset = std::stof(value);
+    } else if (name == "colorMapping") {
+        ubo.colorMapping = IsNumber(value) ? std::stoi(value) : ParseColorMapping(value);
+    } else if (name == "outputChannel") {
+        ubo.outputChannel = IsNumber(value) ? std::stoi(value) : ParseOutputChannel(value);
+    } else if (name == "interiorDetection") {
+        ubo.interiorDetection = IsNumber(value) ? std::stoi(value) : ParseInteriorDetection(value);
+    } else if (name == "antialiasSamples") {
+        ubo.antialiasSamples = std::stoi(value);
+    } else if (!ParseFractalOption("--" + name, value, ubo)) {
+        throw std::runtime_error("Unknown job field: " + name);
+    }
+
+    if (ubo.fractalType < 0 || ubo.fractalType >= FRACTAL_COUNT) {
+        throw std::runtime_error("Fractal type out of range: " + value);
+    }
+    if (ubo.colorPalette < 0 || ubo.colorPalette > PALETTE_CUSTOM) {
+        throw std::runtime_error("Color palette out of range: " + value);
+    }
+    if (ubo.colorMapping < 0 || ubo.colorMapping >= COLOR_MAPPING_COUNT) {
+        throw std::runtime_error("Color mapping out of range: " + value);
+    }
+    if (ubo.outputChannel < 0 || ubo.outputChannel >= OUTPUT_COUNT) {
+        throw std::runtime_error("Output channel out of range: " + value);
+    }
+    if (ubo.antialiasSamples < 0 || ubo.antialiasSamples > MAX_ANTIALIAS_SAMPLES) {
+        throw std::runtime_error("Anti-aliasing samples out of range: " + value);
+    }
+    if (ubo.interiorDetection & ~INTERIOR_DETECTION_TYPES) {
+        throw std::runtime_error("Interior detection out of range: " + value);
+    }
+}
+
+// Split a CSV line at commas and trim each field
+static std::vector<std::string> SplitCsvLine(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(Trim(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start)));
+        if (comma == std::string::npos) {
+            return fields;
+        }
+        start = comma + 1;
+    }
+}
+
+// Minimal reader for one flat JSON object: string keys, string or number
+// values. null values are skipped, nested objects and arrays are rejected.
+class JsonLineReader {
+public:
+    explicit JsonLineReader(const std::string& line) : m_line(line), m_position(0) {}
+
+    template <typename Callback>
+    void ReadObject(Callback onField) {
+        Expect('{');
+        SkipWhitespace();
+        if (Peek() == '}') {
+            m_position++;
+            ExpectEnd();
+            return;
+        }
+
+        while (true) {
+            std::string name = ReadString();
+            Expect(':');
+            SkipWhitespace();
+
+            if (Peek() == '"') {
+                onField(name, ReadString());
+            } else {
+                std::string literal = ReadLiteral();
+                if (literal != "null") {
+                    onField(name, literal);
+                }
+            }
+
+            SkipWhitespace();
+            char separator = Next();
+            if (separator == '}') {
+                break;
+            }
+            if (separator != ',') {
+                throw std::runtime_error("Expected ',' or '}' in JSON object");
+            }
+        }
+
+        ExpectEnd();
+    }
+
+private:
+    void SkipWhitespace() {
+        while (m_position < m_line.size() && std::isspace(static_cast<unsigned char>(m_line[m_position]))) {
+            m_position++;
+        }
+    }
+
+    char Peek() const {
+        return m_position < m_line.size() ? m_line[m_position] : '\0';
+    }
+
+    char Next() {
+        if (m_position >= m_line.size()) {
+            throw std::runtime_error("Unexpected end of JSON line");
+        }
+        return m_line[m_position++];
+    }
+
+    void Expect(char expected) {
+        SkipWhitespace();
+        if (Next() != expected) {
+            throw std::runtime_error(std::string("Expected '") + expected + "' in JSON line");
+        }
+    }
+
+    void ExpectEnd() {
+        SkipWhitespace();
+        if (m_position != m_line.size()) {
+            throw std::runtime_error("Unexpected text after JSON object");
+        }
+    }
+
+    std::string ReadString() {
+        Expect('"');
+        std::string text;
+        while (true) {
+            char c = Next();
+            if (c == '"') {
+                return text;
+            }
+            if (c != '\\') {
+                text += c;
+                continue;
+            }
+
+            // Escapes; \u is only accepted for ASCII, which covers every
+            // valid field and palette name
+            char escaped = Next();
+            switch (escaped) {
+            case 'n': text += '\n'; break;
+            case 't': text += '\t'; break;
+            case 'r': text += '\r'; break;
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'u':
+                {
+                    if (m_position + 4 > m_line.size()) {
+                        throw std::runtime_error("Truncated \\u escape in JSON string");
+                    }
+                    unsigned long code = std::stoul(m_line.substr(m_position, 4), nullptr, 16);
+                    m_position += 4;
+                    if (code > 0x7f) {
+                        throw std::runtime_error("Non-ASCII \\u escape in JSON string");
+                    }
+                    text += static_cast<char>(code);
+                }
+                break;
+            default: text += escaped; break;
+            }
+        }
+    }
+
+    // Number, true, false or null
+    std::string ReadLiteral() {
+        size_t start = m_position;
+        while (m_position < m_line.size() && m_line[m_position] != ',' && m_line[m_position] != '}' &&
+            !std::isspace(static_cast<unsigned char>(m_line[m_position]))) {
+            m_position++;
+        }
+
+        std::string literal = m_line.substr(start, m_position - start);
+        if (literal.empty() || literal[0] == '{' || literal[0] == '[') {
+            throw std::runtime_error("Expected a string or number value in JSON object");
+        }
+        return literal;
+    }
+
+    const std::string& m_line;
+    size_t m_position;
+};
+
+static bool EndsWith(const std::string& text, const std::string& suffix) {
+    if (text.size() < suffix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < suffix.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(text[text.size() - suffix.size() + i])) != suffix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<RenderJob> LoadJobFile(const std::string& path, const RenderJob& defaults,
+    const JobFieldHandler& extraField) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open job file: " + path);
+    }
+
+    bool csv = EndsWith(path, ".csv");
+    std::vector<std::string> columns;
+    std::vector<RenderJob> jobs;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        std::string trimmed = Trim(line);
+        if (trimmed.empty() || trimmed[0] == '#') {
+            continue;
+        }
+
+        try {
+            if (csv && columns.empty()) {
+                columns = SplitCsvLine(trimmed);
+                continue;
+            }
+
+            RenderJob job = defaults;
+            auto applyField = [&](const std::string& name, const std::string& value) {
+                if (!extraField || !extraField(name, value, jobs.size(), job)) {
+                    ApplyJobField(name, value, job);
+                }
+            };
+
+            if (csv) {
+                std::vector<std::string> fields = SplitCsvLine(trimmed);
+                if (fields.size() != columns.size()) {
+                    throw std::runtime_error("Expected " + std::to_string(columns.size()) + " fields, found " +
+                        std::to_string(fields.size()));
+                }
+
+                // Empty fields keep the default
+                for (size_t i = 0; i < fields.size(); i++) {
+                    if (!fields[i].empty()) {
+                        applyField(columns[i], fields[i]);
+                    }
+                }
+            } else {
+                JsonLineReader reader(trimmed);
+                reader.ReadObject(applyField);
+            }
+
+            if (job.width == 0 || job.height == 0) {
+                throw std::runtime_error("Image size must be at least 1x1");
+            }
+
+            jobs.push_back(job);
+        } catch (const std::exception& e) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + e.what());
+        }
+    }
+
+    return jobs;
+}
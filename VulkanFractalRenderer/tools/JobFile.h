@@ -0,0 +1,38 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// One image of a batch
+struct RenderJob {
+    FractalUBO parameters;
+    uint32_t width;
+    uint32_t height;
+    // Output path; empty to use the batch's output pattern
+    std::string output;
+};
+
+// Load a job file. Files ending in .csv have a header row naming the columns
+// and one job per row (values must not contain commas); anything else is
+// read as JSON lines, one flat object per line. Blank lines and lines
+// starting with '#' are skipped.
+//
+// Field names are FractalUBO members (centerX, centerY, scale, fractalType,
+// maxIterations, colorPalette, juliaConstantX, juliaConstantY,
+// multibrotPower, colorOffset, colorMapping, outputChannel,
+// antialiasSamples, interiorDetection), the fractal options without their
+// dashes (fractal, palette, center-x, zoom, ...), width, height and output.
+// fractalType, colorPalette, colorMapping, outputChannel and
+// interiorDetection take numbers or names. Fields a job leaves out keep their
+// values from defaults. Throws with the file name and line on errors.
+//
+// Files that carry more than jobs (keyframes, for example) pass extraField,
+// which sees every field first along with the index of the job it belongs
+// to and returns true for the fields it handles itself.
+using JobFieldHandler = std::function<bool(const std::string& name, const std::string& value, size_t jobIndex, RenderJob& job)>;
+
+std::vector<RenderJob> LoadJobFile(const std::string& path, const RenderJob& defaults,
+    const JobFieldHandler& extraField = JobFieldHandler());
@@ -0,0 +1,128 @@
+#include "Keyframes.h"
+#include "JobFile.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+std::vector<Keyframe> LoadKeyframeFile(const std::string& path, const FractalUBO& defaults, uint32_t frameCount, uint32_t height) {
+    RenderJob defaultJob{};
+    defaultJob.parameters = defaults;
+    defaultJob.width = 1;
+    defaultJob.height = 1;
+
+    // Frame numbers by job index; -1 where a keyframe has none
+    std::vector<long long> frames;
+
+    std::vector<RenderJob> jobs = LoadJobFile(path, defaultJob,
+        [&frames](const std::string& name, const std::string& value, size_t jobIndex, RenderJob& job) {
+            if (name == "frame") {
+                frames.resize(std::max(frames.size(), jobIndex + 1), -1);
+                frames[jobIndex] = std::stoll(value);
+                if (frames[jobIndex] < 0) {
+                    throw std::runtime_error("Frame numbers must not be negative");
+                }
+                return true;
+            }
+            if (name == "logZoom" || name == "log-zoom") {
+                job.parameters.scale = static_cast<float>(std::exp2(-std::stod(value)));
+                return true;
+            }
+            return false;
+        });
+
+    if (jobs.size() < 2) {
+        throw std::runtime_error("An animation needs at least two keyframes: " + path);
+    }
+    frames.resize(jobs.size(), -1);
+
+    bool anyFrame = std::any_of(frames.begin(), frames.end(), [](long long frame) { return frame >= 0; });
+    bool allFrames = std::all_of(frames.begin(), frames.end(), [](long long frame) { return frame >= 0; });
+    if (anyFrame && !allFrames) {
+        throw std::runtime_error("Either every keyframe or none must have a frame number: " + path);
+    }
+    if (!anyFrame && frameCount < jobs.size()) {
+        throw std::runtime_error("Fewer frames than keyframes");
+    }
+
+    std::vector<Keyframe> keyframes(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        keyframes[i].parameters = jobs[i].parameters;
+        if (anyFrame) {
+            keyframes[i].frame = static_cast<uint32_t>(frames[i]);
+        } else {
+            // Spread evenly so the last keyframe is the last frame
+            keyframes[i].frame = static_cast<uint32_t>(std::llround(
+                static_cast<double>(i) * (frameCount - 1) / (jobs.size() - 1)));
+        }
+
+        if (keyframes[i].parameters.scale <= 0.0f) {
+            throw std::runtime_error("Keyframe " + std::to_string(i) + " has a zoom of zero");
+        }
+
+        // Past this depth neighbouring pixels round to the same float
+        // coordinate and the frame turns into blocks
+        float center = std::max(std::abs(keyframes[i].parameters.centerX), std::abs(keyframes[i].parameters.centerY));
+        double centerSpacing = static_cast<double>(std::nextafter(center, INFINITY)) - center;
+        double pixelSize = 2.0 * keyframes[i].parameters.scale / height;
+        if (pixelSize < centerSpacing) {
+            std::ostringstream message;
+            message << "Keyframe " << i << " zooms deeper than single precision resolves: pixels are "
+                << pixelSize << " apart but coordinates near its center are " << centerSpacing
+                << " apart; zoom out or lower the frame height";
+            throw std::runtime_error(message.str());
+        }
+
+        if (i > 0 && keyframes[i].frame <= keyframes[i - 1].frame) {
+            throw std::runtime_error("Keyframe frame numbers must increase: " + path);
+        }
+    }
+
+    return keyframes;
+}
+
+FractalUBO InterpolateKeyframes(const std::vector<Keyframe>& keyframes, uint32_t frame) {
+    if (frame <= keyframes.front().frame) {
+        return keyframes.front().parameters;
+    }
+    if (frame >= keyframes.back().frame) {
+        return keyframes.back().parameters;
+    }
+
+    // The segment containing the frame
+    size_t next = 1;
+    while (keyframes[next].frame < frame) {
+        next++;
+    }
+    const FractalUBO& from = keyframes[next - 1].parameters;
+    const FractalUBO& to = keyframes[next].parameters;
+    double t = static_cast<double>(frame - keyframes[next - 1].frame) /
+        static_cast<double>(keyframes[next].frame - keyframes[next - 1].frame);
+
+    // Scale is interpolated in log space, in double precision, so deep zooms
+    // keep a steady rate
+    double fromScale = from.scale;
+    double toScale = to.scale;
+    double scale = std::exp(std::log(fromScale) + (std::log(toScale) - std::log(fromScale)) * t);
+
+    // Moving the center by the fraction of the scale change already covered
+    // zooms towards the one point that both views keep at the same place on
+    // screen. Pure pans fall back to linear motion.
+    double centerWeight = t;
+    if (std::abs(fromScale - toScale) > 1e-6 * std::max(fromScale, toScale)) {
+        centerWeight = (fromScale - scale) / (fromScale - toScale);
+    }
+
+    // Everything not interpolated below (fractal type, palette, color
+    // mapping, output channel) holds until the next keyframe
+    FractalUBO ubo = from;
+    ubo.scale = static_cast<float>(scale);
+    ubo.centerX = static_cast<float>(from.centerX + (static_cast<double>(to.centerX) - from.centerX) * centerWeight);
+    ubo.centerY = static_cast<float>(from.centerY + (static_cast<double>(to.centerY) - from.centerY) * centerWeight);
+    ubo.maxIterations = static_cast<int>(std::lround(from.maxIterations + (to.maxIterations - from.maxIterations) * t));
+    ubo.juliaConstantX = static_cast<float>(from.juliaConstantX + (to.juliaConstantX - from.juliaConstantX) * t);
+    ubo.juliaConstantY = static_cast<float>(from.juliaConstantY + (to.juliaConstantY - from.juliaConstantY) * t);
+    ubo.multibrotPower = static_cast<float>(from.multibrotPower + (to.multibrotPower - from.multibrotPower) * t);
+    ubo.colorOffset = static_cast<float>(from.colorOffset + (to.colorOffset - from.colorOffset) * t);
+    return ubo;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// A view of an animation pinned to a frame
+struct Keyframe {
+    FractalUBO parameters;
+    uint32_t frame;
+};
+
+// Load keyframes from a file in the job file format (see LoadJobFile), with
+// two extra fields: frame, the frame number the keyframe is reached at, and
+// logZoom (or log-zoom), the base 2 logarithm of the zoom factor, as an
+// alternative to zoom and scale. Either every keyframe has a frame or none
+// has, in which case they are spread evenly over frameCount frames. Frames
+// must increase and there must be at least two keyframes. The shaders work
+// in single precision, so a keyframe is rejected when a pixel of a frame
+// height pixels tall (2 * scale / height) is finer than the float spacing at
+// its center; for a 1080 line frame around a center of magnitude 0.5 to 1
+// that is past logZoom 15.
+std::vector<Keyframe> LoadKeyframeFile(const std::string& path, const FractalUBO& defaults, uint32_t frameCount, uint32_t height);
+
+// The view at a frame between the first and the last keyframe. The zoom is
+// interpolated in log space, so it changes at a constant rate, and the
+// center moves in proportion to the change in scale, which keeps the point
+// being zoomed into fixed on screen. Iteration counts, fractal constants
+// and the color offset are interpolated linearly; the fractal type and
+// palette switch at the keyframe.
+FractalUBO InterpolateKeyframes(const std::vector<Keyframe>& keyframes, uint32_t frame);
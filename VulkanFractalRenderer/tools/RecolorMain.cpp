@@ -0,0 +1,252 @@
+#include "CpuColorer.h"
+#include "FractalOptions.h"
+#include "ImageWriter.h"
+#include "IterationFileReader.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+
+// fractal_recolor: color an iteration file written by fractal_render --raw
+// into a PPM without a GPU, with another palette, offset or mapping than it
+// was rendered with; print its header; or compare two of them. The file is
+// memory-mapped and worked through one row of tiles at a time, so a crop
+// only decodes the tiles it covers and even 16K renders need no more memory
+// than a few rows.
+
+static void PrintUsage() {
+    std::cout <<
+        "Usage: fractal_recolor --input=FILE [options]\n"
+        "  --input=FILE        iteration file written by fractal_render --raw\n"
+        "  --output=FILE       output image, binary PPM (default recolored.ppm)\n"
+        "  --region=X,Y,W,H    color only this rectangle of the image\n"
+        "  --info              print the file's size, encoding and parameters\n"
+        "  --compare=FILE      compare the values with another iteration file of the\n"
+        "                      same size instead of coloring\n"
+        "  --max-mismatch=P    with --compare, fail when more than P percent of the\n"
+        "                      pixels differ by over half an iteration (default 1)\n"
+        "  --palette=NAME      rainbow, fire, ocean, grayscale, electric or custom\n"
+        "  --gradient=STOPS    custom palette as position:RRGGBB stops, e.g.\n"
+        "                      0:000000,0.5:ff8000,1:ffffff (implies --palette=custom)\n"
+        "  --color-offset=O    shift the palette, one cycle per 1.0\n"
+        "  --color-mapping=M   linear or histogram (equalized over the region)\n"
+        "Coloring options default to the ones the file was rendered with.\n";
+}
+
+// Values further apart than this count as a mismatch, as in fractal_bench
+// --validate
+constexpr double MISMATCH_THRESHOLD = 0.5;
+
+// A rectangle of the image
+struct Region {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+static Region ParseRegion(const std::string& text) {
+    Region region;
+    char separator[3];
+    std::istringstream stream(text);
+    if (!(stream >> region.x >> separator[0] >> region.y >> separator[1] >> region.width >> separator[2] >> region.height) ||
+        separator[0] != ',' || separator[1] != ',' || separator[2] != ',' || region.width == 0 || region.height == 0) {
+        throw std::runtime_error("Malformed region: " + text + " (expected X,Y,W,H)");
+    }
+    return region;
+}
+
+// Pass the region to visit band by band, top first. Bands end on tile row
+// boundaries so each tile is decoded once per pass.
+static void ForEachBand(const IterationFileReader& reader, const Region& region,
+    const std::function<void(const float* values, uint32_t rowCount)>& visit) {
+    const uint32_t tileSize = reader.GetHeader().tileSize;
+    std::vector<float> band(static_cast<size_t>(region.width) * tileSize);
+
+    uint32_t y = region.y;
+    while (y < region.y + region.height) {
+        uint32_t end = std::min(region.y + region.height, (y / tileSize + 1) * tileSize);
+        reader.ReadRegion(region.x, y, region.width, end - y, band.data());
+        visit(band.data(), end - y);
+        y = end;
+    }
+}
+
+static void PrintInfo(const std::string& path, const IterationFileReader& reader) {
+    const IterationFileHeader& header = reader.GetHeader();
+    const FractalUBO& parameters = reader.GetParameters();
+
+    uint32_t compressedTiles = 0;
+    for (uint32_t tileY = 0; tileY < reader.GetTilesY(); tileY++) {
+        for (uint32_t tileX = 0; tileX < reader.GetTilesX(); tileX++) {
+            if (reader.GetTileEntry(tileX, tileY).encoding == ITERATION_COMPRESSION_RLE) {
+                compressedTiles++;
+            }
+        }
+    }
+
+    double rawSize = static_cast<double>(header.width) * header.height * sizeof(float);
+    std::cout << path << ": " << header.width << "x" << header.height << " "
+        << (parameters.outputChannel == OUTPUT_DISTANCE ? "distance estimates" : "iteration counts") << ", "
+        << (header.precision == ITERATION_PRECISION_FLOAT16 ? "float16" : "float32") << std::endl;
+    std::cout << "Tiles: " << reader.GetTilesX() << "x" << reader.GetTilesY() << " of " << header.tileSize << " pixels, "
+        << compressedTiles << " of " << reader.GetTilesX() * reader.GetTilesY() << " run-length encoded" << std::endl;
+    std::cout << "Size: " << reader.GetFileSize() / (1024.0 * 1024.0) << " MiB, "
+        << 100.0 * static_cast<double>(reader.GetFileSize()) / rawSize << "% of float32" << std::endl;
+    std::cout << std::setprecision(9) << "Fractal: " << GetFractalTypeName(static_cast<FractalType>(parameters.fractalType))
+        << ", center " << parameters.centerX << ", " << parameters.centerY << ", zoom " << 1.0 / parameters.scale
+        << ", " << parameters.maxIterations << " iterations" << std::endl;
+}
+
+// Compare the values of two files of the same size, in pixels for
+// distances. Returns whether at most maxMismatch percent differ.
+static bool Compare(const IterationFileReader& reader, const IterationFileReader& other, double maxMismatch) {
+    if (other.GetWidth() != reader.GetWidth() || other.GetHeight() != reader.GetHeight()) {
+        throw std::runtime_error("Iteration files to compare differ in size!");
+    }
+
+    const FractalUBO& parameters = reader.GetParameters();
+    double unit = parameters.outputChannel == OUTPUT_DISTANCE ? 2.0 * parameters.scale / parameters.imageHeight : 1.0;
+
+    Region region;
+    region.width = reader.GetWidth();
+    region.height = reader.GetHeight();
+    std::vector<float> otherBand(static_cast<size_t>(region.width) * reader.GetHeader().tileSize);
+
+    size_t mismatches = 0;
+    double totalDifference = 0.0;
+    double maxDifference = 0.0;
+    uint32_t y = 0;
+    ForEachBand(reader, region, [&](const float* values, uint32_t rowCount) {
+        other.ReadRegion(0, y, region.width, rowCount, otherBand.data());
+        for (size_t i = 0; i < static_cast<size_t>(region.width) * rowCount; i++) {
+            // Equal values first, so matching infinities count as equal
+            if (values[i] == otherBand[i]) {
+                continue;
+            }
+            double difference = std::abs(static_cast<double>(values[i]) - otherBand[i]) / unit;
+            totalDifference += difference;
+            maxDifference = std::max(maxDifference, difference);
+            if (difference > MISMATCH_THRESHOLD) {
+                mismatches++;
+            }
+        }
+        y += rowCount;
+    });
+
+    double pixelCount = static_cast<double>(region.width) * region.height;
+    double mismatchPercent = 100.0 * mismatches / pixelCount;
+    std::cout << std::fixed << std::setprecision(3) << "Mismatch: " << mismatchPercent << "%, mean difference "
+        << totalDifference / pixelCount << ", max difference " << maxDifference << std::endl;
+
+    bool passed = mismatchPercent <= maxMismatch;
+    std::cout << (passed ? "Comparison passed" : "Comparison failed") << std::endl;
+    return passed;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string input;
+        std::string output = "recolored.ppm";
+        std::string compare;
+        bool info = false;
+        bool hasRegion = false;
+        Region region;
+        double maxMismatch = 1.0;
+        std::vector<PaletteStop> gradient;
+
+        // Coloring options, applied over the file's parameters once it is open
+        std::vector<std::pair<std::string, std::string>> coloring;
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            std::string name, value;
+            SplitOption(argument, name, value);
+
+            if (name == "--help" || name == "-h") {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            } else if (name == "--input" && !value.empty()) {
+                input = value;
+            } else if (name == "--output" && !value.empty()) {
+                output = value;
+            } else if (name == "--compare" && !value.empty()) {
+                compare = value;
+            } else if (name == "--info") {
+                info = true;
+            } else if (name == "--region" && !value.empty()) {
+                region = ParseRegion(value);
+                hasRegion = true;
+            } else if (name == "--max-mismatch" && !value.empty()) {
+                maxMismatch = std::stod(value);
+            } else if (name == "--gradient" && !value.empty()) {
+                gradient = ParseGradient(value);
+                coloring.emplace_back("--palette", "custom");
+            } else if ((name == "--palette" || name == "--color-offset" || name == "--color-mapping") && !value.empty()) {
+                coloring.emplace_back(name, value);
+            } else {
+                throw std::runtime_error("Unknown command line option: " + argument);
+            }
+        }
+
+        if (input.empty()) {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+
+        IterationFileReader reader(input);
+        if (info) {
+            PrintInfo(input, reader);
+            return EXIT_SUCCESS;
+        }
+        if (!compare.empty()) {
+            IterationFileReader other(compare);
+            return Compare(reader, other, maxMismatch) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        FractalUBO ubo = reader.GetParameters();
+        for (const auto& option : coloring) {
+            ParseFractalOption(option.first, option.second, ubo);
+        }
+
+        if (!hasRegion) {
+            region.width = reader.GetWidth();
+            region.height = reader.GetHeight();
+        } else if (region.x >= reader.GetWidth() || region.width > reader.GetWidth() - region.x ||
+            region.y >= reader.GetHeight() || region.height > reader.GetHeight() - region.y) {
+            throw std::runtime_error("Region outside the iteration file!");
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        CpuColorer colorer(ubo, gradient);
+        if (colorer.NeedsHistogram()) {
+            ForEachBand(reader, region, [&](const float* values, uint32_t rowCount) {
+                colorer.AddToHistogram(values, static_cast<size_t>(region.width) * rowCount);
+            });
+            colorer.FinishHistogram();
+        }
+
+        PpmWriter writer(output, region.width, region.height);
+        std::vector<uint8_t> pixels(static_cast<size_t>(region.width) * reader.GetHeader().tileSize * 4);
+        ForEachBand(reader, region, [&](const float* values, uint32_t rowCount) {
+            colorer.Color(values, static_cast<size_t>(region.width) * rowCount, pixels.data());
+            writer.WriteRows(pixels.data(), rowCount);
+        });
+        writer.Finish();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Recolored " << region.width << "x" << region.height << " of " << input << " in " << milliseconds
+            << " ms to " << output << std::endl;
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,110 @@
+#include "HeadlessRenderer.h"
+#include "FractalOptions.h"
+#include "ImageWriter.h"
+#include "IterationFile.h"
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+
+// fractal_render: render a single image without a window and write it as a
+// binary PPM, or its raw iteration buffer as an iteration file
+
+// Rows evaluated per dispatch when writing an iteration file, so the
+// readback buffers stay small whatever the image size
+constexpr uint32_t RAW_BAND_ROWS = 1024;
+
+static void PrintUsage() {
+    std::cout <<
+        "Usage: fractal_render [options]\n"
+        "  --output=FILE       output image, binary PPM (default fractal.ppm)\n"
+        "  --width=W           image width in pixels (default 1920)\n"
+        "  --height=H          image height in pixels (default 1080)\n"
+        "  --raw=FILE          write the iteration buffer as an iteration file instead\n"
+        "                      of an image (see fractal_recolor)\n"
+        "  --raw-precision=P   float32 or float16 (default float32)\n"
+        "  --raw-compression=C none or rle (default rle)\n"
+        << GetFractalOptionsHelp();
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        FractalUBO ubo = DefaultFractalParameters();
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        std::string output = "fractal.ppm";
+        std::string raw;
+        IterationPrecision rawPrecision = ITERATION_PRECISION_FLOAT32;
+        IterationCompression rawCompression = ITERATION_COMPRESSION_RLE;
+        std::string device;
+        std::vector<PaletteStop> gradient;
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            std::string name, value;
+            SplitOption(argument, name, value);
+
+            if (name == "--help" || name == "-h") {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            } else if (name == "--output" && !value.empty()) {
+                output = value;
+            } else if (name == "--width" && !value.empty()) {
+                width = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--height" && !value.empty()) {
+                height = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--raw" && !value.empty()) {
+                raw = value;
+            } else if (name == "--raw-precision" && !value.empty()) {
+                rawPrecision = ParseIterationPrecision(value);
+            } else if (name == "--raw-compression" && !value.empty()) {
+                rawCompression = ParseIterationCompression(value);
+            } else if (name == "--device" && !value.empty()) {
+                device = value;
+            } else if (name == "--gradient" && !value.empty()) {
+                gradient = ParseGradient(value);
+                ubo.colorPalette = PALETTE_CUSTOM;
+            } else if (!ParseFractalOption(name, value, ubo)) {
+                throw std::runtime_error("Unknown command line option: " + argument);
+            }
+        }
+
+        HeadlessRenderer renderer(device);
+        if (!gradient.empty()) {
+            renderer.SetCustomPalette(gradient);
+        }
+        std::cout << "Device: " << renderer.GetDeviceName() << std::endl;
+
+        if (!raw.empty()) {
+            // Bands go straight from the readback buffer into the writer, so
+            // neither the renderer nor the writer ever holds the whole image
+            IterationFileWriter writer(raw, ubo, width, height, rawPrecision, rawCompression);
+            auto start = std::chrono::steady_clock::now();
+            renderer.RenderIterationBands(ubo, width, height, RAW_BAND_ROWS,
+                [&](const float* rows, uint32_t, uint32_t rowCount) { writer.WriteRows(rows, rowCount); });
+            writer.Finish();
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            double rawSize = static_cast<double>(width) * height * sizeof(float);
+            std::cout << "Rendered " << width << "x" << height << " " << GetFractalTypeName(static_cast<FractalType>(ubo.fractalType))
+                << " iterations in " << milliseconds << " ms (GPU " << renderer.GetLastGpuTime() << " ms) to " << raw
+                << " (" << writer.GetFileSize() / (1024.0 * 1024.0) << " MiB, "
+                << 100.0 * static_cast<double>(writer.GetFileSize()) / rawSize << "% of float32)" << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<uint8_t> pixels = renderer.Render(ubo, width, height);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        WritePpm(output, pixels.data(), width, height);
+
+        std::cout << "Rendered " << width << "x" << height << " " << GetFractalTypeName(static_cast<FractalType>(ubo.fractalType))
+            << " in " << milliseconds << " ms (GPU " << renderer.GetLastGpuTime() << " ms) to " << output << std::endl;
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,209 @@
+#include "TileCache.h"
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Pack file layout: a PACK_HEADER_SIZE header, then slotCount slots of
+// slotSize bytes. Each slot starts with SLOT_HEADER_SIZE bytes holding the
+// key and the blob size, followed by the blob. A slot is committed once its
+// key is nonzero; the key is written last, so a pack left behind by a crash
+// mid-insert holds at worst an empty slot.
+constexpr char PACK_MAGIC[8] = { 'V', 'F', 'R', 'P', 'A', 'C', 'K', '1' };
+constexpr size_t PACK_HEADER_SIZE = 4096;
+constexpr size_t SLOT_HEADER_SIZE = 16;
+constexpr size_t SLOT_ALIGNMENT = 4096;
+
+struct PackHeader {
+    char magic[8];
+    uint32_t slotSize;
+    uint32_t slotCount;
+};
+
+struct SlotHeader {
+    uint64_t key;
+    uint64_t size;
+};
+
+static std::string PackPath(const std::string& directory, size_t index) {
+    char name[32];
+    snprintf(name, sizeof(name), "pack_%05zu.vfrpack", index);
+    return (std::filesystem::path(directory) / name).string();
+}
+
+TileCache::TileCache(const std::string& directory, size_t maxBlobSize, uint32_t slotsPerPack)
+    : m_directory(directory)
+    , m_maxBlobSize(maxBlobSize)
+    , m_slotSize((SLOT_HEADER_SIZE + maxBlobSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT)
+    , m_slotsPerPack(std::max(1u, slotsPerPack))
+    , m_nextSlot(0)
+    , m_nextPackNumber(0) {
+    std::filesystem::create_directories(directory);
+
+    // Packs are numbered from 0 with no gaps; the last one is appended to
+    for (; std::filesystem::exists(PackPath(directory, m_nextPackNumber)); m_nextPackNumber++) {
+        if (OpenPack(PackPath(directory, m_nextPackNumber), false)) {
+            IndexPack(m_packs.size() - 1);
+        }
+    }
+}
+
+TileCache::~TileCache() {
+    for (const Pack& pack : m_packs) {
+        munmap(pack.base, pack.mappedSize);
+        close(pack.fd);
+    }
+}
+
+bool TileCache::OpenPack(const std::string& path, bool create) {
+    int fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open tile pack " + path + ": " + strerror(errno));
+    }
+
+    size_t mappedSize = PACK_HEADER_SIZE + m_slotSize * m_slotsPerPack;
+    if (create) {
+        // Sparse: Insert reserves each slot's blocks before writing it
+        if (ftruncate(fd, static_cast<off_t>(mappedSize)) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to size tile pack " + path + ": " + strerror(errno));
+        }
+        int result = posix_fallocate(fd, 0, static_cast<off_t>(PACK_HEADER_SIZE));
+        if (result != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to reserve space for tile pack " + path + ": " + strerror(result));
+        }
+    } else {
+        PackHeader header{};
+        if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+            header.slotSize != m_slotSize || header.slotCount != m_slotsPerPack ||
+            lseek(fd, 0, SEEK_END) < static_cast<off_t>(mappedSize)) {
+            close(fd);
+            return false;
+        }
+    }
+
+    void* base = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Failed to map tile pack " + path + ": " + strerror(errno));
+    }
+
+    if (create) {
+        PackHeader header{};
+        memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+        header.slotSize = static_cast<uint32_t>(m_slotSize);
+        header.slotCount = m_slotsPerPack;
+        memcpy(base, &header, sizeof(header));
+    }
+
+    m_packs.push_back({ fd, static_cast<uint8_t*>(base), mappedSize });
+    m_nextSlot = 0;
+    return true;
+}
+
+void TileCache::IndexPack(size_t packIndex) {
+    // Slots are handed out in order, but inserts commit in any order, so
+    // every slot up to the last committed one is in use
+    for (uint32_t slot = 0; slot < m_slotsPerPack; slot++) {
+        uint8_t* data = GetSlot(packIndex, slot);
+        SlotHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (header.key != 0 && header.size <= m_maxBlobSize) {
+            m_index.emplace(header.key, CachedBlob{ data + SLOT_HEADER_SIZE, static_cast<size_t>(header.size) });
+            m_nextSlot = slot + 1;
+        }
+    }
+}
+
+uint8_t* TileCache::GetSlot(size_t packIndex, uint32_t slot) const {
+    return m_packs[packIndex].base + PACK_HEADER_SIZE + m_slotSize * slot;
+}
+
+bool TileCache::Lookup(uint64_t key, CachedBlob& blob) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto entry = m_index.find(key);
+    if (entry == m_index.end()) {
+        return false;
+    }
+
+    blob = entry->second;
+    return true;
+}
+
+bool TileCache::Contains(uint64_t key) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_index.count(key) != 0;
+}
+
+CachedBlob TileCache::Insert(uint64_t key, size_t size, const BlobWriter& fill) {
+    if (key == 0) {
+        throw std::runtime_error("Tile cache keys must not be 0!");
+    }
+    if (size > m_maxBlobSize) {
+        throw std::runtime_error("Blob too large for the tile cache!");
+    }
+
+    // Reserve a slot, appending a pack when the last one is full
+    uint8_t* data;
+    int fd;
+    off_t offset;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        auto entry = m_index.find(key);
+        if (entry != m_index.end()) {
+            return entry->second;
+        }
+
+        if (m_packs.empty() || m_nextSlot == m_slotsPerPack) {
+            OpenPack(PackPath(m_directory, m_nextPackNumber++), true);
+        }
+        data = GetSlot(m_packs.size() - 1, m_nextSlot);
+        fd = m_packs.back().fd;
+        offset = static_cast<off_t>(PACK_HEADER_SIZE + m_slotSize * m_nextSlot);
+        m_nextSlot++;
+    }
+
+    // Writing a hole of the mapping with the disk full raises SIGBUS, so
+    // the slot's blocks are allocated first. A slot that fails here stays
+    // empty.
+    int result = posix_fallocate(fd, offset, static_cast<off_t>(m_slotSize));
+    if (result != 0) {
+        throw std::runtime_error(std::string("Failed to reserve space in the tile cache: ") + strerror(result));
+    }
+
+    fill(data + SLOT_HEADER_SIZE);
+
+    SlotHeader header{ 0, size };
+    memcpy(data, &header, sizeof(header));
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(data, &key, sizeof(key));
+
+    // A concurrent insert of the same key may have won; its slot stays the
+    // indexed one and this one is only found again on reopening
+    CachedBlob blob{ data + SLOT_HEADER_SIZE, size };
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    return m_index.emplace(key, blob).first->second;
+}
+
+CachedBlob TileCache::Insert(uint64_t key, const uint8_t* data, size_t size) {
+    return Insert(key, size, [&](uint8_t* destination) { memcpy(destination, data, size); });
+}
+
+size_t TileCache::GetEntryCount() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_index.size();
+}
+
+size_t TileCache::GetPackCount() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_packs.size();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+#include <cstddef>
+
+// A blob stored in a TileCache. Points into a mapped pack file and stays
+// valid as long as the cache exists.
+struct CachedBlob {
+    const uint8_t* data;
+    size_t size;
+};
+
+// Content-addressed on-disk cache for the tile server: blobs of up to
+// maxBlobSize bytes under 64-bit keys that hash what the blob shows, so equal
+// content is only ever stored once and a key never needs invalidating.
+//
+// Blobs go into pack files in one directory, each a fixed number of
+// equal-sized slots that is mapped into memory once, when it is opened or
+// created. A lookup is a hash table probe under a shared lock, and a hit
+// hands out a pointer into the page cache, without a read or a copy. Packs
+// are created sparse, so unused slots take no disk space. Entries are never
+// replaced or evicted; delete the directory to clear the cache.
+//
+// Lookup and Insert may be called from any thread. POSIX only (mmap).
+class TileCache {
+public:
+    static constexpr uint32_t DEFAULT_SLOTS_PER_PACK = 1024;
+
+    // Open the cache in directory, creating the directory if needed, and
+    // index the packs already there. Packs made for a different
+    // maxBlobSize are skipped. Throws on I/O errors.
+    TileCache(const std::string& directory, size_t maxBlobSize, uint32_t slotsPerPack = DEFAULT_SLOTS_PER_PACK);
+    ~TileCache();
+
+    // Delete copy constructors
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    // The blob stored under key, if any
+    bool Lookup(uint64_t key, CachedBlob& blob) const;
+    bool Contains(uint64_t key) const;
+
+    // Store a size-byte blob under key, written in place by fill, which
+    // runs without any lock held so inserts from several threads encode in
+    // parallel. Does nothing if key is already present. Returns the stored
+    // blob. Throws if size exceeds maxBlobSize or the disk is full.
+    using BlobWriter = std::function<void(uint8_t* data)>;
+    CachedBlob Insert(uint64_t key, size_t size, const BlobWriter& fill);
+    CachedBlob Insert(uint64_t key, const uint8_t* data, size_t size);
+
+    size_t GetEntryCount() const;
+    size_t GetPackCount() const;
+
+private:
+    struct Pack {
+        int fd;
+        uint8_t* base;
+        size_t mappedSize;
+    };
+
+    // Map the pack at path, creating it first if create is set. Returns
+    // false for an existing pack with another slot layout.
+    bool OpenPack(const std::string& path, bool create);
+    void IndexPack(size_t packIndex);
+    uint8_t* GetSlot(size_t packIndex, uint32_t slot) const;
+
+    std::string m_directory;
+    size_t m_maxBlobSize;
+    size_t m_slotSize;
+    uint32_t m_slotsPerPack;
+
+    // Guards the index and the packs; appending a pack takes it exclusively
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<uint64_t, CachedBlob> m_index;
+    std::vector<Pack> m_packs;
+
+    // Next free slot of the last pack, and the file number of the next pack
+    uint32_t m_nextSlot;
+    size_t m_nextPackNumber;
+};
@@ -0,0 +1,812 @@
+#include "HeadlessRenderer.h"
+#include "FractalOptions.h"
+#include "JobFile.h"
+#include "TileCache.h"
+#include "TilePyramid.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+
+// fractal_tiles: serve fractal scenes as zoomable tile pyramids over HTTP.
+// Tiles are addressed as (scene hash, level, x, y) and kept in an on-disk
+// TileCache, so a tile is only ever rendered once and cached tiles go out
+// straight from the mapped pack files. Missing tiles are built from their
+// four children when those are cached, and otherwise rendered on the GPU:
+// misses from all connections are collected for a short window and each
+// scene's share of them is rendered in a single batched dispatch, so a
+// viewer asking for a screenful of tiles costs one submission instead of
+// dozens. A minimal HTTP/1.1 server on a thread per connection, up to
+// MAX_CONNECTIONS at once, stands in for a real front end.
+
+static void PrintUsage() {
+    std::cout <<
+        "Usage: fractal_tiles [options]\n"
+        "  --cache=DIR         tile cache directory (default tile_cache)\n"
+        "  --port=N            HTTP port (default 8080)\n"
+        "  --bind=ADDRESS      IPv4 address to listen on (default 127.0.0.1)\n"
+        "  --scenes=FILE       job file with one scene per job (see README); without\n"
+        "                      it the fractal options give the only scene. Image\n"
+        "                      size and output fields are ignored\n"
+        "  --batch=N           most tiles rendered per GPU batch (default 64)\n"
+        "  --batch-window=MS   how long a miss waits for others to batch with\n"
+        "                      (default 2)\n"
+        "  --build=LEVEL       render every tile of LEVEL, build the levels above it\n"
+        "                      from their children and exit instead of serving\n"
+        "  --export=MODE       auto (default), staging or host-visible: how pixels\n"
+        "                      reach the host (see README)\n"
+        << GetFractalOptionsHelp() <<
+        "Tiles are served as /tiles/SCENE/LEVEL/X/Y.bmp; / lists the scenes and\n"
+        "/stats the cache and batching counters.\n";
+}
+
+// How a request was served
+enum TileSource {
+    TILE_SOURCE_CACHE = 0,
+    TILE_SOURCE_DOWNSAMPLED,
+    TILE_SOURCE_RENDERED
+};
+
+static const char* const TILE_SOURCE_NAMES[] = { "cache", "downsampled", "rendered" };
+
+// Tiles, from the cache or made on demand
+class TileService {
+public:
+    TileService(HeadlessRenderer& renderer, TileCache& cache, const std::map<uint64_t, FractalUBO>& scenes,
+        uint32_t maxBatch, std::chrono::microseconds batchWindow)
+        : m_renderer(renderer)
+        , m_cache(cache)
+        , m_scenes(scenes)
+        , m_maxBatch(std::max(1u, maxBatch))
+        , m_batchWindow(batchWindow)
+        , m_stopping(false)
+        , m_lastAntialiased(false) {
+        m_renderer.SetFrameConsumer([this](const RenderedFrame& frame) { StoreRenderedTile(frame); });
+    }
+
+    ~TileService() {
+        StopRendering();
+    }
+
+    // Serve misses from a render thread that batches them
+    void StartRendering() {
+        m_renderThread = std::thread(&TileService::RenderLoop, this);
+    }
+
+    void StopRendering() {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_stopping = true;
+        }
+        m_queueChanged.notify_all();
+
+        if (m_renderThread.joinable()) {
+            m_renderThread.join();
+        }
+    }
+
+    // The tile at address, making it if it is not cached yet. Blocks while
+    // it renders. Throws for unknown scenes, positions outside the pyramid
+    // and render errors.
+    CachedBlob GetTile(const TileAddress& address, TileSource& source) {
+        uint64_t key = GetTileKey(address);
+
+        CachedBlob blob;
+        source = TILE_SOURCE_CACHE;
+        if (m_cache.Lookup(key, blob)) {
+            m_hits++;
+            return blob;
+        }
+
+        GetScene(address);
+
+        source = TILE_SOURCE_DOWNSAMPLED;
+        if (Downsample(address, key, blob)) {
+            return blob;
+        }
+
+        source = TILE_SOURCE_RENDERED;
+        std::shared_future<void> done;
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+
+            // Join a render of the same tile that is already on its way. The
+            // render stores the tile before leaving m_pending, so if it is
+            // not there, the cache has to be checked again.
+            auto pending = m_pending.find(key);
+            if (pending != m_pending.end()) {
+                done = pending->second->done;
+            } else if (m_cache.Lookup(key, blob)) {
+                return blob;
+            } else {
+                auto tile = std::make_shared<PendingTile>();
+                tile->address = address;
+                tile->key = key;
+                tile->done = tile->promise.get_future().share();
+                done = tile->done;
+
+                m_pending.emplace(key, tile);
+                m_queue.push_back(tile);
+                m_queueChanged.notify_all();
+            }
+        }
+
+        done.get();
+        if (!m_cache.Lookup(key, blob)) {
+            throw std::runtime_error("Rendered tile missing from the cache!");
+        }
+        return blob;
+    }
+
+    // Fill the pyramid of one scene down to level: every tile of level not
+    // cached yet is rendered, in GPU batches, and every level above is then
+    // built from its children
+    void Build(uint64_t sceneHash, uint32_t level) {
+        std::vector<std::shared_ptr<PendingTile>> batch;
+        auto renderAndWait = [&]() {
+            RenderBatch(batch);
+            for (const auto& tile : batch) {
+                tile->done.get();
+            }
+            batch.clear();
+        };
+
+        uint32_t tiles = 1u << level;
+        for (uint32_t y = 0; y < tiles; y++) {
+            for (uint32_t x = 0; x < tiles; x++) {
+                auto tile = std::make_shared<PendingTile>();
+                tile->address = { sceneHash, level, x, y };
+                tile->key = GetTileKey(tile->address);
+                if (m_cache.Contains(tile->key)) {
+                    continue;
+                }
+
+                tile->done = tile->promise.get_future().share();
+                batch.push_back(tile);
+                if (batch.size() == m_maxBatch) {
+                    renderAndWait();
+                }
+            }
+        }
+        renderAndWait();
+
+        for (uint32_t parentLevel = level; parentLevel-- > 0;) {
+            for (uint32_t y = 0; y < (1u << parentLevel); y++) {
+                for (uint32_t x = 0; x < (1u << parentLevel); x++) {
+                    TileAddress address = { sceneHash, parentLevel, x, y };
+                    CachedBlob blob;
+                    uint64_t key = GetTileKey(address);
+                    if (!m_cache.Contains(key) && !Downsample(address, key, blob)) {
+                        throw std::runtime_error("Children missing while building the pyramid!");
+                    }
+                }
+            }
+        }
+    }
+
+    const std::map<uint64_t, FractalUBO>& GetScenes() const { return m_scenes; }
+
+    // Counters for /stats
+    std::string GetStats() const {
+        std::ostringstream stats;
+        uint64_t batches = m_batches;
+        stats << std::fixed << std::setprecision(3)
+            << "cache entries: " << m_cache.GetEntryCount() << " in " << m_cache.GetPackCount() << " packs\n"
+            << "hits: " << m_hits << "\n"
+            << "downsampled: " << m_downsampled << "\n"
+            << "rendered: " << m_rendered << " in " << batches << " batches ("
+            << (batches > 0 ? static_cast<double>(m_rendered) / batches : 0.0) << " tiles per batch)\n"
+            << "gpu ms per rendered tile: "
+            << (m_rendered > 0 ? m_gpuMicroseconds / 1000.0 / m_rendered : 0.0) << "\n";
+        return stats.str();
+    }
+
+private:
+    // A tile waiting for or going through the GPU; requests for it wait on
+    // done
+    struct PendingTile {
+        TileAddress address;
+        uint64_t key;
+        std::promise<void> promise;
+        std::shared_future<void> done;
+        bool finished = false;
+    };
+
+    const FractalUBO& GetScene(const TileAddress& address) const {
+        auto scene = m_scenes.find(address.sceneHash);
+        if (scene == m_scenes.end()) {
+            throw std::runtime_error("Unknown scene");
+        }
+        if (!IsValidTile(address.level, address.x, address.y)) {
+            throw std::runtime_error("Tile outside the pyramid");
+        }
+        return scene->second;
+    }
+
+    // Build the tile at address from its children if all four are cached
+    bool Downsample(const TileAddress& address, uint64_t key, CachedBlob& blob) {
+        if (address.level >= MAX_TILE_LEVEL) {
+            return false;
+        }
+
+        const uint8_t* children[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            TileAddress child = { address.sceneHash, address.level + 1, address.x * 2 + (i & 1), address.y * 2 + (i >> 1) };
+            CachedBlob childBlob;
+            if (!m_cache.Lookup(GetTileKey(child), childBlob)) {
+                return false;
+            }
+            children[i] = childBlob.data;
+        }
+
+        blob = m_cache.Insert(key, TILE_BLOB_SIZE, [&](uint8_t* tile) { DownsampleTile(children, tile); });
+        m_downsampled++;
+        return true;
+    }
+
+    void RenderLoop() {
+        while (true) {
+            std::vector<std::shared_ptr<PendingTile>> batch;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueChanged.wait(lock, [this] { return !m_queue.empty() || m_stopping; });
+                if (m_stopping) {
+                    return;
+                }
+
+                // Give the rest of a viewer's requests a moment to arrive
+                m_queueChanged.wait_for(lock, m_batchWindow, [this] { return m_queue.size() >= m_maxBatch || m_stopping; });
+
+                size_t count = std::min<size_t>(m_queue.size(), m_maxBatch);
+                batch.assign(m_queue.begin(), m_queue.begin() + count);
+                m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+            }
+
+            RenderBatch(batch);
+        }
+    }
+
+    // Submit every tile of batch and wait until they are all stored. Tiles
+    // that fail pass the error on to whoever waits for them.
+    void RenderBatch(const std::vector<std::shared_ptr<PendingTile>>& batch) {
+        if (batch.empty()) {
+            return;
+        }
+
+        // Tiles of a scene share everything but their view, so each scene's
+        // tiles go out as one batched dispatch. Anti-aliased scenes need the
+        // whole-image passes and go out a tile per frame. The two render at
+        // different image sizes, and every switch between them drains and
+        // reallocates the renderer's frames, so each kind goes out together,
+        // starting with the kind the previous batch ended with.
+        std::map<uint64_t, std::vector<std::shared_ptr<PendingTile>>> scenes;
+        for (const auto& tile : batch) {
+            scenes[tile->address.sceneHash].push_back(tile);
+        }
+
+        try {
+            for (bool antialiased : { m_lastAntialiased, !m_lastAntialiased }) {
+                for (const auto& [sceneHash, tiles] : scenes) {
+                    const FractalUBO& scene = GetScene(tiles.front()->address);
+                    if ((scene.antialiasSamples > 1) != antialiased) {
+                        continue;
+                    }
+                    m_lastAntialiased = antialiased;
+                    if (antialiased) {
+                        SubmitAntialiased(scene, tiles);
+                    } else {
+                        SubmitBatched(scene, tiles);
+                    }
+                }
+            }
+            m_renderer.Flush();
+            m_batches++;
+        } catch (...) {
+            std::exception_ptr error = std::current_exception();
+
+            // Frames submitted before the failure still finish and store
+            // their tiles; wait for them, so the frames of the next batch
+            // start from an empty ring
+            try {
+                m_renderer.Flush();
+            } catch (...) {
+                // The batch fails with the first error either way
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_inFlightMutex);
+                m_inFlight.clear();
+            }
+            for (const auto& tile : batch) {
+                Finish(tile, error);
+            }
+        }
+    }
+
+    // Submit the tiles of an anti-aliased scene, a tile per frame
+    void SubmitAntialiased(const FractalUBO& scene, const std::vector<std::shared_ptr<PendingTile>>& tiles) {
+        for (const auto& tile : tiles) {
+            SubmitFrame({ tile }, [&]() {
+                m_renderer.Submit(GetTileParameters(scene, tile->address.level, tile->address.x, tile->address.y),
+                    TILE_SIZE, TILE_SIZE);
+            });
+        }
+    }
+
+    // Submit the tiles of a scene as batched dispatches, one frame per
+    // dispatch the device can hold, so each frame's tiles are registered
+    // under its own id
+    void SubmitBatched(const FractalUBO& scene, const std::vector<std::shared_ptr<PendingTile>>& tiles) {
+        const size_t maxBatch = std::max<uint32_t>(m_renderer.GetMaxTileBatch(TILE_SIZE), 1);
+        for (size_t first = 0; first < tiles.size(); first += maxBatch) {
+            std::vector<std::shared_ptr<PendingTile>> frameTiles(tiles.begin() + first,
+                tiles.begin() + std::min(tiles.size(), first + maxBatch));
+            std::vector<TileDescriptor> descriptors;
+            for (const auto& tile : frameTiles) {
+                FractalUBO parameters = GetTileParameters(scene, tile->address.level, tile->address.x, tile->address.y);
+                descriptors.push_back({ parameters.centerX, parameters.centerY, parameters.scale,
+                    parameters.fractalType, parameters.maxIterations, parameters.colorPalette,
+                    parameters.juliaConstantX, parameters.juliaConstantY });
+            }
+            SubmitFrame(frameTiles, [&]() { m_renderer.SubmitTiles(scene, descriptors, TILE_SIZE); });
+        }
+    }
+
+    // Submit a frame holding tiles, top to bottom. The tiles are registered
+    // under the frame's id before the frame can possibly finish, and the
+    // consumer only stores a frame under the tiles registered for its id.
+    // Only the render thread submits, so the next id is this frame's.
+    void SubmitFrame(const std::vector<std::shared_ptr<PendingTile>>& tiles, const std::function<void()>& submit) {
+        uint64_t id = m_renderer.GetNextFrameId();
+        {
+            std::lock_guard<std::mutex> lock(m_inFlightMutex);
+            m_inFlight[id] = tiles;
+        }
+
+        try {
+            submit();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(m_inFlightMutex);
+            m_inFlight.erase(id);
+            throw;
+        }
+    }
+
+    // Frame consumer, on the renderer's readback thread
+    void StoreRenderedTile(const RenderedFrame& frame) {
+        std::vector<std::shared_ptr<PendingTile>> tiles;
+        {
+            // Frames nobody registered never belong to another frame's tiles
+            std::lock_guard<std::mutex> lock(m_inFlightMutex);
+            auto entry = m_inFlight.find(frame.id);
+            if (entry == m_inFlight.end()) {
+                return;
+            }
+            tiles = std::move(entry->second);
+            m_inFlight.erase(entry);
+        }
+
+        const size_t tilePixels = static_cast<size_t>(TILE_SIZE) * TILE_SIZE * 4;
+        for (size_t i = 0; i < tiles.size(); i++) {
+            m_cache.Insert(tiles[i]->key, TILE_BLOB_SIZE, [&](uint8_t* data) { EncodeTile(frame.pixels + i * tilePixels, data); });
+        }
+        m_rendered += tiles.size();
+        m_gpuMicroseconds += static_cast<uint64_t>(frame.gpuTime * 1000.0);
+        for (const auto& tile : tiles) {
+            Finish(tile, nullptr);
+        }
+    }
+
+    void Finish(const std::shared_ptr<PendingTile>& tile, std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (tile->finished) {
+            return;
+        }
+
+        tile->finished = true;
+        m_pending.erase(tile->key);
+        if (error) {
+            tile->promise.set_exception(error);
+        } else {
+            tile->promise.set_value();
+        }
+    }
+
+    HeadlessRenderer& m_renderer;
+    TileCache& m_cache;
+    std::map<uint64_t, FractalUBO> m_scenes;
+    uint32_t m_maxBatch;
+    std::chrono::microseconds m_batchWindow;
+
+    // Misses waiting for the render thread, and every tile queued or
+    // rendering by key
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueChanged;
+    std::deque<std::shared_ptr<PendingTile>> m_queue;
+    std::map<uint64_t, std::shared_ptr<PendingTile>> m_pending;
+    bool m_stopping;
+
+    // Tiles of each submitted frame by frame id
+    std::mutex m_inFlightMutex;
+    std::map<uint64_t, std::vector<std::shared_ptr<PendingTile>>> m_inFlight;
+
+    std::thread m_renderThread;
+
+    // Whether the render thread last submitted an anti-aliased tile, and so
+    // which image size the renderer is configured for
+    bool m_lastAntialiased;
+
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_downsampled{ 0 };
+    std::atomic<uint64_t> m_rendered{ 0 };
+    std::atomic<uint64_t> m_batches{ 0 };
+    std::atomic<uint64_t> m_gpuMicroseconds{ 0 };
+};
+
+static std::string FormatSceneHash(uint64_t hash) {
+    std::ostringstream text;
+    text << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return text.str();
+}
+
+// Parse /tiles/SCENE/LEVEL/X/Y.bmp
+static bool ParseTilePath(const std::string& path, TileAddress& address) {
+    const std::string prefix = "/tiles/";
+    const std::string suffix = ".bmp";
+    if (path.compare(0, prefix.size(), prefix) != 0 || path.size() < prefix.size() + suffix.size() ||
+        path.compare(path.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+
+    std::vector<std::string> parts;
+    std::istringstream stream(path.substr(prefix.size(), path.size() - prefix.size() - suffix.size()));
+    std::string part;
+    while (std::getline(stream, part, '/')) {
+        const char* digits = parts.empty() ? "0123456789abcdefABCDEF" : "0123456789";
+        if (part.empty() || part.find_first_not_of(digits) != std::string::npos) {
+            return false;
+        }
+        parts.push_back(part);
+    }
+    if (parts.size() != 4 || parts[0].size() > 16 || parts[1].size() > 2 || parts[2].size() > 5 || parts[3].size() > 5) {
+        return false;
+    }
+
+    try {
+        address.sceneHash = std::stoull(parts[0], nullptr, 16);
+        address.level = static_cast<uint32_t>(std::stoul(parts[1]));
+        address.x = static_cast<uint32_t>(std::stoul(parts[2]));
+        address.y = static_cast<uint32_t>(std::stoul(parts[3]));
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+// Write all of the buffers, headers and body in one go where the socket
+// takes them
+static bool SendAll(int socket, const std::string& headers, const uint8_t* body, size_t bodySize) {
+    iovec parts[2];
+    parts[0].iov_base = const_cast<char*>(headers.data());
+    parts[0].iov_len = headers.size();
+    parts[1].iov_base = const_cast<uint8_t*>(body);
+    parts[1].iov_len = bodySize;
+
+    iovec* remaining = parts;
+    int count = bodySize > 0 ? 2 : 1;
+    while (count > 0) {
+        ssize_t written = writev(socket, remaining, count);
+        if (written <= 0) {
+            return false;
+        }
+
+        size_t left = static_cast<size_t>(written);
+        while (count > 0 && left >= remaining->iov_len) {
+            left -= remaining->iov_len;
+            remaining++;
+            count--;
+        }
+        if (count > 0) {
+            remaining->iov_base = static_cast<uint8_t*>(remaining->iov_base) + left;
+            remaining->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+static bool SendResponse(int socket, const char* status, const char* contentType, const std::string& extraHeaders,
+    const uint8_t* body, size_t bodySize, bool keepAlive) {
+    std::ostringstream headers;
+    headers << "HTTP/1.1 " << status << "\r\n"
+        << "Content-Type: " << contentType << "\r\n"
+        << "Content-Length: " << bodySize << "\r\n"
+        << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n"
+        << extraHeaders << "\r\n";
+    return SendAll(socket, headers.str(), body, bodySize);
+}
+
+static bool SendText(int socket, const char* status, const std::string& text, bool keepAlive) {
+    return SendResponse(socket, status, "text/plain; charset=utf-8", std::string(),
+        reinterpret_cast<const uint8_t*>(text.data()), text.size(), keepAlive);
+}
+
+// Requests and responses on one connection until the client closes it.
+// Only GET without a body is understood.
+static void ServeConnection(TileService& service, int socket) {
+    std::string buffer;
+    char chunk[4096];
+    bool keepAlive = true;
+
+    while (keepAlive) {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+            if (received <= 0 || buffer.size() > 65536) {
+                close(socket);
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+
+        std::string request = buffer.substr(0, headerEnd);
+        buffer.erase(0, headerEnd + 4);
+        auto start = std::chrono::steady_clock::now();
+
+        std::istringstream requestLine(request.substr(0, request.find("\r\n")));
+        std::string method, path, version;
+        requestLine >> method >> path >> version;
+        path = path.substr(0, path.find('?'));
+
+        std::string lowerRequest = request;
+        std::transform(lowerRequest.begin(), lowerRequest.end(), lowerRequest.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        keepAlive = version == "HTTP/1.1" && lowerRequest.find("\r\nconnection: close") == std::string::npos;
+
+        bool sent;
+        TileAddress address;
+        if (method != "GET") {
+            sent = SendText(socket, "405 Method Not Allowed", "Only GET is supported\n", keepAlive);
+        } else if (path == "/") {
+            std::ostringstream text;
+            text << "Scenes (tiles at /tiles/SCENE/LEVEL/X/Y.bmp, levels 0 to " << MAX_TILE_LEVEL << "):\n";
+            for (const auto& scene : service.GetScenes()) {
+                text << FormatSceneHash(scene.first) << "  "
+                    << GetFractalTypeName(static_cast<FractalType>(scene.second.fractalType))
+                    << " center " << scene.second.centerX << "," << scene.second.centerY
+                    << " scale " << scene.second.scale << "\n";
+            }
+            sent = SendText(socket, "200 OK", text.str(), keepAlive);
+        } else if (path == "/stats") {
+            sent = SendText(socket, "200 OK", service.GetStats(), keepAlive);
+        } else if (ParseTilePath(path, address)) {
+            try {
+                TileSource source;
+                CachedBlob blob = service.GetTile(address, source);
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                // Tile contents never change, so clients can keep them
+                std::ostringstream headers;
+                headers << "Cache-Control: public, max-age=31536000, immutable\r\n"
+                    << "ETag: \"" << FormatSceneHash(GetTileKey(address)) << "\"\r\n"
+                    << "Server-Timing: " << TILE_SOURCE_NAMES[source] << ";dur=" << milliseconds << "\r\n";
+                sent = SendResponse(socket, "200 OK", "image/bmp", headers.str(), blob.data, blob.size, keepAlive);
+            } catch (const std::exception& e) {
+                sent = SendText(socket, "404 Not Found", std::string(e.what()) + "\n", keepAlive);
+            }
+        } else {
+            sent = SendText(socket, "404 Not Found", "Not found\n", keepAlive);
+        }
+
+        keepAlive = keepAlive && sent;
+    }
+
+    close(socket);
+}
+
+// Most connections served at once; further clients wait in the listen
+// backlog until one closes
+constexpr uint32_t MAX_CONNECTIONS = 256;
+
+// Pause after a failed accept, so errors that persist (such as running out
+// of file descriptors) do not spin the accept loop
+constexpr std::chrono::milliseconds ACCEPT_RETRY_DELAY(100);
+
+// Connection threads running, shared by the accept loop and the detached
+// connection threads
+struct ConnectionCount {
+    std::mutex mutex;
+    std::condition_variable closed;
+    uint32_t count = 0;
+};
+
+static void Serve(TileService& service, const std::string& bindAddress, uint16_t port) {
+    // Clients hanging up mid-response must not end the server
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("Failed to create the server socket");
+    }
+
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1) {
+        close(listener);
+        throw std::runtime_error("Invalid bind address: " + bindAddress);
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        close(listener);
+        throw std::runtime_error("Failed to listen on " + bindAddress + ":" + std::to_string(port) + ": " + strerror(errno));
+    }
+
+    std::cerr << "Serving on http://" << bindAddress << ":" << port << "/" << std::endl;
+    auto connections = std::make_shared<ConnectionCount>();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(connections->mutex);
+            connections->closed.wait(lock, [&connections] { return connections->count < MAX_CONNECTIONS; });
+        }
+
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno != EINTR) {
+                std::this_thread::sleep_for(ACCEPT_RETRY_DELAY);
+            }
+            continue;
+        }
+
+        // Small responses go out at once instead of waiting for more
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        {
+            std::lock_guard<std::mutex> lock(connections->mutex);
+            connections->count++;
+        }
+        std::thread([&service, connections, connection]() {
+            ServeConnection(service, connection);
+
+            std::lock_guard<std::mutex> lock(connections->mutex);
+            connections->count--;
+            connections->closed.notify_one();
+        }).detach();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        FractalUBO defaults = DefaultFractalParameters();
+        std::string cacheDirectory = "tile_cache";
+        std::string bindAddress = "127.0.0.1";
+        std::string sceneFile;
+        std::string device;
+        std::vector<PaletteStop> gradient;
+        uint16_t port = 8080;
+        uint32_t maxBatch = 64;
+        double batchWindow = 2.0;
+        int buildLevel = -1;
+        ExportMode exportMode = EXPORT_MODE_AUTO;
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            std::string name, value;
+            SplitOption(argument, name, value);
+
+            if (name == "--help" || name == "-h") {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            } else if (name == "--cache" && !value.empty()) {
+                cacheDirectory = value;
+            } else if (name == "--port" && !value.empty()) {
+                port = static_cast<uint16_t>(std::stoul(value));
+            } else if (name == "--bind" && !value.empty()) {
+                bindAddress = value;
+            } else if (name == "--scenes" && !value.empty()) {
+                sceneFile = value;
+            } else if (name == "--batch" && !value.empty()) {
+                maxBatch = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--batch-window" && !value.empty()) {
+                batchWindow = std::stod(value);
+            } else if (name == "--build" && !value.empty()) {
+                buildLevel = std::stoi(value);
+            } else if (name == "--export" && !value.empty()) {
+                exportMode = ParseExportMode(value);
+            } else if (name == "--device" && !value.empty()) {
+                device = value;
+            } else if (name == "--gradient" && !value.empty()) {
+                gradient = ParseGradient(value);
+                defaults.colorPalette = PALETTE_CUSTOM;
+            } else if (!ParseFractalOption(name, value, defaults)) {
+                throw std::runtime_error("Unknown command line option: " + argument);
+            }
+        }
+
+        if (buildLevel > static_cast<int>(MAX_TILE_LEVEL)) {
+            throw std::runtime_error("--build level must be at most " + std::to_string(MAX_TILE_LEVEL));
+        }
+
+        // Scenes are addressed by the hash of what they show, so restarts
+        // with the same scenes find their tiles again
+        std::vector<FractalUBO> sceneList;
+        if (sceneFile.empty()) {
+            sceneList.push_back(defaults);
+        } else {
+            // Tiles have their own size; width, height and output fields of
+            // scenes are ignored
+            RenderJob jobDefaults{};
+            jobDefaults.parameters = defaults;
+            jobDefaults.width = TILE_SIZE;
+            jobDefaults.height = TILE_SIZE;
+            for (const RenderJob& job : LoadJobFile(sceneFile, jobDefaults)) {
+                sceneList.push_back(job.parameters);
+            }
+        }
+
+        std::map<uint64_t, FractalUBO> scenes;
+        for (const FractalUBO& scene : sceneList) {
+            FractalUBO normalized = NormalizeScene(scene);
+            uint64_t hash = HashScene(normalized, gradient);
+            scenes.emplace(hash, normalized);
+            std::cerr << "Scene " << FormatSceneHash(hash) << ": "
+                << GetFractalTypeName(static_cast<FractalType>(normalized.fractalType)) << std::endl;
+        }
+
+        TileCache cache(cacheDirectory, TILE_BLOB_SIZE);
+        HeadlessRenderer renderer(device, exportMode);
+        if (!gradient.empty()) {
+            renderer.SetCustomPalette(gradient);
+        }
+        std::cerr << "Device: " << renderer.GetDeviceName() << ", " << cache.GetEntryCount()
+            << " tiles cached in " << cacheDirectory << std::endl;
+
+        TileService service(renderer, cache, scenes,
+            maxBatch, std::chrono::microseconds(static_cast<int64_t>(batchWindow * 1000.0)));
+
+        if (buildLevel >= 0) {
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& scene : scenes) {
+                service.Build(scene.first, static_cast<uint32_t>(buildLevel));
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cerr << "Built levels 0 to " << buildLevel << " in " << std::fixed << std::setprecision(2)
+                << seconds << " s\n" << service.GetStats();
+            return EXIT_SUCCESS;
+        }
+
+        service.StartRendering();
+        Serve(service, bindAddress, port);
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,170 @@
+#include "TilePyramid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// 64-bit FNV-1a, fed field by field
+class Fnv1a {
+public:
+    Fnv1a()
+        : m_hash(14695981039346656037ull) {
+    }
+
+    template<typename T>
+    void Add(const T& value) {
+        uint8_t bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T));
+        for (uint8_t byte : bytes) {
+            m_hash = (m_hash ^ byte) * 1099511628211ull;
+        }
+    }
+
+    uint64_t GetHash() const { return m_hash; }
+
+private:
+    uint64_t m_hash;
+};
+
+// Bumped whenever tiles of the same scene would come out differently, so
+// caches from older versions are not served
+constexpr uint32_t TILE_FORMAT_VERSION = 1;
+
+FractalUBO NormalizeScene(const FractalUBO& scene) {
+    FractalUBO normalized = scene;
+    normalized.aspectRatio = 1.0f;
+    normalized.projection = PROJECTION_PLANE;
+    normalized.colorMapping = COLOR_MAPPING_LINEAR;
+    normalized.imageWidth = 0;
+    normalized.imageHeight = 0;
+    normalized.rowOffset = 0;
+    normalized.rowCount = 0;
+    normalized.interiorDetection &= INTERIOR_DETECTION_TYPES & (1 << scene.fractalType);
+    if (scene.fractalType != FRACTAL_JULIA) {
+        normalized.juliaConstantX = 0.0f;
+        normalized.juliaConstantY = 0.0f;
+    }
+    if (scene.fractalType != FRACTAL_MULTIBROT) {
+        normalized.multibrotPower = 0.0f;
+    }
+    if (normalized.antialiasSamples < 2) {
+        normalized.antialiasSamples = 0;
+    }
+    return normalized;
+}
+
+uint64_t HashScene(const FractalUBO& scene, const std::vector<PaletteStop>& gradient) {
+    Fnv1a hash;
+    hash.Add(TILE_FORMAT_VERSION);
+    hash.Add(scene);
+    if (scene.colorPalette == PALETTE_CUSTOM) {
+        for (const PaletteStop& stop : gradient) {
+            hash.Add(stop);
+        }
+    }
+    return hash.GetHash();
+}
+
+uint64_t GetTileKey(const TileAddress& address) {
+    Fnv1a hash;
+    hash.Add(address.sceneHash);
+    hash.Add(address.level);
+    hash.Add(address.x);
+    hash.Add(address.y);
+    return std::max<uint64_t>(hash.GetHash(), 1);
+}
+
+bool IsValidTile(uint32_t level, uint32_t x, uint32_t y) {
+    return level <= MAX_TILE_LEVEL && x < (1u << level) && y < (1u << level);
+}
+
+FractalUBO GetTileParameters(const FractalUBO& scene, uint32_t level, uint32_t x, uint32_t y) {
+    // Positions in double, so deep tiles keep their place on the grid until
+    // the final rounding
+    double tiles = static_cast<double>(1u << level);
+    double tileSize = 2.0 * scene.scale / tiles;
+
+    FractalUBO tile = scene;
+    tile.centerX = static_cast<float>(scene.centerX - scene.scale + (x + 0.5) * tileSize);
+    tile.centerY = static_cast<float>(scene.centerY - scene.scale + (y + 0.5) * tileSize);
+    tile.scale = static_cast<float>(scene.scale / tiles);
+    return tile;
+}
+
+static void WriteLittleEndian(uint8_t* destination, uint32_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        destination[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+// BITMAPFILEHEADER and BITMAPINFOHEADER of a TILE_SIZE square 24-bit image,
+// with a negative height for top row first
+static void WriteBmpHeader(uint8_t* tile) {
+    memset(tile, 0, TILE_BMP_HEADER_SIZE);
+    tile[0] = 'B';
+    tile[1] = 'M';
+    WriteLittleEndian(tile + 2, static_cast<uint32_t>(TILE_BLOB_SIZE), 4);
+    WriteLittleEndian(tile + 10, static_cast<uint32_t>(TILE_BMP_HEADER_SIZE), 4);
+    WriteLittleEndian(tile + 14, 40, 4);
+    WriteLittleEndian(tile + 18, TILE_SIZE, 4);
+    WriteLittleEndian(tile + 22, static_cast<uint32_t>(-static_cast<int32_t>(TILE_SIZE)), 4);
+    WriteLittleEndian(tile + 26, 1, 2);
+    WriteLittleEndian(tile + 28, 24, 2);
+    WriteLittleEndian(tile + 34, static_cast<uint32_t>(TILE_SIZE * TILE_SIZE * 3), 4);
+}
+
+void EncodeTile(const uint8_t* pixels, uint8_t* tile) {
+    WriteBmpHeader(tile);
+
+    // Rows of 768 bytes need no padding to 4 bytes
+    uint8_t* destination = tile + TILE_BMP_HEADER_SIZE;
+    for (size_t i = 0; i < static_cast<size_t>(TILE_SIZE) * TILE_SIZE; i++) {
+        destination[i * 3 + 0] = pixels[i * 4 + 2];
+        destination[i * 3 + 1] = pixels[i * 4 + 1];
+        destination[i * 3 + 2] = pixels[i * 4 + 0];
+    }
+}
+
+// sRGB to linear for every 8-bit value, and linear back to sRGB at
+// LINEAR_STEPS evenly spaced points
+constexpr int LINEAR_STEPS = 4096;
+
+struct SrgbTables {
+    float toLinear[256];
+    uint8_t toSrgb[LINEAR_STEPS + 1];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            float value = i / 255.0f;
+            toLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i <= LINEAR_STEPS; i++) {
+            float value = static_cast<float>(i) / LINEAR_STEPS;
+            float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = static_cast<uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+void DownsampleTile(const uint8_t* const children[4], uint8_t* tile) {
+    static const SrgbTables tables;
+
+    WriteBmpHeader(tile);
+
+    const size_t rowSize = static_cast<size_t>(TILE_SIZE) * 3;
+    const uint32_t half = TILE_SIZE / 2;
+    for (uint32_t y = 0; y < TILE_SIZE; y++) {
+        // Children 0 and 1 fill the top half, 2 and 3 the bottom half
+        uint8_t* destination = tile + TILE_BMP_HEADER_SIZE + y * rowSize;
+        for (uint32_t x = 0; x < TILE_SIZE; x++) {
+            const uint8_t* child = children[(y >= half ? 2 : 0) + (x >= half ? 1 : 0)] + TILE_BMP_HEADER_SIZE;
+            const uint8_t* top = child + (y % half) * 2 * rowSize + (x % half) * 2 * 3;
+            const uint8_t* bottom = top + rowSize;
+
+            for (int channel = 0; channel < 3; channel++) {
+                float sum = tables.toLinear[top[channel]] + tables.toLinear[top[3 + channel]] +
+                    tables.toLinear[bottom[channel]] + tables.toLinear[bottom[3 + channel]];
+                destination[x * 3 + channel] = tables.toSrgb[static_cast<int>(sum * (LINEAR_STEPS / 4.0f) + 0.5f)];
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "FractalParameters.h"
+#include "PaletteLut.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Addressing and encoding of the fractal_tiles pyramid. A scene is a view of
+// a fractal (FractalUBO without the image fields); its level 0 is a single
+// tile covering the square 2 * scale wide around the scene's center, and
+// each level below splits every tile of the one above into 2 x 2, so level L
+// is 2^L x 2^L tiles. Tile x grows with the real axis and tile y with the
+// imaginary axis, like image columns and rows.
+
+constexpr uint32_t TILE_SIZE = 256;
+
+// Deepest level: below this, single precision tile centers no longer
+// resolve tile pixels
+constexpr uint32_t MAX_TILE_LEVEL = 16;
+
+// Tiles are stored and served as top-down 24-bit BMP files, which browsers
+// and map viewers display as they are
+constexpr size_t TILE_BMP_HEADER_SIZE = 54;
+constexpr size_t TILE_BLOB_SIZE = TILE_BMP_HEADER_SIZE + TILE_SIZE * TILE_SIZE * 3;
+
+struct TileAddress {
+    uint64_t sceneHash;
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+};
+
+// The scene as tiles render it: plane projection, linear color mapping
+// (histogram equalization per tile would make neighbouring tiles disagree)
+// and the constants of other fractal types cleared, so scenes that look the
+// same hash the same
+FractalUBO NormalizeScene(const FractalUBO& scene);
+
+// Content hash of a normalized scene, including the gradient for
+// PALETTE_CUSTOM; the first part of every tile address
+uint64_t HashScene(const FractalUBO& scene, const std::vector<PaletteStop>& gradient);
+
+// Cache key of a tile: a hash of its address, never 0
+uint64_t GetTileKey(const TileAddress& address);
+
+// Whether the level and position exist in the pyramid
+bool IsValidTile(uint32_t level, uint32_t x, uint32_t y);
+
+// Render parameters of one tile of a normalized scene, for TILE_SIZE square
+// images
+FractalUBO GetTileParameters(const FractalUBO& scene, uint32_t level, uint32_t x, uint32_t y);
+
+// Encode TILE_SIZE x TILE_SIZE RGBA8 pixels, top row first, into a
+// TILE_BLOB_SIZE byte tile
+void EncodeTile(const uint8_t* pixels, uint8_t* tile);
+
+// Build a tile from its four children (x, y), (x + 1, y), (x, y + 1) and
+// (x + 1, y + 1) at the level below, in that order, by averaging each 2 x 2
+// block of child pixels in linear light
+void DownsampleTile(const uint8_t* const children[4], uint8_t* tile);
@@ -0,0 +1,489 @@
+#include "HeadlessRenderer.h"
+#include "FractalOptions.h"
+#include "Keyframes.h"
+#include "VideoWriter.h"
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+// fractal_video: render a zoom animation from keyframes and stream it as Y4M
+// or raw RGBA. Frames pass through three stages that run concurrently: the
+// main thread submits renders, the renderer's readback thread converts each
+// finished frame into the stream's pixel layout, and a writer thread appends
+// the converted frames to the output. Only a few frames are in memory at any
+// time however long the animation is.
+
+static void PrintUsage() {
+    std::cerr <<
+        "Usage: fractal_video --keyframes=FILE [options]\n"
+        "  --keyframes=FILE    keyframe file, .csv or JSON lines (see README)\n"
+        "  --output=FILE       output file, or - for standard output (default -)\n"
+        "  --format=NAME       y4m (default) or rgba\n"
+        "  --width=W           frame width in pixels (default 1920)\n"
+        "  --height=H          frame height in pixels (default 1080)\n"
+        "  --fps=N             frames per second written to the Y4M header (default 30)\n"
+        "  --frames=N          frame count for keyframes without frame numbers (default 300)\n"
+        "  --export=MODE       auto (default), staging or host-visible: how pixels\n"
+        "                      reach the host (see README)\n"
+        "  --exp-map           render the zoom path once as an exponential map strip\n"
+        "                      and resample every frame from it\n"
+        "  --strip-width=N     exponential map samples per turn (default pi * height)\n"
+        "  --reuse=N           resample up to N frames from each larger source view\n"
+        "                      instead of evaluating every frame\n"
+        "  --reuse-scale=S     sources have at most S * S times the pixels of a frame\n"
+        "                      (default 2)\n"
+        "  --reuse-quality=Q   source pixels are at most Q times the size of the\n"
+        "                      pixels of the frames they serve (default 1)\n"
+        << GetFractalOptionsHelp() <<
+        "The fractal options set defaults for fields a keyframe leaves out.\n";
+}
+
+// The write stage: a fixed set of frame buffers cycles between the readback
+// thread, which fills them, and the writer thread, which writes them out in
+// order. When the output is slower than the GPU, the readback thread waits
+// for a free buffer, which in turn holds back new renders.
+class FrameQueue {
+public:
+    FrameQueue(VideoWriter& writer, size_t bufferCount)
+        : m_writer(writer)
+        , m_stopping(false) {
+        for (size_t i = 0; i < bufferCount; i++) {
+            m_freeBuffers.emplace_back(writer.GetFrameSize());
+        }
+        m_thread = std::thread(&FrameQueue::WriteLoop, this);
+    }
+
+    ~FrameQueue() {
+        Stop();
+    }
+
+    // A buffer to convert the next frame into; blocks until one is free
+    std::vector<uint8_t> AcquireBuffer() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_bufferAvailable.wait(lock, [this] { return !m_freeBuffers.empty() || !m_error.empty(); });
+        ThrowIfFailed();
+
+        std::vector<uint8_t> buffer = std::move(m_freeBuffers.back());
+        m_freeBuffers.pop_back();
+        return buffer;
+    }
+
+    // Queue a converted frame after the ones before it
+    void Push(std::vector<uint8_t>&& frame) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ThrowIfFailed();
+
+        m_queue.push_back(std::move(frame));
+        m_workAvailable.notify_one();
+    }
+
+    // Write everything queued and stop the thread. Rethrows the first write
+    // error.
+    void Finish() {
+        Stop();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ThrowIfFailed();
+    }
+
+private:
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    void WriteLoop() {
+        while (true) {
+            std::vector<uint8_t> frame;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_workAvailable.wait(lock, [this] { return !m_queue.empty() || m_stopping; });
+                if (m_queue.empty()) {
+                    return;
+                }
+
+                frame = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            std::string error;
+            try {
+                m_writer.WriteFrame(frame.data());
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_freeBuffers.push_back(std::move(frame));
+                if (!error.empty()) {
+                    m_error = error;
+                }
+            }
+            m_bufferAvailable.notify_one();
+
+            // Nothing more can be written after a failure; AcquireBuffer and
+            // Push report the error from now on
+            if (!error.empty()) {
+                return;
+            }
+        }
+    }
+
+    // Callers hold m_mutex
+    void ThrowIfFailed() const {
+        if (!m_error.empty()) {
+            throw std::runtime_error(m_error);
+        }
+    }
+
+    VideoWriter& m_writer;
+    bool m_stopping;
+    std::string m_error;
+    std::deque<std::vector<uint8_t>> m_queue;
+    std::vector<std::vector<uint8_t>> m_freeBuffers;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_bufferAvailable;
+};
+
+// The exponential map strip covering every frame: centered on the last
+// keyframe, the point the animation zooms into, reaching out to the farthest
+// frame corner and in to the smallest half pixel. Frames can only be
+// resampled from one strip if they all show the same fractal.
+struct ExpMapCoverage {
+    FractalUBO parameters;
+    double outerRadius;
+    double innerRadius;
+};
+
+static ExpMapCoverage GetExpMapCoverage(const std::vector<FractalUBO>& frames, uint32_t width, uint32_t height) {
+    ExpMapCoverage coverage{};
+    coverage.parameters = frames.back();
+    coverage.outerRadius = 0.0;
+    coverage.innerRadius = HUGE_VAL;
+
+    double aspectRatio = static_cast<double>(width) / height;
+    for (const FractalUBO& frame : frames) {
+        if (frame.fractalType != coverage.parameters.fractalType ||
+            frame.juliaConstantX != coverage.parameters.juliaConstantX ||
+            frame.juliaConstantY != coverage.parameters.juliaConstantY ||
+            frame.multibrotPower != coverage.parameters.multibrotPower) {
+            throw std::runtime_error("--exp-map needs the same fractal and constants in every keyframe");
+        }
+        coverage.parameters.maxIterations = std::max(coverage.parameters.maxIterations, frame.maxIterations);
+
+        double offsetX = std::abs(static_cast<double>(frame.centerX) - coverage.parameters.centerX);
+        double offsetY = std::abs(static_cast<double>(frame.centerY) - coverage.parameters.centerY);
+        coverage.outerRadius = std::max(coverage.outerRadius,
+            std::hypot(offsetX + aspectRatio * frame.scale, offsetY + static_cast<double>(frame.scale)));
+        coverage.innerRadius = std::min(coverage.innerRadius, static_cast<double>(frame.scale) / height);
+    }
+
+    return coverage;
+}
+
+// Limits on the sources of --reuse
+struct ReuseOptions {
+    uint32_t maxFrames;
+    double pixelBudget;
+    double quality;
+    // The device's limit (HeadlessRenderer::GetMaxSourcePixels)
+    double maxSourcePixels;
+};
+
+// Largest source side; beyond this a source is no longer worth its memory
+constexpr double MAX_SOURCE_SIZE = 16384.0;
+
+// A plane source for --reuse and the frames it serves
+struct SourcePlan {
+    FractalUBO parameters;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameCount;
+};
+
+static bool SameFractal(const FractalUBO& a, const FractalUBO& b) {
+    return a.fractalType == b.fractalType && a.juliaConstantX == b.juliaConstantX &&
+        a.juliaConstantY == b.juliaConstantY && a.multibrotPower == b.multibrotPower;
+}
+
+// Plan the source for the frames from first on: the bounding box of as many
+// consecutive frames as fit the budget, sampled at the smallest pixel size
+// among them scaled by the quality threshold. In a zoom the first frame is
+// the widest, so the source is in effect a sharper render of it that the
+// following frames zoom into. A frameCount of 0 means not even the first
+// frame fits; it has to be rendered directly.
+static SourcePlan PlanSource(const std::vector<FractalUBO>& frames, uint32_t first, uint32_t width, uint32_t height,
+    const ReuseOptions& options) {
+    SourcePlan plan{};
+    double aspectRatio = static_cast<double>(width) / height;
+    double minX = HUGE_VAL, maxX = -HUGE_VAL, minY = HUGE_VAL, maxY = -HUGE_VAL;
+    double pixelSize = HUGE_VAL;
+    int maxIterations = 0;
+
+    for (uint32_t i = first; i < frames.size() && plan.frameCount < options.maxFrames; i++) {
+        const FractalUBO& frame = frames[i];
+        if (!SameFractal(frame, frames[first])) {
+            break;
+        }
+
+        double halfHeight = frame.scale;
+        double halfWidth = aspectRatio * halfHeight;
+        double nextMinX = std::min(minX, frame.centerX - halfWidth);
+        double nextMaxX = std::max(maxX, frame.centerX + halfWidth);
+        double nextMinY = std::min(minY, frame.centerY - halfHeight);
+        double nextMaxY = std::max(maxY, frame.centerY + halfHeight);
+        double nextPixelSize = std::min(pixelSize, options.quality * 2.0 * halfHeight / height);
+
+        double sourceWidth = std::ceil((nextMaxX - nextMinX) / nextPixelSize);
+        double sourceHeight = std::ceil((nextMaxY - nextMinY) / nextPixelSize);
+        if (sourceWidth * sourceHeight > options.pixelBudget || sourceWidth * sourceHeight > options.maxSourcePixels ||
+            sourceWidth > MAX_SOURCE_SIZE || sourceHeight > MAX_SOURCE_SIZE) {
+            break;
+        }
+
+        minX = nextMinX;
+        maxX = nextMaxX;
+        minY = nextMinY;
+        maxY = nextMaxY;
+        pixelSize = nextPixelSize;
+        maxIterations = std::max(maxIterations, frame.maxIterations);
+        plan.width = static_cast<uint32_t>(sourceWidth);
+        plan.height = static_cast<uint32_t>(sourceHeight);
+        plan.frameCount++;
+    }
+
+    // Whole pixels round the box up a little; the view keeps them square
+    plan.parameters = frames[first];
+    plan.parameters.centerX = static_cast<float>((minX + maxX) * 0.5);
+    plan.parameters.centerY = static_cast<float>((minY + maxY) * 0.5);
+    plan.parameters.scale = static_cast<float>(plan.height * pixelSize * 0.5);
+    plan.parameters.maxIterations = maxIterations;
+    return plan;
+}
+
+static VideoFormat ParseVideoFormat(const std::string& name) {
+    if (name == "y4m") {
+        return VIDEO_FORMAT_Y4M;
+    } else if (name == "rgba") {
+        return VIDEO_FORMAT_RGBA;
+    }
+    throw std::runtime_error("Unknown video format: " + name + " (expected y4m or rgba)");
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        FractalUBO defaults = DefaultFractalParameters();
+        std::string keyframeFile;
+        std::string output = "-";
+        std::string device;
+        std::vector<PaletteStop> gradient;
+        VideoFormat format = VIDEO_FORMAT_Y4M;
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t framesPerSecond = 30;
+        uint32_t frameCount = 300;
+        ExportMode exportMode = EXPORT_MODE_AUTO;
+        bool expMap = false;
+        uint32_t stripWidth = 0;
+        uint32_t reuse = 0;
+        double reuseScale = 2.0;
+        double reuseQuality = 1.0;
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            std::string name, value;
+            SplitOption(argument, name, value);
+
+            if (name == "--help" || name == "-h") {
+                PrintUsage();
+                return EXIT_SUCCESS;
+            } else if (name == "--keyframes" && !value.empty()) {
+                keyframeFile = value;
+            } else if (name == "--output" && !value.empty()) {
+                output = value;
+            } else if (name == "--format" && !value.empty()) {
+                format = ParseVideoFormat(value);
+            } else if (name == "--width" && !value.empty()) {
+                width = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--height" && !value.empty()) {
+                height = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--fps" && !value.empty()) {
+                framesPerSecond = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(value)));
+            } else if (name == "--frames" && !value.empty()) {
+                frameCount = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--export" && !value.empty()) {
+                exportMode = ParseExportMode(value);
+            } else if (name == "--exp-map") {
+                expMap = true;
+            } else if (name == "--strip-width" && !value.empty()) {
+                stripWidth = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--reuse" && !value.empty()) {
+                reuse = static_cast<uint32_t>(std::stoul(value));
+            } else if (name == "--reuse-scale" && !value.empty()) {
+                reuseScale = std::stod(value);
+            } else if (name == "--reuse-quality" && !value.empty()) {
+                reuseQuality = std::stod(value);
+            } else if (name == "--device" && !value.empty()) {
+                device = value;
+            } else if (name == "--gradient" && !value.empty()) {
+                gradient = ParseGradient(value);
+                defaults.colorPalette = PALETTE_CUSTOM;
+            } else if (!ParseFractalOption(name, value, defaults)) {
+                throw std::runtime_error("Unknown command line option: " + argument);
+            }
+        }
+
+        if (keyframeFile.empty()) {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+        if (width == 0 || height == 0) {
+            throw std::runtime_error("Frame size must be at least 1x1");
+        }
+        if (expMap && reuse > 0) {
+            throw std::runtime_error("--exp-map and --reuse are alternatives; pick one");
+        }
+        if (!(reuseScale >= 1.0) || !(reuseQuality > 0.0)) {
+            throw std::runtime_error("--reuse-scale must be at least 1 and --reuse-quality above 0");
+        }
+
+        std::vector<Keyframe> keyframes = LoadKeyframeFile(keyframeFile, defaults, frameCount, height);
+        frameCount = keyframes.back().frame + 1;
+
+        std::vector<FractalUBO> frames(frameCount);
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            frames[frame] = InterpolateKeyframes(keyframes, frame);
+        }
+
+        // Progress goes to standard error so the video can go to standard
+        // output. Declaration order matters: the renderer's readback thread
+        // feeds the queue, which feeds the writer, until the renderer is
+        // destroyed.
+        VideoWriter writer(output, format, width, height, framesPerSecond);
+        FrameQueue queue(writer, 4);
+
+        HeadlessRenderer renderer(device, exportMode);
+        if (!gradient.empty()) {
+            renderer.SetCustomPalette(gradient);
+        }
+        std::cerr << "Device: " << renderer.GetDeviceName() << ", " << frameCount << " frames of "
+            << width << "x" << height << " from " << keyframes.size() << " keyframes" << std::endl;
+
+        // Only touched by the readback thread until Flush returns
+        double totalGpuMilliseconds = 0.0;
+        uint32_t writtenFrames = 0;
+
+        renderer.SetFrameConsumer([&](const RenderedFrame& frame) {
+            // Convert straight out of the readback buffer, which then goes
+            // back to the GPU
+            std::vector<uint8_t> buffer = queue.AcquireBuffer();
+            writer.ConvertFrame(frame.pixels, buffer.data());
+            queue.Push(std::move(buffer));
+
+            totalGpuMilliseconds += frame.gpuTime;
+            writtenFrames++;
+            if (writtenFrames % 100 == 0) {
+                std::cerr << "Frame " << writtenFrames << "/" << frameCount << std::endl;
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+
+        if (expMap) {
+            // One strip pixel per frame pixel at the inscribed circle of the
+            // frame by default; corners are resampled a little softer
+            if (stripWidth == 0) {
+                stripWidth = static_cast<uint32_t>(std::ceil(3.14159265358979323846 * height / 8.0)) * 8;
+            }
+
+            ExpMapCoverage coverage = GetExpMapCoverage(frames, width, height);
+            renderer.RenderExpMap(coverage.parameters, coverage.outerRadius, coverage.innerRadius, stripWidth, width, height);
+
+            std::cerr << "Exponential map strip " << renderer.GetSourceWidth() << "x" << renderer.GetSourceHeight()
+                << " at " << coverage.parameters.maxIterations << " iterations rendered in "
+                << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+        }
+
+        // With --reuse, sources and frames are submitted in one stream: a new
+        // source waits on the GPU for the frames resampled from the last one
+        ReuseOptions reuseOptions{};
+        reuseOptions.maxFrames = reuse;
+        reuseOptions.pixelBudget = reuseScale * reuseScale * width * height;
+        reuseOptions.quality = reuseQuality;
+        reuseOptions.maxSourcePixels = static_cast<double>(renderer.GetMaxSourcePixels());
+
+        // Frames before sourceEnd are resampled, unless no source could
+        // serve them
+        uint32_t sourceEnd = 0;
+        bool hasSource = false;
+        uint32_t sourceCount = 0;
+        uint32_t directFrames = 0;
+        double evaluatedPixels = 0.0;
+
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            if (expMap) {
+                renderer.SubmitResampled(frames[frame], width, height);
+                continue;
+            }
+
+            if (reuse > 0 && frame >= sourceEnd) {
+                SourcePlan plan = PlanSource(frames, frame, width, height, reuseOptions);
+                hasSource = plan.frameCount > 0;
+                sourceEnd = frame + std::max<uint32_t>(plan.frameCount, 1);
+                if (hasSource) {
+                    renderer.RenderSource(plan.parameters, plan.width, plan.height, width, height);
+                    sourceCount++;
+                    evaluatedPixels += static_cast<double>(plan.width) * plan.height;
+                }
+            }
+
+            if (hasSource) {
+                renderer.SubmitResampled(frames[frame], width, height);
+            } else {
+                renderer.Submit(frames[frame], width, height);
+                directFrames++;
+                evaluatedPixels += static_cast<double>(width) * height;
+            }
+        }
+
+        renderer.Flush();
+        queue.Finish();
+        writer.Close();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cerr << std::fixed << std::setprecision(2)
+            << "Rendered " << frameCount << " frames in " << seconds << " s: "
+            << (seconds > 0.0 ? frameCount / seconds : 0.0) << " frames/s, GPU busy "
+            << totalGpuMilliseconds * 1e-3 << " s" << std::endl;
+        if (reuse > 0) {
+            std::cerr << sourceCount << " sources and " << directFrames << " direct frames evaluated "
+                << evaluatedPixels / (static_cast<double>(frameCount) * width * height) * 100.0
+                << "% of the pixels of rendering every frame" << std::endl;
+        }
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
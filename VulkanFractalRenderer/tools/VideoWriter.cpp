@@ -0,0 +1,137 @@
+#include "VideoWriter.h"
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+VideoWriter::VideoWriter(const std::string& path, VideoFormat format, uint32_t width, uint32_t height,
+    uint32_t framesPerSecond)
+    : m_path(path)
+    , m_format(format)
+    , m_width(width)
+    , m_height(height)
+    , m_file(nullptr)
+    , m_ownsFile(false) {
+    if (path == "-") {
+#ifdef _WIN32
+        // Frames are binary; stop the C runtime from translating newlines
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        m_file = stdout;
+        m_path = "standard output";
+    } else {
+        m_file = std::fopen(path.c_str(), "wb");
+        if (m_file == nullptr) {
+            throw std::runtime_error("Failed to open output file: " + path);
+        }
+        m_ownsFile = true;
+    }
+
+    if (m_format == VIDEO_FORMAT_Y4M) {
+        std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) +
+            " F" + std::to_string(framesPerSecond) + ":1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n";
+        Write(header.data(), header.size());
+    }
+}
+
+VideoWriter::~VideoWriter() {
+    if (m_ownsFile && m_file != nullptr) {
+        std::fclose(m_file);
+    }
+}
+
+size_t VideoWriter::GetFrameSize() const {
+    size_t pixelCount = static_cast<size_t>(m_width) * m_height;
+    if (m_format == VIDEO_FORMAT_RGBA) {
+        return pixelCount * 4;
+    }
+
+    // Full-resolution luma and two chroma planes at half resolution in each
+    // direction, rounded up for odd sizes
+    size_t chromaCount = static_cast<size_t>((m_width + 1) / 2) * ((m_height + 1) / 2);
+    return pixelCount + chromaCount * 2;
+}
+
+static uint8_t ClampToByte(float value) {
+    return static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+}
+
+void VideoWriter::ConvertFrame(const uint8_t* pixels, uint8_t* frame) const {
+    if (m_format == VIDEO_FORMAT_RGBA) {
+        std::copy(pixels, pixels + GetFrameSize(), frame);
+        return;
+    }
+
+    // JFIF (full-range BT.601) coefficients, which is what C420jpeg means
+    uint8_t* lumaPlane = frame;
+    for (size_t i = 0; i < static_cast<size_t>(m_width) * m_height; i++) {
+        const uint8_t* pixel = pixels + i * 4;
+        lumaPlane[i] = ClampToByte(0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2]);
+    }
+
+    // Chroma of each 2x2 block from its average color; blocks on the right
+    // and bottom edge of odd sizes average the pixels they have
+    uint32_t chromaWidth = (m_width + 1) / 2;
+    uint32_t chromaHeight = (m_height + 1) / 2;
+    uint8_t* cbPlane = lumaPlane + static_cast<size_t>(m_width) * m_height;
+    uint8_t* crPlane = cbPlane + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+        for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+            float red = 0.0f, green = 0.0f, blue = 0.0f;
+            uint32_t count = 0;
+            for (uint32_t y = cy * 2; y < std::min(cy * 2 + 2, m_height); y++) {
+                for (uint32_t x = cx * 2; x < std::min(cx * 2 + 2, m_width); x++) {
+                    const uint8_t* pixel = pixels + (static_cast<size_t>(y) * m_width + x) * 4;
+                    red += pixel[0];
+                    green += pixel[1];
+                    blue += pixel[2];
+                    count++;
+                }
+            }
+            red /= count;
+            green /= count;
+            blue /= count;
+
+            size_t index = static_cast<size_t>(cy) * chromaWidth + cx;
+            cbPlane[index] = ClampToByte(128.0f - 0.168736f * red - 0.331264f * green + 0.5f * blue);
+            crPlane[index] = ClampToByte(128.0f + 0.5f * red - 0.418688f * green - 0.081312f * blue);
+        }
+    }
+}
+
+void VideoWriter::WriteFrame(const uint8_t* frame) {
+    if (m_format == VIDEO_FORMAT_Y4M) {
+        static const char FRAME_HEADER[] = "FRAME\n";
+        Write(FRAME_HEADER, sizeof(FRAME_HEADER) - 1);
+    }
+    Write(frame, GetFrameSize());
+}
+
+void VideoWriter::Close() {
+    if (m_file == nullptr) {
+        return;
+    }
+
+    bool failed = std::fflush(m_file) != 0;
+    if (m_ownsFile) {
+        failed = std::fclose(m_file) != 0 || failed;
+    }
+    m_file = nullptr;
+
+    if (failed) {
+        throw std::runtime_error("Failed to write " + m_path);
+    }
+}
+
+void VideoWriter::Write(const void* data, size_t size) {
+    if (m_file == nullptr) {
+        throw std::runtime_error("Output already closed: " + m_path);
+    }
+    if (std::fwrite(data, 1, size, m_file) != size) {
+        throw std::runtime_error("Failed to write " + m_path);
+    }
+}
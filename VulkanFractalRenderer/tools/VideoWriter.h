@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+// Stream formats for rendered animations
+enum VideoFormat {
+    // YUV4MPEG2 with full-range BT.601 4:2:0 (C420jpeg), which ffmpeg, x264
+    // and most players read directly
+    VIDEO_FORMAT_Y4M = 0,
+    // Headerless width * height RGBA8 frames, e.g. for
+    // ffmpeg -f rawvideo -pixel_format rgba
+    VIDEO_FORMAT_RGBA
+};
+
+// Writes frames one after another to a file or to standard output ("-"),
+// so an animation never has to be held in memory. Throws on I/O errors.
+class VideoWriter {
+public:
+    VideoWriter(const std::string& path, VideoFormat format, uint32_t width, uint32_t height, uint32_t framesPerSecond);
+    ~VideoWriter();
+
+    // Delete copy constructors
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    // Bytes of one frame in the stream's pixel layout
+    size_t GetFrameSize() const;
+
+    // Convert width * height RGBA8 pixels, top row first, into the stream's
+    // pixel layout. Safe to call from any thread.
+    void ConvertFrame(const uint8_t* pixels, uint8_t* frame) const;
+
+    // Append a frame in the stream's pixel layout
+    void WriteFrame(const uint8_t* frame);
+
+    // Flush and close the output; the destructor closes without reporting
+    // errors
+    void Close();
+
+private:
+    void Write(const void* data, size_t size);
+
+    std::string m_path;
+    VideoFormat m_format;
+    uint32_t m_width;
+    uint32_t m_height;
+    std::FILE* m_file;
+    bool m_ownsFile;
+};